@@ -53,6 +53,8 @@ void DoWriteOutput(const ConfigParameters& config);
 template <typename ElemType>
 void DoCreateLabelMap(const ConfigParameters& config);
 template <typename ElemType>
+void DoConvertCorpus(const ConfigParameters& config);
+template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
@@ -112,6 +112,29 @@ void DoCreateLabelMap(const ConfigParameters& config)
 template void DoCreateLabelMap<float>(const ConfigParameters& config);
 template void DoCreateLabelMap<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoConvertCorpus() - implements CNTK "convertCorpus" command
+// Writes the corpus described by the deserializers of the reader section into
+// the binary format of the CNTKBinaryReader, which reads it without any parsing.
+// ===========================================================================
+
+template <typename ElemType>
+void DoConvertCorpus(const ConfigParameters& config)
+{
+    typedef void (*ConvertCorpusProc)(const ConfigParameters& config);
+
+    // the binary format stores the values as they are used, so they are written in the precision of the command
+    ConfigParameters convertConfig(config);
+    convertConfig.Insert("precision", sizeof(ElemType) == sizeof(float) ? "float" : "double");
+
+    Plugin plugin;
+    ConvertCorpusProc convertCorpus = (ConvertCorpusProc) plugin.Load(std::string("CNTKBinaryReader"), "ConvertCorpus");
+    convertCorpus(convertConfig);
+}
+
+template void DoConvertCorpus<float>(const ConfigParameters& config);
+template void DoConvertCorpus<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoParameterSVD() - implements CNTK "SVD" command
 // ===========================================================================
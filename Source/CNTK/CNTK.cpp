@@ -19,6 +19,7 @@
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
 #include "CommonMatrix.h"
+#include "ConvolutionEngine.h" // for ConvolutionEngineAutotuning
 #include "SGD.h"
 #include "MPIWrapper.h"
 #include "Config.h"
@@ -281,6 +282,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoCreateLabelMap<ElemType>(commandParams);
                 }
+                else if (thisAction == "convertCorpus")
+                {
+                    DoConvertCorpus<ElemType>(commandParams);
+                }
                 else if (thisAction == "writeWordAndClass")
                 {
                     DoWriteWordAndClassInfo<ElemType>(commandParams);
@@ -482,6 +487,8 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
+    ConvolutionEngineAutotuning::Enable(config(L"autotuneConvolution", false), config(L"convolutionAutotuneCache", L""));
+
     // logging
     wstring logpath = config(L"stderr", L"");
     if (logpath != L"")
@@ -580,6 +587,8 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
+    ConvolutionEngineAutotuning::Enable(config(L"autotuneConvolution", false), config(L"convolutionAutotuneCache", L""));
+
     if (logpath != L"")
     {
         for (int i = 0; i < command.size(); i++)
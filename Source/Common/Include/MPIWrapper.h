@@ -19,6 +19,7 @@
 #include <array>
 #include <vector>
 #include <memory>
+#include <cstring>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -58,6 +59,24 @@ static int operator||(int rc, const MpiFail &what)
     RuntimeError("%s", what.c_str());
 }
 
+// algorithm used by MPIWrapper::AllReduce() to sum up a buffer over all nodes
+enum class MPIAllReduceAlgorithm : int
+{
+    Default,     // MPI_Allreduce() of the installed MPI library
+    Ring,        // reduce-scatter followed by all-gather around a ring; each node sends and receives 2(N-1)/N of the buffer
+    Hierarchical // reduce within each host through shared memory, ring across hosts, then gather within each host
+};
+
+static inline const char *AllReduceAlgorithmName(MPIAllReduceAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+    case MPIAllReduceAlgorithm::Ring:         return "ring";
+    case MPIAllReduceAlgorithm::Hierarchical: return "hierarchical";
+    default:                                  return "MPI";
+    }
+}
+
 class MPIWrapper;
 typedef std::shared_ptr<MPIWrapper> MPIWrapperPtr;
 
@@ -70,6 +89,16 @@ class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
     // MPI communicator that reflects the current subset selection
     MPI_Comm m_currentComm;
 
+    // state of the built-in all-reduce algorithms, created on first use for m_currentComm and freed by RequestNodes() when that changes
+    MPI_Comm m_ringComm;             // duplicate of m_currentComm, so that the ring messages cannot match anybody else's
+    MPI_Comm m_hostComm;             // nodes on the same host
+    MPI_Comm m_crossHostComm;        // nodes with the same rank on their host, one per host
+    bool m_hostsHaveSameNumNodes;
+    MPI_Win m_hostWindow;            // shared memory with one slot per node on the host
+    size_t m_hostSlotSize;           // in bytes
+    std::vector<char *> m_hostSlots;
+    std::vector<char> m_ringBuffer;  // receives the partial sums of the left neighbor
+
     static MPIWrapperPtr s_mpi;
 
     // MPI_Init() with delay-loading the msmpi.dll (possibly causing a failure if missing; we want to catch that)
@@ -119,7 +148,8 @@ class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
 
 public:
     MPIWrapper()
-        : m_currentComm(MPI_COMM_WORLD)
+        : m_currentComm(MPI_COMM_WORLD), m_ringComm(MPI_COMM_NULL), m_hostComm(MPI_COMM_NULL), m_crossHostComm(MPI_COMM_NULL),
+          m_hostsHaveSameNumNodes(false), m_hostWindow(MPI_WIN_NULL), m_hostSlotSize(0)
     {
         static bool initialized = false;
         if (initialized)
@@ -169,7 +199,10 @@ public:
         // Do not finalize in event of an exception since calling MPI_Finalize without
         // all pending communications being finished results in a hang
         if (!std::uncaught_exception())
+        {
+            FreeAllReduceState();
             MPI_Finalize();
+        }
     }
 
 private:
@@ -199,6 +232,9 @@ private:
     {
         Ping("requestnodes (before change)");
 
+        // the all-reduce communicators and the shared memory were derived from the current communicator
+        FreeAllReduceState();
+
 // undo current split
 #ifdef USE2NDCOMM
         if (m_currentComm != MPI_COMM_WORLD /*no subset*/ && m_currentComm != MPI_COMM_NULL /*idle nodes*/)
@@ -286,6 +322,14 @@ public:
     {
         return 0;
     }
+    // number of nodes that share this node's host (and can thus exchange data through shared memory); collective on first call
+    size_t NumNodesOnThisHost()
+    {
+        CreateHostCommunicators();
+        int numHostRanks;
+        MPI_Comm_size(m_hostComm, &numHostRanks) || MpiFail("numnodesonthishost: MPI_Comm_size");
+        return numHostRanks;
+    }
 
     // -----------------------------------------------------------------------
     // data-exchange functions (wrappers around MPI functions)
@@ -328,12 +372,59 @@ public:
     }
 
     // for raw pointer
+    // The built-in algorithms are blocking and keep per-process scratch state, so only one thread at a time may call this with them
+    // (which MPI_THREAD_SERIALIZED demands anyway). All nodes must call it with the same algorithm and size.
     template <class ElemType>
-    void AllReduce(ElemType *pData, size_t nData)
+    void AllReduce(ElemType *pData, size_t nData, MPIAllReduceAlgorithm algorithm = MPIAllReduceAlgorithm::Default)
     {
         if ((NumNodesInUse() > 1 && (Communicator() != MPI_COMM_NULL)))
         {
-            MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
+            switch (algorithm)
+            {
+            case MPIAllReduceAlgorithm::Ring:
+                RingAllReduce(pData, nData, RingCommunicator());
+                break;
+            case MPIAllReduceAlgorithm::Hierarchical:
+                HierarchicalAllReduce(pData, nData);
+                break;
+            default:
+                MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
+                break;
+            }
+        }
+    }
+
+    // time each all-reduce algorithm on a buffer of 'nData' elements, so that the fastest one for this cluster and MPI build can be configured
+    template <class ElemType>
+    void BenchmarkAllReduce(size_t nData, size_t numRepeats = 10)
+    {
+        if ((NumNodesInUse() <= 1) || (Communicator() == MPI_COMM_NULL) || (nData == 0) || (numRepeats == 0))
+            return;
+
+        std::vector<ElemType> buffer(nData);
+        const MPIAllReduceAlgorithm algorithms[] = {MPIAllReduceAlgorithm::Default, MPIAllReduceAlgorithm::Ring, MPIAllReduceAlgorithm::Hierarchical};
+        for (auto algorithm : algorithms)
+        {
+            // the first call also sets up the communicators and shared memory, and checks the result
+            std::fill(buffer.begin(), buffer.end(), (ElemType) 1);
+            AllReduce(buffer.data(), nData, algorithm);
+            if (buffer.front() != (ElemType) NumNodesInUse() || buffer.back() != (ElemType) NumNodesInUse())
+                LogicError("BenchmarkAllReduce: The %s all-reduce returned a wrong sum.", AllReduceAlgorithmName(algorithm));
+
+            WaitAll();
+            double start = MPI_Wtime();
+            for (size_t i = 0; i < numRepeats; i++)
+                AllReduce(buffer.data(), nData, algorithm);
+            double seconds = (MPI_Wtime() - start) / numRepeats;
+            MPI_Allreduce(MPI_IN_PLACE, &seconds, 1, MPI_DOUBLE, MPI_MAX, Communicator()) || MpiFail("BenchmarkAllReduce: MPI_Allreduce");
+
+            if (IsMainNode())
+            {
+                fprintf(stderr, "allreduce benchmark [%s]: %d elements on %d nodes in %.3f ms (%.2f GB/s per node)\n",
+                        AllReduceAlgorithmName(algorithm), (int) nData, (int) NumNodesInUse(), seconds * 1000,
+                        2.0 * (NumNodesInUse() - 1) / NumNodesInUse() * nData * sizeof(ElemType) / seconds / 1e9);
+                fflush(stderr);
+            }
         }
     }
 
@@ -351,6 +442,172 @@ public:
     {
         MPI_Barrier(m_currentComm) || MpiFail("waitall: MPI_Barrier");
     }
+
+private:
+    // -----------------------------------------------------------------------
+    // built-in all-reduce algorithms
+    // -----------------------------------------------------------------------
+
+    MPI_Comm RingCommunicator()
+    {
+        if (m_ringComm == MPI_COMM_NULL)
+            MPI_Comm_dup(Communicator(), &m_ringComm) || MpiFail("allreduce: MPI_Comm_dup");
+        return m_ringComm;
+    }
+
+    // Bandwidth-optimal all-reduce: the buffer is cut into one segment per node. In N-1 reduce-scatter steps each node passes
+    // a partial sum to its right neighbor and adds the one from its left neighbor, after which it holds the complete sum of one
+    // segment. In N-1 all-gather steps the complete segments are then passed around the ring.
+    template <class ElemType>
+    void RingAllReduce(ElemType *pData, size_t nData, MPI_Comm comm)
+    {
+        int numRanks, rank;
+        MPI_Comm_size(comm, &numRanks) || MpiFail("ringallreduce: MPI_Comm_size");
+        MPI_Comm_rank(comm, &rank) || MpiFail("ringallreduce: MPI_Comm_rank");
+        if (numRanks < 2 || nData == 0)
+            return;
+
+        auto segmentBegin = [nData, numRanks](int segment) { return nData * segment / numRanks; };
+        auto segmentSize = [&segmentBegin](int segment) { return segmentBegin(segment + 1) - segmentBegin(segment); };
+        size_t maxSegmentSize = (nData + numRanks - 1) / numRanks;
+        if (m_ringBuffer.size() < maxSegmentSize * sizeof(ElemType))
+            m_ringBuffer.resize(maxSegmentSize * sizeof(ElemType));
+        ElemType *received = reinterpret_cast<ElemType *>(m_ringBuffer.data());
+
+        int right = (rank + 1) % numRanks;
+        int left = (rank + numRanks - 1) % numRanks;
+        for (int step = 0; step < numRanks - 1; step++)
+        {
+            int sendSegment = (rank - step + numRanks) % numRanks;
+            int recvSegment = (rank - step - 1 + numRanks) % numRanks;
+            MPI_Sendrecv(pData + segmentBegin(sendSegment), (int) segmentSize(sendSegment), GetDataType(pData), right, step,
+                         received, (int) segmentSize(recvSegment), GetDataType(pData), left, step, comm, MPI_STATUS_IGNORE) || MpiFail("ringallreduce: MPI_Sendrecv");
+
+            ElemType *accumulator = pData + segmentBegin(recvSegment);
+            size_t n = segmentSize(recvSegment);
+            for (size_t i = 0; i < n; i++)
+                accumulator[i] += received[i];
+        }
+        for (int step = 0; step < numRanks - 1; step++)
+        {
+            int sendSegment = (rank + 1 - step + numRanks) % numRanks;
+            int recvSegment = (rank - step + numRanks) % numRanks;
+            MPI_Sendrecv(pData + segmentBegin(sendSegment), (int) segmentSize(sendSegment), GetDataType(pData), right, numRanks + step,
+                         pData + segmentBegin(recvSegment), (int) segmentSize(recvSegment), GetDataType(pData), left, numRanks + step, comm, MPI_STATUS_IGNORE) || MpiFail("ringallreduce: MPI_Sendrecv");
+        }
+    }
+
+    // All nodes copy their buffer into shared memory, and each one sums up its slice over the nodes of its host. The nodes that own
+    // the same slice on the different hosts then ring-all-reduce it, and finally each node gathers all slices from shared memory.
+    // This way only 1/(nodes per host) of the buffer goes over the network from each node.
+    template <class ElemType>
+    void HierarchicalAllReduce(ElemType *pData, size_t nData)
+    {
+        CreateHostCommunicators();
+        if (!m_hostsHaveSameNumNodes)
+            return RingAllReduce(pData, nData, RingCommunicator());
+
+        int numHostRanks, hostRank;
+        MPI_Comm_size(m_hostComm, &numHostRanks) || MpiFail("hierarchicalallreduce: MPI_Comm_size");
+        MPI_Comm_rank(m_hostComm, &hostRank) || MpiFail("hierarchicalallreduce: MPI_Comm_rank");
+        if (numHostRanks == 1)
+            return RingAllReduce(pData, nData, m_crossHostComm);
+
+        CreateHostWindow(nData * sizeof(ElemType), numHostRanks);
+        auto slot = [this](int r) { return reinterpret_cast<ElemType *>(m_hostSlots[r]); };
+        auto sliceBegin = [nData, numHostRanks](int r) { return nData * r / numHostRanks; };
+
+        memcpy(slot(hostRank), pData, nData * sizeof(ElemType));
+        SynchronizeHost();
+
+        ElemType *slice = slot(hostRank) + sliceBegin(hostRank);
+        size_t sliceSize = sliceBegin(hostRank + 1) - sliceBegin(hostRank);
+        for (int r = 0; r < numHostRanks; r++)
+        {
+            if (r == hostRank)
+                continue;
+            const ElemType *other = slot(r) + sliceBegin(hostRank);
+            for (size_t i = 0; i < sliceSize; i++)
+                slice[i] += other[i];
+        }
+        RingAllReduce(slice, sliceSize, m_crossHostComm);
+        SynchronizeHost();
+
+        for (int r = 0; r < numHostRanks; r++)
+            memcpy(pData + sliceBegin(r), slot(r) + sliceBegin(r), (sliceBegin(r + 1) - sliceBegin(r)) * sizeof(ElemType));
+        // nobody may overwrite its slot in the next call before everybody has gathered from it
+        SynchronizeHost();
+    }
+
+    void CreateHostCommunicators()
+    {
+        if (m_hostComm != MPI_COMM_NULL)
+            return;
+
+        MPI_Comm_split_type(Communicator(), MPI_COMM_TYPE_SHARED, (int) CurrentNodeRank(), MPI_INFO_NULL, &m_hostComm) || MpiFail("hierarchicalallreduce: MPI_Comm_split_type");
+        int numHostRanks, hostRank;
+        MPI_Comm_size(m_hostComm, &numHostRanks) || MpiFail("hierarchicalallreduce: MPI_Comm_size");
+        MPI_Comm_rank(m_hostComm, &hostRank) || MpiFail("hierarchicalallreduce: MPI_Comm_rank");
+        MPI_Comm_split(Communicator(), hostRank, (int) CurrentNodeRank(), &m_crossHostComm) || MpiFail("hierarchicalallreduce: MPI_Comm_split");
+
+        // each node on a host reduces one slice across hosts, which requires the same slicing on all hosts
+        int range[2] = {numHostRanks, -numHostRanks};
+        MPI_Allreduce(MPI_IN_PLACE, range, 2, MPI_INT, MPI_MAX, Communicator()) || MpiFail("hierarchicalallreduce: MPI_Allreduce");
+        m_hostsHaveSameNumNodes = (range[0] == -range[1]);
+        if (!m_hostsHaveSameNumNodes && IsMainNode())
+            fprintf(stderr, "hierarchicalallreduce: hosts run different numbers of nodes (%d to %d), using the ring all-reduce instead\n", -range[1], range[0]);
+    }
+
+    void CreateHostWindow(size_t slotSize, int numHostRanks)
+    {
+        if (m_hostWindow != MPI_WIN_NULL && m_hostSlotSize >= slotSize)
+            return;
+
+        FreeHostWindow();
+        char *mySlot;
+        MPI_Win_allocate_shared((MPI_Aint) slotSize, 1, MPI_INFO_NULL, m_hostComm, &mySlot, &m_hostWindow) || MpiFail("hierarchicalallreduce: MPI_Win_allocate_shared");
+        m_hostSlotSize = slotSize;
+        m_hostSlots.resize(numHostRanks);
+        for (int r = 0; r < numHostRanks; r++)
+        {
+            MPI_Aint size;
+            int dispUnit;
+            MPI_Win_shared_query(m_hostWindow, r, &size, &dispUnit, &m_hostSlots[r]) || MpiFail("hierarchicalallreduce: MPI_Win_shared_query");
+        }
+        // a passive epoch for the lifetime of the window; SynchronizeHost() makes the stores visible
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, m_hostWindow) || MpiFail("hierarchicalallreduce: MPI_Win_lock_all");
+    }
+
+    void FreeHostWindow()
+    {
+        if (m_hostWindow == MPI_WIN_NULL)
+            return;
+        MPI_Win_unlock_all(m_hostWindow) || MpiFail("hierarchicalallreduce: MPI_Win_unlock_all");
+        MPI_Win_free(&m_hostWindow) || MpiFail("hierarchicalallreduce: MPI_Win_free");
+        m_hostSlots.clear();
+        m_hostSlotSize = 0;
+    }
+
+    // collective over the current communicator
+    void FreeAllReduceState()
+    {
+        FreeHostWindow();
+        MPI_Comm *comms[] = {&m_ringComm, &m_hostComm, &m_crossHostComm};
+        for (auto comm : comms)
+        {
+            if (*comm != MPI_COMM_NULL)
+                MPI_Comm_free(comm) || MpiFail("allreduce: MPI_Comm_free"); // will leave MPI_COMM_NULL here
+        }
+        m_hostsHaveSameNumNodes = false;
+        m_ringBuffer.clear();
+    }
+
+    void SynchronizeHost()
+    {
+        MPI_Win_sync(m_hostWindow) || MpiFail("hierarchicalallreduce: MPI_Win_sync");
+        MPI_Barrier(m_hostComm) || MpiFail("hierarchicalallreduce: MPI_Barrier");
+        MPI_Win_sync(m_hostWindow) || MpiFail("hierarchicalallreduce: MPI_Win_sync");
+    }
 };
 
 }}}
@@ -0,0 +1,139 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <cstdint>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// WorkStealingThreadPool -- fixed set of worker threads with one task queue each.
+//
+// A worker takes the newest task from its own queue first (good locality when a
+// task submits its successors), and only when that is empty steals the oldest
+// task from the other queues. Tasks receive the index of the worker that runs
+// them, which they can pass back to Submit() to keep follow-up work local.
+// Kept in a separate header because it pulls in <thread> and friends.
+// -----------------------------------------------------------------------
+
+class WorkStealingThreadPool
+{
+public:
+    typedef std::function<void(size_t /*workerIndex*/)> Task;
+
+    explicit WorkStealingThreadPool(size_t numThreads)
+        : m_queues(numThreads == 0 ? 1 : numThreads), m_numPending(0), m_nextQueue(0), m_stop(false)
+    {
+        for (size_t i = 0; i < m_queues.size(); i++)
+            m_queues[i].reset(new TaskQueue());
+        for (size_t i = 0; i < m_queues.size(); i++)
+            m_threads.push_back(std::thread([this, i] { WorkerLoop(i); }));
+    }
+
+    ~WorkStealingThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wakeUp.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    size_t NumThreads() const { return m_threads.size(); }
+
+    // queue a task; 'preferredWorker' is normally the index of the submitting worker, or SIZE_MAX from outside the pool
+    void Submit(Task task, size_t preferredWorker = SIZE_MAX)
+    {
+        // count first, so that m_numPending never drops below the number of queued tasks
+        size_t queue;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            queue = preferredWorker < m_queues.size() ? preferredWorker : (m_nextQueue++ % m_queues.size());
+            m_numPending++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_queues[queue]->m_mutex);
+            m_queues[queue]->m_tasks.push_back(std::move(task));
+        }
+        m_wakeUp.notify_one();
+    }
+
+public:
+    WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+    WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+private:
+    struct TaskQueue
+    {
+        std::mutex m_mutex;
+        std::deque<Task> m_tasks;
+    };
+
+    bool TryPop(size_t self, Task& task)
+    {
+        for (size_t k = 0; k < m_queues.size(); k++)
+        {
+            TaskQueue& queue = *m_queues[(self + k) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+            if (queue.m_tasks.empty())
+                continue;
+            if (k == 0) // own queue: LIFO
+            {
+                task = std::move(queue.m_tasks.back());
+                queue.m_tasks.pop_back();
+            }
+            else // steal: FIFO
+            {
+                task = std::move(queue.m_tasks.front());
+                queue.m_tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void WorkerLoop(size_t self)
+    {
+        for (;;)
+        {
+            Task task;
+            if (TryPop(self, task))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_numPending--;
+                }
+                task(self);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [this] { return m_stop || m_numPending > 0; });
+            if (m_stop && m_numPending == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex; // guards the members below
+    std::condition_variable m_wakeUp;
+    size_t m_numPending;
+    size_t m_nextQueue;
+    bool m_stop;
+};
+
+}}}
@@ -34,15 +34,27 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <>
-vector<shared_ptr<Matrix<float>>>& MatrixPool::GetReleasedMatrices<float>()
+vector<MatrixPool::MemRequestInfo<float>>& MatrixPool::GetMemRequestInfoVec<float>()
 {
-    return m_releasedFloatMatrices;
+    return m_floatRequests;
 }
 
 template <>
-vector<shared_ptr<Matrix<double>>>& MatrixPool::GetReleasedMatrices<double>()
+vector<MatrixPool::MemRequestInfo<double>>& MatrixPool::GetMemRequestInfoVec<double>()
 {
-    return m_releasedDoubleMatrices;
+    return m_doubleRequests;
+}
+
+template <>
+MatrixPool::PlanStatistics& MatrixPool::GetStatistics<float>()
+{
+    return m_floatStatistics;
+}
+
+template <>
+MatrixPool::PlanStatistics& MatrixPool::GetStatistics<double>()
+{
+    return m_doubleStatistics;
 }
 
 // -----------------------------------------------------------------------
@@ -604,6 +616,62 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
     }
 }
 
+template <class ElemType>
+static size_t EnableQuantizedTimesNodes(const list<ComputationNodeBasePtr>& timesNodes, size_t numBits, double tolerance)
+{
+    map<ComputationNodeBasePtr, shared_ptr<QuantizedMultiplier<ElemType>>> multipliers; // nodes that multiply with the same weights share them
+    size_t numNodes = 0;
+    for (const auto& nodeIter : timesNodes)
+    {
+        auto node = dynamic_pointer_cast<TimesNode<ElemType>>(nodeIter);
+        if (!node || !node->IsWeightTimesData())
+            continue;
+        const auto& inputs = nodeIter->GetInputs();
+        auto& multiplier = multipliers[inputs[0]];
+        if (!multiplier)
+        {
+            size_t outputDim = nodeIter->GetSampleLayout().GetNumElements();
+            size_t inputDim  = inputs[1]->GetSampleLayout().GetNumElements();
+            const auto& weights = dynamic_pointer_cast<ComputationNode<ElemType>>(inputs[0])->Value();
+            multiplier = make_shared<QuantizedMultiplier<ElemType>>(weights.Reshaped(outputDim, inputDim), numBits);
+        }
+        node->SetQuantizedMultiplier(multiplier, tolerance);
+        numNodes++;
+    }
+    return numNodes;
+}
+
+size_t ComputationNetwork::EnableQuantizedTimes(size_t numBits, double tolerance)
+{
+    list<ComputationNodeBasePtr> timesNodes = GetNodesWithType(OperationNameOf(TimesNode));
+    size_t numNodes = EnableQuantizedTimesNodes<float>(timesNodes, numBits, tolerance) + EnableQuantizedTimesNodes<double>(timesNodes, numBits, tolerance);
+    fprintf(stderr, "EnableQuantizedTimes: Using %d-bit integer products for %d out of %d Times operations.\n", (int) numBits, (int) numNodes, (int) timesNodes.size());
+    return numNodes;
+}
+
+template <class ElemType>
+static size_t EnablePackedWeightsNodes(const list<ComputationNodeBasePtr>& timesNodes)
+{
+    size_t numNodes = 0;
+    for (const auto& nodeIter : timesNodes)
+    {
+        auto node = dynamic_pointer_cast<TimesNode<ElemType>>(nodeIter);
+        if (!node || !node->IsWeightTimesData())
+            continue;
+        node->SetUsePackedWeights(true); // the weights are packed on first use, by the LearnableParameter
+        numNodes++;
+    }
+    return numNodes;
+}
+
+size_t ComputationNetwork::EnablePackedWeights()
+{
+    list<ComputationNodeBasePtr> timesNodes = GetNodesWithType(OperationNameOf(TimesNode));
+    size_t numNodes = EnablePackedWeightsNodes<float>(timesNodes) + EnablePackedWeightsNodes<double>(timesNodes);
+    fprintf(stderr, "EnablePackedWeights: Using packed weights for %d out of %d Times operations.\n", (int) numNodes, (int) timesNodes.size());
+    return numNodes;
+}
+
 // -----------------------------------------------------------------------
 // unit test
 // -----------------------------------------------------------------------
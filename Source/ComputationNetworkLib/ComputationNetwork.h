@@ -13,6 +13,7 @@
 #include "ComputationNode.h"
 #include "ScriptableObjects.h"
 #include "ComputationEnvironment.h"
+#include "WorkStealingThreadPool.h"
 
 #include <map>
 #include <string>
@@ -52,6 +53,7 @@ public:
         m_randomSeedOffset(0),
         m_isCompiled(false),
         m_areMatricesAllocated(false),
+        m_parallelTraversalThreads(0),
         m_pMBLayoutOfNetwork(make_shared<MBLayout>(1, 0, L"*")),
         m_environment(make_shared<ComputationEnvironment>())
     {
@@ -134,7 +136,10 @@ public:
     void ForwardProp(const ComputationNodeBasePtr rootNode);
 
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // If given, 'nodeDoneCallback' is called for each node as soon as its Backprop() has completed. For a leaf such as a
+    // LearnableParameter, this means that its gradient is final. With parallel traversal, it is called from the worker threads.
+    typedef std::function<void(const ComputationNodeBasePtr&)> BackpropCallback;
+    void Backprop(const ComputationNodeBasePtr rootNode, const BackpropCallback& nodeDoneCallback = BackpropCallback());
 
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
@@ -189,10 +194,15 @@ private:
 public:
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
 
+    // opt-in: run independent nodes of the top-level (PAR) traversal concurrently on this many CPU threads (0 = off)
+    // Must be called before AllocateAllMatrices(), since the schedule must honor the memory sharing planned there.
+    void SetParallelTraversalThreads(size_t numThreads) { m_parallelTraversalThreads = numThreads; }
+
 private:
     template <class ElemType> void PrintMemorySharingStructure(const std::vector<ComputationNodeBasePtr>& nodes);
     void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount);
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
+    void EnableParallelTraversal();
 
 public:
     // -----------------------------------------------------------------------
@@ -370,6 +380,16 @@ public:
     //ComputationNodeBasePtr RemoveFeatureNode(ComputationNodeBasePtr featureNode);
     void SetLearnableNodesBelowLearningRateMultiplier(const float learningRateMultiplier, const ComputationNodeBasePtr& rootNode = nullptr);
 
+    // replace a Sigmoid, Tanh, or RectifiedLinear of a Plus, e.g. Sigmoid(Plus(z, b)), by a FusedBiasActivationNode; returns the number of fusions
+    // Only these two-node patterns are fused, not longer chains of elementwise nodes.
+    // The network is recompiled if anything changed. Has no effect once AllocateAllMatrices() has been called.
+    size_t FuseBiasActivations(const std::vector<ComputationNodeBasePtr>& nodesToKeep = std::vector<ComputationNodeBasePtr>());
+
+    // replace LSTM cells unrolled through PastValue/FutureValue loops by FusedLSTMNodes; returns the number of cells replaced
+    // Only the cell of BS.RNNs.LSTMP is recognized; there is no fused node for other recurrent cells such as GRUs.
+    // The network is recompiled if anything changed. Has no effect once AllocateAllMatrices() has been called.
+    size_t FuseLSTMCells(const std::vector<ComputationNodeBasePtr>& nodesToKeep = std::vector<ComputationNodeBasePtr>());
+
     // -----------------------------------------------------------------------
     // node access
     // -----------------------------------------------------------------------
@@ -451,6 +471,13 @@ public:
                             const bool& sMBR = false);
     static void SetMaxTempMemSizeForCNN(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const size_t maxTempMemSizeInSamples);
 
+    // inference only: compute W * x of TimesNodes with CPU weights in 'numBits' integer arithmetic; returns the number of nodes affected
+    // Each node falls back to floating point if its first minibatch shows a relative error above 'tolerance'.
+    size_t EnableQuantizedTimes(size_t numBits, double tolerance);
+
+    // inference only: compute W * x of TimesNodes with CPU weights and few columns in x with prepacked copies of the weights; returns the number of nodes affected
+    size_t EnablePackedWeights();
+
     // -----------------------------------------------------------------------
     // node-group access
     // -----------------------------------------------------------------------
@@ -1027,6 +1054,28 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // switch ForwardProp() and Backprop() to running ready nodes concurrently on 'threadPool' (CPU only)
+        void EnableParallelTraversal(const shared_ptr<WorkStealingThreadPool>& threadPool, const MatrixPool& matrixPool);
+
+        // called for each entry whose Backprop() has completed (for a recurrent loop, with the SEQTraversalFlowControlNode)
+        void SetBackpropCallback(const BackpropCallback& callback) { m_backpropCallback = callback; }
+
+    private:
+        static std::vector<ComputationNodeBasePtr> NodesOfEntry(const ComputationNodeBasePtr& entry);
+        void ParallelTraverse(const std::vector<std::vector<size_t>>& predecessors, const std::vector<std::vector<size_t>>& successors,
+                              const std::function<void(const ComputationNodeBasePtr&)>& run);
+
+        // dependencies between entries of m_nestedNodes, as indices into m_nestedNodes
+        // Data dependencies are determined when the network is compiled; the parallel schedule adds to them
+        // the ordering constraints that arise from nodes sharing matrices through the MatrixPool.
+        std::vector<std::vector<size_t>> m_dataPredecessors;
+        std::vector<std::vector<size_t>> m_forwardPredecessors, m_forwardSuccessors;
+        std::vector<std::vector<size_t>> m_backpropPredecessors, m_backpropSuccessors;
+        std::set<MBLayoutPtr> m_mbLayouts;           // lazily initialized state in these must be prepared before going parallel
+        shared_ptr<WorkStealingThreadPool> m_threadPool; // non-null if parallel traversal is enabled
+        int m_innerThreads;                              // OpenMP threads per node under parallel traversal, so that nodes do not oversubscribe the cores
+        BackpropCallback m_backpropCallback;             // see ComputationNetwork::Backprop()
     };
 
 public:
@@ -1084,6 +1133,8 @@ private:
     // cache for evaluation ordering:
     bool m_isCompiled; // CompileNetwork has been called
     bool m_areMatricesAllocated; // AllocateAllMatrices has been called
+    size_t m_parallelTraversalThreads;                                 // see SetParallelTraversalThreads()
+    shared_ptr<WorkStealingThreadPool> m_parallelTraversalThreadPool; // shared by all nested networks
 
     // cached network iterations
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_evalOrders; // [out node] flat depth-first traversal starting from out node
@@ -10,6 +10,9 @@
 #include "ComputationNetwork.h"
 #include "InputAndParamNodes.h"
 #include "TrainingNodes.h"
+#include "NonlinearityNodes.h"
+#include "RecurrentNodes.h"
+#include "ReshapingNodes.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -336,6 +339,353 @@ ComputationNodeBasePtr ComputationNetwork::RemoveFeatureNode(ComputationNodeBase
 }
 #endif
 
+// replace a node 'outer' and its first input 'inner' by a single FusedBiasActivationNode
+// The fused node takes over the name, the node-group memberships, and the consumers of 'outer'; 'inner' is removed.
+template <class ElemType>
+static ComputationNodeBasePtr CreateFusedBiasActivationNode(const ComputationNodeBasePtr& outer, const ComputationNodeBasePtr& inner, const std::wstring& fusedOperation)
+{
+    auto fused = New<FusedBiasActivationNode<ElemType>>(outer->GetDeviceId(), outer->NodeName(), fusedOperation);
+    fused->AttachInputs({ inner->Input(0), inner->Input(1) });
+    return fused;
+}
+
+size_t ComputationNetwork::FuseBiasActivations(const std::vector<ComputationNodeBasePtr>& nodesToKeep)
+{
+    if (AreMatricesAllocated()) // too late: nodes may already be referenced by the memory plan
+        return 0;
+    VerifyIsCompiled("FuseBiasActivations");
+
+    // Nodes the caller holds on to must neither be removed nor replaced. Members of node groups (outputs, criteria, ...)
+    // must not be removed, but may be replaced by a fused node, which then takes over the group membership.
+    set<ComputationNodeBasePtr> keep(nodesToKeep.begin(), nodesToKeep.end());
+    set<ComputationNodeBasePtr> groupMembers;
+    for (auto groupIter : GetAllNodeGroups())
+        groupMembers.insert(groupIter->begin(), groupIter->end());
+
+    // an intermediate node can only be fused away if it has no other consumer
+    map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            numConsumers[input]++;
+
+    // find the pairs; the inner node type never also appears as an outer type, so pairs cannot overlap
+    vector<pair<ComputationNodeBasePtr, ComputationNodeBasePtr>> pairs; // (outer, inner)
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& outer = iter.second;
+        if (outer->GetNumInputs() != 1 || keep.find(outer) != keep.end())
+            continue;
+        const auto& inner = outer->Input(0);
+        if (inner->GetNumInputs() != 2 || numConsumers[inner] != 1 || keep.find(inner) != keep.end() || groupMembers.find(inner) != groupMembers.end())
+            continue;
+        if (FusedBiasActivationNode<float>::FusedOperationFor(outer->OperationName(), inner->OperationName()).empty())
+            continue;
+        pairs.push_back(make_pair(outer, inner));
+    }
+    if (pairs.empty())
+        return 0;
+
+    InvalidateCompiledNetwork();
+    for (const auto& outerAndInner : pairs)
+    {
+        const auto& outer = outerAndInner.first;
+        const auto& inner = outerAndInner.second;
+        wstring fusedOperation = FusedBiasActivationNode<float>::FusedOperationFor(outer->OperationName(), inner->OperationName());
+        ComputationNodeBasePtr fused;
+        if (dynamic_pointer_cast<ComputationNode<float>>(outer))
+            fused = CreateFusedBiasActivationNode<float>(outer, inner, fusedOperation);
+        else if (dynamic_pointer_cast<ComputationNode<double>>(outer))
+            fused = CreateFusedBiasActivationNode<double>(outer, inner, fusedOperation);
+        else
+            LogicError("FuseBiasActivations: Unexpected element type of %ls %ls operation.", outer->NodeName().c_str(), outer->OperationName().c_str());
+
+        ChangeNodeInputs(outer, fused);
+        for (auto groupIter : GetAllNodeGroups())
+            replace(groupIter->begin(), groupIter->end(), outer, fused);
+
+        RemoveNodeFromNet(outer);
+        RemoveNodeFromNet(inner);
+        outer->DetachInputs(); // break links so that the removed nodes get freed
+        inner->DetachInputs();
+        AddNodeToNet(fused);
+    }
+
+    fprintf(stderr, "FuseBiasActivations: Fused %d activations with the sum they are applied to.\n", (int) pairs.size());
+    CompileNetwork();
+    return pairs.size();
+}
+
+// the nodes of an LSTM cell as created by BS.RNNs.LSTMP without projection, auxiliary input, and self-stabilization
+// Per-gate nodes are indexed in the order of FusedLSTMNode.
+struct LSTMCellNodes
+{
+    ComputationNodeBasePtr x;
+    ComputationNodeBasePtr W[4], H[4], B[4];
+    ComputationNodeBasePtr peepholes[3];    // diagonal cell-to-gate weights of the input, forget, and output gate
+    ComputationNodeBasePtr dh, dc;          // the delay nodes that close the loop
+    int direction;                          // -1 for PastValue, +1 for FutureValue
+    double initialStateValue;               // defaultHiddenActivation of the delay nodes
+    set<ComputationNodeBasePtr> innerNodes; // all nodes that get removed except for h(t) itself; the parameters are kept
+};
+
+static bool IsOperation(const ComputationNodeBasePtr& node, const wchar_t* operationName, size_t numInputs)
+{
+    return node->OperationName() == operationName && node->GetNumInputs() == numInputs;
+}
+
+static bool IsParameter(const ComputationNodeBasePtr& node)
+{
+    return node->OperationName() == OperationNameOf(LearnableParameter);
+}
+
+// B + W * x
+static bool MatchLSTMInputProjection(const ComputationNodeBasePtr& node, size_t gate, LSTMCellNodes& cell)
+{
+    if (!IsOperation(node, L"Plus", 2) || !IsOperation(node->Input(1), L"Times", 2))
+        return false;
+    auto times = node->Input(1);
+    if (!IsParameter(node->Input(0)) || !IsParameter(times->Input(0)) || (cell.x && cell.x != times->Input(1)))
+        return false;
+    cell.x = times->Input(1);
+    cell.B[gate] = node->Input(0);
+    cell.W[gate] = times->Input(0);
+    cell.innerNodes.insert({ node, times });
+    return true;
+}
+
+// B + W * x + H * h(t-1)
+static bool MatchLSTMGateInput(const ComputationNodeBasePtr& node, size_t gate, LSTMCellNodes& cell)
+{
+    if (!IsOperation(node, L"Plus", 2) || !IsOperation(node->Input(1), L"Times", 2))
+        return false;
+    auto times = node->Input(1);
+    if (!IsParameter(times->Input(0)) || times->Input(1) != cell.dh)
+        return false;
+    cell.H[gate] = times->Input(0);
+    cell.innerNodes.insert({ node, times });
+    return MatchLSTMInputProjection(node->Input(0), gate, cell);
+}
+
+// Sigmoid (B + W * x + H * h(t-1) + C .* c), where c is c(t-1) for the input and forget gates, and c(t) for the output gate
+static bool MatchLSTMGate(const ComputationNodeBasePtr& node, size_t gate, const ComputationNodeBasePtr& c, LSTMCellNodes& cell)
+{
+    if (!IsOperation(node, L"Sigmoid", 1) || !IsOperation(node->Input(0), L"Plus", 2) || !IsOperation(node->Input(0)->Input(1), L"ElementTimes", 2))
+        return false;
+    auto plus = node->Input(0);
+    auto peephole = plus->Input(1);
+    if (!IsParameter(peephole->Input(0)) || peephole->Input(1) != c)
+        return false;
+    cell.peepholes[gate] = peephole->Input(0);
+    cell.innerNodes.insert({ node, plus, peephole });
+    return MatchLSTMGateInput(plus->Input(0), gate, cell);
+}
+
+// PastValue (input) or FutureValue (input) by one step
+template <class ElemType>
+static bool MatchLSTMDelay(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& input, int& direction, double& initialStateValue)
+{
+    if (auto past = dynamic_pointer_cast<PastValueNode<ElemType>>(node))
+    {
+        direction = -1;
+        initialStateValue = past->GetInitialActivationValue();
+        if (past->GetTimeStep() != 1)
+            return false;
+    }
+    else if (auto future = dynamic_pointer_cast<FutureValueNode<ElemType>>(node))
+    {
+        direction = +1;
+        initialStateValue = future->GetInitialActivationValue();
+        if (future->GetTimeStep() != 1)
+            return false;
+    }
+    else
+        return false;
+    return node->Input(0) == input;
+}
+
+// match the LSTM cell whose output is 'h'
+//   h(t) = o(t) .* Tanh (c(t))
+//   c(t) = f(t) .* c(t-1) + i(t) .* Tanh (B + W * x + H * h(t-1))
+// with the gates as in MatchLSTMGate()
+template <class ElemType>
+static bool MatchLSTMCell(const ComputationNodeBasePtr& h, LSTMCellNodes& cell)
+{
+    typedef FusedLSTMNode<ElemType> FusedNode;
+
+    if (!IsOperation(h, L"ElementTimes", 2) || !IsOperation(h->Input(1), L"Tanh", 1))
+        return false;
+    auto tanhC = h->Input(1);
+    auto c = tanhC->Input(0);
+    if (!IsOperation(c, L"Plus", 2) || !IsOperation(c->Input(0), L"ElementTimes", 2) || !IsOperation(c->Input(1), L"ElementTimes", 2))
+        return false;
+    auto forgetTerm = c->Input(0);
+    auto inputTerm = c->Input(1);
+    auto tanhCellInput = inputTerm->Input(1);
+    if (!IsOperation(tanhCellInput, L"Tanh", 1) || !IsOperation(tanhCellInput->Input(0), L"Plus", 2) || !IsOperation(tanhCellInput->Input(0)->Input(1), L"Times", 2))
+        return false;
+
+    // h(t-1) and c(t-1) must be delayed in the same way
+    cell.dh = tanhCellInput->Input(0)->Input(1)->Input(1);
+    cell.dc = forgetTerm->Input(1);
+    int dcDirection;
+    double dcInitialStateValue;
+    if (!MatchLSTMDelay<ElemType>(cell.dh, h, cell.direction, cell.initialStateValue) ||
+        !MatchLSTMDelay<ElemType>(cell.dc, c, dcDirection, dcInitialStateValue) ||
+        cell.direction != dcDirection || cell.initialStateValue != dcInitialStateValue)
+        return false;
+
+    cell.innerNodes.insert({ tanhC, c, forgetTerm, inputTerm, tanhCellInput, cell.dh, cell.dc });
+    return MatchLSTMGate(inputTerm->Input(0),  FusedNode::inputGate,  cell.dc, cell) &&
+           MatchLSTMGate(forgetTerm->Input(0), FusedNode::forgetGate, cell.dc, cell) &&
+           MatchLSTMGate(h->Input(0),          FusedNode::outputGate, c,       cell) &&
+           MatchLSTMGateInput(tanhCellInput->Input(0), FusedNode::cellInput, cell);
+}
+
+// a matched cell can only be replaced if nothing outside of it depends on its inner nodes, and if its parameters have the expected shapes
+// The parameters themselves are kept, and may also be used elsewhere.
+static bool CanReplaceLSTMCell(const ComputationNodeBasePtr& h, const LSTMCellNodes& cell,
+                               const map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>>& consumers,
+                               const set<ComputationNodeBasePtr>& keep, const set<ComputationNodeBasePtr>& groupMembers)
+{
+    if (cell.innerNodes.find(cell.x) != cell.innerNodes.end())
+        return false;
+
+    size_t cellDim = h->GetSampleMatrixNumRows();
+    size_t inputDim = cell.x->GetSampleMatrixNumRows();
+    for (size_t gate = 0; gate < _countof(cell.W); gate++)
+    {
+        if (cell.W[gate]->GetSampleLayout() != TensorShape(cellDim, inputDim) ||
+            cell.H[gate]->GetSampleLayout() != TensorShape(cellDim, cellDim) ||
+            cell.B[gate]->GetSampleLayout().GetNumElements() != cellDim)
+            return false;
+    }
+    for (const auto& peephole : cell.peepholes)
+    {
+        if (peephole->GetSampleLayout().GetNumElements() != cellDim)
+            return false;
+    }
+
+    for (const auto& node : cell.innerNodes)
+    {
+        if (keep.find(node) != keep.end() || groupMembers.find(node) != groupMembers.end())
+            return false;
+        auto iter = consumers.find(node);
+        if (iter == consumers.end())
+            continue;
+        for (const auto& consumer : iter->second)
+        {
+            if (consumer != h && cell.innerNodes.find(consumer) == cell.innerNodes.end())
+                return false;
+        }
+    }
+    return true;
+}
+
+// names of the nodes that stack the cell's parameters into the inputs of the FusedLSTMNode
+static vector<wstring> StackedLSTMParameterNames(const ComputationNodeBasePtr& h)
+{
+    return { h->NodeName() + L".W", h->NodeName() + L".H", h->NodeName() + L".B", h->NodeName() + L".peepholes" };
+}
+
+// create the FusedLSTMNode that replaces the cell
+// The cell's parameters are kept as they are, so that models keep their parameter names and shapes; RowStack nodes stack
+// them into the layout of FusedLSTMNode. This costs one copy of the parameters per minibatch in training, and none in eval.
+template <class ElemType>
+static ComputationNodeBasePtr CreateFusedLSTMNode(const ComputationNodeBasePtr& h, const LSTMCellNodes& cell, vector<ComputationNodeBasePtr>& stackNodes)
+{
+    typedef FusedLSTMNode<ElemType> FusedNode;
+    DEVICEID_TYPE deviceId = h->GetDeviceId();
+    auto names = StackedLSTMParameterNames(h);
+    auto W         = New<RowStackNode<ElemType>>(deviceId, names[0]);
+    auto H         = New<RowStackNode<ElemType>>(deviceId, names[1]);
+    auto B         = New<RowStackNode<ElemType>>(deviceId, names[2]);
+    auto peepholes = New<RowStackNode<ElemType>>(deviceId, names[3], 2); // column vectors side by side: [cellDim x 3]
+    W->AttachInputs(vector<ComputationNodeBasePtr>(begin(cell.W), end(cell.W)));
+    H->AttachInputs(vector<ComputationNodeBasePtr>(begin(cell.H), end(cell.H)));
+    B->AttachInputs(vector<ComputationNodeBasePtr>(begin(cell.B), end(cell.B)));
+    peepholes->AttachInputs(vector<ComputationNodeBasePtr>(begin(cell.peepholes), end(cell.peepholes)));
+    stackNodes = { W, H, B, peepholes };
+
+    auto fused = New<FusedNode>(deviceId, h->NodeName(), cell.direction, (ElemType) cell.initialStateValue);
+    fused->AttachInputs({ cell.x, W, H, B, peepholes });
+    return fused;
+}
+
+size_t ComputationNetwork::FuseLSTMCells(const std::vector<ComputationNodeBasePtr>& nodesToKeep)
+{
+    if (AreMatricesAllocated()) // too late: nodes may already be referenced by the memory plan
+        return 0;
+    VerifyIsCompiled("FuseLSTMCells");
+
+    // same rules as in FuseBiasActivations()
+    set<ComputationNodeBasePtr> keep(nodesToKeep.begin(), nodesToKeep.end());
+    set<ComputationNodeBasePtr> groupMembers;
+    for (auto groupIter : GetAllNodeGroups())
+        groupMembers.insert(groupIter->begin(), groupIter->end());
+
+    map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>> consumers;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            consumers[input].push_back(iter.second);
+
+    // find the cells; they cannot overlap, since no inner node of a cell is used outside of it
+    vector<pair<ComputationNodeBasePtr, LSTMCellNodes>> cells; // (h(t), cell)
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& h = iter.second;
+        if (keep.find(h) != keep.end())
+            continue;
+        LSTMCellNodes cell;
+        bool matched;
+        if (dynamic_pointer_cast<ComputationNode<float>>(h))
+            matched = MatchLSTMCell<float>(h, cell);
+        else if (dynamic_pointer_cast<ComputationNode<double>>(h))
+            matched = MatchLSTMCell<double>(h, cell);
+        else
+            matched = false;
+        if (!matched || !CanReplaceLSTMCell(h, cell, consumers, keep, groupMembers))
+            continue;
+        auto names = StackedLSTMParameterNames(h);
+        if (any_of(names.begin(), names.end(), [this](const wstring& name) { return NodeNameExists(name); }))
+            continue;
+        cells.push_back(make_pair(h, cell));
+    }
+    if (cells.empty())
+        return 0;
+
+    InvalidateCompiledNetwork();
+    for (const auto& hAndCell : cells)
+    {
+        const auto& h = hAndCell.first;
+        const auto& cell = hAndCell.second;
+        vector<ComputationNodeBasePtr> stackNodes;
+        ComputationNodeBasePtr fused;
+        if (dynamic_pointer_cast<ComputationNode<float>>(h))
+            fused = CreateFusedLSTMNode<float>(h, cell, stackNodes);
+        else
+            fused = CreateFusedLSTMNode<double>(h, cell, stackNodes);
+
+        ChangeNodeInputs(h, fused);
+        for (auto groupIter : GetAllNodeGroups())
+            replace(groupIter->begin(), groupIter->end(), h, fused);
+
+        auto removedNodes = cell.innerNodes;
+        removedNodes.insert(h);
+        for (const auto& node : removedNodes)
+            RemoveNodeFromNet(node);
+        for (const auto& node : removedNodes) // break links (including the loop) so that the removed nodes get freed
+            node->DetachInputs();
+
+        for (const auto& node : stackNodes)
+            AddNodeToNet(node);
+        AddNodeToNet(fused);
+    }
+
+    fprintf(stderr, "FuseLSTMCells: Replaced %d LSTM cells by FusedLSTM nodes.\n", (int) cells.size());
+    CompileNetwork();
+    return cells.size();
+}
+
 // sets m_learningRateMultiplier in all LearnableParameters feeding into the passed rootNode
 // Called from MEL
 void ComputationNetwork::SetLearnableNodesBelowLearningRateMultiplier(const float learningRateMultiplier, const ComputationNodeBasePtr& rootNode)
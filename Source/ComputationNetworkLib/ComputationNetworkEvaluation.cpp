@@ -16,6 +16,11 @@
 #include <set>
 #include <algorithm>
 #include <map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <omp.h>
 
 using namespace std;
 
@@ -63,7 +68,8 @@ static bool SetRootGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, // training criterion to compute the gradients for
+                                  const BackpropCallback& nodeDoneCallback)
 {
     if (!Environment().IsTraining())
         LogicError("Backprop: Requires network is to be in training mode.");
@@ -76,7 +82,9 @@ void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // trai
     ZeroInputGradients(rootNode);
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    auto nestedNetwork = static_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    nestedNetwork->SetBackpropCallback(nodeDoneCallback);
+    nestedNetwork->Backprop(FrameRange(nullptr), true, true);
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -103,6 +111,7 @@ ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNod
 // -----------------------------------------------------------------------
 
 ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes /*must be in eval order*/)
+    : m_innerThreads(1)
 {
     // traverse the network in evaluation order and create a new list that replaces all recurrence by a SEQTraversalFlowControlNode
     set<shared_ptr<IComputationNode>> loopsSeen; // for consistency check only
@@ -128,37 +137,280 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
             nodeIter++; // and consume this node
         }
     }
+
+    // record the data dependencies between our entries, for use by parallel traversal
+    std::map<ComputationNodeBasePtr, size_t> entryOf;
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+        for (const auto& node : NodesOfEntry(m_nestedNodes[i]))
+            entryOf[node] = i;
+    m_dataPredecessors.resize(m_nestedNodes.size());
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        std::set<size_t> predecessors;
+        for (const auto& node : NodesOfEntry(m_nestedNodes[i]))
+        {
+            for (const auto& input : node->GetInputs())
+            {
+                auto iter = entryOf.find(input);
+                if (iter != entryOf.end() && iter->second != i)
+                    predecessors.insert(iter->second);
+            }
+        }
+        m_dataPredecessors[i].assign(predecessors.begin(), predecessors.end());
+    }
+}
+
+// the nodes that an entry of m_nestedNodes stands for: the node itself, or all nodes of a recurrent loop
+/*static*/ std::vector<ComputationNodeBasePtr> ComputationNetwork::PARTraversalFlowControlNode::NodesOfEntry(const ComputationNodeBasePtr& entry)
+{
+    auto loop = dynamic_pointer_cast<FlowControlNode>(entry);
+    return loop ? loop->m_nestedNodes : std::vector<ComputationNodeBasePtr>{ entry };
+}
+
+// Parallel traversal: Entries of m_nestedNodes run on a thread pool as soon as their predecessors have completed.
+// Besides data dependencies, two entries must keep their sequential order if they touch the same matrix and at least one
+// of them writes it. Since the MatrixPool lets nodes share matrices whose lifetimes do not overlap in the *sequential*
+// order, nodes that are independent in the graph may still share memory. We therefore treat as the resources of a node
+// the node itself (standing for its non-pooled matrices) and the pooled matrices planned for it, and derive the hazards:
+//  - ForwardProp() writes the resources of the node and reads those of its inputs.
+//  - Backprop() writes the resources of the node and of the inputs it computes gradients for, and reads the other inputs.
+// All conflicting accesses thus happen in the same order as in sequential traversal, which makes the result identical
+// to it (gradients of shared inputs are, in particular, accumulated in the same order).
+void ComputationNetwork::PARTraversalFlowControlNode::EnableParallelTraversal(const shared_ptr<WorkStealingThreadPool>& threadPool, const MatrixPool& matrixPool)
+{
+    for (const auto& entry : m_nestedNodes)
+    {
+        for (const auto& node : NodesOfEntry(entry))
+        {
+            // GPU kernels are already serialized on a single stream; this is meant for CPU-bound networks
+            if (node->GetDeviceId() != CPUDEVICE)
+            {
+                fprintf(stderr, "EnableParallelTraversal: %ls %ls operation is not on the CPU; keeping sequential traversal.\n", node->NodeName().c_str(), node->OperationName().c_str());
+                return;
+            }
+            if (node->HasMBLayout())
+                m_mbLayouts.insert(node->GetMBLayout());
+        }
+    }
+
+    auto resourcesOf = [&matrixPool](const ComputationNodeBasePtr& node)
+    {
+        std::vector<const void*> resources = matrixPool.GetPlannedMatrices(node.get());
+        resources.push_back(node.get());
+        return resources;
+    };
+
+    // visit entries in sequential order and derive read-after-write, write-after-read, and write-after-write dependencies
+    struct Accesses
+    {
+        size_t lastWriter;
+        std::vector<size_t> readersSinceWrite;
+        Accesses() : lastWriter(SIZE_MAX) {}
+    };
+    auto addHazards = [](std::map<const void*, Accesses>& accesses, size_t entry, const std::set<const void*>& reads, const std::set<const void*>& writes, std::set<size_t>& predecessors)
+    {
+        for (const auto& resource : reads)
+        {
+            auto& access = accesses[resource];
+            if (access.lastWriter != SIZE_MAX)
+                predecessors.insert(access.lastWriter);
+            access.readersSinceWrite.push_back(entry);
+        }
+        for (const auto& resource : writes)
+        {
+            auto& access = accesses[resource];
+            if (access.lastWriter != SIZE_MAX)
+                predecessors.insert(access.lastWriter);
+            predecessors.insert(access.readersSinceWrite.begin(), access.readersSinceWrite.end());
+            access.lastWriter = entry;
+            access.readersSinceWrite.clear();
+        }
+        predecessors.erase(entry);
+    };
+
+    size_t numEntries = m_nestedNodes.size();
+    std::map<const void*, Accesses> forwardAccesses, backpropAccesses;
+    m_forwardPredecessors.assign(numEntries, std::vector<size_t>());
+    m_backpropPredecessors.assign(numEntries, std::vector<size_t>());
+    for (size_t i = 0; i < numEntries; i++)
+    {
+        const auto nodes = NodesOfEntry(m_nestedNodes[i]);
+        std::set<const void*> writes, reads;
+        for (const auto& node : nodes)
+        {
+            auto resources = resourcesOf(node);
+            writes.insert(resources.begin(), resources.end());
+        }
+        for (const auto& node : nodes)
+        {
+            for (const auto& input : node->GetInputs())
+            {
+                auto resources = resourcesOf(input);
+                for (const auto& resource : resources)
+                    if (writes.find(resource) == writes.end())
+                        reads.insert(resource);
+            }
+        }
+        std::set<size_t> predecessors(m_dataPredecessors[i].begin(), m_dataPredecessors[i].end());
+        addHazards(forwardAccesses, i, reads, writes, predecessors);
+        m_forwardPredecessors[i].assign(predecessors.begin(), predecessors.end());
+    }
+    for (size_t i = numEntries; i-- > 0;)
+    {
+        const auto nodes = NodesOfEntry(m_nestedNodes[i]);
+        std::set<const void*> writes, reads;
+        for (const auto& node : nodes)
+        {
+            auto resources = resourcesOf(node);
+            writes.insert(resources.begin(), resources.end());
+        }
+        for (const auto& node : nodes)
+        {
+            for (const auto& input : node->GetInputs())
+            {
+                auto resources = resourcesOf(input);
+                (input->NeedsGradient() ? writes : reads).insert(resources.begin(), resources.end());
+            }
+        }
+        for (const auto& resource : writes)
+            reads.erase(resource);
+        // in Backprop(), data flows from an entry to the entries of its inputs
+        std::set<size_t> predecessors;
+        for (size_t j = i + 1; j < numEntries; j++)
+            if (std::find(m_dataPredecessors[j].begin(), m_dataPredecessors[j].end(), i) != m_dataPredecessors[j].end())
+                predecessors.insert(j);
+        addHazards(backpropAccesses, i, reads, writes, predecessors);
+        m_backpropPredecessors[i].assign(predecessors.begin(), predecessors.end());
+    }
+
+    auto successorsOf = [numEntries](const std::vector<std::vector<size_t>>& predecessors)
+    {
+        std::vector<std::vector<size_t>> successors(numEntries);
+        for (size_t i = 0; i < numEntries; i++)
+            for (size_t j : predecessors[i])
+                successors[j].push_back(i);
+        return successors;
+    };
+    m_forwardSuccessors  = successorsOf(m_forwardPredecessors);
+    m_backpropSuccessors = successorsOf(m_backpropPredecessors);
+    m_threadPool = threadPool;
+    // the nodes themselves use OpenMP; split the cores among the workers instead of giving each worker all of them
+    m_innerThreads = max(1, omp_get_max_threads() / (int) threadPool->NumThreads());
+}
+
+// run all entries of m_nestedNodes on the thread pool, each once its predecessors have completed; rethrows the first error
+void ComputationNetwork::PARTraversalFlowControlNode::ParallelTraverse(const std::vector<std::vector<size_t>>& predecessors, const std::vector<std::vector<size_t>>& successors,
+                                                                        const std::function<void(const ComputationNodeBasePtr&)>& run)
+{
+    // MBLayout computes its validity mask lazily; do that here rather than racing on it from several nodes
+    for (const auto& pMBLayout : m_mbLayouts)
+        if (pMBLayout->HasGaps())
+            pMBLayout->GetColumnsValidityMask(CPUDEVICE);
+
+    size_t numEntries = m_nestedNodes.size();
+    std::unique_ptr<std::atomic<size_t>[]> numPending(new std::atomic<size_t>[numEntries]);
+    for (size_t i = 0; i < numEntries; i++)
+        numPending[i] = predecessors[i].size();
+
+    std::mutex mutex;
+    std::condition_variable allDone;
+    size_t numCompleted = 0;    // guarded by mutex
+    std::exception_ptr error;   // guarded by mutex
+    std::atomic<bool> failed(false);
+
+    std::function<void(size_t, size_t)> runEntry = [&](size_t i, size_t worker)
+    {
+        if (!failed)
+        {
+            try
+            {
+                omp_set_num_threads(m_innerThreads); // per-thread setting, affects only this worker
+                run(m_nestedNodes[i]);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error)
+                    error = std::current_exception();
+                failed = true;
+            }
+        }
+        // after an error we still walk the graph (without running anything) so that the counting below completes
+        for (size_t j : successors[i])
+            if (--numPending[j] == 0)
+                m_threadPool->Submit([&runEntry, j](size_t w) { runEntry(j, w); }, worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (++numCompleted == numEntries)
+            allDone.notify_all();
+    };
+
+    for (size_t i = 0; i < numEntries; i++)
+        if (predecessors[i].empty())
+            m_threadPool->Submit([&runEntry, i](size_t w) { runEntry(i, w); });
+
+    std::unique_lock<std::mutex> lock(mutex);
+    allDone.wait(lock, [&] { return numCompleted == numEntries; });
+    if (error)
+        std::rethrow_exception(error);
+}
+
+static void ForwardPropIfOutOfDate(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    if (node->IsOutOfDateWrtInputs())
+    {
+        node->BeginForwardProp();
+        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+        node->EndForwardProp();
+
+        node->BumpEvalTimeStamp();
+    }
+}
+
+static void BackpropNode(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    node->BeginBackprop();
+    node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+    node->EndBackprop();
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
+    if (m_threadPool)
+    {
+        ParallelTraverse(m_forwardPredecessors, m_forwardSuccessors, [&fr](const ComputationNodeBasePtr& node) { ForwardPropIfOutOfDate(node, fr); });
+        return;
+    }
+
     for (auto& node : m_nestedNodes)
     {
 #if 0
         if (dynamic_pointer_cast<LearnableParameter<float>>(node))
             dynamic_pointer_cast<ComputationNode<float>>(node)->DebugLogMinibatch();
 #endif
-        if (node->IsOutOfDateWrtInputs())
-        {
-            node->BeginForwardProp();
-            node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
-            node->EndForwardProp();
-
-            node->BumpEvalTimeStamp();
-        }
+        ForwardPropIfOutOfDate(node, fr);
     }
 }
 
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
+    if (m_threadPool)
+    {
+        ParallelTraverse(m_backpropPredecessors, m_backpropSuccessors, [this, &fr](const ComputationNodeBasePtr& node)
+        {
+            BackpropNode(node, fr);
+            if (m_backpropCallback)
+                m_backpropCallback(node);
+        });
+        return;
+    }
+
     // process nodes in pre-determined order
     for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
     {
-        auto& node = *pnode;
-
-        node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndBackprop();
+        BackpropNode(*pnode, fr);
+        if (m_backpropCallback)
+            m_backpropCallback(*pnode);
     }
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
@@ -834,6 +1086,17 @@ void ComputationNetwork::PrintMemorySharingStructure(const std::vector<Computati
         fprintf(stderr, "}\n");
     }
     fprintf(stderr, "\n");
+
+    // summary of the memory plan; sizes that scale with the minibatch are given per minibatch column
+    const MatrixPool::PlanStatistics& stats = m_matrixPool.GetPlanStatistics<ElemType>();
+    if (stats.numRequests > 0)
+    {
+        fprintf(stderr, "Memory sharing plan: %d requests served by %d matrices (naive reuse: %d matrices).\n",
+                (int) stats.numRequests, (int) stats.numPlannedMatrices, (int) stats.numNaiveMatrices);
+        fprintf(stderr, "\tplanned peak:     %9.1f KB + %9.1f KB per minibatch column\n", stats.plannedFixedBytes / 1024.0,    stats.plannedBytesPerColumn / 1024.0);
+        fprintf(stderr, "\tnaive peak:       %9.1f KB + %9.1f KB per minibatch column\n", stats.naiveFixedBytes / 1024.0,      stats.naiveBytesPerColumn / 1024.0);
+        fprintf(stderr, "\tlower bound:      %9.1f KB + %9.1f KB per minibatch column\n\n", stats.lowerBoundFixedBytes / 1024.0, stats.lowerBoundBytesPerColumn / 1024.0);
+    }
 }
 
 
@@ -917,6 +1180,9 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // from here on, requests are recorded with their lifetimes and bound to shared matrices at the end
+    m_matrixPool.BeginPlanning();
+
     set<ComputationNodeBasePtr> completedEvaluate;
     for (auto& nodeIter : compositeForwardPropEvalOrder)
     {
@@ -984,6 +1250,13 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // now that all lifetimes are known, bind the requested matrices to shared physical matrices
+    m_matrixPool.OptimizedMemoryAllocation();
+
+    // the parallel schedule depends on which nodes share matrices, so it can only be set up now
+    if (m_parallelTraversalThreads > 0)
+        EnableParallelTraversal();
+
     m_areMatricesAllocated = true;
 
     //print the memory sharing structure
@@ -1009,4 +1282,13 @@ void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBase
             pNode->ReleaseMatricesAfterForwardProp(m_matrixPool);
     }
 }
+
+void ComputationNetwork::EnableParallelTraversal()
+{
+    fprintf(stderr, "Enabling parallel traversal on %d threads.\n", (int) m_parallelTraversalThreads);
+    if (!m_parallelTraversalThreadPool)
+        m_parallelTraversalThreadPool = make_shared<WorkStealingThreadPool>(m_parallelTraversalThreads);
+    for (auto& nestedNetwork : m_nestedNetworks)
+        static_pointer_cast<PARTraversalFlowControlNode>(nestedNetwork.second)->EnableParallelTraversal(m_parallelTraversalThreadPool, m_matrixPool);
+}
 } } }
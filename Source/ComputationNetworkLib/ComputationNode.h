@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <mutex>
 
 #define DEFAULT_HIDDEN_ACTIVATION 0.1
 
@@ -1156,6 +1157,9 @@ public:
     MatrixBasePtr GradientPtr() const { return m_gradient; }
     // TODO: This is only used for testing whether a gradient has been allocated. Maybe reduce to bool HasGradient()?
 
+    // for rebinding the gradient to other storage (the matrix object itself may be shared with other nodes through the MatrixPool)
+    shared_ptr<Matrix<ElemType>>& GradientPtrRef() { return m_gradient; }
+
 private:
 
     template<class E>
@@ -1529,14 +1533,15 @@ protected:
     {
         if (matrixPtr == nullptr)
         {
-            matrixPtr = matrixPool.Request<ElemType>(m_deviceId);
+            // predicted size: temporaries are assumed to have the shape of the node's output
+            matrixPool.Request<ElemType>(m_deviceId, this, &matrixPtr, GetSampleLayout().GetNumElements(), HasMBLayout());
         }
     }
 
     void ReleaseMatrixToPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
     {
         assert(matrixPtr != nullptr);
-        matrixPool.Release<ElemType>(matrixPtr);
+        matrixPool.Release<ElemType>(&matrixPtr);
     }
 
 public:
@@ -1692,13 +1697,14 @@ public:
         }
     }
 
-    // NOTE: we should reimplement this to be thread-safe and use a larger than requested initialized memory block
+    // NOTE: we should reimplement this to use a larger than requested initialized memory block
     // we can then just wrap that memory block in a matrix of the correct dimensions since it will be const no one can change it
     // should only need one memory block per device
-    // Thread-safety could be achieved by changing this to a shared_ptr.
     // When using the TensorView interface, one could instead just use a 1x1 matrix with a view that broadcasts its columns (stride 0).
     static const Matrix<ElemType>& ConstOnes(const size_t rows, const size_t cols, const DEVICEID_TYPE deviceId)
     {
+        // nodes may call this concurrently under parallel traversal; entries are never removed, so the reference stays valid
+        std::lock_guard<std::mutex> lock(s_constOnesMutex);
         if (s_constOnes.find(rows) == s_constOnes.end() ||
             s_constOnes[rows].find(cols) == s_constOnes[rows].end()) // not found
         {
@@ -1722,6 +1728,7 @@ protected:
     shared_ptr<Matrix<ElemType>> m_value, m_gradient;
 
     static std::map<size_t, std::map<size_t, shared_ptr<Matrix<ElemType>>>> s_constOnes;
+    static std::mutex s_constOnesMutex;
 };
 
 // convenience wrapper for ComputationNode::New()
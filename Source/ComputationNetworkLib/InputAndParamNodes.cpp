@@ -79,6 +79,8 @@ void LearnableParameter<ElemType>::InitRandom(const bool uniformInit,
                                                 const ElemType initValueScale,
                                                 bool initOnCPUOnly)
 {
+    InvalidatePackedValue();
+
     // fprintf(stderr, "%d x %d: %d  %ls\n", (int)GetNumRows(), (int)GetNumCols(), (int)randomSeed, NodeName().c_str());
 
     // the random seed offset is set via the "randomSeedOffset" parameter in config
@@ -118,6 +120,8 @@ void LearnableParameter<ElemType>::InitFromFile(const wstring& initFromFilePath)
 template <class ElemType>
 void LearnableParameter<ElemType>::InitFromArray(const std::vector<ElemType>& array, size_t numRows, size_t numCols)
 {
+    InvalidatePackedValue();
+
     // infer tensor dimensions from input file if not set
     // Note: The mapping of dimensions of the input matrix to tensor dimensions are somewhat confusing.
     //       The file contains a 2D matrix (one row per text line) that is saved into our column-major representation.
@@ -204,6 +208,7 @@ void LearnableParameter<ElemType>::Load(File& fstream, size_t modelVersion) /*ov
     LoadValue(fstream);
     SetDims(sampleLayout, false); // note: call this after LoadValue() since LoadValue() overwrites m_sampleLayout
     VerifyDataSize(Value());      // sanity check
+    InvalidatePackedValue();
 }
 
 // computation functions don't do anything for parameter nodes
@@ -286,6 +291,30 @@ template <class ElemType>
     PrintNodeValuesToFile(printValues, printMetadata, fstream);
 }
 
+template <class ElemType>
+std::shared_ptr<const CPUPackedMatrix<ElemType>> LearnableParameter<ElemType>::GetPackedValue(size_t numRows)
+{
+    const auto& value = Value();
+    if (value.GetDeviceId() != CPUDEVICE || value.GetMatrixType() != DENSE)
+        LogicError("%ls %ls operation: Only dense CPU values can be packed.", NodeName().c_str(), OperationName().c_str());
+    size_t numElements = value.GetNumElements();
+    if (numRows == 0 || numElements % numRows != 0)
+        InvalidArgument("%ls %ls operation: The value cannot be packed as a matrix with %d rows.", NodeName().c_str(), OperationName().c_str(), (int) numRows);
+
+    std::lock_guard<std::mutex> lock(m_packedValueMutex);
+    if (!m_packedValue || m_packedValue->GetNumRows() != numRows ||
+        m_packedValueTimeStamp != this->GetEvalTimeStamp() || m_packedValueLocation != value.Data())
+    {
+        m_packedValue = make_shared<CPUPackedMatrix<ElemType>>(value.Data(), numRows, numElements / numRows);
+        m_packedValueTimeStamp = this->GetEvalTimeStamp();
+        m_packedValueLocation = value.Data();
+        // A stamp set by ResetEvalTimeStamp() equals the next id that CreateUniqId() hands out. Take that id,
+        // so that the next bump of this node is guaranteed to yield a different stamp.
+        this->CreateUniqId();
+    }
+    return m_packedValue;
+}
+
 template class LearnableParameter<float>;
 template class LearnableParameter<double>;
 
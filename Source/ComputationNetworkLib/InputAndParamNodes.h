@@ -9,8 +9,11 @@
 #include "ScriptableObjects.h"
 #include "TensorShape.h"
 #include "Matrix.h"
+#include "CPUPackedMatrix.h"
 
 #include <string>
+#include <memory>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -30,13 +33,13 @@ class LearnableParameter : public ComputationNode<ElemType>, public NumInputs<0>
 
 public:
     LearnableParameter(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_packedValueTimeStamp(0), m_packedValueLocation(nullptr)
     {
         SetLearningRateMultiplier(1.0f); // enable normal learning by default
         MarkValueNonSharable();
     }
     LearnableParameter(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& shape)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_packedValueTimeStamp(0), m_packedValueLocation(nullptr)
     {
         SetLearningRateMultiplier(1.0f);
         MarkValueNonSharable();
@@ -106,6 +109,25 @@ public:
     void InferInputDimsFrom(const TensorShape& otherShape);
 
     virtual void DumpNodeInfo(const bool printValues, const bool printMetadata, File& fstream) const override;
+
+    // Inference on the CPU: a copy of the value, as a [numRows x (#elements / numRows)] matrix, packed for
+    // products with few columns (see CPUPackedMatrix). It is created on first use and rebuilt after the value
+    // has been written. Writes are detected through the eval time stamp, which whoever modifies a parameter
+    // must bump anyway so that dependent nodes get recomputed, and through the location of the value.
+    // Nodes that share the parameter may call this concurrently during parallel traversal; each caller keeps
+    // the copy it got alive, even if another one rebuilds it meanwhile.
+    std::shared_ptr<const CPUPackedMatrix<ElemType>> GetPackedValue(size_t numRows);
+    void InvalidatePackedValue()
+    {
+        std::lock_guard<std::mutex> lock(m_packedValueMutex);
+        m_packedValue.reset();
+    }
+
+private:
+    std::mutex m_packedValueMutex;         // guards the rebuild of the packed copy
+    std::shared_ptr<const CPUPackedMatrix<ElemType>> m_packedValue;
+    int64_t m_packedValueTimeStamp;        // eval time stamp of the value when it was packed
+    const ElemType* m_packedValueLocation; // and its location
 };
 
 // -----------------------------------------------------------------------
@@ -8,6 +8,8 @@
 #include "ComputationNode.h"
 #include "Matrix.h"
 #include "TensorView.h"
+#include "QuantizedMultiplier.h"
+#include "InputAndParamNodes.h"
 
 #include <unordered_set>
 #include <map>
@@ -229,7 +231,7 @@ class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>
 
 public:
     TimesNodeBase(DEVICEID_TYPE deviceId, const wstring& name, size_t outputRank = 1)
-        : Base(deviceId, name), m_outputRank(outputRank)
+        : Base(deviceId, name), m_outputRank(outputRank), m_quantizationTolerance(0), m_quantizationVerified(false), m_usePackedWeights(false)
     {
     }
 
@@ -293,10 +295,36 @@ public:
         // TensorView::DoMatrixProductOf() will reduce each tensor object into a 2D tensor (or fail if it cannot)
         // and recreate actual Matrix objects (in case of sparse, they must be identical to the original tensor storage object).
         // Transposition is applied after flattening into 2D, but only allowed if the input sample is 2D anyway.
+        // inference with quantized weights, once they have been verified against the regular product
+        bool useQuantizedMultiplier = m_quantizedMultiplier && Input(1)->Value().GetMatrixType() == DENSE;
+        if (useQuantizedMultiplier && m_quantizationVerified)
+        {
+            auto output = ValueFor(fr);
+            m_quantizedMultiplier->Multiply(Input(1)->ValueFor(fr), output);
+            return;
+        }
+
+        // inference with few columns: multiply with the weights packed for this case
+        if (m_usePackedWeights && !useQuantizedMultiplier && Input(1)->Value().GetMatrixType() == DENSE)
+        {
+            auto input1 = Input(1)->ValueFor(fr);
+            if (input1.GetNumCols() <= CPUPackedMatrix<ElemType>::MaxColumns)
+            {
+                auto output = ValueFor(fr);
+                auto& weights = dynamic_cast<LearnableParameter<ElemType>&>(*Input(0));
+                auto packedWeights = weights.GetPackedValue(output.GetNumRows());
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, *packedWeights, input1, 0, output);
+                return;
+            }
+        }
+
         auto input0 = OneSampleTensorFor(0,  /*gradient=*/false, fr.AllowBroadcast());
         auto input1 = OneSampleTensorFor(1,  /*gradient=*/false, fr.AllowBroadcast());
         auto output = OneSampleTensorFor(-1, /*gradient=*/false, fr);
         output.AssignMatrixProductOf(false/*transC*/, input0, m_transpose/*transA*/, input1, false/*transB*/);
+
+        if (useQuantizedMultiplier)
+            VerifyQuantizedMultiplier(fr);
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
@@ -453,8 +481,51 @@ public:
         Base::AllocateGradientMatricesForInputs(matrixPool);
     }
 
+    // Inference only: the weight product can be computed in integer arithmetic by a QuantizedMultiplier,
+    // or with the packed weights kept by the LearnableParameter (see SetUsePackedWeights()).
+    // This requires CPU weights W and the plain matrix product W * x of minibatch data x.
+    bool IsWeightTimesData() const
+    {
+        bool transpose = m_transpose;
+        return !transpose && m_deviceId == CPUDEVICE &&
+               Input(0)->OperationName() == OperationNameOf(LearnableParameter) && !Input(0)->HasMBLayout() && Input(1)->HasMBLayout() &&
+               Input(0)->GetSampleLayout().GetNumElements() == GetSampleLayout().GetNumElements() * Input(1)->GetSampleLayout().GetNumElements();
+    }
+
+    // The first minibatch is computed both ways; if the relative error exceeds 'tolerance', the node falls back to the regular product.
+    void SetQuantizedMultiplier(const shared_ptr<QuantizedMultiplier<ElemType>>& quantizedMultiplier, double tolerance)
+    {
+        m_quantizedMultiplier   = quantizedMultiplier;
+        m_quantizationTolerance = tolerance;
+        m_quantizationVerified  = false;
+    }
+
+    bool UsesQuantizedMultiplier() const { return m_quantizedMultiplier != nullptr; }
+
+    // Minibatches of up to CPUPackedMatrix::MaxColumns columns are multiplied with the packed weights.
+    void SetUsePackedWeights(bool usePackedWeights) { m_usePackedWeights = usePackedWeights; }
+
 private:
+    void VerifyQuantizedMultiplier(const FrameRange& fr)
+    {
+        auto output = ValueFor(fr);
+        Matrix<ElemType> quantizedOutput(output.GetNumRows(), output.GetNumCols(), CPUDEVICE);
+        m_quantizedMultiplier->Multiply(Input(1)->ValueFor(fr), quantizedOutput);
+        double error = QuantizedMultiplier<ElemType>::RelativeError(quantizedOutput, output);
+        if (error > m_quantizationTolerance)
+        {
+            fprintf(stderr, "%ls %ls operation: Relative error of the %d-bit product is %.3g (tolerance %.3g), falling back to floating point.\n",
+                    NodeName().c_str(), OperationName().c_str(), (int) m_quantizedMultiplier->GetNumBits(), error, m_quantizationTolerance);
+            m_quantizedMultiplier.reset();
+        }
+        m_quantizationVerified = true;
+    }
+
     size_t m_outputRank;
+    shared_ptr<QuantizedMultiplier<ElemType>> m_quantizedMultiplier; // may be shared with other nodes that multiply with the same weights
+    double m_quantizationTolerance;
+    bool m_quantizationVerified;
+    bool m_usePackedWeights;
 };
 
 // -----------------------------------------------------------------------
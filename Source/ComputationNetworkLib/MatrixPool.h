@@ -9,6 +9,8 @@
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <numeric>
+#include <map>
 #include <stdlib.h>
 
 #include "Basics.h"
@@ -17,59 +19,302 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class ComputationNodeBase;
+
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
 // Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
+//
+// The pool works in two phases:
+//  - Between BeginPlanning() and OptimizedMemoryAllocation(), while AllocateAllMatrices() simulates the execution order, nodes call Request() and Release() on their matrix
+//    members. Each call is recorded as one step; a request thus defines a lifetime [allocStep, releaseStep) together
+//    with the predicted size of the matrix (elements per sample if it scales with the minibatch, or elements in total).
+//    The requesting member receives an empty placeholder matrix so that code inspecting it during simulation still works.
+//  - OptimizedMemoryAllocation() then assigns all requests to as few and as small physical matrices as possible.
+//    This is an interval-graph coloring: requests are visited from largest to smallest, and each one goes into the
+//    smallest already planned matrix (best fit) whose assigned lifetimes do not overlap its own.
+//    Requests that scale with the minibatch are never mixed with fixed-size ones, as their relative size is unknown.
+//    The planned matrices of each requesting node are remembered, so that a parallel executor can tell which nodes must
+//    not run concurrently because they share memory (see GetPlannedMatrices()).
+// A Request() outside of a planning pass cannot be planned anymore; it receives a private matrix that is never shared.
 class MatrixPool
 {
-    vector<shared_ptr<Matrix<float>>>  m_releasedFloatMatrices;
-    vector<shared_ptr<Matrix<double>>> m_releasedDoubleMatrices;
+public:
+    // statistics of the last plan, in bytes; mb-scaled sizes are per minibatch column
+    struct PlanStatistics
+    {
+        size_t numRequests;
+        size_t numPlannedMatrices;
+        size_t numNaiveMatrices;
+        size_t plannedFixedBytes,    plannedBytesPerColumn;    // sum of the planned matrix sizes
+        size_t naiveFixedBytes,      naiveBytesPerColumn;      // what the previous LIFO reuse of released matrices would have allocated (upper estimate where it mixes both kinds)
+        size_t lowerBoundFixedBytes, lowerBoundBytesPerColumn; // max over all steps of the bytes simultaneously alive
+
+        PlanStatistics()
+            : numRequests(0), numPlannedMatrices(0), numNaiveMatrices(0),
+              plannedFixedBytes(0), plannedBytesPerColumn(0), naiveFixedBytes(0), naiveBytesPerColumn(0), lowerBoundFixedBytes(0), lowerBoundBytesPerColumn(0)
+        {
+        }
+    };
+
+private:
+    static const size_t NotReleased = SIZE_MAX;
 
     template <class ElemType>
-    vector<shared_ptr<Matrix<ElemType>>>& GetReleasedMatrices();
+    struct MemRequestInfo
+    {
+        DEVICEID_TYPE deviceId;
+        const ComputationNodeBase* owner;         // the node that requested it
+        shared_ptr<Matrix<ElemType>>* pMatrixPtr; // the node member that receives the matrix once planned
+        size_t numElements;                       // predicted size (per sample if mbScale)
+        bool mbScale;                             // size scales with the number of minibatch columns
+        size_t allocStep;
+        size_t releaseStep;
+
+        MemRequestInfo(DEVICEID_TYPE deviceId, const ComputationNodeBase* owner, shared_ptr<Matrix<ElemType>>* pMatrixPtr, size_t numElements, bool mbScale, size_t allocStep)
+            : deviceId(deviceId), owner(owner), pMatrixPtr(pMatrixPtr), numElements(numElements), mbScale(mbScale), allocStep(allocStep), releaseStep(NotReleased)
+        {
+        }
+
+        bool Overlaps(const MemRequestInfo& other) const
+        {
+            return allocStep < other.releaseStep && other.allocStep < releaseStep;
+        }
+    };
+
+    // one physical matrix of the plan, and the requests that share it
+    struct MemAllocInfo
+    {
+        DEVICEID_TYPE deviceId;
+        bool mbScale;
+        size_t numElements;
+        vector<size_t> requests; // indices into the request vector
+    };
+
+    vector<MemRequestInfo<float>>  m_floatRequests;
+    vector<MemRequestInfo<double>> m_doubleRequests;
+    PlanStatistics m_floatStatistics;
+    PlanStatistics m_doubleStatistics;
+    size_t m_stepCounter;
+    bool m_isPlanning;
+    std::map<const ComputationNodeBase*, std::vector<const void*>> m_plannedMatricesByOwner;
+
+    template <class ElemType>
+    vector<MemRequestInfo<ElemType>>& GetMemRequestInfoVec();
+    template <class ElemType>
+    PlanStatistics& GetStatistics();
 
 public:
+    MatrixPool()
+        : m_stepCounter(0), m_isPlanning(false)
+    {
+    }
+
+    // start recording requests for a new plan; this forgets the previous plan
+    void BeginPlanning()
+    {
+        m_floatRequests.clear();
+        m_doubleRequests.clear();
+        m_plannedMatricesByOwner.clear();
+        m_stepCounter = 0;
+        m_isPlanning = true;
+    }
+
+    // request a matrix for a member of node 'owner'; the member is bound to its shared matrix by OptimizedMemoryAllocation()
+    // 'numElements' is the predicted size, per minibatch column if 'mbScale'
+    template <class ElemType>
+    void Request(DEVICEID_TYPE deviceId, const ComputationNodeBase* owner, shared_ptr<Matrix<ElemType>>* pMatrixPtr, size_t numElements, bool mbScale)
+    {
+        if (pMatrixPtr == nullptr)
+            LogicError("MatrixPool::Request: pMatrixPtr should not be null.");
+
+        // too late to be planned: fall back to a matrix of its own, which is safe since it is shared with nobody
+        if (!m_isPlanning)
+        {
+            *pMatrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            return;
+        }
+
+        GetMemRequestInfoVec<ElemType>().push_back(MemRequestInfo<ElemType>(deviceId, owner, pMatrixPtr, numElements, mbScale, m_stepCounter++));
+
+        // placeholder until the plan is made; holds no memory
+        *pMatrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+    }
+
     // release here means the matrix can be put back and shared by others
     template <class ElemType>
-    void Release(shared_ptr<Matrix<ElemType>> freeMatrix)
+    void Release(shared_ptr<Matrix<ElemType>>* pMatrixPtr)
     {
-        if (freeMatrix == nullptr || freeMatrix->GetMatrixType() == SPARSE)
+        if (pMatrixPtr == nullptr || *pMatrixPtr == nullptr || (*pMatrixPtr)->GetMatrixType() == SPARSE)
             LogicError("MatrixPool::Release: freeMatrix should not be null or sparse.");
 //#define SUPRESS_MEMSHARING // #define this to disable memory sharing through this structure
         // TODO: Make this a runtime option.
 #ifndef SUPRESS_MEMSHARING
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
-#ifdef _DEBUG
-        for (int i = 0; i < releasedMatrices.size(); i++)
+        vector<MemRequestInfo<ElemType>>& memInfoVec = GetMemRequestInfoVec<ElemType>();
+        auto iter = std::find_if(memInfoVec.rbegin(), memInfoVec.rend(), [pMatrixPtr](const MemRequestInfo<ElemType>& memInfo) { return memInfo.pMatrixPtr == pMatrixPtr; });
+        // A matrix that was not requested during this planning pass is owned by its node; there is nothing to share.
+        if (iter == memInfoVec.rend())
+            return;
+        if (iter->releaseStep != NotReleased)
         {
-            if (releasedMatrices[i] == freeMatrix)
-                RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
-        }
-
+#ifdef _DEBUG
+            RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
 #endif
-        releasedMatrices.push_back(freeMatrix);
+            return;
+        }
+        iter->releaseStep = m_stepCounter++;
 #endif
     }
 
+    // assign all requests recorded since BeginPlanning() to physical matrices, and end the planning pass
+    void OptimizedMemoryAllocation()
+    {
+        if (!m_isPlanning)
+            LogicError("MatrixPool::OptimizedMemoryAllocation: called without prior call to BeginPlanning().");
+
+        // MatrixPool is not templated, so we plan both float and double requests here
+        OptimizedMemoryAllocationFunc<float>();
+        OptimizedMemoryAllocationFunc<double>();
+        m_stepCounter = 0;
+        m_isPlanning = false;
+    }
+
     template <class ElemType>
-    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId)
+    const PlanStatistics& GetPlanStatistics()
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
-        shared_ptr<Matrix<ElemType>> matrixPtr;
-        if (releasedMatrices.empty())
+        return GetStatistics<ElemType>();
+    }
+
+    // identities of the physical matrices (of either precision) that were planned for a node's requests
+    const std::vector<const void*>& GetPlannedMatrices(const ComputationNodeBase* owner) const
+    {
+        static const std::vector<const void*> none;
+        auto iter = m_plannedMatricesByOwner.find(owner);
+        return iter != m_plannedMatricesByOwner.end() ? iter->second : none;
+    }
+
+private:
+    template <class ElemType>
+    void OptimizedMemoryAllocationFunc()
+    {
+        vector<MemRequestInfo<ElemType>>& memInfoVec = GetMemRequestInfoVec<ElemType>();
+        PlanStatistics& stats = GetStatistics<ElemType>();
+        stats = PlanStatistics();
+        if (memInfoVec.empty())
+            return;
+
+        // largest requests first, so that every request can go into an already planned matrix at least as large as itself
+        vector<size_t> order(memInfoVec.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&memInfoVec](size_t a, size_t b) { return memInfoVec[a].numElements > memInfoVec[b].numElements; });
+
+        vector<MemAllocInfo> memAllocInfoVec;
+        for (size_t i : order)
         {
-            matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            const auto& memInfo = memInfoVec[i];
+            size_t bestFit = SIZE_MAX;
+            for (size_t k = 0; k < memAllocInfoVec.size(); k++)
+            {
+                const auto& memAlloc = memAllocInfoVec[k];
+                if (memAlloc.deviceId != memInfo.deviceId || memAlloc.mbScale != memInfo.mbScale)
+                    continue;
+                if (bestFit != SIZE_MAX && memAllocInfoVec[bestFit].numElements <= memAlloc.numElements)
+                    continue;
+                bool conflicts = std::any_of(memAlloc.requests.begin(), memAlloc.requests.end(), [&](size_t j) { return memInfoVec[j].Overlaps(memInfo); });
+                if (!conflicts)
+                    bestFit = k;
+            }
+            if (bestFit == SIZE_MAX)
+            {
+                memAllocInfoVec.push_back(MemAllocInfo{ memInfo.deviceId, memInfo.mbScale, memInfo.numElements, vector<size_t>() });
+                bestFit = memAllocInfoVec.size() - 1;
+            }
+            memAllocInfoVec[bestFit].requests.push_back(i);
         }
-        else
+
+        // materialize the plan
+        for (const auto& memAlloc : memAllocInfoVec)
         {
-            matrixPtr = releasedMatrices.back();
-            releasedMatrices.pop_back();
+            auto matrixPtr = make_shared<Matrix<ElemType>>(memAlloc.deviceId);
+            for (size_t i : memAlloc.requests)
+            {
+                *memInfoVec[i].pMatrixPtr = matrixPtr;
+                m_plannedMatricesByOwner[memInfoVec[i].owner].push_back(matrixPtr.get());
+            }
+            (memAlloc.mbScale ? stats.plannedBytesPerColumn : stats.plannedFixedBytes) += memAlloc.numElements * sizeof(ElemType);
         }
+        stats.numRequests = memInfoVec.size();
+        stats.numPlannedMatrices = memAllocInfoVec.size();
+        ComputeBaselineStatistics(memInfoVec, stats);
 
-        if (!matrixPtr) // this can't really happen
-            LogicError("MatrixPool::Request: failed to get a valid matrix.");
+        memInfoVec.clear();
+    }
+
+    // replay the request/release sequence to determine what the plan is compared against:
+    // the lower bound (peak of simultaneously alive bytes), and the naive allocation that the pool used to do,
+    // i.e. handing out the most recently released matrix regardless of its size
+    template <class ElemType>
+    static void ComputeBaselineStatistics(const vector<MemRequestInfo<ElemType>>& memInfoVec, PlanStatistics& stats)
+    {
+        struct Event
+        {
+            size_t step;
+            size_t request;
+            bool isRelease;
+        };
+        vector<Event> events;
+        for (size_t i = 0; i < memInfoVec.size(); i++)
+        {
+            events.push_back(Event{ memInfoVec[i].allocStep, i, false });
+            if (memInfoVec[i].releaseStep != NotReleased)
+                events.push_back(Event{ memInfoVec[i].releaseStep, i, true });
+        }
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.step < b.step; });
 
-        return matrixPtr;
+        struct NaiveMatrix
+        {
+            size_t fixedElements, elementsPerColumn;
+        };
+        vector<NaiveMatrix> naiveMatrices;
+        vector<size_t> naiveReleased;                          // LIFO, like the old pool (which did not distinguish devices either)
+        vector<size_t> naiveAssignment(memInfoVec.size(), 0); // request -> naive matrix
+        size_t aliveFixed = 0, alivePerColumn = 0;
+        for (const auto& event : events)
+        {
+            const auto& memInfo = memInfoVec[event.request];
+            size_t& alive = memInfo.mbScale ? alivePerColumn : aliveFixed;
+            if (event.isRelease)
+            {
+                alive -= memInfo.numElements;
+                naiveReleased.push_back(naiveAssignment[event.request]);
+                continue;
+            }
+
+            alive += memInfo.numElements;
+            stats.lowerBoundFixedBytes     = max(stats.lowerBoundFixedBytes,     aliveFixed     * sizeof(ElemType));
+            stats.lowerBoundBytesPerColumn = max(stats.lowerBoundBytesPerColumn, alivePerColumn * sizeof(ElemType));
+
+            if (naiveReleased.empty())
+            {
+                naiveMatrices.push_back(NaiveMatrix{ 0, 0 });
+                naiveAssignment[event.request] = naiveMatrices.size() - 1;
+            }
+            else
+            {
+                naiveAssignment[event.request] = naiveReleased.back();
+                naiveReleased.pop_back();
+            }
+            auto& naive = naiveMatrices[naiveAssignment[event.request]];
+            size_t& naiveElements = memInfo.mbScale ? naive.elementsPerColumn : naive.fixedElements;
+            naiveElements = max(naiveElements, memInfo.numElements);
+        }
+
+        stats.numNaiveMatrices = naiveMatrices.size();
+        for (const auto& naive : naiveMatrices)
+        {
+            stats.naiveFixedBytes     += naive.fixedElements     * sizeof(ElemType);
+            stats.naiveBytesPerColumn += naive.elementsPerColumn * sizeof(ElemType);
+        }
     }
 };
 
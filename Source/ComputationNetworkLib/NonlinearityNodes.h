@@ -155,6 +155,146 @@ DeclareUnaryElementWiseWithOpCodeNode(Tanh,            Tanh,            Elementw
 
 #pragma pop_macro("DeclareUnaryElementWiseWithOpCodeNode")
 
+// -----------------------------------------------------------------------
+// FusedBiasActivationNode (input0, input1) -- an activation applied to a sum,
+// typically of a projection and a bias, evaluated as a single elementwise op,
+// e.g. Sigmoid(Plus(z, b)). Only Sigmoid, Tanh, and RectifiedLinear are supported.
+// This node is not meant to be used directly. It is created by
+// ComputationNetwork::FuseBiasActivations() to replace the pair of
+// nodes, saving the intermediate matrix and one pass over memory each way.
+// The gradient is computed from the output, as for the stand-alone nonlinearity.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class FusedBiasActivationNode : public BinaryElementWiseNode<ElemType>
+{
+    typedef BinaryElementWiseNode<ElemType> Base; UsingBinaryElementwiseNodeBaseMembers;
+    static const std::wstring TypeName() { return L"FusedBiasActivation"; }
+
+    // the supported fusions; 'operation' is what gets saved to the model
+    struct FusedOperation
+    {
+        const wchar_t* operation;
+        const wchar_t* outerOperationName; // OperationName() of the consuming node
+        const wchar_t* innerOperationName; // OperationName() of the node that is fused into it
+        ElementWiseOperator opForward;
+        ElementWiseOperator opBackward;
+    };
+    static const FusedOperation* FusedOperations(size_t& numFusedOperations)
+    {
+        static const FusedOperation fusedOperations[] =
+        {
+            // operation               outer              inner    forward                  backward (from output)
+            { L"SigmoidOfSum",         L"Sigmoid",        L"Plus", opSigmoidOfSum,         opElementwiseProductWithSigmoidDerivativeFromOutput },
+            { L"TanhOfSum",            L"Tanh",           L"Plus", opTanhOfSum,            opElementwiseProductWithTanhDerivativeFromOutput },
+            { L"LinearRectifierOfSum", L"RectifiedLinear", L"Plus", opLinearRectifierOfSum, opElementwiseProductWithLinearRectifierDerivativeFromOutput },
+        };
+        numFusedOperations = _countof(fusedOperations);
+        return fusedOperations;
+    }
+
+    void ValidateOp()
+    {
+        size_t numFusedOperations;
+        const FusedOperation* fusedOperations = FusedOperations(numFusedOperations);
+        for (size_t i = 0; i < numFusedOperations; i++)
+        {
+            if (m_operation == fusedOperations[i].operation)
+            {
+                m_opForward  = fusedOperations[i].opForward;
+                m_opBackward = fusedOperations[i].opBackward;
+                return;
+            }
+        }
+        InvalidArgument("%ls was given an invalid operation code '%ls'.", NodeDescription().c_str(), m_operation.c_str());
+    }
+
+public:
+    FusedBiasActivationNode(DEVICEID_TYPE deviceId, const wstring& name, const std::wstring& operation = std::wstring())
+        : Base(deviceId, name), m_operation(operation), m_opForward(opNone), m_opBackward(opNone)
+    {
+        if (!m_operation.empty())
+            ValidateOp();
+    }
+
+    FusedBiasActivationNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : FusedBiasActivationNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"fusedOp"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    // determine the fused operation for a node 'outer' whose first input is 'inner'; returns an empty string if they cannot be fused
+    static std::wstring FusedOperationFor(const std::wstring& outerOperationName, const std::wstring& innerOperationName)
+    {
+        size_t numFusedOperations;
+        const FusedOperation* fusedOperations = FusedOperations(numFusedOperations);
+        for (size_t i = 0; i < numFusedOperations; i++)
+            if (outerOperationName == fusedOperations[i].outerOperationName && innerOperationName == fusedOperations[i].innerOperationName)
+                return fusedOperations[i].operation;
+        return std::wstring();
+    }
+
+    virtual void /*ComputationNodeBase::*/ CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<FusedBiasActivationNode<ElemType>>(nodeP);
+            node->m_operation  = m_operation;
+            node->m_opForward  = m_opForward;
+            node->m_opBackward = m_opBackward;
+        }
+    }
+
+    virtual void /*ComputationNodeBase::*/ Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_operation;
+        ValidateOp();
+    }
+
+    virtual void /*ComputationNodeBase::*/ Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_operation; // note: we serialize the string and not the opcode, since opcodes may change
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        size_t rank = DetermineElementwiseTensorRank();
+        auto result =           ValueTensorFor(rank, fr);
+        auto input0 = Input(0)->ValueTensorFor(rank, fr.AllowBroadcast());
+        auto input1 = Input(1)->ValueTensorFor(rank, fr.AllowBroadcast());
+        result.DoBinaryOpOf(0, input0, input1, 1, m_opForward, opSum);
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        // both inputs receive the same gradient, gradient .* f'(output), reduced if the input broadcasts
+        size_t rank = DetermineElementwiseTensorRank();
+        auto gradient      =                    GradientTensorFor(rank, fr);
+        auto value         =                    ValueTensorFor(rank, fr);
+        auto inputGradient = Input(inputIndex)->GradientTensorFor(rank, fr.AllowBroadcast());
+
+        // if reduction then mask the respective input(s) (zero out the gaps)
+        if (Input(inputIndex)->ReducesInTimeWrt(shared_from_this()))
+            MaskMissingGradientColumnsToZero(fr);
+
+        inputGradient.DoBinaryOpOf(1, gradient, value, 1, m_opBackward, opSum);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return true; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+private:
+    std::wstring m_operation; // the fused operation as a string, e.g. "SigmoidOfSum", see FusedOperations()
+    ElementWiseOperator m_opForward;
+    ElementWiseOperator m_opBackward;
+};
+
+template class FusedBiasActivationNode<float>;
+template class FusedBiasActivationNode<double>;
+
 // -----------------------------------------------------------------------
 // SoftmaxNodeBase (input) -- shared base of Softmax and LogSoftmax
 // -----------------------------------------------------------------------
@@ -372,6 +372,9 @@ public:
         return -direction;
     }
 
+    int GetTimeStep() const { return m_timeStep; }
+    ElemType GetInitialActivationValue() const { return m_initialActivationValue; }
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
     {
         Base::CopyTo(nodeP, newName, flags);
@@ -552,6 +555,419 @@ public:
 template class FutureValueNode<float>;
 template class FutureValueNode<double>;
 
+// -----------------------------------------------------------------------
+// FusedLSTMNode (x, W, H, B, peepholes) -- an entire LSTM layer as a single node
+//
+// This computes the same as the recurrent loop of BS.RNNs.LSTMP (without projection
+// and self-stabilization), but without unrolling it node by node and frame by frame:
+//  - the input projections W x + B of all frames are computed by a single GEMM;
+//  - each time step then runs one GEMM H h(t-1) over all parallel sequences, plus a few tensor ops;
+//  - backprop runs the recurrence backwards once, collecting the gradients of all gate pre-activations,
+//    from which the gradients of x, W, H, and B are again single GEMMs over all frames.
+// The gates are stacked in the rows of W, H, and B in the order input, forget, output, cell input.
+// 'peepholes' is [cellDim x 3], the diagonal cell-to-gate weights of the input, forget, and output gate.
+// 'direction' is -1 to recur from the past (like PastValue) or +1 from the future (like FutureValue).
+// At sequence boundaries, h and c are 'initialState', like the defaultHiddenActivation of PastValue.
+// This node is not part of a recurrent loop; it must always see the entire minibatch.
+// ComputationNetwork::FuseLSTMCells() creates it from the equivalent subgraph.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class FusedLSTMNode : public ComputationNode<ElemType>, public NumInputs<5>
+{
+    typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"FusedLSTM"; }
+
+public:
+    // the order in which the gates are stacked in W, H, and B
+    enum { inputGate = 0, forgetGate = 1, outputGate = 2, cellInput = 3, numGates = 4 };
+
+private:
+    void Init()
+    {
+        if (m_direction != -1 && m_direction != +1)
+            InvalidArgument("%ls %ls operation: direction must be -1 (past) or +1 (future).", NodeName().c_str(), OperationName().c_str());
+        CreateMatrixIfNull(m_gates);
+        CreateMatrixIfNull(m_cells);
+        CreateMatrixIfNull(m_tanhCells);
+        CreateMatrixIfNull(m_prevH);
+        CreateMatrixIfNull(m_prevC);
+        CreateMatrixIfNull(m_stepMask);
+        CreateMatrixIfNull(m_initialState);
+        CreateMatrixIfNull(m_carriedH);
+        CreateMatrixIfNull(m_carriedC);
+        CreateMatrixIfNull(m_dhNext);
+        CreateMatrixIfNull(m_dcNext);
+        CreateMatrixIfNull(m_dc);
+        CreateMatrixIfNull(m_temp);
+    }
+
+public:
+    FusedLSTMNode(DEVICEID_TYPE deviceId, const wstring& name, int direction = -1, ElemType initialStateValue = 0)
+        : Base(deviceId, name), m_direction(direction), m_initialStateValue(initialStateValue), m_carriesState(false), m_gatesGradientUpToDate(false)
+    {
+        Init();
+    }
+
+    FusedLSTMNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : FusedLSTMNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"direction"), configp->Get(L"initialState"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void /*ComputationNodeBase::*/ CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<FusedLSTMNode<ElemType>>(nodeP);
+            node->m_direction         = m_direction;
+            node->m_initialStateValue = m_initialStateValue;
+        }
+    }
+
+    virtual void /*ComputationNodeBase::*/ Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_direction << m_initialStateValue;
+    }
+
+    virtual void /*ComputationNodeBase::*/ Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_direction >> m_initialStateValue;
+        Init();
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+        if (isFinalValidationPass && !HasMBLayout())
+            InvalidArgument("%ls %ls operation can only operate on minibatches.", NodeName().c_str(), OperationName().c_str());
+
+        // the cell dimension is given by the hidden-to-hidden weights H [numGates * cellDim x cellDim]
+        size_t cellDim  = Input(2)->GetSampleLayout().GetRank() > 0 ? Input(2)->GetAsMatrixNumCols() : 0;
+        size_t inputDim = Input(0)->GetSampleMatrixNumRows();
+        if (isFinalValidationPass || (cellDim != 0 && inputDim != 0))
+        {
+            Input(1)->ValidateInferInputDimsFrom(TensorShape(numGates * cellDim, inputDim));
+            if (isFinalValidationPass)
+            {
+                if (Input(1)->GetAsMatrixNumRows() != numGates * cellDim || Input(1)->GetAsMatrixNumCols() != inputDim)
+                    InvalidArgument("%ls %ls operation: The input weights must be [%d x %d].", NodeName().c_str(), OperationName().c_str(), (int) (numGates * cellDim), (int) inputDim);
+                if (Input(2)->GetAsMatrixNumRows() != numGates * cellDim)
+                    InvalidArgument("%ls %ls operation: The hidden-to-hidden weights must be [%d x %d].", NodeName().c_str(), OperationName().c_str(), (int) (numGates * cellDim), (int) cellDim);
+                if (Input(3)->GetSampleLayout().GetNumElements() != numGates * cellDim || Input(3)->HasMBLayout())
+                    InvalidArgument("%ls %ls operation: The bias must be a vector of dimension %d.", NodeName().c_str(), OperationName().c_str(), (int) (numGates * cellDim));
+                if (Input(4)->GetAsMatrixNumRows() != cellDim || Input(4)->GetAsMatrixNumCols() != 3 || Input(4)->HasMBLayout())
+                    InvalidArgument("%ls %ls operation: The peephole weights must be [%d x 3].", NodeName().c_str(), OperationName().c_str(), (int) cellDim);
+            }
+            SetDims(TensorShape(cellDim), HasMBLayout());
+        }
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        if (!fr.IsAllFrames())
+            LogicError("%ls %ls operation must not be part of a recurrent loop.", NodeName().c_str(), OperationName().c_str());
+
+        size_t S = GetNumParallelSequences();
+        size_t T = GetNumTimeSteps();
+        size_t cellDim = GetSampleMatrixNumRows();
+        UpdateStepMask();
+
+        // input projections of all frames in one go: gates = W x + B
+        Input(0)->MaskMissingValueColumnsToZero(fr); // gaps must not leak NaNs into the recurrence
+        Matrix<ElemType>::Multiply(Input(1)->Value(), false, Input(0)->Value(), false, *m_gates);
+        TensorView<ElemType>(m_gates, TensorShape(numGates * cellDim, S * T)).AddCopyOf(TensorView<ElemType>(Input(3)->ValuePtr(), TensorShape(numGates * cellDim, 1)));
+
+        m_cells->Resize(cellDim, S * T);
+        m_tanhCells->Resize(cellDim, S * T);
+        m_prevH->Resize(cellDim, S * T);
+        m_prevC->Resize(cellDim, S * T);
+        m_initialState->Resize(1, 1);
+        m_initialState->SetValue(m_initialStateValue);
+        auto initialState = TensorView<ElemType>(m_initialState, TensorShape(1, 1, 1));
+
+        // the recurrence proper
+        for (size_t i = 0; i < T; i++)
+        {
+            size_t t = m_direction < 0 ? i : T - 1 - i;
+            ptrdiff_t tPrev = (ptrdiff_t) t + m_direction;
+
+            // h(t-1) and c(t-1), or the initial state where a sequence starts
+            auto mask  = StepTensor(m_stepMask, t);
+            auto prevH = StepTensor(m_prevH, t);
+            auto prevC = StepTensor(m_prevC, t);
+            if (tPrev >= 0 && tPrev < (ptrdiff_t) T)
+            {
+                prevH.AssignCondOf(mask, StepTensor(ValuePtr(), tPrev), initialState);
+                prevC.AssignCondOf(mask, StepTensor(m_cells,    tPrev), initialState);
+            }
+            else if (m_carriesState) // truncated BPTT: continue from the end of the previous minibatch
+            {
+                prevH.AssignCondOf(mask, StepTensor(m_carriedH, 0), initialState);
+                prevC.AssignCondOf(mask, StepTensor(m_carriedC, 0), initialState);
+            }
+            else
+            {
+                prevH.AssignCopyOf(initialState);
+                prevC.AssignCopyOf(initialState);
+            }
+
+            // add the recurrent contribution H h(t-1)
+            Matrix<ElemType> gatesStep = m_gates->ColumnSlice(t * S, S);
+            Matrix<ElemType>::MultiplyAndAdd(Input(2)->Value(), false, m_prevH->ColumnSlice(t * S, S), false, gatesStep);
+
+            // input and forget gates, with peepholes from c(t-1)
+            auto inputAndForgetGates = GatesTensor(m_gates, inputGate, forgetGate + 1, t);
+            inputAndForgetGates.AddElementwiseProductOf(PeepholesTensor(Input(4)->ValuePtr(), inputGate, forgetGate + 1), prevC);
+            inputAndForgetGates.AssignSigmoidOf(inputAndForgetGates);
+
+            // c(t) = f .* c(t-1) + i .* tanh(cell input)
+            auto cellInputs = GatesTensor(m_gates, cellInput, cellInput + 1, t);
+            cellInputs.AssignTanhOf(cellInputs);
+            auto c = StepTensor(m_cells, t);
+            c.AssignElementwiseProductOf(GatesTensor(m_gates, forgetGate, forgetGate + 1, t), prevC);
+            c.AddElementwiseProductOf(GatesTensor(m_gates, inputGate, inputGate + 1, t), cellInputs);
+
+            // output gate, with peephole from c(t)
+            auto outputGates = GatesTensor(m_gates, outputGate, outputGate + 1, t);
+            outputGates.AddElementwiseProductOf(PeepholesTensor(Input(4)->ValuePtr(), outputGate, outputGate + 1), c);
+            outputGates.AssignSigmoidOf(outputGates);
+
+            // h(t) = o .* tanh(c(t))
+            auto tanhC = StepTensor(m_tanhCells, t);
+            tanhC.AssignTanhOf(c);
+            StepTensor(ValuePtr(), t).AssignElementwiseProductOf(outputGates, tanhC);
+        }
+
+        // in truncated BPTT, sequences may continue into the next minibatch
+        if (m_direction < 0)
+        {
+            m_carriedH->SetValue(Value().ColumnSlice((T - 1) * S, S));
+            m_carriedC->SetValue(m_cells->ColumnSlice((T - 1) * S, S));
+        }
+        m_gatesGradientUpToDate = false;
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        if (!fr.IsAllFrames())
+            LogicError("%ls %ls operation must not be part of a recurrent loop.", NodeName().c_str(), OperationName().c_str());
+
+        // the recurrence is backpropagated once, for all inputs
+        if (!m_gatesGradientUpToDate)
+        {
+            BackpropThroughTime();
+            m_gatesGradientUpToDate = true;
+        }
+
+        size_t cellDim = GetSampleMatrixNumRows();
+        size_t numCols = GetNumParallelSequences() * GetNumTimeSteps();
+        switch (inputIndex)
+        {
+        case 0: // x
+            Matrix<ElemType>::MultiplyAndAdd(Input(1)->Value(), true, *m_gatesGradient, false, Input(0)->Gradient());
+            break;
+        case 1: // W
+            Matrix<ElemType>::MultiplyAndAdd(*m_gatesGradient, false, Input(0)->Value(), true, Input(1)->Gradient());
+            break;
+        case 2: // H
+            Matrix<ElemType>::MultiplyAndAdd(*m_gatesGradient, false, *m_prevH, true, Input(2)->Gradient());
+            break;
+        case 3: // B
+            TensorView<ElemType>(Input(3)->GradientPtr(), TensorShape(numGates * cellDim, 1)).AddCopyOf(TensorView<ElemType>(m_gatesGradient, TensorShape(numGates * cellDim, numCols)));
+            break;
+        case 4: // peepholes: input and forget gates look at c(t-1), the output gate at c(t)
+        {
+            auto peepholesGradient = Input(4)->GradientPtr();
+            PeepholesTensor(peepholesGradient, inputGate, forgetGate + 1).AddElementwiseProductOf(GatesTensor(m_gatesGradient, inputGate, forgetGate + 1, 0, numCols), ColumnsTensor(m_prevC, 0, numCols));
+            PeepholesTensor(peepholesGradient, outputGate, outputGate + 1).AddElementwiseProductOf(GatesTensor(m_gatesGradient, outputGate, outputGate + 1, 0, numCols), ColumnsTensor(m_cells, 0, numCols));
+            break;
+        }
+        default:
+            LogicError("%ls %ls operation: Invalid input index %d.", NodeName().c_str(), OperationName().c_str(), (int) inputIndex);
+        }
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex != 3; }
+
+    // the forward buffers are owned by the node, since they live until backprop; the gate gradients are only needed during backprop
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        if (m_gatesGradient == nullptr)
+            matrixPool.Request<ElemType>(m_deviceId, this, &m_gatesGradient, numGates * GetSampleLayout().GetNumElements(), HasMBLayout());
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_gatesGradient, matrixPool);
+    }
+
+private:
+    static const Matrix<ElemType>& AsMatrix(const MatrixBasePtr& data)
+    {
+        return dynamic_cast<const Matrix<ElemType>&>(*data);
+    }
+
+    // [cellDim x gateEnd-gateBegin x numColumns] view of the given gates in a [numGates * cellDim x columns] matrix
+    TensorView<ElemType> GatesTensor(const MatrixBasePtr& data, size_t gateBegin, size_t gateEnd, size_t firstColumn, size_t numColumns) const
+    {
+        size_t cellDim = GetSampleMatrixNumRows();
+        TensorShape shape(cellDim, numGates, AsMatrix(data).GetNumCols());
+        shape.NarrowTo(1, gateBegin, gateEnd);
+        shape.NarrowTo(2, firstColumn, firstColumn + numColumns);
+        return TensorView<ElemType>(data, shape);
+    }
+    TensorView<ElemType> GatesTensor(const MatrixBasePtr& data, size_t gateBegin, size_t gateEnd, size_t t) const
+    {
+        size_t S = GetNumParallelSequences();
+        return GatesTensor(data, gateBegin, gateEnd, t * S, S);
+    }
+
+    // [rows x 1 x numColumns] view of a column range of a matrix, to line up with GatesTensor()
+    static TensorView<ElemType> ColumnsTensor(const MatrixBasePtr& data, size_t firstColumn, size_t numColumns)
+    {
+        TensorShape shape(AsMatrix(data).GetNumRows(), 1, AsMatrix(data).GetNumCols());
+        shape.NarrowTo(2, firstColumn, firstColumn + numColumns);
+        return TensorView<ElemType>(data, shape);
+    }
+    TensorView<ElemType> StepTensor(const MatrixBasePtr& data, size_t t) const
+    {
+        size_t S = GetNumParallelSequences();
+        return ColumnsTensor(data, t * S, S);
+    }
+
+    // [cellDim x gateEnd-gateBegin x 1] view of the peephole weights (or their gradient) of the given gates
+    TensorView<ElemType> PeepholesTensor(const MatrixBasePtr& data, size_t gateBegin, size_t gateEnd) const
+    {
+        TensorShape shape(GetSampleMatrixNumRows(), 3, 1);
+        shape.NarrowTo(1, gateBegin, gateEnd);
+        return TensorView<ElemType>(data, shape);
+    }
+
+    // determine for every column whether its predecessor in the recurrence (at t + m_direction) belongs to the same sequence;
+    // if not, the column starts from the initial state
+    void UpdateStepMask()
+    {
+        const auto& pMBLayout = GetMBLayout();
+        size_t S = pMBLayout->GetNumParallelSequences();
+        size_t T = pMBLayout->GetNumTimeSteps();
+        vector<ElemType> mask(S * T, 0);
+        m_carriesState = false;
+        for (const auto& seq : pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            ptrdiff_t tEnd = (ptrdiff_t) min(seq.tEnd, T);
+            for (ptrdiff_t t = max(seq.tBegin, (ptrdiff_t) 0); t < tEnd; t++)
+            {
+                ptrdiff_t tPrev = t + m_direction;
+                if (tPrev < seq.tBegin || tPrev >= (ptrdiff_t) seq.tEnd)
+                    continue;
+                mask[t * S + seq.s] = 1;
+                if (tPrev < 0)
+                    m_carriesState = true;
+                else if (tPrev >= (ptrdiff_t) T)
+                    InvalidArgument("%ls %ls operation: Sequences must not extend beyond the end of the minibatch when recurring from the future.", NodeName().c_str(), OperationName().c_str());
+            }
+        }
+        if (m_carriesState && (m_carriedH->GetNumRows() != GetSampleMatrixNumRows() || m_carriedH->GetNumCols() != S))
+            InvalidArgument("%ls %ls operation: A sequence continues from a previous minibatch that has not been seen.", NodeName().c_str(), OperationName().c_str());
+        m_stepMask->SetValue(1, S * T, m_deviceId, mask.data());
+    }
+
+    // backpropagate through the recurrence, computing the gradients of all gate pre-activations into m_gatesGradient
+    void BackpropThroughTime()
+    {
+        size_t S = GetNumParallelSequences();
+        size_t T = GetNumTimeSteps();
+        size_t cellDim = GetSampleMatrixNumRows();
+
+        MaskMissingGradientColumnsToZero(FrameRange(GetMBLayout()));
+        m_gatesGradient->Resize(numGates * cellDim, S * T);
+        m_dhNext->Resize(cellDim, S);
+        m_dhNext->SetValue(0);
+        m_dcNext->Resize(cellDim, S);
+        m_dcNext->SetValue(0);
+        m_dc->Resize(cellDim, S);
+        m_temp->Resize(cellDim, S);
+        auto dh     = StepTensor(m_dhNext, 0); // dh(t) is accumulated in place into the gradient coming from step t+1
+        auto dcNext = StepTensor(m_dcNext, 0);
+        auto dc     = StepTensor(m_dc, 0);
+        auto temp   = StepTensor(m_temp, 0);
+        auto peepholes = Input(4)->ValuePtr();
+
+        for (size_t i = 0; i < T; i++)
+        {
+            size_t t = m_direction < 0 ? T - 1 - i : i;
+
+            auto inputGates  = GatesTensor(m_gates, inputGate,  inputGate  + 1, t);
+            auto forgetGates = GatesTensor(m_gates, forgetGate, forgetGate + 1, t);
+            auto outputGates = GatesTensor(m_gates, outputGate, outputGate + 1, t);
+            auto cellInputs  = GatesTensor(m_gates, cellInput,  cellInput  + 1, t);
+            auto tanhC = StepTensor(m_tanhCells, t);
+            auto prevC = StepTensor(m_prevC, t);
+            auto mask  = StepTensor(m_stepMask, t);
+
+            dh.AddCopyOf(StepTensor(GradientPtr(), t));
+
+            // h(t) = o .* tanh(c(t))
+            auto outputGatesGradient = GatesTensor(m_gatesGradient, outputGate, outputGate + 1, t);
+            temp.AssignElementwiseProductOf(dh, tanhC);
+            outputGatesGradient.AssignElementwiseProductWithSigmoidDerivativeFromOutputOf(temp, outputGates);
+            temp.AssignElementwiseProductOf(dh, outputGates);
+            dc.AssignElementwiseProductWithTanhDerivativeFromOutputOf(temp, tanhC);
+            dc.AddCopyOf(dcNext);
+            dc.AddElementwiseProductOf(outputGatesGradient, PeepholesTensor(peepholes, outputGate, outputGate + 1));
+
+            // c(t) = f .* c(t-1) + i .* tanh(cell input)
+            temp.AssignElementwiseProductOf(dc, cellInputs);
+            GatesTensor(m_gatesGradient, inputGate, inputGate + 1, t).AssignElementwiseProductWithSigmoidDerivativeFromOutputOf(temp, inputGates);
+            temp.AssignElementwiseProductOf(dc, prevC);
+            GatesTensor(m_gatesGradient, forgetGate, forgetGate + 1, t).AssignElementwiseProductWithSigmoidDerivativeFromOutputOf(temp, forgetGates);
+            temp.AssignElementwiseProductOf(dc, inputGates);
+            GatesTensor(m_gatesGradient, cellInput, cellInput + 1, t).AssignElementwiseProductWithTanhDerivativeFromOutputOf(temp, cellInputs);
+
+            // gradients w.r.t. c(t-1) and h(t-1), which do not propagate across a sequence start
+            dcNext.AssignElementwiseProductOf(dc, forgetGates);
+            dcNext.AddElementwiseProductOf(GatesTensor(m_gatesGradient, inputGate, forgetGate + 1, t), PeepholesTensor(peepholes, inputGate, forgetGate + 1));
+            dcNext.AssignCopyIfOf(mask, dcNext);
+            Matrix<ElemType>::Multiply(Input(2)->Value(), true, m_gatesGradient->ColumnSlice(t * S, S), false, *m_dhNext);
+            dh.AssignCopyIfOf(mask, dh);
+        }
+    }
+
+private:
+    int m_direction;              // -1: h(t) depends on h(t-1), like PastValue; +1: on h(t+1), like FutureValue
+    ElemType m_initialStateValue; // h and c at sequence boundaries
+    // forward state, kept for backprop; columns are laid out like the minibatch
+    shared_ptr<Matrix<ElemType>> m_gates;     // [numGates * cellDim x T*S] gate activations
+    shared_ptr<Matrix<ElemType>> m_cells;     // c(t)
+    shared_ptr<Matrix<ElemType>> m_tanhCells; // tanh(c(t))
+    shared_ptr<Matrix<ElemType>> m_prevH;     // h(t-1), or the initial state
+    shared_ptr<Matrix<ElemType>> m_prevC;     // c(t-1), or the initial state
+    shared_ptr<Matrix<ElemType>> m_stepMask;  // [1 x T*S] 1 if h(t-1) and c(t-1) belong to the same sequence, else 0
+    shared_ptr<Matrix<ElemType>> m_initialState;
+    // last h and c of the previous minibatch, for truncated BPTT (past direction only)
+    shared_ptr<Matrix<ElemType>> m_carriedH;
+    shared_ptr<Matrix<ElemType>> m_carriedC;
+    bool m_carriesState;
+    // backprop
+    shared_ptr<Matrix<ElemType>> m_gatesGradient; // [numGates * cellDim x T*S] gradients of the gate pre-activations
+    shared_ptr<Matrix<ElemType>> m_dhNext, m_dcNext, m_dc, m_temp; // [cellDim x S] per-step temporaries
+    bool m_gatesGradientUpToDate;
+};
+
+template class FusedLSTMNode<float>;
+template class FusedLSTMNode<double>;
+
 #ifdef COMING_SOON
 
 // -----------------------------------------------------------------------
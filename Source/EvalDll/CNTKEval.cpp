@@ -15,6 +15,7 @@
 #include "Actions.h"
 #include "CNTKEval.h"
 #include "CPUMatrix.h" // for SetNumThreads()
+#include "ConvolutionEngine.h" // for ConvolutionEngineAutotuning
 #include "SimpleOutputWriter.h"
 #include "NDLNetworkBuilder.h"
 #ifdef LEAKDETECT
@@ -44,6 +45,7 @@ void CNTKEvalBase<ElemType>::Init(const std::string& config)
     size_t nThreads = m_config("numCPUThreads", "1");
     CPUMatrix<ElemType>::SetNumThreads(nThreads);
     g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
+    ConvolutionEngineAutotuning::Enable(m_config(L"autotuneConvolution", false), m_config(L"convolutionAutotuneCache", L""));
 }
 
 
@@ -62,6 +64,15 @@ void CNTKEvalBase<ElemType>::CreateNetwork(const std::string& networkDescription
     {
         LogicError("Unable to construct network from description");
     }
+
+    // optionally compute the weight products in integer arithmetic; the weights are quantized here, once
+    size_t quantizedTimesBits = m_config(L"quantizedTimesBits", (size_t) 0);
+    if (quantizedTimesBits > 0)
+        this->m_net->EnableQuantizedTimes(quantizedTimesBits, m_config(L"quantizedTimesTolerance", 0.01));
+
+    // optionally, small minibatches multiply with copies of the weights packed for this case; they are packed on first use
+    if (m_config(L"packedWeights", false))
+        this->m_net->EnablePackedWeights();
 }
 
 
@@ -260,9 +271,15 @@ template<typename ElemType>
 void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputNodeNames)
 {
     m_scopedNetworkOperationMode = make_shared<ScopedNetworkOperationMode>(this->m_net, NetworkOperationMode::inferring);
+    // optionally fuse LSTM cells and bias-activation pairs; this edits the network, so it must happen before we hold on to any of its nodes
+    if (this->m_config(L"fuseLSTMCells", false))
+        this->m_net->FuseLSTMCells(this->m_net->OutputNodesByName(outputNodeNames));
+    if (this->m_config(L"fuseBiasActivations", false))
+        this->m_net->FuseBiasActivations(this->m_net->OutputNodesByName(outputNodeNames));
     m_outputNodes  = this->m_net->OutputNodesByName(outputNodeNames);
     m_inputNodes = this->m_net->InputNodesForOutputs(outputNodeNames);
     // allocate memory for forward computation
+    this->m_net->SetParallelTraversalThreads(this->m_config(L"parallelTraversalThreads", (size_t) 0));
     this->m_net->AllocateAllMatrices({}, m_outputNodes, nullptr);
     this->m_net->StartEvaluateMinibatchLoop(m_outputNodes);
     m_inputMatrices = DataReaderHelpers::RetrieveInputMatrices(m_inputNodes);
@@ -14,7 +14,6 @@
 #include <iostream>
 #include <exception>
 #include <thread>
-#include <mutex>
 #include <memory>
 #include <vector>
 #include "BlockMultiplierMatrixUtil.h"
@@ -22,22 +21,13 @@
 #ifdef SUPPORT_AVX2
 #include "BlockHandlerAVX.h"
 #endif
-//#define STDTHREAD
-#define OPENMPTHREAD
-#ifdef STDTHREAD
-#include "StdThreadPool.h"
-#else 
-#ifdef OPENMPTHREAD
 #include <omp.h>
-#endif
-#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // All of the information needed for the various BlockHandler functions.
-// Packaged into a struct because in some cases we call these functions on a thread pool
-// and most thread pool class interfaces aren't happy with lots of arguments to the worker
-// thread function.
+// Packaged into a struct because each one describes a tile of C (a group of rows of A
+// times a panel of columns of B) that is handed to a worker thread.
 //
 // Throughout the code, I use the following nomenclature:
 // A is the LHS matrix for the multiplication, B is the RHS, and C is the result.
@@ -47,6 +37,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // k is the common dimension (the number of columns in A and rows in B).
 // n is the number of columns in B and C.
 // In other words, A is (m x k), B is (k x n) and C is (m x n).
+// Within HandlerArgs, n is the width of the current panel of B, B points to that panel,
+// transC points to the first column of the panel in C, and cCols is the number of columns of C.
 //
 template<typename BlockHandlerT>struct HandlerArgs
 {
@@ -58,9 +50,11 @@ template<typename BlockHandlerT>struct HandlerArgs
     typename BlockHandlerT::ScalarAT* newA;
     typename BlockHandlerT::ScalarBT* B;
     int32_t* transC;
-    int rowsPerThread;
+    int cCols;
     int rowsPerBlock;
     typename BlockHandlerT::VectorT* pBlockPreparedB;
+    // scratch space for the partial sums, owned by the caller (rowsPerBlock * n vectors)
+    typename BlockHandlerT::VectorT* resultStorage;
 };
 
 
@@ -80,6 +74,14 @@ template<typename BlockHandlerT>struct HandlerArgs
 // multiplying by that matrix). Then you can call MultiplyMatrices().
 // For details on how the block rewrite works, see the comments on RewriteBInBlockOrder and
 // RewriteAInBlockOrder.
+//
+// B is rewritten in panels of PANELCOLS columns, and each panel is stored as a matrix in
+// block order of its own. MultiplyMatrices splits C into tiles of (up to) four rows by one panel
+// and runs them in parallel, so that even a product with only a few rows (e.g. a single
+// minibatch at inference time) uses all threads.
+// MultiplyMatrices keeps all of its intermediate state on the stack or in per-call buffers,
+// so it may be called concurrently from several threads on the same object and the same prepared B.
+// PrepareB must not be called concurrently with MultiplyMatrices.
 template<typename BlockHandlerT> class BlockMultiplier
 {
     public:
@@ -99,14 +101,15 @@ template<typename BlockHandlerT> class BlockMultiplier
         int RowToColOffsetRewrittenB(int col, int kOffset, int blockSize, int origCols);
         int RowToColOffsetRewrittenA(int row, int kOffset, int blockSize, int rowsPerBlock, int origCols);
         void RewriteBInBlockOrder(ScalarBT* oldB, ScalarBT* newB, int k, int n);
-        ScalarBT* RewriteBInBlockOrder(ScalarBT* oldB, ScalarBT* newB, int k, int n, int blockSize, int* kOffset);
+        ScalarBT* RewriteBInBlockOrder(ScalarBT* oldB, ScalarBT* newB, int k, int n, int startCol, int panelCols, int blockSize, int* kOffset);
         void RewriteAInBlockOrder(ScalarAT* A, ScalarAT* newA, int m, int k, int blockSize, int rowsPerBlock);
         ScalarAT* RewriteAInBlockOrder(ScalarAT* A, ScalarAT* newA, int m, int k, int blockSize, int rowsPerBlock, int* pKOffset);
         ScalarAT* RewriteAInBlockOrder2(ScalarAT* A, ScalarAT* newA, int m, int k, int blockSize, int rowsPerBlock, int* pKOffset);
         int m_blockSize;
-        std::mutex m_MultiplyMut;
+        void MultiplyTile(ScalarAT* newA, int m, int k, ScalarBT* B, int n, int32_t* C,
+                int startRow, int rowsPerBlock, int startCol, VectorT* resultStorage);
 
-        // Function objects - thin wrappers around the thread functions (which know how to feed
+        // Function objects - thin wrappers around the tile functions (which know how to feed
         // blocks to the actualy dot product kernels implemented in BlockHandlerT).
 
         class BlockHandler128x4Fn 
@@ -160,10 +163,6 @@ template<typename BlockHandlerT> class BlockMultiplier
                 void operator()(HandlerArgs<BlockHandlerT> param) { BlockHandler8x1Thread(param); }
         };
 
-#ifdef STDTHREAD
-        std::unique_ptr<StdThreadPool<HandlerArgs<BlockHandlerT>>> m_pPool;
-#endif
-
         typename BlockHandlerT::VectorT* m_pBlockHandlerBInfo;
 
 
@@ -175,13 +174,12 @@ template<typename BlockHandlerT> class BlockMultiplier
         // We walk through all of the blocks for this set of rows in the common dimension, accumulating
         // the partial sums in resultStorage as we go. These temporary data are then copied into the target
         // matrix (C). Accumulating directly in C is a disaster because you end up with read-write hazards
-        // in multithreaded situations and end up with lots of pipeline stalls trying to reconcile the cache, so
-        // this ends up being faster even through we're allocating the memory each time. I think we can
-        // get rid of the allocation but I haven't had time to do this yet.
+        // in multithreaded situations and end up with lots of pipeline stalls trying to reconcile the cache.
+        // resultStorage is allocated once per tile by MultiplyMatrices and shared by all block sizes.
         static void BlockHandler128x4Thread(HandlerArgs<BlockHandlerT> ha)
         {
             //Accumulate full row results locally b/f writing to C
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 16);
+            VectorT* resultStorage = ha.resultStorage;
             memset(resultStorage, 0, sizeof(VectorT) * ha.rowsPerBlock * ha.n);
             const int blocksAtOnce = 2;
 
@@ -207,20 +205,19 @@ template<typename BlockHandlerT> class BlockMultiplier
                     int32_t secondHorizontal = my_hadd(result2);
                     int32_t thirdHorizontal  = my_hadd(result3);
                     int32_t fourthHorizontal = my_hadd(result4);
-                    transC[RowColToOffset(ha.startRow, c, n)]     = firstHorizontal;
-                    transC[RowColToOffset(ha.startRow + 1, c, n)] = secondHorizontal;
-                    transC[RowColToOffset(ha.startRow + 2, c, n)] = thirdHorizontal;
-                    transC[RowColToOffset(ha.startRow + 3, c, n)] = fourthHorizontal;
+                    transC[RowColToOffset(ha.startRow, c, ha.cCols)]     = firstHorizontal;
+                    transC[RowColToOffset(ha.startRow + 1, c, ha.cCols)] = secondHorizontal;
+                    transC[RowColToOffset(ha.startRow + 2, c, ha.cCols)] = thirdHorizontal;
+                    transC[RowColToOffset(ha.startRow + 3, c, ha.cCols)] = fourthHorizontal;
                 }
             }
 
-            ALIGNED_FREE(resultStorage);
 
         }
 
         static void BlockHandler64x4Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * 4 * ha.n, 16);
+            VectorT* resultStorage = ha.resultStorage;
             memset(resultStorage, 0, sizeof(VectorT) * 4 * ha.n);
             int32_t* transC = ha.transC;
 
@@ -242,18 +239,17 @@ template<typename BlockHandlerT> class BlockMultiplier
                     int32_t secondHorizontal = my_hadd(result2);
                     int32_t thirdHorizontal  = my_hadd(result3);
                     int32_t fourthHorizontal = my_hadd(result4);
-                    transC[RowColToOffset(ha.startRow, c, n)]     += firstHorizontal;
-                    transC[RowColToOffset(ha.startRow + 1, c, n)] += secondHorizontal;
-                    transC[RowColToOffset(ha.startRow + 2, c, n)] += thirdHorizontal;
-                    transC[RowColToOffset(ha.startRow + 3, c, n)] += fourthHorizontal;
+                    transC[RowColToOffset(ha.startRow, c, ha.cCols)]     += firstHorizontal;
+                    transC[RowColToOffset(ha.startRow + 1, c, ha.cCols)] += secondHorizontal;
+                    transC[RowColToOffset(ha.startRow + 2, c, ha.cCols)] += thirdHorizontal;
+                    transC[RowColToOffset(ha.startRow + 3, c, ha.cCols)] += fourthHorizontal;
                 }
             }
-            ALIGNED_FREE(resultStorage);
         }
 
         static void BlockHandler32x4Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * 4 * ha.n, 16);
+            VectorT* resultStorage = ha.resultStorage;
             memset(resultStorage, 0, sizeof(VectorT) * 4 * ha.n);
             int32_t* transC = ha.transC;
 
@@ -275,18 +271,17 @@ template<typename BlockHandlerT> class BlockMultiplier
                     int32_t secondHorizontal = my_hadd(result2);
                     int32_t thirdHorizontal  = my_hadd(result3);
                     int32_t fourthHorizontal = my_hadd(result4);
-                    transC[RowColToOffset(ha.startRow, c, n)]     += firstHorizontal;
-                    transC[RowColToOffset(ha.startRow + 1, c, n)] += secondHorizontal;
-                    transC[RowColToOffset(ha.startRow + 2, c, n)] += thirdHorizontal;
-                    transC[RowColToOffset(ha.startRow + 3, c, n)] += fourthHorizontal;
+                    transC[RowColToOffset(ha.startRow, c, ha.cCols)]     += firstHorizontal;
+                    transC[RowColToOffset(ha.startRow + 1, c, ha.cCols)] += secondHorizontal;
+                    transC[RowColToOffset(ha.startRow + 2, c, ha.cCols)] += thirdHorizontal;
+                    transC[RowColToOffset(ha.startRow + 3, c, ha.cCols)] += fourthHorizontal;
                 }
             }
-            ALIGNED_FREE(resultStorage);
         }
 
         static void BlockHandler16x4Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*) ALIGNED_ALLOC(sizeof(VectorT) * 4 * ha.n, 16);
+            VectorT* resultStorage = ha.resultStorage;
             memset(resultStorage, 0, sizeof(VectorT) * 4 * ha.n);
             int32_t* transC = ha.transC;
             for (int currBlock = 0; currBlock < ha.blocks; ++currBlock)
@@ -308,18 +303,17 @@ template<typename BlockHandlerT> class BlockMultiplier
                     int32_t secondHorizontal = my_hadd(result2);
                     int32_t thirdHorizontal  = my_hadd(result3);
                     int32_t fourthHorizontal = my_hadd(result4);
-                    transC[RowColToOffset(ha.startRow, c, n)]     += firstHorizontal;
-                    transC[RowColToOffset(ha.startRow + 1, c, n)] += secondHorizontal;
-                    transC[RowColToOffset(ha.startRow + 2, c, n)] += thirdHorizontal;
-                    transC[RowColToOffset(ha.startRow + 3, c, n)] += fourthHorizontal;
+                    transC[RowColToOffset(ha.startRow, c, ha.cCols)]     += firstHorizontal;
+                    transC[RowColToOffset(ha.startRow + 1, c, ha.cCols)] += secondHorizontal;
+                    transC[RowColToOffset(ha.startRow + 2, c, ha.cCols)] += thirdHorizontal;
+                    transC[RowColToOffset(ha.startRow + 3, c, ha.cCols)] += fourthHorizontal;
                 }
             }
-            ALIGNED_FREE(resultStorage);
         }
 
         static void BlockHandler8x4Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            __m128i* resultStorage = (__m128i*)ALIGNED_ALLOC(sizeof(__m128i) * 4 * ha.n, 16);
+            __m128i* resultStorage = (__m128i*)ha.resultStorage;
             memset(resultStorage, 0, sizeof(__m128i) * 4 * ha.n);
             int32_t* transC = ha.transC;
             //_mm_prefetch((char*)&(transC[RowColToOffset(c, ha.startRow, m)]), _MM_HINT_T1);
@@ -342,20 +336,19 @@ template<typename BlockHandlerT> class BlockMultiplier
                     int32_t secondHorizontal = my_hadd(result2);
                     int32_t thirdHorizontal  = my_hadd(result3);
                     int32_t fourthHorizontal = my_hadd(result4);
-                    transC[RowColToOffset(ha.startRow, c, n)]     += firstHorizontal;
-                    transC[RowColToOffset(ha.startRow + 1, c, n)] += secondHorizontal;
-                    transC[RowColToOffset(ha.startRow + 2, c, n)] += thirdHorizontal;
-                    transC[RowColToOffset(ha.startRow + 3, c, n)] += fourthHorizontal;
+                    transC[RowColToOffset(ha.startRow, c, ha.cCols)]     += firstHorizontal;
+                    transC[RowColToOffset(ha.startRow + 1, c, ha.cCols)] += secondHorizontal;
+                    transC[RowColToOffset(ha.startRow + 2, c, ha.cCols)] += thirdHorizontal;
+                    transC[RowColToOffset(ha.startRow + 3, c, ha.cCols)] += fourthHorizontal;
                 }
             }
-            ALIGNED_FREE(resultStorage);
         }
 
 
 
         static void BlockHandler128x1Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 64);
+            VectorT* resultStorage = ha.resultStorage;
             memset(resultStorage, 0, sizeof(VectorT) * ha.rowsPerBlock * ha.n);
             const int blocksAtOnce = 2;
             int32_t* transC = ha.transC;
@@ -371,15 +364,14 @@ template<typename BlockHandlerT> class BlockMultiplier
                 {
                     VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
                     int32_t firstHorizontal = my_hadd(result1);
-                    transC[RowColToOffset(ha.startRow, c, n)] = firstHorizontal;
+                    transC[RowColToOffset(ha.startRow, c, ha.cCols)] = firstHorizontal;
                 }
             }
-            ALIGNED_FREE(resultStorage);
         }
 
         static void BlockHandler64x1Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 16);
+            VectorT* resultStorage = ha.resultStorage;
             memset(resultStorage, 0, sizeof(VectorT) * ha.rowsPerBlock * ha.n);
             int32_t* transC = ha.transC;
 
@@ -395,15 +387,14 @@ template<typename BlockHandlerT> class BlockMultiplier
                 {
                     VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
                     int32_t firstHorizontal = my_hadd(result1);
-                    transC[RowColToOffset(ha.startRow, c, n)] += firstHorizontal;
+                    transC[RowColToOffset(ha.startRow, c, ha.cCols)] += firstHorizontal;
                 }
             }
-            ALIGNED_FREE(resultStorage);
         }
 
         static void BlockHandler32x1Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 16);
+            VectorT* resultStorage = ha.resultStorage;
             memset(resultStorage, 0, sizeof(VectorT) * ha.rowsPerBlock * ha.n);
             int32_t* transC = ha.transC;
 
@@ -419,15 +410,14 @@ template<typename BlockHandlerT> class BlockMultiplier
                 {
                     VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
                     int32_t firstHorizontal = my_hadd(result1);
-                    transC[RowColToOffset(ha.startRow, c, n)] += firstHorizontal;
+                    transC[RowColToOffset(ha.startRow, c, ha.cCols)] += firstHorizontal;
                 }
             }
-            ALIGNED_FREE(resultStorage);
         }
 
         static void BlockHandler16x1Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 16);
+            VectorT* resultStorage = ha.resultStorage;
             memset(resultStorage, 0, sizeof(VectorT) * ha.rowsPerBlock  * ha.n);
             int32_t* transC = ha.transC;
 
@@ -443,15 +433,14 @@ template<typename BlockHandlerT> class BlockMultiplier
                 {
                     VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
                     int32_t firstHorizontal = my_hadd(result1);
-                    transC[RowColToOffset(ha.startRow, c, n)] += firstHorizontal;
+                    transC[RowColToOffset(ha.startRow, c, ha.cCols)] += firstHorizontal;
                 }
             }
-            ALIGNED_FREE(resultStorage);
         }
 
         static void BlockHandler8x1Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            __m128i* resultStorage = (__m128i*)ALIGNED_ALLOC(sizeof(__m128i) * ha.rowsPerBlock * ha.n, 64);
+            __m128i* resultStorage = (__m128i*)ha.resultStorage;
             memset(resultStorage, 0, sizeof(__m128i) * ha.rowsPerBlock * ha.n);
             int32_t* transC = ha.transC;
 
@@ -467,10 +456,9 @@ template<typename BlockHandlerT> class BlockMultiplier
                 {
                     __m128i result1 = resultStorage[RowColToOffset(0, c, n)];
                     int32_t firstHorizontal = my_hadd(result1);
-                    transC[RowColToOffset(ha.startRow, c, n)] += firstHorizontal;
+                    transC[RowColToOffset(ha.startRow, c, ha.cCols)] += firstHorizontal;
                 }
             }
-            ALIGNED_FREE(resultStorage);
         }
 
     public:
@@ -548,21 +536,17 @@ template<typename BlockHandlerT> class BlockMultiplier
 
         int m_numThreads;
 
-        BlockMultiplier(int numThreads = 1) 
+        BlockMultiplier(int numThreads = 1)
+            : m_blockSize(0), m_pBlockHandlerBInfo(nullptr)
         {
             SetNumThreads(numThreads);
         }
 
+        // Number of threads used by each call to MultiplyMatrices. This only affects this object;
+        // the global OpenMP setting is left alone.
         void SetNumThreads(int threads)
         {
-            m_numThreads = threads;
-#ifdef STDTHREAD
-            m_pPool.reset(new StdThreadPool<HandlerArgs<BlockHandlerT>>(threads));
-#else
-#ifdef OPENMPTHREAD
-            omp_set_num_threads(threads);
-#endif
-#endif
+            m_numThreads = std::max(threads, 1);
         }
 
         ~BlockMultiplier()
@@ -574,10 +558,12 @@ template<typename BlockHandlerT> class BlockMultiplier
         static int32_t* CreateMatrixC(int m, int n, int32_t initVal = 0);
         ScalarBT* PrepareB(ScalarBT* oldB, int k, int n);
         template<typename ScalarT> static void FreeMatrix(ScalarT* freeMe) { FreeAlignedMatrix<ScalarT>(freeMe); }
-        //We assume B has been rewritten in block order.
-        //For now we assume m, k and n are all multiples of kernelsize.
+        //We assume B has been rewritten in block order by PrepareB. Safe to call from several threads at once.
         void MultiplyMatrices(ScalarAT* A, int m, int k, ScalarBT* B, int n, int32_t* C, ScalarAT alpha = 1, ScalarBT beta = 0);
         static const int MAXRANGE = 1 << 13;
+        // Width of the column panels B is rewritten in. This is the unit of work (together with
+        // a group of rows of A) for the threads in MultiplyMatrices.
+        static const int PANELCOLS = 128;
 };
 
 // Instantiate block multipliers
@@ -617,33 +603,40 @@ template<typename BlockHandlerT> FORCEINLINE int BlockMultiplier<BlockHandlerT>:
 }
 
 //Rewrites B in Block order so that memory accesses to B will be sequential.
+//B is split into panels of PANELCOLS columns (the last one may be narrower), and each panel
+//is rewritten as if it were a matrix of its own. The panel starting at column c begins at newB + k * c.
 //See comments on RewriteBInBlockOrder for details.
 template<typename BlockHandlerT> typename BlockMultiplier<BlockHandlerT>::ScalarBT* BlockMultiplier<BlockHandlerT>::PrepareB(ScalarBT* oldB, int k, int n)
 {
     ScalarBT* newB = CreateMatrixB(k, n);
-    int offset = 0;
+    ScalarBT* next = newB;
 
-    ScalarBT* next = RewriteBInBlockOrder(oldB, newB, k, n, 128, &offset);
-    if (offset < k)
-    {
-        next = RewriteBInBlockOrder(oldB, next, k, n, 64, &offset);
-    }
-    if (offset < k)
-    {
-        next = RewriteBInBlockOrder(oldB, next, k, n, 32, &offset);
-    }
-    if (offset < k)
-    {
-        next = RewriteBInBlockOrder(oldB, next, k, n, 16, &offset);
-    }
-    if (offset < k)
-    {
-        next = RewriteBInBlockOrder(oldB, next, k, n, 8, &offset);
-    }
-    if (offset < k)
+    for (int startCol = 0; startCol < n; startCol += PANELCOLS)
     {
-        int blockSize = k - offset;
-        next = RewriteBInBlockOrder(oldB, next, k, n, blockSize, &offset);
+        int panelCols = std::min(n - startCol, (int) PANELCOLS);
+        int offset = 0;
+        next = RewriteBInBlockOrder(oldB, next, k, n, startCol, panelCols, 128, &offset);
+        if (offset < k)
+        {
+            next = RewriteBInBlockOrder(oldB, next, k, n, startCol, panelCols, 64, &offset);
+        }
+        if (offset < k)
+        {
+            next = RewriteBInBlockOrder(oldB, next, k, n, startCol, panelCols, 32, &offset);
+        }
+        if (offset < k)
+        {
+            next = RewriteBInBlockOrder(oldB, next, k, n, startCol, panelCols, 16, &offset);
+        }
+        if (offset < k)
+        {
+            next = RewriteBInBlockOrder(oldB, next, k, n, startCol, panelCols, 8, &offset);
+        }
+        if (offset < k)
+        {
+            int blockSize = k - offset;
+            next = RewriteBInBlockOrder(oldB, next, k, n, startCol, panelCols, blockSize, &offset);
+        }
     }
     assert(next - newB == k * n);
     m_pBlockHandlerBInfo = BlockHandlerT::PrepareExtraB(newB, k, n);
@@ -677,13 +670,14 @@ template<typename BlockHandlerT> typename BlockMultiplier<BlockHandlerT>::Scalar
 //So each "row" of the new matrix (block size * num_original_cols) contains all of the values that
 //will be multiplied with block zero of a given row.
 //Column offsets within the row can be computed by (block_size * col_offset).
+//Only the panelCols columns starting at startCol are rewritten; n is the number of columns of oldB.
 
 //Given the original B matrix, we restructure it so that we will access all of its elements in block order.
 //That way we can load in blocksize elements from A, then read in the corresponding elements from each
 //column of B in sequential order.
 //Old, replaced with fn below, keeping around for now for reference.
 template<typename BlockHandlerT> typename BlockMultiplier<BlockHandlerT>::ScalarBT* BlockMultiplier<BlockHandlerT>::RewriteBInBlockOrder(ScalarBT* oldB, ScalarBT* newB, int k, 
-        int n, int blockSize, int* kOffset)
+        int n, int startCol, int panelCols, int blockSize, int* kOffset)
 {
     ScalarBT* curr = newB;
     int numBlocks = (k - *kOffset) / blockSize;
@@ -691,7 +685,7 @@ template<typename BlockHandlerT> typename BlockMultiplier<BlockHandlerT>::Scalar
     {
         //row offset to beginning of block
         int blockOffset = *kOffset + (b * blockSize);
-        for (int c = 0; c < n; ++c)
+        for (int c = startCol; c < startCol + panelCols; ++c)
         {
             for (int rowOffset = 0; rowOffset < blockSize; ++rowOffset)
             {
@@ -820,181 +814,146 @@ template<typename BlockHandlerT>struct BlockInfo
     std::function<void (HandlerArgs<BlockHandlerT>)> oneFn;
 };
 
-//We assume B has been rewritten in block order.
-//For now we assume m, k and n are all multiples of kernelsize.
-template<typename BlockHandlerT> void BlockMultiplier<BlockHandlerT>::MultiplyMatrices(ScalarAT* A, int m, int k, ScalarBT* B, int n,
-        int32_t* C, ScalarAT alpha, ScalarBT beta)
+//Multiplies the rows startRow .. startRow + rowsPerBlock - 1 of A by the panel of B that starts at
+//column startCol, and writes the result to the corresponding tile of C.
+//newA is A rewritten in block order, B has been prepared by PrepareB.
+//Tiles do not overlap, so they can be computed in parallel.
+template<typename BlockHandlerT> void BlockMultiplier<BlockHandlerT>::MultiplyTile(ScalarAT* newA, int m, int k, ScalarBT* B, int n,
+        int32_t* C, int startRow, int rowsPerBlock, int startCol, VectorT* resultStorage)
 {
-
-    // The lock here is required whenever you are calling MultiplyMatrices on the same BlockMultiplier object
-    // (For instance you are simultaneously multiplying two different inputs by the same first layer weight matrix).
-    // It is an artifact of the thread pool I am using when STDTHREAD is defined and may not be necessary
-    // in the openmp case, but I have not tested this scenario so I'm leaving it in for now.
-    std::lock_guard<std::mutex> lock(m_MultiplyMut);
+    int panelCols = std::min(n - startCol, (int) PANELCOLS);
+    ScalarBT* panelB = B + k * startCol;
+
+    int blocks128 = k / 128;
+    int k128 = blocks128 * 128;
+    int blocks64 = (k - k128) / 64;
+    int k64 = blocks64 * 64;
+    int blocks32 = (k - k128 - k64) / 32;
+    int k32 = blocks32 * 32;
+    int blocks16 = (k - k128 - k64 - k32) / 16;
+    int k16 = blocks16 * 16;
+    int blocks8 = (k - k128 - k64 - k32 - k16) / 8;
+    int k8 = blocks8 * 8;
+    int blocks1 = (k - k128 - k64 - k32 - k16 - k8);
+
+    int offsetA64 = m * k128;
+    int offsetB64 = panelCols * k128;
+    int offsetA32 = offsetA64 + (m * k64);
+    int offsetB32 = offsetB64 + (panelCols * k64);
+    int offsetA16 = offsetA32 + (m * k32);
+    int offsetB16 = offsetB32 + (panelCols * k32);
+    int offsetA8 = offsetA16 + (m * k16);
+    int offsetB8 = offsetB16 + (panelCols * k16);
+
+    int offsetA1 = offsetA8 + (m * k8);
+    int offsetB1 = offsetB8 + (panelCols * k8);
+
+    BlockHandler128x4Fn fn128x4;
+    BlockHandler64x4Fn fn64x4;
+    BlockHandler32x4Fn fn32x4;
+    BlockHandler16x4Fn fn16x4;
+    BlockHandler8x4Fn fn8x4;
+    BlockHandler128x1Fn fn128x1;
+    BlockHandler64x1Fn fn64x1;
+    BlockHandler32x1Fn fn32x1;
+    BlockHandler16x1Fn fn16x1;
+    BlockHandler8x1Fn fn8x1;
+
+    //The 128 blocks come first, since they overwrite C, and the others add to it.
+    BlockInfo<BlockHandlerT> blockInfos[] = {
+        BlockInfo<BlockHandlerT>(blocks128, k128, 0, 0, fn128x4, fn128x1),
+        BlockInfo<BlockHandlerT>(blocks64, k64, offsetA64, offsetB64, fn64x4, fn64x1),
+        BlockInfo<BlockHandlerT>(blocks32, k32, offsetA32, offsetB32, fn32x4, fn32x1),
+        BlockInfo<BlockHandlerT>(blocks16, k16, offsetA16, offsetB16, fn16x4, fn16x1),
+        BlockInfo<BlockHandlerT>(blocks8, k8, offsetA8, offsetB8, fn8x4, fn8x1)
+    };
+
+    for (const BlockInfo<BlockHandlerT>& currBlockInfo : blockInfos)
     {
-        int rowsPerBlock = m / m_numThreads;
-        if (rowsPerBlock < 4)
-            rowsPerBlock = 1;
-        if (rowsPerBlock > 4)
-            rowsPerBlock = 4;
-
-        if (m % rowsPerBlock != 0)
-        {
-            throw new std::runtime_error("Error: m must be < 4 or a multiple of 4.");
+        if (currBlockInfo.blockCnt > 0)
+        {
+            HandlerArgs<BlockHandlerT> ha;
+            ha.startRow = startRow;
+            ha.blocks = currBlockInfo.blockCnt;
+            ha.m = m;
+            ha.k = currBlockInfo.k;
+            ha.n = panelCols;
+            ha.newA = newA + currBlockInfo.offsetA;
+            ha.B = panelB + currBlockInfo.offsetB;
+            ha.transC = C + startCol;
+            ha.cCols = n;
+            ha.rowsPerBlock = rowsPerBlock;
+            ha.pBlockPreparedB = m_pBlockHandlerBInfo;
+            ha.resultStorage = resultStorage;
+
+            if (rowsPerBlock == 4)
+            {
+                currBlockInfo.fourFn(ha);
+            }
+            else
+            {
+                currBlockInfo.oneFn(ha);
+            }
         }
+    }
 
-        if (alpha != 1 || beta != 0)
+    if (blocks1 > 0)
+    {
+        for (int row = startRow; row < startRow + rowsPerBlock; ++row)
         {
-            throw std::logic_error("alpha / beta not yet implemented for this class");
-        }
-
-        ScalarAT* newA = CreateMatrixA(m, k);
-
-        RewriteAInBlockOrder(A, newA, m, k, m_blockSize, rowsPerBlock);
-
-        int blocks128 = k / 128;
-        int k128 = blocks128 * 128;
-        int blocks64 = (k - k128) / 64;
-        int k64 = blocks64 * 64;
-        int blocks32 = (k - k128 - k64) / 32;
-        int k32 = blocks32 * 32;
-        int blocks16 = (k - k128 - k64 - k32) / 16;
-        int k16 = blocks16 * 16;
-        int blocks8 = (k - k128 - k64 - k32 - k16) / 8;
-        int k8 = blocks8 * 8;
-        int blocks1 = (k - k128 - k64 - k32 - k16 - k8);
-
-        int offsetA64 = m * blocks128 * 128;
-        int offsetB64 = n * blocks128 * 128;
-        int offsetA32 = offsetA64 + (m * k64);
-        int offsetB32 = offsetB64 + (n * k64);
-        int offsetA16 = offsetA32 + (m * k32);
-        int offsetB16 = offsetB32 + (n * k32);
-        int offsetA8 = offsetA16 + (m * k16);
-        int offsetB8 = offsetB16 + (n * k16);
-
-        int offsetA1 = offsetA8 + (m * k8);
-        int offsetB1 = offsetB8 + (n * k8);
-
-
-        BlockHandler128x4Fn fn128x4;
-        BlockHandler64x4Fn fn64x4;
-        BlockHandler32x4Fn fn32x4;
-        BlockHandler16x4Fn fn16x4;
-        BlockHandler8x4Fn fn8x4;
-        BlockHandler128x1Fn fn128x1;
-        BlockHandler64x1Fn fn64x1;
-        BlockHandler32x1Fn fn32x1;
-        BlockHandler16x1Fn fn16x1;
-        BlockHandler8x1Fn fn8x1;
-
-        std::vector<BlockInfo<BlockHandlerT>*> blockInfos(5);
-
-
-        //std::function<void __cdecl(HandlerArgs<BlockHandlerT>)> fourFn = BlockHandler128x4Thread;
-        //std::function<void __cdecl(HandlerArgs<BlockHandlerT>)> oneFn = BlockHandler128x1Thread;
-
-        BlockInfo<BlockHandlerT> bi128(blocks128, k128, 0, 0, fn128x4, fn128x1);
-        BlockInfo<BlockHandlerT> bi64(blocks64, k64, offsetA64, offsetB64, fn64x4, fn64x1);
-        BlockInfo<BlockHandlerT> bi32(blocks32, k32, offsetA32, offsetB32, fn32x4, fn32x1);
-        BlockInfo<BlockHandlerT> bi16(blocks16, k16, offsetA16, offsetB16, fn16x4, fn16x1);
-        BlockInfo<BlockHandlerT> bi8(blocks8, k8, offsetA8, offsetB8, fn8x4, fn8x1);
-
-        blockInfos[0] = &bi128;
-        blockInfos[1] = &bi64;
-        blockInfos[2] = &bi32;
-        blockInfos[3] = &bi16;
-        blockInfos[4] = &bi8;
-        for (int i = 0; i < blockInfos.size(); ++i)
-        {
-            BlockInfo<BlockHandlerT>& currBlockInfo = *(blockInfos[i]);
-            if ( currBlockInfo.blockCnt > 0)
+            ScalarAT* pA = newA + offsetA1 + (row * blocks1);
+            ScalarBT* pB = panelB + offsetB1;
+            for (int c = 0; c < panelCols; ++c)
             {
-                HandlerArgs<BlockHandlerT> ha;
-
-
-                ha.blocks = currBlockInfo.blockCnt;
-                ha.m = m;
-                ha.k = currBlockInfo.k;
-                ha.n = n;
-                ha.newA = newA + currBlockInfo.offsetA;
-                ha.B = B + currBlockInfo.offsetB;
-                ha.transC = C;
-
-                ha.rowsPerThread = m / m_numThreads;
-                ha.rowsPerBlock = rowsPerBlock;
-                ha.pBlockPreparedB = m_pBlockHandlerBInfo;
-
-                if (rowsPerBlock == 4)
-                {
-
-#ifdef OPENMPTHREAD
-#pragma omp parallel for
-#endif
-                    for (int startRow = 0; startRow < m; startRow += 4)
-                    {
-                        ha.startRow = startRow;
-#ifdef STDTHREAD
-                        m_pPool->QueueAndWake(ha, currBlockInfo.fourFn);
-#else
-#ifdef OPENMPTHREAD
-                        currBlockInfo.fourFn(ha);
-#endif
-#endif
-                    }
-
-#ifdef STDTHREAD 
-                    m_pPool->Drain();
-#endif
-                }
+                C[RowColToOffset(row, startCol + c, n)] += referenceKernel(pA, pB, blocks1);
+                pB += blocks1;
+            }
+        }
+    }
+}
 
-                else if (rowsPerBlock == 1)
-                {
-#ifdef OPENMPTHREAD
-#pragma omp parallel for
-#endif
-                    for (int startRow = 0; startRow < m; ++startRow)
-                    {
-                        ha.startRow = startRow;
-#ifdef STDTHREAD
-                        m_pPool->QueueAndWake(ha, currBlockInfo.oneFn);
-#else
-#ifdef OPENMPTHREAD
-                        currBlockInfo.oneFn(ha);
-#endif
-#endif
-                    }
-#ifdef STDTHREAD
-                    m_pPool->Drain();
-#endif
-                }
-                else
-                {
-                    throw std::runtime_error("Illegal setting for rowsPerBlock");
-                }
+//We assume B has been rewritten in block order by PrepareB.
+//C must be zero-initialized (CreateMatrixC does this) unless k is at least 128.
+//m, k and n may be arbitrary, but if m is not a multiple of 4 the slower single-row kernels are used.
+//This function may be called concurrently on the same object: the rewritten A and the partial sums are
+//allocated per call, and the tiles of C are split among m_numThreads threads.
+template<typename BlockHandlerT> void BlockMultiplier<BlockHandlerT>::MultiplyMatrices(ScalarAT* A, int m, int k, ScalarBT* B, int n,
+        int32_t* C, ScalarAT alpha, ScalarBT beta)
+{
+    if (alpha != 1 || beta != 0)
+    {
+        throw std::logic_error("alpha / beta not yet implemented for this class");
+    }
 
-            }
+    int rowsPerBlock = (m % 4 == 0) ? 4 : 1;
+    int rowGroups = m / rowsPerBlock;
+    int panels = (n + PANELCOLS - 1) / PANELCOLS;
+    int tiles = rowGroups * panels;
+    if (tiles == 0)
+    {
+        return;
+    }
 
-        }
+    ScalarAT* newA = CreateMatrixA(m, k);
+    RewriteAInBlockOrder(A, newA, m, k, m_blockSize, rowsPerBlock);
 
-        if (blocks1 > 0)
+    //Consecutive tiles share a panel of B, so that threads running at the same time
+    //find it in the cache.
+    int numThreads = std::min(m_numThreads, tiles);
+#pragma omp parallel num_threads(numThreads) if (numThreads > 1)
+    {
+        VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * rowsPerBlock * PANELCOLS, 64);
+#pragma omp for schedule(dynamic)
+        for (int tile = 0; tile < tiles; ++tile)
         {
-            ScalarAT* pA = newA + offsetA1;
-            for (int startRow = 0; startRow < m; startRow++)
-            {
-                ScalarBT* pB = B + offsetB1;
-                for (int c = 0; c < n; ++c)
-                {
-                    C[RowColToOffset(startRow, c, n)] += referenceKernel(pA, pB, blocks1);
-                    pB += blocks1;
-                }
-                pA += blocks1;
-
-            }
+            int startRow = (tile % rowGroups) * rowsPerBlock;
+            int startCol = (tile / rowGroups) * PANELCOLS;
+            MultiplyTile(newA, m, k, B, n, C, startRow, rowsPerBlock, startCol, resultStorage);
         }
-
-        FreeAlignedMatrix(newA);
+        ALIGNED_FREE(resultStorage);
     }
+
+    FreeAlignedMatrix(newA);
 }
 
 
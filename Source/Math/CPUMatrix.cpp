@@ -10,7 +10,9 @@
 #include "File.h"
 
 #include "CPUMatrix.h"
+#include "CPUPackedMatrix.h"
 #include "TensorOps.h"
+#include "CPUTensorKernels.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -4564,6 +4566,71 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
     }
 }
 
+/// <summary>Matrix-matrix multiply with a prepacked left operand: c = alpha * a * b + beta * c</summary>
+/// <param name="alpha">Scalar</param>
+/// <param name="a">Input matrix, packed by CPUPackedMatrix</param>
+/// <param name="b">Input matrix; this is meant for few columns (up to CPUPackedMatrix::MaxColumns), but any number works</param>
+/// <param name="beta">Scalar</param>
+/// <param name="c">Resulting matrix, user is responsible for allocating this</param>
+template <class ElemType>
+void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUPackedMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType beta, CPUMatrix<ElemType>& c)
+{
+    if (b.IsEmpty())
+        return;
+    if (b.GetNumRows() != a.GetNumCols())
+        InvalidArgument("CPUMatrix<ElemType>::MultiplyAndWeightedAdd : The inner dimensions of a and b must match.");
+
+    const size_t m = a.GetNumRows();
+    const size_t k = a.GetNumCols();
+    const size_t n = b.GetNumCols();
+    if (beta == 0)
+        c.RequireSize(m, n);
+    else
+        c.VerifySize(m, n); // Can't resize if beta != 0
+
+    const size_t panelRows = CPUPackedMatrix<ElemType>::PanelRows;
+    const size_t columnsAtOnce = CPUPackedMatrix<ElemType>::ColumnsAtOnce;
+    const ElemType* bData = b.Data();
+    ElemType* cData = c.Data();
+    const size_t ldb = b.GetNumRows();
+    const size_t ldc = c.GetNumRows();
+
+    // each thread takes whole panels of a, and streams through them once for every group of columns of b
+#pragma omp parallel for
+    for (long long pp = 0; pp < (long long) a.GetNumPanels(); pp++)
+    {
+        const size_t p = (size_t) pp;
+        const ElemType* panel = a.Panel(p);
+        const size_t firstRow = p * panelRows;
+        const size_t numRows = min(panelRows, m - firstRow);
+        for (size_t j0 = 0; j0 < n; j0 += columnsAtOnce)
+        {
+            const size_t numCols = min(columnsAtOnce, n - j0);
+            ElemType sums[CPUPackedMatrix<ElemType>::ColumnsAtOnce][CPUPackedMatrix<ElemType>::PanelRows] = {};
+            for (size_t kk = 0; kk < k; kk++)
+            {
+                const ElemType* aCol = panel + kk * panelRows;
+                for (size_t jj = 0; jj < numCols; jj++)
+                {
+                    const ElemType bVal = bData[(j0 + jj) * ldb + kk];
+                    for (size_t i = 0; i < panelRows; i++) // (constant trip count, so that this gets vectorized)
+                        sums[jj][i] += aCol[i] * bVal;
+                }
+            }
+            for (size_t jj = 0; jj < numCols; jj++)
+            {
+                ElemType* cCol = cData + (j0 + jj) * ldc + firstRow;
+                if (beta == 0) // don't even read the memory if beta is 0
+                    for (size_t i = 0; i < numRows; i++)
+                        cCol[i] = alpha * sums[jj][i];
+                else
+                    for (size_t i = 0; i < numRows; i++)
+                        cCol[i] = alpha * sums[jj][i] + beta * cCol[i];
+            }
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b,
                                                     ElemType beta, CPUMatrix<ElemType>& c)
@@ -6040,23 +6107,67 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
 // function to compute the value for a given output location (perform reduction if needed)
 // -----------------------------------------------------------------------
 
+// reduction ops: the initial value of the aggregate, and how to fold in the next value
+// Aggregation happens in double. The switch is on a loop-invariant value, so branch prediction makes it cheap.
+static inline double ReductionNeutralValue(ElementWiseOperator reductionOp)
+{
+    switch (reductionOp)
+    {
+    case ElementWiseOperator::opSum:                return 0;
+    case ElementWiseOperator::opLogSum:             return LZERO; // not -inf, since LogAdd(-inf, -inf) would yield NaN
+    case ElementWiseOperator::opMax:                return -std::numeric_limits<double>::infinity();
+    case ElementWiseOperator::opMin:                return std::numeric_limits<double>::infinity();
+    case ElementWiseOperator::opElementwiseProduct: return 1;
+    default: LogicError("TensorOp: Unsupported reduction op code %d.", (int) reductionOp);
+    }
+}
+
+static inline double ReductionCombine(ElementWiseOperator reductionOp, double aggregate, double value)
+{
+    switch (reductionOp)
+    {
+    case ElementWiseOperator::opSum:                return aggregate + value;
+    case ElementWiseOperator::opLogSum:             return OpLogSum(aggregate, value);
+    case ElementWiseOperator::opMax:                return OpMax(aggregate, value);
+    case ElementWiseOperator::opMin:                return OpMin(aggregate, value);
+    case ElementWiseOperator::opElementwiseProduct: return aggregate * value;
+    default: LogicError("TensorOp: Unsupported reduction op code %d.", (int) reductionOp);
+    }
+}
+
+// validate the reduction op at the entry points, before any work is done
+static void CheckTensorOpReductionOp(ElementWiseOperator reductionOp)
+{
+    switch (reductionOp)
+    {
+    case ElementWiseOperator::opSum:
+    case ElementWiseOperator::opLogSum:
+    case ElementWiseOperator::opMax:
+    case ElementWiseOperator::opMin:
+    case ElementWiseOperator::opElementwiseProduct:
+        return;
+    default:
+        InvalidArgument("TensorOp: Reduction op code %d is not supported. Supported are opSum, opLogSum, opMax, opMin, and opElementwiseProduct.", (int) reductionOp);
+    }
+}
+
 // perform loop over reduction index m
 // This function is declared inside a wrapper struct to allow partial specialization (m = -1).
 template <class ElemType, typename OPFN, size_t N, int m>
 struct TensorOpReduction
 {
     // reduction case (non-reduction case is specialized)
-    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn,
+    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn, ElementWiseOperator reductionOp,
                                 const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
     {
         array<ptrdiff_t, N - 1> strides;   // N-1 because last one is the result pointer, which is unused in reduction
         for (size_t i = 0; i < N - 1; i++) // N = a small constant, this will be unrolled
             strides[i] = reducingStrides[i][(size_t) m];
-        double /*ElemType*/ aggregate = 0;
+        double /*ElemType*/ aggregate = ReductionNeutralValue(reductionOp);
         for (size_t dim = reducingOpDims[(size_t) m]; dim-- > 0;)
         {
             // need to descend into one loop deeper
-            aggregate += TensorOpReduction<ElemType, OPFN, N, m - 1>::Loop(pointers, opfn, reducingOpDims, reducingStrides);
+            aggregate = ReductionCombine(reductionOp, aggregate, TensorOpReduction<ElemType, OPFN, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides));
             // advance the pointers
             for (size_t i = 0; i < N - 1; i++)
                 pointers[i] += strides[i]; // note: last pointer (result) is unused and untouched here
@@ -6070,13 +6181,17 @@ struct TensorOpReduction
 template <class ElemType, typename OPFN, size_t N>
 struct TensorOpReduction<ElemType, OPFN, N, -1>
 {
-    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn,
+    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn, ElementWiseOperator reductionOp,
                                 const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&)
     {
         return opfn(pointers); // finally we are doing some work!!!
     }
 };
 
+// Minimum number of elements (times reduction length) of a tensor op for it to be split across OMP threads.
+// Below this, the cost of starting a parallel region exceeds the gain.
+static const size_t TensorOpMinElementsForThreading = 32768;
+
 // -----------------------------------------------------------------------
 // perform loop over regular index k for N-nary operations (N counting the output)
 // -----------------------------------------------------------------------
@@ -6085,7 +6200,7 @@ struct TensorOpReduction<ElemType, OPFN, N, -1>
 template <class ElemType, typename OPFN, size_t N, bool vectorizable, int m, int k>
 struct TensorOpIteration
 {
-    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
+    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
                             const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
     {
@@ -6096,7 +6211,7 @@ struct TensorOpIteration
         for (size_t dim = regularOpDims[(size_t) k]; dim-- > 0;)
         {
             // need to descend into one loop deeper
-            TensorOpIteration<ElemType, OPFN, N, vectorizable, m, k - 1>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            TensorOpIteration<ElemType, OPFN, N, vectorizable, m, k - 1>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
             // advance the pointers
             for (size_t i = 0; i < N; i++)
                 pointers[i] += strides[i];
@@ -6109,7 +6224,7 @@ struct TensorOpIteration
 template <class ElemType, typename OPFN>
 struct TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, 0 /*innermost loop*/>
 {
-    static inline void Loop(ElemType beta, array<ElemType*, 3> pointers, ElemType alpha, const OPFN& opfn,
+    static inline void Loop(ElemType beta, array<ElemType*, 3> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                             const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
     {
@@ -6119,27 +6234,27 @@ struct TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduc
         size_t K = regularOpDims[0];
         // special-case beta and alpha to allow the compiler to short-circuit it
         if (beta != 0)
-#pragma omp parallel for
+#pragma omp parallel for if (K >= TensorOpMinElementsForThreading)
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else if (alpha != 1)
-#pragma omp parallel for
+#pragma omp parallel for if (K >= TensorOpMinElementsForThreading)
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
-#pragma omp parallel for
+#pragma omp parallel for if (K >= TensorOpMinElementsForThreading)
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         // TODO: According to Amit, the VS compiler is not able to vectorize into lambdas. Solution: change the lambda to take an N, or to implement the loop inside (with 1 element by default).
         // TODO: The signedness of k (required for omp) causes an extra sign-extend.
-        // TODO: OMP adds LOTS of overhead. Do we need a guard, a min size when to use it?
+        // Note: OMP only kicks in above TensorOpMinElementsForThreading, since starting a parallel region costs more than a small loop.
     }
 };
 // and unary
 template <class ElemType, typename OPFN>
 struct TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, 0 /*innermost loop*/>
 {
-    static inline void Loop(ElemType beta, array<ElemType*, 2> pointers, ElemType alpha, const OPFN& opfn,
+    static inline void Loop(ElemType beta, array<ElemType*, 2> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                             const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
     {
@@ -6148,29 +6263,29 @@ struct TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduc
         size_t K = regularOpDims[0];
         // special-case beta and alpha to allow the compiler to short-circuit it
         if (beta != 0)
-#pragma omp parallel for
+#pragma omp parallel for if (K >= TensorOpMinElementsForThreading)
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else if (alpha != 1)
-#pragma omp parallel for
+#pragma omp parallel for if (K >= TensorOpMinElementsForThreading)
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
-#pragma omp parallel for
+#pragma omp parallel for if (K >= TensorOpMinElementsForThreading)
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     }
 };
 
 template <class ElemType, typename OPFN, size_t N, bool vectorizable, int m>
 struct TensorOpIteration<ElemType, OPFN, N, vectorizable, m, -1>
 {
-    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
+    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                             const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&,
                             const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
     {
         // we are at element level for the result: perform the op (there may still be reduction)
-        ElemType val = TensorOpReduction<ElemType, OPFN, N, m>::Loop(pointers, opfn, reducingOpDims, reducingStrides);
+        ElemType val = TensorOpReduction<ElemType, OPFN, N, m>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
         // scale
         val *= alpha;
         // combine with previous value in target matrix, then write it out
@@ -6189,7 +6304,7 @@ struct TensorOpIteration<ElemType, OPFN, N, vectorizable, m, -1>
 
 // tensor operation with k+1 dimensions (-1 means scalar)
 template <class ElemType, typename OPFN, size_t N, int k>
-static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn,
+static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
                                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
 {
@@ -6197,9 +6312,9 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
     switch (dims)
     {
     case 2:
-        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 1:
-        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 0, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 0, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 0:
     {
         // if all leading dimensions are 1, we can let the compiler do some unrolling
@@ -6207,43 +6322,168 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
         for (size_t i = 0; i < N; i++)
             leadingAllOne &= k >= 0 && regularStrides[i][0] == 1;
         if (leadingAllOne) // special version that uses a hard-coded increment of 1 for all leading dimensions
-            return TensorOpIteration<ElemType, OPFN, N, true /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            return TensorOpIteration<ElemType, OPFN, N, true /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
-            return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     }
     default:
         LogicError("TensorOp: %d non-flattened reduction dimensions are not supported.", (int) dims);
     }
 }
 
-// tensor operation, generalized in number of arguments, operation already provided as a lambda
+// tensor operation, generalized in number of arguments, operation already provided as a lambda, offsets already applied
 // This function now expands into different k.
 template <class ElemType, typename OPFN, size_t N>
-static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
-                           const array<size_t, N>& offsets,
-                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
-                           const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+static void TensorOpWithRegularDims(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
+                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
 {
-    for (size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
-        pointers[i] += offsets[i];
     size_t dims = regularOpDims.size();
     switch (dims)
     {
     case 4:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 3>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 3>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 3:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 2>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 2>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 2:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 1>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 1:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 0>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 0>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 0:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, -1>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, -1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     default:
         LogicError("TensorOp: %d non-flattened input dimensions are not supported.", (int) dims);
     }
 }
 
+// tensor operation, generalized in number of arguments, operation already provided as a lambda
+// Large operations are split across OMP threads along the outermost regular dimension. Each thread
+// then owns a disjoint slab of the output, so this is also valid with reduction. Rank-1 operations
+// without reduction are left to the innermost loop, which does its own threading.
+template <class ElemType, typename OPFN, size_t N>
+static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
+                           const array<size_t, N>& offsets,
+                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                           const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    for (size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
+        pointers[i] += offsets[i];
+
+    size_t rank = regularOpDims.size();
+    bool splittable = rank > 0 && rank <= 4 && reducingOpDims.size() <= 2 && (rank > 1 || !reducingOpDims.empty()); // (no errors must be thrown inside the OMP region)
+    if (splittable)
+    {
+        size_t numElements = 1;
+        for (size_t d = 0; d < rank; d++)
+            numElements *= regularOpDims[d];
+        for (size_t d = 0; d < reducingOpDims.size(); d++)
+            numElements *= reducingOpDims[d];
+        size_t outerDim = regularOpDims[rank - 1];
+        int numSlabs = (int) min(outerDim, (size_t) omp_get_max_threads());
+        if (numSlabs > 1 && numElements >= TensorOpMinElementsForThreading && !omp_in_parallel())
+        {
+#pragma omp parallel for
+            for (int slab = 0; slab < numSlabs; slab++)
+            {
+                size_t begin = outerDim * slab / numSlabs;
+                size_t end = outerDim * (slab + 1) / numSlabs;
+                array<ElemType*, N> slabPointers = pointers;
+                for (size_t i = 0; i < N; i++)
+                    slabPointers[i] += (ptrdiff_t) begin * regularStrides[i][rank - 1];
+                SmallVector<size_t> slabOpDims = regularOpDims;
+                slabOpDims[rank - 1] = end - begin;
+                TensorOpWithRegularDims(beta, slabPointers, alpha, opfn, reductionOp, slabOpDims, regularStrides, reducingOpDims, reducingStrides);
+            }
+            return;
+        }
+    }
+    TensorOpWithRegularDims(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+}
+
+// -----------------------------------------------------------------------
+// explicitly vectorized path for unary and binary ops without reduction
+// -----------------------------------------------------------------------
+
+// decided once at load time which kernel flavor this CPU can run
+static const CPUSIMDLevel s_tensorOpSIMDLevel = DetectCPUSIMDLevel();
+
+template <class ElemType>
+static inline void TensorOpSIMDRun(ElementWiseOperator op, ElemType beta, const ElemType* pa, bool aIsScalar, const ElemType* pb, bool bIsScalar,
+                                   ElemType* pc, size_t n, ElemType alpha)
+{
+#ifdef SUPPORT_AVX2
+    if (s_tensorOpSIMDLevel == CPUSIMDLevel::AVX2)
+        SIMDElementwise<ElemType, CPUSIMDLevel::AVX2>(op, beta, pa, aIsScalar, pb, bIsScalar, pc, n, alpha);
+    else
+#endif
+        SIMDElementwise<ElemType, CPUSIMDLevel::SSE2>(op, beta, pa, aIsScalar, pb, bIsScalar, pc, n, alpha);
+}
+
+// Unary (N = 2) or binary (N = 3) operation using the kernels from CPUTensorKernels.h.
+// Applicable if the op has a kernel, the output is contiguous along the leading dimension, and each input
+// is either contiguous or broadcasting along it. The work is cut into runs along the leading dimension, which are
+// distributed over OMP threads; runs are further cut into chunks when there are fewer runs than threads.
+// Returns false if not applicable, in which case nothing has been done.
+template <class ElemType, size_t N>
+static bool TensorOpWithSIMDKernel(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op,
+                                   const array<size_t, N>& offsets,
+                                   const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides)
+{
+    static_assert(N == 2 || N == 3, "TensorOpWithSIMDKernel: Only unary and binary ops are supported.");
+    size_t rank = regularOpDims.size();
+    if (s_tensorOpSIMDLevel == CPUSIMDLevel::None || rank == 0 || !HasSIMDKernel(op) || regularStrides[N - 1][0] != 1)
+        return false;
+    for (size_t i = 0; i + 1 < N; i++)
+        if (regularStrides[i][0] != 0 && regularStrides[i][0] != 1)
+            return false;
+
+    for (size_t i = 0; i < N; i++)
+        pointers[i] += offsets[i];
+
+    const size_t* dims = regularOpDims.data();
+    array<const ptrdiff_t*, N> strides;
+    for (size_t i = 0; i < N; i++)
+        strides[i] = regularStrides[i].data();
+    bool aIsScalar = strides[0][0] == 0;
+    bool bIsScalar = N == 3 && strides[1][0] == 0;
+
+    size_t runLength = dims[0];
+    size_t numRuns = 1;
+    for (size_t d = 1; d < rank; d++)
+        numRuns *= dims[d];
+    if (runLength == 0 || numRuns == 0)
+        return true;
+
+    // if there are fewer runs than threads, cut each run into chunks (on vector boundaries)
+    int numThreads = runLength * numRuns >= TensorOpMinElementsForThreading ? omp_get_max_threads() : 1;
+    size_t chunkLength = runLength;
+    if (numRuns < (size_t) numThreads)
+    {
+        size_t numChunksPerRun = ((size_t) numThreads + numRuns - 1) / numRuns;
+        chunkLength = (runLength + numChunksPerRun - 1) / numChunksPerRun;
+        chunkLength = (chunkLength + 15) / 16 * 16;
+    }
+    size_t chunksPerRun = (runLength + chunkLength - 1) / chunkLength;
+    size_t numChunks = numRuns * chunksPerRun;
+
+#pragma omp parallel for if (numThreads > 1)
+    for (int chunk = 0; chunk < (int) numChunks; chunk++)
+    {
+        size_t run = (size_t) chunk / chunksPerRun;
+        size_t begin = ((size_t) chunk % chunksPerRun) * chunkLength;
+        size_t length = min(chunkLength, runLength - begin);
+        // locate the run by decomposing its index over the outer dimensions
+        array<ElemType*, N> p = pointers;
+        for (size_t d = 1, r = run; d < rank; r /= dims[d], d++)
+            for (size_t i = 0; i < N; i++)
+                p[i] += (ptrdiff_t) (r % dims[d]) * strides[i][d];
+        for (size_t i = 0; i < N; i++)
+            p[i] += (ptrdiff_t) begin * strides[i][0];
+        TensorOpSIMDRun<ElemType>(op, beta, p[0], aIsScalar, N == 3 ? p[1] : nullptr, bIsScalar, p[N - 1], length, alpha);
+    }
+    return true;
+}
+
 // -----------------------------------------------------------------------
 // entry points from Matrix.cpp; also map op to a lambda
 // -----------------------------------------------------------------------
@@ -6256,19 +6496,21 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
 {
-    if (reductionOp != ElementWiseOperator::opSum) // TODO: enable the reduction ops
-        InvalidArgument("TensorOp: Unary reduction operations other than opSum not yet implemented.");
+    CheckTensorOpReductionOp(reductionOp);
+
+    // common elementwise ops go through the explicitly vectorized kernels
+    array<ElemType*, 2> pointers = {a.Data(), Data()};
+    if (reducingOpDims.empty() && TensorOpWithSIMDKernel(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides))
+        return;
 
-// TODO: Change the lambda to take a pointer and a number of elements, so that we can pass it 1 or 4 elements, in order for it to SSE-vectorize.
 #define CaseUnaryTensorOp(oper)                                                        \
     case ElementWiseOperator::op##oper:                                                \
         return TensorOpWithFn(beta, pointers, alpha, [](const array<ElemType*, 2>& pp) \
                               {                                                        \
                                   return Op##oper((*(pp[0])));                         \
                               },                                                       \
-                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+                              reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
-    array<ElemType*, 2> pointers = {a.Data(), Data()};
     switch (op)
     {
         ForAllUnaryOps(CaseUnaryTensorOp);
@@ -6285,8 +6527,11 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
 {
-    if (reductionOp != ElementWiseOperator::opSum)
-        InvalidArgument("TensorOp (binary): The only permitted binary reduction operation is opSum.");
+    CheckTensorOpReductionOp(reductionOp);
+
+    array<ElemType*, 3> pointers = {a.Data(), b.Data(), Data()};
+    if (reducingOpDims.empty() && TensorOpWithSIMDKernel(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides))
+        return;
 
 #define CaseBinaryTensorOp(oper)                                                       \
     case ElementWiseOperator::op##oper:                                                \
@@ -6294,9 +6539,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               {                                                        \
                                   return Op##oper((*(pp[0])), (*(pp[1])));             \
                               },                                                       \
-                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+                              reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
-    array<ElemType*, 3> pointers = {a.Data(), b.Data(), Data()};
     switch (op)
     {
         ForAllBinaryOps(CaseBinaryTensorOp);
@@ -6313,8 +6557,7 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides)
 {
-    if (reductionOp != ElementWiseOperator::opSum)
-        InvalidArgument("TensorOp: The only permitted ternary reduction operation is opSum.");
+    CheckTensorOpReductionOp(reductionOp);
 
 #define CaseTernaryTensorOp(oper)                                                      \
     case ElementWiseOperator::op##oper:                                                \
@@ -6322,7 +6565,7 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               {                                                        \
                                   return Op##oper((*(pp[0])), (*(pp[1])), (*(pp[2]))); \
                               },                                                       \
-                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+                              reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 4> pointers = {a.Data(), b.Data(), c.Data(), Data()};
     switch (op)
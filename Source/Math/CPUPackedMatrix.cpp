@@ -0,0 +1,35 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+#include "stdafx.h"
+#include "CPUPackedMatrix.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+CPUPackedMatrix<ElemType>::CPUPackedMatrix(const ElemType* data, size_t numRows, size_t numCols)
+    : m_numRows(numRows), m_numCols(numCols)
+{
+    if (numRows == 0 || numCols == 0)
+        InvalidArgument("CPUPackedMatrix: The matrix must not be empty.");
+
+    size_t numPanels = GetNumPanels();
+    m_packedData.assign(numPanels * PanelRows * numCols, 0); // the padding rows of the last panel stay 0
+#pragma omp parallel for
+    for (long long pp = 0; pp < (long long) numPanels; pp++)
+    {
+        size_t p = (size_t) pp;
+        size_t firstRow = p * PanelRows;
+        size_t panelRows = min((size_t) PanelRows, numRows - firstRow);
+        ElemType* panel = m_packedData.data() + p * PanelRows * numCols;
+        for (size_t j = 0; j < numCols; j++)
+            for (size_t i = 0; i < panelRows; i++)
+                panel[j * PanelRows + i] = data[j * numRows + firstRow + i];
+    }
+}
+
+template class CPUPackedMatrix<float>;
+template class CPUPackedMatrix<double>;
+
+}}}
@@ -0,0 +1,46 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+#pragma once
+
+#include "Matrix.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// CPUPackedMatrix -- a read-only copy of a dense column-major matrix A, repacked for products A * B on the CPU
+// where B has only a few columns (e.g. when serving a model one or a few samples at a time).
+// The rows of A are grouped into panels of PanelRows rows, and each panel is stored column by column,
+// so that a product streams through A exactly once per group of ColumnsAtOnce columns of B,
+// with all loads contiguous.
+// The copy does not track changes of the original; owners must rebuild it when A is modified.
+// See CPUMatrix::MultiplyAndWeightedAdd() for the product.
+template <class ElemType>
+class MATH_API CPUPackedMatrix
+{
+public:
+    // rows of A processed together: 32 bytes, i.e. one AVX or two SSE registers of accumulators per column of B
+    static const size_t PanelRows = 32 / sizeof(ElemType);
+    // columns of B processed together in one pass through A
+    static const size_t ColumnsAtOnce = 4;
+    // products with up to this many columns of B are faster with the packed layout than with BLAS
+    static const size_t MaxColumns = 8;
+
+    // 'data' is a column-major [numRows x numCols] matrix with leading dimension numRows
+    CPUPackedMatrix(const ElemType* data, size_t numRows, size_t numCols);
+
+    size_t GetNumRows() const { return m_numRows; }
+    size_t GetNumCols() const { return m_numCols; }
+    size_t GetNumPanels() const { return (m_numRows + PanelRows - 1) / PanelRows; }
+
+    // panel p holds rows p * PanelRows .. p * PanelRows + PanelRows - 1 (zero-padded), as a [PanelRows x numCols] column-major matrix
+    const ElemType* Panel(size_t p) const { return m_packedData.data() + p * PanelRows * m_numCols; }
+
+private:
+    size_t m_numRows;
+    size_t m_numCols;
+    std::vector<ElemType> m_packedData;
+};
+
+}}}
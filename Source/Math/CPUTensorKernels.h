@@ -0,0 +1,298 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernels.h -- explicitly vectorized inner loops for CPUMatrix::TensorOp()
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for ElementWiseOperator
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#ifdef SUPPORT_AVX2
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// SIMD kernels for elementwise tensor operations
+//
+// These cover the cheap, memory-bound ops that most elementwise nodes end up
+// in (copy, plus, minus, element times, ReLU, and the derivatives used by
+// backprop). A kernel processes one contiguous run of output elements. Each
+// input is either contiguous along the run (stride 1) or broadcasts a single
+// value (stride 0). Ops not listed in ForAllSIMDOps() have no kernel; the
+// caller then uses the generic template loops. Transcendental ops are
+// intentionally not covered, since a vectorized exp() would not produce
+// bit-identical results to the scalar path.
+// -----------------------------------------------------------------------
+
+enum class CPUSIMDLevel
+{
+    None, // no kernels, use the generic loops
+    SSE2,
+    AVX2  // only with SUPPORT_AVX2, and only if the CPU has it
+};
+
+// determine the best kernel flavor for the CPU we are running on
+static inline CPUSIMDLevel DetectCPUSIMDLevel()
+{
+#ifdef SUPPORT_AVX2
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7)
+    {
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6; // OSXSAVE, and OS saves XMM and YMM state
+        __cpuidex(info, 7, 0);
+        if (osSavesYmm && (info[1] & (1 << 5)) != 0) // EBX bit 5 = AVX2
+            return CPUSIMDLevel::AVX2;
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return CPUSIMDLevel::AVX2;
+#endif
+#endif
+    return CPUSIMDLevel::SSE2; // SSE2 is part of the x64 baseline
+}
+
+// -----------------------------------------------------------------------
+// register abstraction per element type and instruction set
+// -----------------------------------------------------------------------
+
+template <class ElemType, CPUSIMDLevel level>
+struct SIMDTraits;
+
+template <>
+struct SIMDTraits<float, CPUSIMDLevel::SSE2>
+{
+    typedef float E;
+    typedef __m128 V;
+    static const size_t width = 4;
+    static inline V Load(const E* p)          { return _mm_loadu_ps(p); }
+    static inline void Store(E* p, V v)       { _mm_storeu_ps(p, v); }
+    static inline V Set1(E x)                 { return _mm_set1_ps(x); }
+    static inline V Add(V a, V b)             { return _mm_add_ps(a, b); }
+    static inline V Sub(V a, V b)             { return _mm_sub_ps(a, b); }
+    static inline V Mul(V a, V b)             { return _mm_mul_ps(a, b); }
+    static inline V Max(V a, V b)             { return _mm_max_ps(a, b); } // returns b if either is NaN, same as 'a > b ? a : b'
+    static inline V Min(V a, V b)             { return _mm_min_ps(a, b); }
+    static inline V Negate(V a)               { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+    static inline V Abs(V a)                  { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static inline V IfGreaterZero(V x, V a)   { return _mm_and_ps(_mm_cmpgt_ps(x, _mm_setzero_ps()), a); } // x > 0 ? a : 0
+    static inline V IfGreaterEqZero(V x, V a) { return _mm_and_ps(_mm_cmpge_ps(x, _mm_setzero_ps()), a); } // x >= 0 ? a : 0
+};
+
+template <>
+struct SIMDTraits<double, CPUSIMDLevel::SSE2>
+{
+    typedef double E;
+    typedef __m128d V;
+    static const size_t width = 2;
+    static inline V Load(const E* p)          { return _mm_loadu_pd(p); }
+    static inline void Store(E* p, V v)       { _mm_storeu_pd(p, v); }
+    static inline V Set1(E x)                 { return _mm_set1_pd(x); }
+    static inline V Add(V a, V b)             { return _mm_add_pd(a, b); }
+    static inline V Sub(V a, V b)             { return _mm_sub_pd(a, b); }
+    static inline V Mul(V a, V b)             { return _mm_mul_pd(a, b); }
+    static inline V Max(V a, V b)             { return _mm_max_pd(a, b); }
+    static inline V Min(V a, V b)             { return _mm_min_pd(a, b); }
+    static inline V Negate(V a)               { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+    static inline V Abs(V a)                  { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+    static inline V IfGreaterZero(V x, V a)   { return _mm_and_pd(_mm_cmpgt_pd(x, _mm_setzero_pd()), a); }
+    static inline V IfGreaterEqZero(V x, V a) { return _mm_and_pd(_mm_cmpge_pd(x, _mm_setzero_pd()), a); }
+};
+
+#ifdef SUPPORT_AVX2
+template <>
+struct SIMDTraits<float, CPUSIMDLevel::AVX2>
+{
+    typedef float E;
+    typedef __m256 V;
+    static const size_t width = 8;
+    static inline V Load(const E* p)          { return _mm256_loadu_ps(p); }
+    static inline void Store(E* p, V v)       { _mm256_storeu_ps(p, v); }
+    static inline V Set1(E x)                 { return _mm256_set1_ps(x); }
+    static inline V Add(V a, V b)             { return _mm256_add_ps(a, b); }
+    static inline V Sub(V a, V b)             { return _mm256_sub_ps(a, b); }
+    static inline V Mul(V a, V b)             { return _mm256_mul_ps(a, b); }
+    static inline V Max(V a, V b)             { return _mm256_max_ps(a, b); }
+    static inline V Min(V a, V b)             { return _mm256_min_ps(a, b); }
+    static inline V Negate(V a)               { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+    static inline V Abs(V a)                  { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static inline V IfGreaterZero(V x, V a)   { return _mm256_and_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ), a); }
+    static inline V IfGreaterEqZero(V x, V a) { return _mm256_and_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GE_OQ), a); }
+};
+
+template <>
+struct SIMDTraits<double, CPUSIMDLevel::AVX2>
+{
+    typedef double E;
+    typedef __m256d V;
+    static const size_t width = 4;
+    static inline V Load(const E* p)          { return _mm256_loadu_pd(p); }
+    static inline void Store(E* p, V v)       { _mm256_storeu_pd(p, v); }
+    static inline V Set1(E x)                 { return _mm256_set1_pd(x); }
+    static inline V Add(V a, V b)             { return _mm256_add_pd(a, b); }
+    static inline V Sub(V a, V b)             { return _mm256_sub_pd(a, b); }
+    static inline V Mul(V a, V b)             { return _mm256_mul_pd(a, b); }
+    static inline V Max(V a, V b)             { return _mm256_max_pd(a, b); }
+    static inline V Min(V a, V b)             { return _mm256_min_pd(a, b); }
+    static inline V Negate(V a)               { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+    static inline V Abs(V a)                  { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static inline V IfGreaterZero(V x, V a)   { return _mm256_and_pd(_mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GT_OQ), a); }
+    static inline V IfGreaterEqZero(V x, V a) { return _mm256_and_pd(_mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GE_OQ), a); }
+};
+#endif
+
+// -----------------------------------------------------------------------
+// the ops; each must match its scalar definition in TensorOps.h
+// Unary ops ignore the second argument.
+// -----------------------------------------------------------------------
+
+#define ForAllSIMDOps(Macro)                                         \
+    Macro(Copy);                                                     \
+    Macro(Negate);                                                   \
+    Macro(Abs);                                                      \
+    Macro(Sqr);                                                      \
+    Macro(LinearRectifier);                                          \
+    Macro(Sum);                                                      \
+    Macro(Difference);                                               \
+    Macro(ElementwiseProduct);                                       \
+    Macro(Max);                                                      \
+    Macro(Min);                                                      \
+    Macro(MaskNegative);                                             \
+    Macro(SqrOfDifference);                                          \
+    Macro(ElementwiseProductWithSigmoidDerivativeFromOutput);        \
+    Macro(ElementwiseProductWithTanhDerivativeFromOutput);           \
+    Macro(ElementwiseProductWithLinearRectifierDerivativeFromOutput);
+
+#pragma push_macro("DefSIMDUnaryOp")
+#define DefSIMDUnaryOp(op, expr)                                                      \
+    template <class T>                                                                \
+    struct SIMDOp##op                                                                 \
+    {                                                                                 \
+        static inline typename T::V Apply(typename T::V a, typename T::V)             \
+        {                                                                             \
+            return expr;                                                              \
+        }                                                                             \
+    }
+DefSIMDUnaryOp(Copy, a);
+DefSIMDUnaryOp(Negate, T::Negate(a));
+DefSIMDUnaryOp(Abs, T::Abs(a));
+DefSIMDUnaryOp(Sqr, T::Mul(a, a));
+DefSIMDUnaryOp(LinearRectifier, T::IfGreaterZero(a, a));
+#pragma pop_macro("DefSIMDUnaryOp")
+
+#pragma push_macro("DefSIMDBinaryOp")
+#define DefSIMDBinaryOp(op, expr)                                                     \
+    template <class T>                                                                \
+    struct SIMDOp##op                                                                 \
+    {                                                                                 \
+        static inline typename T::V Apply(typename T::V a, typename T::V b)           \
+        {                                                                             \
+            return expr;                                                              \
+        }                                                                             \
+    }
+DefSIMDBinaryOp(Sum, T::Add(a, b));
+DefSIMDBinaryOp(Difference, T::Sub(a, b));
+DefSIMDBinaryOp(ElementwiseProduct, T::Mul(a, b));
+DefSIMDBinaryOp(Max, T::Max(a, b));
+DefSIMDBinaryOp(Min, T::Min(a, b));
+DefSIMDBinaryOp(MaskNegative, T::IfGreaterEqZero(b, a));
+DefSIMDBinaryOp(SqrOfDifference, T::Mul(T::Sub(a, b), T::Sub(a, b)));
+DefSIMDBinaryOp(ElementwiseProductWithSigmoidDerivativeFromOutput, T::Mul(a, T::Mul(b, T::Sub(T::Set1(1), b))));
+DefSIMDBinaryOp(ElementwiseProductWithTanhDerivativeFromOutput, T::Mul(a, T::Sub(T::Set1(1), T::Mul(b, b))));
+DefSIMDBinaryOp(ElementwiseProductWithLinearRectifierDerivativeFromOutput, T::IfGreaterZero(b, a));
+#pragma pop_macro("DefSIMDBinaryOp")
+
+static inline bool HasSIMDKernel(ElementWiseOperator op)
+{
+#define CaseHasSIMDKernel(oper) \
+    case ElementWiseOperator::op##oper: return true
+    switch (op)
+    {
+        ForAllSIMDOps(CaseHasSIMDKernel);
+    default: return false;
+    }
+#undef CaseHasSIMDKernel
+}
+
+// -----------------------------------------------------------------------
+// the loop: c[i] = alpha * op(a[i], b[i]) + beta * c[i] for i < n
+// A null 'pb' means unary. 'aIsScalar'/'bIsScalar' mean the input is broadcast (stride 0).
+// -----------------------------------------------------------------------
+
+template <class T, class OP>
+static inline void SIMDElementwiseLoop(typename T::E beta, const typename T::E* pa, bool aIsScalar, const typename T::E* pb, bool bIsScalar,
+                                       typename T::E* pc, size_t n, typename T::E alpha)
+{
+    typedef typename T::E E;
+    typedef typename T::V V;
+    const size_t W = T::width;
+    if (!pb) // unary: feed 'a' as dummy second argument, which the op ignores
+    {
+        pb = pa;
+        bIsScalar = aIsScalar;
+    }
+    const V va = T::Set1(*pa); // only used if broadcasting
+    const V vb = T::Set1(*pb);
+    const V valpha = T::Set1(alpha);
+    const V vbeta = T::Set1(beta);
+    size_t i = 0;
+    for (; i + W <= n; i += W)
+    {
+        V r = OP::Apply(aIsScalar ? va : T::Load(pa + i), bIsScalar ? vb : T::Load(pb + i));
+        if (alpha != 1)
+            r = T::Mul(r, valpha);
+        if (beta != 0)
+            r = T::Add(r, T::Mul(vbeta, T::Load(pc + i)));
+        T::Store(pc + i, r);
+    }
+    if (i < n) // remainder: go through a zero-padded buffer, so that each op is only defined once
+    {
+        E bufA[W], bufB[W], bufC[W];
+        for (size_t j = 0; j < W; j++)
+        {
+            bool valid = i + j < n;
+            bufA[j] = !valid ? 0 : aIsScalar ? *pa : pa[i + j];
+            bufB[j] = !valid ? 0 : bIsScalar ? *pb : pb[i + j];
+            bufC[j] = valid && beta != 0 ? pc[i + j] : 0;
+        }
+        V r = OP::Apply(T::Load(bufA), T::Load(bufB));
+        if (alpha != 1)
+            r = T::Mul(r, valpha);
+        if (beta != 0)
+            r = T::Add(r, T::Mul(vbeta, T::Load(bufC)));
+        T::Store(bufC, r);
+        for (size_t j = 0; i + j < n; j++)
+            pc[i + j] = bufC[j];
+    }
+}
+
+// run the kernel for 'op' at the given instruction-set level; returns false if 'op' has no kernel
+template <class ElemType, CPUSIMDLevel level>
+static inline bool SIMDElementwise(ElementWiseOperator op, ElemType beta, const ElemType* pa, bool aIsScalar, const ElemType* pb, bool bIsScalar,
+                                   ElemType* pc, size_t n, ElemType alpha)
+{
+    typedef SIMDTraits<ElemType, level> T;
+#define CaseSIMDElementwise(oper)                                                                       \
+    case ElementWiseOperator::op##oper:                                                                 \
+        SIMDElementwiseLoop<T, SIMDOp##oper<T>>(beta, pa, aIsScalar, pb, bIsScalar, pc, n, alpha);      \
+        return true
+    switch (op)
+    {
+        ForAllSIMDOps(CaseSIMDElementwise);
+    default: return false;
+    }
+#undef CaseSIMDElementwise
+}
+
+}}}
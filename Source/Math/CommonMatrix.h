@@ -96,7 +96,9 @@ enum ElementWiseOperator
     opCond /*a ? b : c*/,
     opClip, /*clip a within interval b..c*/
     opElementwiseProductWithLogSumDerivative,
-    opCopyIfEqual
+    opCopyIfEqual,
+    // binary, fused nonlinearity of a sum; appended so that the values of the opcodes above do not change
+    opSigmoidOfSum, opTanhOfSum, opLinearRectifierOfSum
     // Note: not all that's implemented in CNTK ComputationNodes has an opcode yet.
 };
 
@@ -151,6 +153,9 @@ enum ElementWiseOperator
     Macro(ElementwiseProductWithReciprocalDerivative);                \
     Macro(ElementwiseProductWithSqrtDerivative);                      \
     Macro(SqrOfDifference);                                           \
+    Macro(SigmoidOfSum);                                              \
+    Macro(TanhOfSum);                                                 \
+    Macro(LinearRectifierOfSum);                                      \
     //Macro(Index);
 
 #define ForAllTernaryOps(Macro)                         \
@@ -6,6 +6,15 @@
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
+#include "TimerUtility.h"
+#include "fileutil.h"
+#include <mutex>
+#include <omp.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -847,6 +856,733 @@ public:
     }
 };
 
+//------------------------------------------------------------------
+// Direct convolution engine implementation.
+// CPU-only engine for 2D convolutions with full sharing (input [WHC x N], kernel [XYC x K], output [W'H'K x N])
+// that computes the forward pass without unrolling the input, which for small kernels costs
+// several times the input size in memory traffic. Two algorithms are used, selected by geometry:
+// 1. 3x3 kernels with stride 1 use Winograd's minimal filtering algorithm F(m x m, 3 x 3)
+//    (see Lavin & Gray, "Fast Algorithms for Convolutional Neural Networks"): each m x m output tile
+//    needs (m + 2)^2 multiplications per channel pair instead of 9 m^2, and the products of all tiles
+//    are done as (m + 2)^2 GEMMs. F(4 x 4, 3 x 3) is used for large outputs, F(2 x 2, 3 x 3) for small ones.
+// 2. Other kernels use a blocked direct convolution that computes one output row of 4 maps at a time,
+//    with the inner loop running over contiguous output cells.
+// The backward passes are the ones of the GEMM engine.
+//------------------------------------------------------------------
+template <class ElemType>
+class DirectConvolutionEngine : public GemmConvolutionEngine<ElemType>
+{
+public:
+    using Base = GemmConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DirectConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind)
+    {
+        const auto& inT = m_geometry->InputShape();
+        const auto& kernT = m_geometry->KernelShape();
+        const auto& outT = m_geometry->OutputShape();
+        m_inW = inT[0];
+        m_inH = inT[1];
+        m_inC = inT[2];
+        m_outW = outT[0];
+        m_outH = outT[1];
+        m_mapCount = outT[2];
+        m_kernW = kernT[0];
+        m_kernH = kernT[1];
+        m_strideW = m_geometry->GetStride(0);
+        m_strideH = m_geometry->GetStride(1);
+        m_offsetW = FirstInputOffset(*m_geometry, 0);
+        m_offsetH = FirstInputOffset(*m_geometry, 1);
+
+        // The transforms cost more than they save when there are only a few channels or maps.
+        m_winogradTileSize = 0;
+        if (m_kernW == 3 && m_kernH == 3 && m_strideW == 1 && m_strideH == 1 && m_inC >= 4 && m_mapCount >= 4)
+            m_winogradTileSize = m_outW >= 8 && m_outH >= 8 ? 4 : 2;
+        if (m_winogradTileSize == 2)
+        {
+            m_winogradBT.assign(begin(s_winograd2BT), end(s_winograd2BT));
+            m_winogradG.assign(begin(s_winograd2G), end(s_winograd2G));
+            m_winogradAT.assign(begin(s_winograd2AT), end(s_winograd2AT));
+        }
+        else if (m_winogradTileSize == 4)
+        {
+            m_winogradBT.assign(begin(s_winograd4BT), end(s_winograd4BT));
+            m_winogradG.assign(begin(s_winograd4G), end(s_winograd4G));
+            m_winogradAT.assign(begin(s_winograd4AT), end(s_winograd4AT));
+        }
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_maxTempMemSizeInSamples;
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        if (in.GetMatrixType() != DENSE)
+            Base::ForwardCore(in, kernel, out, workspace);
+        else if (m_winogradTileSize != 0)
+            ForwardWinograd(in, kernel, out, workspace);
+        else
+            ForwardDirect(in, kernel, out);
+    }
+
+    // Computes one output row of MapsAtOnce maps per work item. The kernel is first repacked
+    // so that the weights of these maps for one kernel cell are adjacent (zero for maps past the last one).
+    void ForwardDirect(const Mat& in, const Mat& kernel, Mat& out)
+    {
+        size_t batchSize = in.GetNumCols();
+        size_t kernelSize = m_kernW * m_kernH * m_inC;
+        size_t mapBlockCount = (m_mapCount + MapsAtOnce - 1) / MapsAtOnce;
+
+        const ElemType* w = kernel.Data();
+        std::vector<ElemType> packedKernel(mapBlockCount * kernelSize * MapsAtOnce, 0);
+        for (size_t k = 0; k < m_mapCount; k++)
+            for (size_t i = 0; i < kernelSize; i++)
+                packedKernel[((k / MapsAtOnce) * kernelSize + i) * MapsAtOnce + k % MapsAtOnce] = w[k * kernelSize + i];
+
+        const ElemType* inData = in.Data();
+        ElemType* outData = out.Data();
+        size_t inRows = in.GetNumRows();
+        size_t outRows = out.GetNumRows();
+        long long itemCount = (long long) (batchSize * mapBlockCount * m_outH);
+#pragma omp parallel
+        {
+            std::vector<ElemType> sums(MapsAtOnce * m_outW);
+#pragma omp for
+            for (long long item = 0; item < itemCount; item++)
+            {
+                size_t oy = (size_t) item % m_outH;
+                size_t mapBlock = ((size_t) item / m_outH) % mapBlockCount;
+                size_t n = (size_t) item / m_outH / mapBlockCount;
+                std::fill(sums.begin(), sums.end(), (ElemType) 0);
+                ElemType* s0 = sums.data();
+                ElemType* s1 = s0 + m_outW;
+                ElemType* s2 = s1 + m_outW;
+                ElemType* s3 = s2 + m_outW;
+                const ElemType* sample = inData + n * inRows;
+                const ElemType* blockKernel = packedKernel.data() + mapBlock * kernelSize * MapsAtOnce;
+                for (size_t c = 0; c < m_inC; c++)
+                {
+                    for (size_t ky = 0; ky < m_kernH; ky++)
+                    {
+                        ptrdiff_t iy = (ptrdiff_t) (oy * m_strideH + ky) + m_offsetH;
+                        if (iy < 0 || iy >= (ptrdiff_t) m_inH)
+                            continue;
+                        const ElemType* inRow = sample + (c * m_inH + iy) * m_inW;
+                        for (size_t kx = 0; kx < m_kernW; kx++)
+                        {
+                            // output cell ox reads input cell ox * stride + ix0; restrict ox to the cells that stay inside the row
+                            ptrdiff_t ix0 = (ptrdiff_t) kx + m_offsetW;
+                            size_t oxBegin = ix0 >= 0 ? 0 : (size_t) (-ix0 + (ptrdiff_t) m_strideW - 1) / m_strideW;
+                            size_t oxEnd = ix0 >= (ptrdiff_t) m_inW ? 0 : min(m_outW, (size_t) ((ptrdiff_t) m_inW - 1 - ix0) / m_strideW + 1);
+                            if (oxBegin >= oxEnd)
+                                continue;
+                            const ElemType* cw = blockKernel + ((c * m_kernH + ky) * m_kernW + kx) * MapsAtOnce;
+                            ElemType w0 = cw[0], w1 = cw[1], w2 = cw[2], w3 = cw[3];
+                            const ElemType* src = inRow + (ptrdiff_t) (oxBegin * m_strideW) + ix0;
+                            if (m_strideW == 1)
+                            {
+                                for (size_t ox = oxBegin; ox < oxEnd; ox++, src++)
+                                {
+                                    ElemType v = *src;
+                                    s0[ox] += w0 * v;
+                                    s1[ox] += w1 * v;
+                                    s2[ox] += w2 * v;
+                                    s3[ox] += w3 * v;
+                                }
+                            }
+                            else
+                            {
+                                for (size_t ox = oxBegin; ox < oxEnd; ox++, src += m_strideW)
+                                {
+                                    ElemType v = *src;
+                                    s0[ox] += w0 * v;
+                                    s1[ox] += w1 * v;
+                                    s2[ox] += w2 * v;
+                                    s3[ox] += w3 * v;
+                                }
+                            }
+                        }
+                    }
+                }
+                for (size_t j = 0; j < MapsAtOnce && mapBlock * MapsAtOnce + j < m_mapCount; j++)
+                {
+                    size_t k = mapBlock * MapsAtOnce + j;
+                    std::copy(sums.begin() + j * m_outW, sums.begin() + (j + 1) * m_outW, outData + n * outRows + (k * m_outH + oy) * m_outW);
+                }
+            }
+        }
+    }
+
+    // Winograd F(m x m, 3 x 3) with alpha = m + 2 has 3 stages, with the workspace holding alpha^2 matrices for each:
+    // 1. Transform the kernels: U = G g G^T for each map k and channel c, stored as alpha^2 matrices [K x C].
+    // 2. Transform the input tiles: V = B^T d B for each alpha x alpha input tile d (tiles overlap by 2)
+    //    and channel c, stored as alpha^2 matrices [T x C], where T is the number of tiles in the sub-batch.
+    // 3. Multiply: M = V U^T for each of the alpha^2 matrices, giving [T x K],
+    //    and transform back: Y = A^T M A for each tile and map, clipping tiles at the output boundary.
+    void ForwardWinograd(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        size_t batchSize = in.GetNumCols();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+
+        size_t m = m_winogradTileSize;
+        size_t alpha = m + 2;
+        size_t alpha2 = alpha * alpha;
+        size_t tilesW = (m_outW + m - 1) / m;
+        size_t tilesH = (m_outH + m - 1) / m;
+        size_t tilesPerSample = tilesW * tilesH;
+        size_t mapCount = m_mapCount;
+        size_t inC = m_inC;
+
+        size_t kernelCols = alpha2 * mapCount * inC;
+        size_t maxTiles = subBatchSize * tilesPerSample;
+        workspace.Resize(1, kernelCols + alpha2 * maxTiles * (inC + mapCount));
+        ElemType* ws = workspace.Data();
+
+        // 1. Transform the kernels.
+        const ElemType* w = kernel.Data();
+#pragma omp parallel for
+        for (long long kc = 0; kc < (long long) (mapCount * inC); kc++)
+        {
+            size_t k = (size_t) kc / inC;
+            size_t c = (size_t) kc % inC;
+            ElemType u[MaxAlpha * MaxAlpha];
+            Sandwich(m_winogradG.data(), alpha, 3, w + (k * inC + c) * 9, u);
+            for (size_t xi = 0; xi < alpha2; xi++)
+                ws[xi * mapCount * inC + c * mapCount + k] = u[xi];
+        }
+
+        const ElemType* inData = in.Data();
+        ElemType* outData = out.Data();
+        size_t inRows = in.GetNumRows();
+        size_t outRows = out.GetNumRows();
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t curBatchSize = min(subBatchSize, batchSize - start);
+            size_t numTiles = curBatchSize * tilesPerSample;
+            size_t inputOffset = kernelCols;
+            size_t productOffset = inputOffset + alpha2 * numTiles * inC;
+
+            // 2. Transform the input tiles.
+#pragma omp parallel for
+            for (long long nc = 0; nc < (long long) (curBatchSize * inC); nc++)
+            {
+                size_t n = (size_t) nc / inC;
+                size_t c = (size_t) nc % inC;
+                const ElemType* channel = inData + (start + n) * inRows + c * m_inH * m_inW;
+                ElemType d[MaxAlpha * MaxAlpha];
+                ElemType v[MaxAlpha * MaxAlpha];
+                for (size_t ty = 0; ty < tilesH; ty++)
+                {
+                    for (size_t tx = 0; tx < tilesW; tx++)
+                    {
+                        ptrdiff_t iy0 = (ptrdiff_t) (ty * m) + m_offsetH;
+                        ptrdiff_t ix0 = (ptrdiff_t) (tx * m) + m_offsetW;
+                        for (size_t i = 0; i < alpha; i++)
+                        {
+                            ptrdiff_t iy = iy0 + (ptrdiff_t) i;
+                            for (size_t j = 0; j < alpha; j++)
+                            {
+                                ptrdiff_t ix = ix0 + (ptrdiff_t) j;
+                                bool inside = iy >= 0 && iy < (ptrdiff_t) m_inH && ix >= 0 && ix < (ptrdiff_t) m_inW;
+                                d[i * alpha + j] = inside ? channel[iy * (ptrdiff_t) m_inW + ix] : 0;
+                            }
+                        }
+                        Sandwich(m_winogradBT.data(), alpha, alpha, d, v);
+                        size_t t = n * tilesPerSample + ty * tilesW + tx;
+                        for (size_t xi = 0; xi < alpha2; xi++)
+                            ws[inputOffset + xi * numTiles * inC + c * numTiles + t] = v[xi];
+                    }
+                }
+            }
+
+            // 3. Multiply and transform back.
+            for (size_t xi = 0; xi < alpha2; xi++)
+            {
+                auto u = workspace.ColumnSlice(xi * mapCount * inC, mapCount * inC);
+                u.Reshape(mapCount, inC);
+                auto v = workspace.ColumnSlice(inputOffset + xi * numTiles * inC, numTiles * inC);
+                v.Reshape(numTiles, inC);
+                auto product = workspace.ColumnSlice(productOffset + xi * numTiles * mapCount, numTiles * mapCount);
+                product.Reshape(numTiles, mapCount);
+                Mat::Multiply(v, false, u, true, product);
+            }
+#pragma omp parallel for
+            for (long long nk = 0; nk < (long long) (curBatchSize * mapCount); nk++)
+            {
+                size_t n = (size_t) nk / mapCount;
+                size_t k = (size_t) nk % mapCount;
+                ElemType* map = outData + (start + n) * outRows + k * m_outH * m_outW;
+                ElemType p[MaxAlpha * MaxAlpha];
+                ElemType y[MaxAlpha * MaxAlpha];
+                for (size_t ty = 0; ty < tilesH; ty++)
+                {
+                    for (size_t tx = 0; tx < tilesW; tx++)
+                    {
+                        size_t t = n * tilesPerSample + ty * tilesW + tx;
+                        for (size_t xi = 0; xi < alpha2; xi++)
+                            p[xi] = ws[productOffset + xi * numTiles * mapCount + k * numTiles + t];
+                        Sandwich(m_winogradAT.data(), m, alpha, p, y);
+                        size_t rows = min(m, m_outH - ty * m);
+                        size_t cols = min(m, m_outW - tx * m);
+                        for (size_t i = 0; i < rows; i++)
+                            for (size_t j = 0; j < cols; j++)
+                                map[(ty * m + i) * m_outW + tx * m + j] = y[i * m + j];
+                    }
+                }
+            }
+        }
+    }
+
+    // y = L x L^T, where L is [rows x cols] and x is [cols x cols], all row-major.
+    static void Sandwich(const ElemType* L, size_t rows, size_t cols, const ElemType* x, ElemType* y)
+    {
+        ElemType lx[MaxAlpha * MaxAlpha];
+        for (size_t i = 0; i < rows; i++)
+        {
+            for (size_t j = 0; j < cols; j++)
+            {
+                ElemType sum = 0;
+                for (size_t l = 0; l < cols; l++)
+                    sum += L[i * cols + l] * x[l * cols + j];
+                lx[i * cols + j] = sum;
+            }
+        }
+        for (size_t i = 0; i < rows; i++)
+        {
+            for (size_t j = 0; j < rows; j++)
+            {
+                ElemType sum = 0;
+                for (size_t l = 0; l < cols; l++)
+                    sum += lx[i * cols + l] * L[j * cols + l];
+                y[i * rows + j] = sum;
+            }
+        }
+    }
+
+    // Offset of the first input cell touched by the kernel applied at output cell 0 along dimension 'dim'
+    // (negative if the input is padded), following the computation of the kernel centers in ConvolveGeometry.
+    static ptrdiff_t FirstInputOffset(const ConvolveGeometry& g, size_t dim)
+    {
+        int kernSize = (int)g.KernelShape()[dim];
+        int outPerMap = (int)(g.OutputShape()[dim] / g.GetMapCount(dim));
+        int cells = (outPerMap - 1) * (int)g.GetStride(dim) + 1;
+        int extra = (int)g.InputShape()[dim] - cells;
+        int lo = g.GetAutoPad(dim) ? 0 : (int)g.LowerPad()[g.LowerPad().size() == 1 ? 0 : dim];
+        int hi = g.GetAutoPad(dim) ? 0 : (int)g.UpperPad()[g.UpperPad().size() == 1 ? 0 : dim];
+        if (lo != 0 || hi != 0)
+            return -lo;
+        return extra / 2 - (kernSize - 1) / 2;
+    }
+
+public:
+    // 2D convolutions where the kernel spans all input channels. 1x1 kernels are left to the GEMM engine,
+    // where the unrolling is a plain copy.
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        if (!Base::IsSupported(deviceId, geometry))
+            return false;
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        const auto& outT = geometry->OutputShape();
+        return inT.GetRank() == 3 &&
+               kernT[2] == inT[2] &&
+               geometry->GetMapCount(0) == 1 && geometry->GetMapCount(1) == 1 && outT[2] == geometry->GetMapCount(2) &&
+               kernT[0] * kernT[1] > 1;
+    }
+
+private:
+    static const size_t MapsAtOnce = 4;
+    static const size_t MaxAlpha = 6;
+
+    // Transform matrices for F(2 x 2, 3 x 3) and F(4 x 4, 3 x 3), row-major.
+    static const ElemType s_winograd2BT[4 * 4];
+    static const ElemType s_winograd2G[4 * 3];
+    static const ElemType s_winograd2AT[2 * 4];
+    static const ElemType s_winograd4BT[6 * 6];
+    static const ElemType s_winograd4G[6 * 3];
+    static const ElemType s_winograd4AT[4 * 6];
+
+    size_t m_inW, m_inH, m_inC;
+    size_t m_outW, m_outH, m_mapCount;
+    size_t m_kernW, m_kernH;
+    size_t m_strideW, m_strideH;
+    ptrdiff_t m_offsetW, m_offsetH;
+
+    size_t m_winogradTileSize; // m in F(m x m, 3 x 3), or 0 to use the direct convolution
+    std::vector<ElemType> m_winogradBT;
+    std::vector<ElemType> m_winogradG;
+    std::vector<ElemType> m_winogradAT;
+};
+
+template <class ElemType>
+const ElemType DirectConvolutionEngine<ElemType>::s_winograd2BT[4 * 4] =
+{
+    1,  0, -1,  0,
+    0,  1,  1,  0,
+    0, -1,  1,  0,
+    0,  1,  0, -1
+};
+template <class ElemType>
+const ElemType DirectConvolutionEngine<ElemType>::s_winograd2G[4 * 3] =
+{
+    1,    0,     0,
+    0.5,  0.5,   0.5,
+    0.5, -0.5,   0.5,
+    0,    0,     1
+};
+template <class ElemType>
+const ElemType DirectConvolutionEngine<ElemType>::s_winograd2AT[2 * 4] =
+{
+    1, 1,  1,  0,
+    0, 1, -1, -1
+};
+template <class ElemType>
+const ElemType DirectConvolutionEngine<ElemType>::s_winograd4BT[6 * 6] =
+{
+    4,  0, -5,  0, 1, 0,
+    0, -4, -4,  1, 1, 0,
+    0,  4, -4, -1, 1, 0,
+    0, -2, -1,  2, 1, 0,
+    0,  2, -1, -2, 1, 0,
+    0,  4,  0, -5, 0, 1
+};
+template <class ElemType>
+const ElemType DirectConvolutionEngine<ElemType>::s_winograd4G[6 * 3] =
+{
+    (ElemType) 1 / 4,  0,                 0,
+    (ElemType) -1 / 6, (ElemType) -1 / 6, (ElemType) -1 / 6,
+    (ElemType) -1 / 6, (ElemType) 1 / 6,  (ElemType) -1 / 6,
+    (ElemType) 1 / 24, (ElemType) 1 / 12, (ElemType) 1 / 6,
+    (ElemType) 1 / 24, (ElemType) -1 / 12, (ElemType) 1 / 6,
+    0,                 0,                 1
+};
+template <class ElemType>
+const ElemType DirectConvolutionEngine<ElemType>::s_winograd4AT[4 * 6] =
+{
+    1, 1,  1, 1,  1, 0,
+    0, 1, -1, 2, -2, 0,
+    0, 1,  1, 4,  4, 0,
+    0, 1, -1, 8, -8, 1
+};
+
+//------------------------------------------------------------------
+// Autotuning of CPU convolution engines.
+//------------------------------------------------------------------
+
+static bool s_autotuningEnabled = false;
+static std::wstring s_autotuningCacheFilePath;
+static bool s_autotuningCacheLoaded = false;
+static std::map<std::string, std::string> s_autotuningChoices;
+static std::mutex s_autotuningMutex;
+
+void ConvolutionEngineAutotuning::Enable(bool enable, const std::wstring& cacheFilePath)
+{
+    std::lock_guard<std::mutex> lock(s_autotuningMutex);
+    s_autotuningEnabled = enable;
+    // (re)load the cache file on the next lookup
+    s_autotuningCacheFilePath = cacheFilePath;
+    s_autotuningCacheLoaded = false;
+    s_autotuningChoices.clear();
+}
+
+bool ConvolutionEngineAutotuning::IsEnabled()
+{
+    return s_autotuningEnabled;
+}
+
+// Cache file format: one "key<TAB>choice" line per choice. Later lines override earlier ones.
+// Lines without a tab are skipped; choices that do not parse are rejected by the engine, which then times again.
+bool ConvolutionEngineAutotuning::Lookup(const std::string& key, std::string& choice)
+{
+    std::lock_guard<std::mutex> lock(s_autotuningMutex);
+    if (!s_autotuningCacheLoaded)
+    {
+        s_autotuningCacheLoaded = true;
+        if (!s_autotuningCacheFilePath.empty() && fexists(s_autotuningCacheFilePath.c_str()))
+        {
+            // An unreadable cache is not worth stopping for either.
+            FILE* f = nullptr;
+            try
+            {
+                f = fopenOrDie(s_autotuningCacheFilePath, L"rb");
+                std::string line;
+                std::vector<char> buf;
+                while (!feof(f))
+                {
+                    fgetline(f, line, buf);
+                    size_t tab = line.rfind('\t');
+                    if (tab != std::string::npos)
+                        s_autotuningChoices[line.substr(0, tab)] = line.substr(tab + 1);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                fprintf(stderr, "WARNING: Ignoring the convolution autotuning cache %ls: %s\n", s_autotuningCacheFilePath.c_str(), e.what());
+                s_autotuningChoices.clear();
+            }
+            if (f)
+                fclose(f);
+        }
+    }
+    auto iter = s_autotuningChoices.find(key);
+    if (iter == s_autotuningChoices.end())
+        return false;
+    choice = iter->second;
+    return true;
+}
+
+void ConvolutionEngineAutotuning::Store(const std::string& key, const std::string& choice)
+{
+    std::lock_guard<std::mutex> lock(s_autotuningMutex);
+    s_autotuningChoices[key] = choice;
+    if (s_autotuningCacheFilePath.empty())
+        return;
+    // Failing to update the cache is not worth stopping for.
+    try
+    {
+        FILE* f = fopenOrDie(s_autotuningCacheFilePath, L"ab");
+        fprintf(f, "%s\t%s\n", key.c_str(), choice.c_str());
+        fcloseOrDie(f);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Could not update the convolution autotuning cache %ls: %s\n", s_autotuningCacheFilePath.c_str(), e.what());
+    }
+}
+
+std::string ConvolutionEngineAutotuning::MachineKey()
+{
+    char brand[49] = {};
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned int)info[0] >= 0x80000004)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            __cpuid(info, 0x80000002 + i);
+            memcpy(brand + 16 * i, info, 16);
+        }
+    }
+#else
+    unsigned int info[4];
+    if (__get_cpuid(0x80000000, &info[0], &info[1], &info[2], &info[3]) && info[0] >= 0x80000004)
+    {
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            __get_cpuid(0x80000002 + i, &info[0], &info[1], &info[2], &info[3]);
+            memcpy(brand + 16 * i, info, 16);
+        }
+    }
+#endif
+    std::string model = brand;
+    model.erase(0, model.find_first_not_of(' '));
+    if (model.empty())
+        model = "unknown CPU";
+    return model + " x " + std::to_string(omp_get_max_threads());
+}
+
+// Wraps all CPU engines that support a geometry, and for each operation and minibatch size uses the one
+// that was fastest when first tried, together with the best value of maxTempMemSizeInSamples
+// (which bounds the workspace and determines how the minibatch is tiled).
+// The engines are timed on a scratch output, since the backward operations accumulate into theirs.
+template <class ElemType>
+class AutotunedConvolutionEngine : public ConvolutionEngine<ElemType>
+{
+public:
+    using Base = ConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+    using EnginePtr = std::unique_ptr<ConvolutionEngine<ElemType>>;
+
+public:
+    AutotunedConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
+                               std::vector<ConvolutionEngineKind>&& kinds, std::vector<EnginePtr>&& engines, const std::wstring& logPrefix)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind), m_kinds(std::move(kinds)), m_engines(std::move(engines)), m_logPrefix(logPrefix)
+    {
+        assert(m_kinds.size() == m_engines.size() && !m_engines.empty());
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+    using Base::m_maxTempMemSizeInSamples;
+
+    enum class Operation
+    {
+        Forward,
+        BackwardData,
+        BackwardKernel
+    };
+
+    struct Choice
+    {
+        size_t engineIndex;
+        size_t maxTempMemSizeInSamples;
+    };
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            LogicError("Autotuned convolution engine supports only CHW/cudnn layout.");
+        if (m_deviceId >= 0)
+            LogicError("Autotuned convolution engine supports only CPU device.");
+    }
+
+    void EnsureConvolutionInitialized() override
+    {
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        auto& engine = Select(Operation::Forward, in.GetNumCols(), out, [&](ConvolutionEngine<ElemType>& eng, Mat& result)
+        {
+            eng.Forward(in, kernel, result, workspace);
+        });
+        engine.Forward(in, kernel, out, workspace);
+    }
+
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, Mat& workspace) override
+    {
+        auto& engine = Select(Operation::BackwardData, srcGrad.GetNumCols(), grad, [&](ConvolutionEngine<ElemType>& eng, Mat& result)
+        {
+            eng.BackwardData(srcGrad, kernel, result, workspace);
+        });
+        engine.BackwardData(srcGrad, kernel, grad, workspace);
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool allowReuse, Mat& workspace) override
+    {
+        auto& engine = Select(Operation::BackwardKernel, srcGrad.GetNumCols(), kernelGrad, [&](ConvolutionEngine<ElemType>& eng, Mat& result)
+        {
+            eng.BackwardKernel(srcGrad, in, result, allowReuse, workspace);
+        });
+        engine.BackwardKernel(srcGrad, in, kernelGrad, allowReuse, workspace);
+    }
+
+    // Create() only uses this engine for convolutions.
+    void EnsurePoolingInitialized() override
+    {
+        LogicError("Autotuned convolution engine does not support pooling.");
+    }
+
+    void ForwardPoolingCore(const Mat&, Mat&) override
+    {
+        LogicError("Autotuned convolution engine does not support pooling.");
+    }
+
+    void BackwardPoolingCore(const Mat&, const Mat&, const Mat&, Mat&) override
+    {
+        LogicError("Autotuned convolution engine does not support pooling.");
+    }
+
+    void MaxUnpoolingCore(const Mat&, const Mat&, Mat&) override
+    {
+        LogicError("Autotuned convolution engine does not support pooling.");
+    }
+
+    // Returns the engine to use for 'operation' with the given minibatch size, set up with the chosen workspace size.
+    // 'run' runs an engine with its output going to the given matrix, which has the dimensions of 'result'.
+    template <class Runner>
+    ConvolutionEngine<ElemType>& Select(Operation operation, size_t batchSize, const Mat& result, const Runner& run)
+    {
+        auto key = std::make_pair((int)operation, batchSize);
+        auto iter = m_choices.find(key);
+        if (iter == m_choices.end())
+            iter = m_choices.insert(std::make_pair(key, Autotune(operation, batchSize, result, run))).first;
+        const auto& choice = iter->second;
+        auto& engine = *m_engines[choice.engineIndex];
+        engine.SetmMaxTempMemSizeInSamples(choice.maxTempMemSizeInSamples);
+        return engine;
+    }
+
+    template <class Runner>
+    Choice Autotune(Operation operation, size_t batchSize, const Mat& result, const Runner& run)
+    {
+        static const char* operationNames[] = { "forward", "backward data", "backward kernel" };
+        const char* operationName = operationNames[(int)operation];
+        std::string key = ConvolutionEngineAutotuning::MachineKey() + "|" + (sizeof(ElemType) == sizeof(float) ? "float" : "double") +
+                          "|" + operationName + "|" + std::to_string(batchSize) + "|" + std::to_string(m_maxTempMemSizeInSamples) + "|" + (std::string)*m_geometry;
+
+        size_t limit = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+
+        // A previous process may already have measured this. Choices of engines we do not have, or outside
+        // the workspace limit, come from a damaged cache and are ignored.
+        std::string cached;
+        if (ConvolutionEngineAutotuning::Lookup(key, cached))
+        {
+            int kind = 0;
+            size_t maxTemp = 0;
+            std::istringstream str(cached);
+            if (str >> kind >> maxTemp && maxTemp >= 1 && maxTemp <= limit)
+            {
+                auto kindIter = std::find(m_kinds.begin(), m_kinds.end(), (ConvolutionEngineKind)kind);
+                if (kindIter != m_kinds.end())
+                    return Choice{ (size_t)(kindIter - m_kinds.begin()), maxTemp };
+            }
+        }
+
+        Mat scratch(result.GetNumRows(), result.GetNumCols(), result.GetDeviceId());
+        Choice best = { 0, limit };
+        double bestTime = std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < m_engines.size(); i++)
+        {
+            // Tiling the minibatch only matters to the engines that use a workspace.
+            std::vector<size_t> tileSizes(1, limit);
+            if (m_kinds[i] != ConvolutionEngineKind::Reference)
+            {
+                for (size_t tileSize = 1; tileSize < limit; tileSize *= 4)
+                    tileSizes.push_back(tileSize);
+            }
+            for (size_t tileSize : tileSizes)
+            {
+                m_engines[i]->SetmMaxTempMemSizeInSamples(tileSize);
+                scratch.SetValue(0);
+                Timer timer;
+                try
+                {
+                    run(*m_engines[i], scratch); // warm-up, also sizes the workspace
+                    timer.Start();
+                    for (size_t r = 0; r < TimedRuns; r++)
+                        run(*m_engines[i], scratch);
+                    timer.Stop();
+                }
+                catch (const std::exception&)
+                {
+                    // This engine cannot do this operation for the geometry (e.g. GEMM backward data for some 3D convolutions).
+                    break;
+                }
+                double time = timer.ElapsedSeconds() / TimedRuns;
+                if (time < bestTime)
+                {
+                    bestTime = time;
+                    best = Choice{ i, tileSize };
+                }
+            }
+        }
+        if (bestTime == std::numeric_limits<double>::infinity())
+            RuntimeError("Autotuned convolution engine: No engine supports the %s operation for geometry: %s.", operationName, ((std::string)*m_geometry).c_str());
+
+        ConvolutionEngineKind bestKind = m_kinds[best.engineIndex];
+        const char* engineName = bestKind == ConvolutionEngineKind::Direct ? "direct" : bestKind == ConvolutionEngineKind::Gemm ? "GEMM" : "reference";
+        fprintf(stderr, "%lsautotuned convolution %s for minibatch size %d: using %s engine with maxTempMemSizeInSamples %d (%.3f ms).\n",
+                m_logPrefix.c_str(), operationName, (int)batchSize, engineName, (int)best.maxTempMemSizeInSamples, bestTime * 1000);
+        ConvolutionEngineAutotuning::Store(key, std::to_string((int)bestKind) + " " + std::to_string(best.maxTempMemSizeInSamples));
+        return best;
+    }
+
+private:
+    static const size_t TimedRuns = 3;
+
+    std::vector<ConvolutionEngineKind> m_kinds;
+    std::vector<EnginePtr> m_engines;
+    std::wstring m_logPrefix;
+    std::map<std::pair<int, size_t>, Choice> m_choices; // (operation, minibatch size) -> choice
+};
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                                  ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
@@ -870,6 +1606,34 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return std::make_unique<LegacyConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
     }
 
+    // Time the CPU engines on first use if asked to.
+    if (ConvolutionEngineAutotuning::IsEnabled() && deviceId < 0 && poolKind == PoolKind::None)
+    {
+        std::vector<ConvolutionEngineKind> kinds;
+        std::vector<std::unique_ptr<ConvolutionEngine<ElemType>>> engines;
+        if (isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+        {
+            kinds.push_back(ConvolutionEngineKind::Direct);
+            engines.push_back(std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind));
+        }
+        if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+        {
+            kinds.push_back(ConvolutionEngineKind::Gemm);
+            engines.push_back(std::make_unique<GemmConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind));
+        }
+        if (isEnabled(ConvolutionEngineKind::Reference))
+        {
+            kinds.push_back(ConvolutionEngineKind::Reference);
+            engines.push_back(std::make_unique<ReferenceConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind));
+        }
+        if (engines.size() > 1)
+        {
+            fprintf(stderr, "\n%lsusing autotuned convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+            return std::make_unique<AutotunedConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind,
+                                                                          std::move(kinds), std::move(engines), logPrefix);
+        }
+    }
+
     // Check if we can use cuDNN engine. Do not need to validate tensors as ConvolveGeometry has already done that.
     if (isEnabled(ConvolutionEngineKind::CuDnn) &&
         CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId, geometry, poolKind))
@@ -878,6 +1642,12 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
     }
 
+    if (isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+    {
+        fprintf(stderr, "\n%lsusing direct convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+        return std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    }
+
     if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
     {
         fprintf(stderr, "\n%lsusing GEMM convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
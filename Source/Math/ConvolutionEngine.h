@@ -22,8 +22,9 @@ enum class ConvolutionEngineKind
     CuDnn     = 1 << 1, // cuDNN, works only for 2D/3D convos with full sharing.
     Legacy    = 1 << 2, // Legacy, for backwards compatibility. REVIEW alexeyk: implement sparse version and remove Legacy altogether.
     Gemm      = 1 << 3, // Uses convolution unrolling+GEMM technique. Works only for convos with full sharing.
+    Direct    = 1 << 4, // CPU-only Winograd (3x3 kernels) and direct convolution without unrolling. Works only for 2D convos with full sharing.
 
-    All       = Reference | CuDnn | Legacy | Gemm
+    All       = Reference | CuDnn | Legacy | Gemm | Direct
 };
 
 enum class PoolKind
@@ -107,6 +108,29 @@ protected:
 
 #pragma warning(pop)
 
+//-------------------------------------------------------------
+// Process-wide settings for autotuning of CPU convolution engines.
+// When enabled, ConvolutionEngine::Create() returns an engine that, for each operation and minibatch size,
+// times all enabled CPU engines that support the geometry (with several workspace sizes) on first use and
+// then sticks to the fastest. The choices are also stored in a cache file (if one is given), keyed by
+// CPU model, thread count, element type, geometry and minibatch size, so later processes skip the timing.
+//-------------------------------------------------------------
+class MATH_API ConvolutionEngineAutotuning
+{
+public:
+    // Also drops the choices made so far; the cache file is read again on the next lookup.
+    static void Enable(bool enable, const std::wstring& cacheFilePath = L"");
+    static bool IsEnabled();
+
+    // Looks up a previous choice for 'key', loading the cache file on first use.
+    static bool Lookup(const std::string& key, std::string& choice);
+    // Records a choice for 'key' and appends it to the cache file.
+    static void Store(const std::string& key, const std::string& choice);
+
+    // Identifies the machine for the cache: CPU brand string and number of OpenMP threads.
+    static std::string MachineKey();
+};
+
 static inline PoolKind PoolKindFrom(const wstring& s)
 {
     if (s.empty() || AreEqualIgnoreCase(s, L"none"))
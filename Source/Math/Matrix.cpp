@@ -4454,6 +4454,18 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
     }
 }
 
+// c = alpha * a * b + beta * c, where 'a' has been prepacked for products with few columns (see CPUPackedMatrix)
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUPackedMatrix<ElemType>& a, const Matrix<ElemType>& b, ElemType beta, Matrix<ElemType>& c)
+{
+    if (b.GetDeviceId() != CPUDEVICE || c.GetDeviceId() != CPUDEVICE || b.GetMatrixType() != MatrixType::DENSE)
+        InvalidArgument("MultiplyAndWeightedAdd: A prepacked matrix can only be multiplied with a dense CPU matrix.");
+
+    c.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    CPUMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, a, *b.m_CPUMatrix, beta, *c.m_CPUMatrix);
+    c.SetDataLocation(CPU, DENSE);
+}
+
 template <class ElemType>
 /*static*/ void Matrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType beta, Matrix<ElemType>& c)
 {
@@ -43,6 +43,7 @@ template <class ElemType> class CPUMatrix;
 template <class ElemType> class GPUSparseMatrix;
 template <class ElemType> class CPUSparseMatrix;
 template <class ElemType> class DeviceBoundNumber;
+template <class ElemType> class CPUPackedMatrix;
 
 // <ElemType>-agnostic base class
 struct /*interface*/ MATH_API MatrixBase
@@ -519,6 +520,7 @@ public:
     static void SVD(const Matrix<ElemType>& A, Matrix<ElemType>& SIGMA, Matrix<ElemType>& U, Matrix<ElemType>& VT, Matrix<ElemType>& W);
 
     static void MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c); // SGEMM
+    static void MultiplyAndWeightedAdd(ElemType alpha, const CPUPackedMatrix<ElemType>& a, const Matrix<ElemType>& b, ElemType beta, Matrix<ElemType>& c); // prepacked a; CPU only
     static void MultiplyAndAdd(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
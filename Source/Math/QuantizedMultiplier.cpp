@@ -0,0 +1,192 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+#include "stdafx.h"
+#include "QuantizedMultiplier.h"
+#include "BlockMultiplier.h"
+#include <cmath>
+#include <limits>
+#include <omp.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef SUPPORT_AVX2
+typedef BlockMultiplier<BlockHandlerAVX> Multiplier;
+#else
+typedef BlockMultiplier<BlockHandlerSSE> Multiplier;
+#endif
+
+template <class ElemType>
+class QuantizedMultiplier<ElemType>::Kernel
+{
+public:
+    Kernel(int numThreads)
+        : m_multiplier(numThreads), m_preparedWeights(nullptr)
+    {
+    }
+    ~Kernel()
+    {
+        if (m_preparedWeights)
+            Multiplier::FreeMatrix(m_preparedWeights);
+    }
+
+    Multiplier m_multiplier;
+    int16_t* m_preparedWeights; // W^T in BlockMultiplier's block order
+};
+
+// largest quantized magnitude such that a sum of 'innerDim' products cannot overflow an int32
+static int MaxQuantizationRange(size_t numBits, size_t innerDim)
+{
+    double range = (double) ((1 << (numBits - 1)) - 1);
+    double overflowBound = floor(sqrt((double) std::numeric_limits<int32_t>::max() / (double) max(innerDim, (size_t) 1)));
+    return (int) min(range, overflowBound);
+}
+
+template <class ElemType>
+static inline int16_t Quantize(ElemType value, ElemType scale)
+{
+    return (int16_t) floor(value * scale + (ElemType) 0.5);
+}
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::QuantizedMultiplier(const Matrix<ElemType>& weights, size_t numBits)
+    : m_outputDim(weights.GetNumRows()), m_inputDim(weights.GetNumCols()), m_numBits(numBits)
+{
+    if (weights.GetDeviceId() != CPUDEVICE || weights.GetMatrixType() != DENSE)
+        InvalidArgument("QuantizedMultiplier: The weights must be a dense CPU matrix.");
+    if (numBits < 2 || numBits > 16)
+        InvalidArgument("QuantizedMultiplier: numBits must be in the range 2..16.");
+    if (m_outputDim == 0 || m_inputDim == 0)
+        InvalidArgument("QuantizedMultiplier: The weights must not be empty.");
+
+    m_range = MaxQuantizationRange(numBits, m_inputDim);
+    if (m_range < 1)
+        InvalidArgument("QuantizedMultiplier: The inner dimension %d is too large for integer accumulation.", (int) m_inputDim);
+
+    // BlockMultiplier computes row-major C = A B. We let A be X^T (which is X in column-major order)
+    // and B be W^T (which is W in column-major order), so that C is (W X)^T, i.e. W X in column-major order.
+    // Each column of B is a row of W, and gets its own scale.
+    const ElemType* w = weights.Data();
+    vector<ElemType> rowScales(m_outputDim);
+    m_inverseRowScales.assign(m_outputDim, 0);
+    for (size_t i = 0; i < m_outputDim; i++)
+    {
+        ElemType maxAbs = 0;
+        for (size_t j = 0; j < m_inputDim; j++)
+            maxAbs = max(maxAbs, (ElemType) fabs(w[j * m_outputDim + i]));
+        if (!std::isfinite(maxAbs))
+            InvalidArgument("QuantizedMultiplier: The weights contain non-finite values.");
+        rowScales[i] = maxAbs > 0 ? m_range / maxAbs : 0;
+        m_inverseRowScales[i] = maxAbs > 0 ? maxAbs / m_range : 0;
+    }
+
+    int16_t* quantizedWeights = Multiplier::CreateMatrixB((int) m_inputDim, (int) m_outputDim);
+    for (size_t j = 0; j < m_inputDim; j++)
+        for (size_t i = 0; i < m_outputDim; i++)
+            quantizedWeights[j * m_outputDim + i] = Quantize(w[j * m_outputDim + i], rowScales[i]);
+
+    m_kernel.reset(new Kernel(omp_get_max_threads()));
+    m_kernel->m_preparedWeights = m_kernel->m_multiplier.PrepareB(quantizedWeights, (int) m_inputDim, (int) m_outputDim);
+    Multiplier::FreeMatrix(quantizedWeights);
+}
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::~QuantizedMultiplier()
+{
+}
+
+template <class ElemType>
+void QuantizedMultiplier<ElemType>::Multiply(const Matrix<ElemType>& data, Matrix<ElemType>& result) const
+{
+    if (data.GetDeviceId() != CPUDEVICE || data.GetMatrixType() != DENSE || result.GetDeviceId() != CPUDEVICE || result.GetMatrixType() != DENSE)
+        InvalidArgument("QuantizedMultiplier::Multiply: Only dense CPU matrices are supported.");
+    if (data.GetNumRows() != m_inputDim)
+        InvalidArgument("QuantizedMultiplier::Multiply: The data has %d rows, but the weights have %d columns.", (int) data.GetNumRows(), (int) m_inputDim);
+    size_t numCols = data.GetNumCols();
+    if (result.GetNumRows() != m_outputDim || result.GetNumCols() != numCols)
+        InvalidArgument("QuantizedMultiplier::Multiply: The result must be [%d x %d].", (int) m_outputDim, (int) numCols);
+    if (numCols == 0)
+        return;
+
+    // BlockMultiplier uses its four-row kernels only if the number of rows of A (our columns) is a multiple of 4
+    size_t paddedCols = numCols < 4 ? numCols : (numCols + 3) / 4 * 4;
+
+    // quantize the data, one scale per column
+    const ElemType* x = data.Data();
+    int16_t* quantizedData = Multiplier::CreateMatrixA((int) paddedCols, (int) m_inputDim); // zero-initialized, which covers the padding
+    vector<ElemType> inverseColumnScales(numCols);
+    vector<char> isFinite(numCols);
+#pragma omp parallel for
+    for (long long jj = 0; jj < (long long) numCols; jj++)
+    {
+        size_t j = (size_t) jj;
+        const ElemType* column = x + j * m_inputDim;
+        ElemType maxAbs = 0;
+        for (size_t k = 0; k < m_inputDim; k++)
+            maxAbs = max(maxAbs, (ElemType) fabs(column[k]));
+        isFinite[j] = std::isfinite(maxAbs);
+        if (!isFinite[j] || maxAbs == 0) // leave the column at 0
+            continue;
+        ElemType scale = m_range / maxAbs;
+        inverseColumnScales[j] = maxAbs / m_range;
+        int16_t* quantizedColumn = quantizedData + j * m_inputDim;
+        for (size_t k = 0; k < m_inputDim; k++)
+            quantizedColumn[k] = Quantize(column[k], scale);
+    }
+
+    int32_t* product = Multiplier::CreateMatrixC((int) paddedCols, (int) m_outputDim);
+    m_kernel->m_multiplier.MultiplyMatrices(quantizedData, (int) paddedCols, (int) m_inputDim, m_kernel->m_preparedWeights, (int) m_outputDim, product);
+
+    // scale back
+    ElemType* r = result.Data();
+#pragma omp parallel for
+    for (long long jj = 0; jj < (long long) numCols; jj++)
+    {
+        size_t j = (size_t) jj;
+        ElemType* resultColumn = r + j * m_outputDim;
+        const int32_t* productColumn = product + j * m_outputDim;
+        if (!isFinite[j])
+        {
+            for (size_t i = 0; i < m_outputDim; i++)
+                resultColumn[i] = std::numeric_limits<ElemType>::quiet_NaN();
+            continue;
+        }
+        for (size_t i = 0; i < m_outputDim; i++)
+            resultColumn[i] = productColumn[i] * inverseColumnScales[j] * m_inverseRowScales[i];
+    }
+
+    Multiplier::FreeMatrix(product);
+    Multiplier::FreeMatrix(quantizedData);
+}
+
+template <class ElemType>
+/*static*/ double QuantizedMultiplier<ElemType>::RelativeError(const Matrix<ElemType>& approximation, const Matrix<ElemType>& reference)
+{
+    if (approximation.GetNumRows() != reference.GetNumRows() || approximation.GetNumCols() != reference.GetNumCols())
+        InvalidArgument("QuantizedMultiplier::RelativeError: The matrices must have the same dimensions.");
+    if (approximation.GetDeviceId() != CPUDEVICE || reference.GetDeviceId() != CPUDEVICE)
+        InvalidArgument("QuantizedMultiplier::RelativeError: Only CPU matrices are supported.");
+
+    const ElemType* a = approximation.Data();
+    const ElemType* b = reference.Data();
+    size_t numElements = reference.GetNumElements();
+    double errorSquared = 0;
+    double normSquared = 0;
+    for (size_t i = 0; i < numElements; i++)
+    {
+        if (!std::isfinite(b[i]))
+            continue;
+        double diff = (double) a[i] - (double) b[i];
+        errorSquared += diff * diff;
+        normSquared += (double) b[i] * (double) b[i];
+    }
+    if (normSquared == 0)
+        return errorSquared == 0 ? 0 : std::numeric_limits<double>::infinity();
+    return sqrt(errorSquared / normSquared);
+}
+
+template class QuantizedMultiplier<float>;
+template class QuantizedMultiplier<double>;
+
+}}}
@@ -0,0 +1,64 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+#pragma once
+
+#include "Matrix.h"
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// QuantizedMultiplier -- computes W * X for a fixed weight matrix W in integer arithmetic
+// This is meant for inference on the CPU, where the weights never change.
+// W is quantized once, with one scale per row, and prepacked for the BlockMultiplier kernel.
+// Each call quantizes X with one scale per column, multiplies into 32-bit integers, and rescales.
+// Values are quantized to 'numBits' (signed), which is reduced if needed so that the 32-bit
+// accumulators cannot overflow for the given inner dimension.
+// Columns of X that contain non-finite values yield NaN columns.
+template <class ElemType>
+class MATH_API QuantizedMultiplier
+{
+public:
+    // weights: dense CPU matrix [outputDim x inputDim]
+    QuantizedMultiplier(const Matrix<ElemType>& weights, size_t numBits);
+    ~QuantizedMultiplier();
+
+    QuantizedMultiplier(const QuantizedMultiplier&) = delete;
+    QuantizedMultiplier& operator=(const QuantizedMultiplier&) = delete;
+
+    // result = W * data, where data is a dense CPU matrix [inputDim x N] and result is [outputDim x N]
+    // 'result' may be a column slice, so it is not resized; it must have the right dimensions.
+    void Multiply(const Matrix<ElemType>& data, Matrix<ElemType>& result) const;
+
+    size_t GetOutputDim() const { return m_outputDim; }
+    size_t GetInputDim() const { return m_inputDim; }
+    size_t GetNumBits() const { return m_numBits; }
+
+    // relative Frobenius-norm error of 'approximation' w.r.t. 'reference', ignoring non-finite entries of 'reference'
+    static double RelativeError(const Matrix<ElemType>& approximation, const Matrix<ElemType>& reference);
+
+private:
+    size_t m_outputDim;
+    size_t m_inputDim;
+    size_t m_numBits;
+    int m_range;                              // quantized values are in [-m_range, m_range]
+    std::vector<ElemType> m_inverseRowScales; // to map the integer products of each row back
+    // the BlockMultiplier and the weights prepared for it; defined in the .cpp, since its block handler
+    // depends on the instruction set that file is compiled for
+    class Kernel;
+    std::unique_ptr<Kernel> m_kernel;
+};
+
+}}}
@@ -0,0 +1,264 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+#include "BinaryChunkDeserializer.h"
+#include "ElementTypeUtils.h"
+#include "StringUtil.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// A chunk mapped into memory. Sequence data points into the mapping, which
+// stays alive until the chunk and all sequences that refer to it are released.
+class BinaryChunkDeserializer::BinaryChunk : public Chunk, public std::enable_shared_from_this<BinaryChunk>
+{
+public:
+    BinaryChunk(BinaryChunkDeserializer* parent, MappedRegionPtr region, size_t numberOfSequences) :
+        m_parent(parent), m_region(region), m_numberOfSequences(numberOfSequences)
+    {
+        const uint64_t* streamOffsets = reinterpret_cast<const uint64_t*>(m_region->Data());
+        for (size_t i = 0; i < m_parent->m_streams.size(); ++i)
+        {
+            if (streamOffsets[i] >= m_region->Size())
+                RuntimeError("Corrupt chunk in binary corpus file %ls", m_parent->m_path.c_str());
+            m_streamBlocks.push_back(m_region->Data() + streamOffsets[i]);
+        }
+    }
+
+    // Gets the data of all streams of a sequence; 'sequenceId' is the index of the sequence in the chunk.
+    virtual void GetSequence(size_t sequenceId, vector<SequenceDataPtr>& result) override
+    {
+        assert(sequenceId < m_numberOfSequences);
+        const size_t n = m_numberOfSequences;
+        result.reserve(m_streamBlocks.size());
+        for (size_t i = 0; i < m_streamBlocks.size(); ++i)
+        {
+            const StreamDescription& stream = *m_parent->m_streams[i];
+            size_t elementSize = GetSizeByType(stream.m_elementType);
+            const char* block = m_streamBlocks[i];
+            const uint64_t* sampleOffsets = reinterpret_cast<const uint64_t*>(block);
+            uint64_t firstSample = sampleOffsets[sequenceId];
+            uint32_t numberOfSamples = (uint32_t)(sampleOffsets[sequenceId + 1] - firstSample);
+            size_t position = AlignUp((n + 1) * sizeof(uint64_t), BINARY_ARRAY_ALIGNMENT);
+
+            SequenceDataPtr data;
+            if (stream.m_storageType == StorageType::dense)
+            {
+                auto dense = make_shared<DenseSequenceData>();
+                dense->m_sampleLayout = stream.m_sampleLayout;
+                size_t sampleSize = stream.m_sampleLayout->GetNumElements() * elementSize;
+                dense->m_data = const_cast<char*>(block + position + firstSample * sampleSize);
+                data = dense;
+            }
+            else
+            {
+                const uint64_t* nnzOffsets = reinterpret_cast<const uint64_t*>(block + position);
+                uint64_t totalSamples = sampleOffsets[n];
+                uint64_t totalNnz = nnzOffsets[n];
+                position = AlignUp(position + (n + 1) * sizeof(uint64_t), BINARY_ARRAY_ALIGNMENT);
+                const IndexType* nnzCounts = reinterpret_cast<const IndexType*>(block + position);
+                position = AlignUp(position + totalSamples * sizeof(IndexType), BINARY_ARRAY_ALIGNMENT);
+                const IndexType* indices = reinterpret_cast<const IndexType*>(block + position);
+                position = AlignUp(position + totalNnz * sizeof(IndexType), BINARY_ARRAY_ALIGNMENT);
+
+                auto sparse = make_shared<SparseSequenceData>();
+                sparse->m_nnzCounts.assign(nnzCounts + firstSample, nnzCounts + firstSample + numberOfSamples);
+                sparse->m_totalNnzCount = (IndexType)(nnzOffsets[sequenceId + 1] - nnzOffsets[sequenceId]);
+                sparse->m_indices = const_cast<IndexType*>(indices + nnzOffsets[sequenceId]);
+                sparse->m_data = const_cast<char*>(block + position + nnzOffsets[sequenceId] * elementSize);
+                data = sparse;
+            }
+
+            data->m_numberOfSamples = numberOfSamples;
+            data->m_id = sequenceId;
+            data->m_chunk = shared_from_this();
+            result.push_back(data);
+        }
+    }
+
+private:
+    BinaryChunkDeserializer* m_parent;
+    MappedRegionPtr m_region;
+    size_t m_numberOfSequences;
+    vector<const char*> m_streamBlocks;
+};
+
+BinaryChunkDeserializer::BinaryChunkDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary) :
+    m_primary(primary)
+{
+    m_path = (wstring) config(L"file");
+    string precision = config.Find("precision", "float");
+
+    ReadIndex(corpus, precision);
+    m_file.reset(new MappedFile(m_path));
+
+    fprintf(stderr, "BinaryChunkDeserializer: %" PRIu64 " sequences in %" PRIu64 " chunks, %" PRIu64 " streams in %ls\n",
+        (uint64_t)m_numberOfSamples.size(), (uint64_t)m_chunks.size(), (uint64_t)m_streams.size(), m_path.c_str());
+}
+
+void BinaryChunkDeserializer::ReadIndex(CorpusDescriptorPtr corpus, const string& precision)
+{
+    FILE* f = fopenOrDie(m_path, L"rbS");
+    auto closeFile = MakeScopeExit([f]() { fclose(f); });
+
+    fcheckTag(f, "BCRP");
+    uint32_t version;
+    uint64_t indexOffset;
+    fget(f, version);
+    if (version != BINARY_FORMAT_VERSION)
+        RuntimeError("Binary corpus file %ls has version %d, expected version %d", m_path.c_str(), (int)version, (int)BINARY_FORMAT_VERSION);
+    fget(f, indexOffset);
+    fsetpos(f, indexOffset);
+    fcheckTag(f, "BIDX");
+
+    ElementType expectedType = AreEqualIgnoreCase(precision, "float") ? ElementType::tfloat : ElementType::tdouble;
+    uint32_t numberOfStreams;
+    fget(f, numberOfStreams);
+    for (uint32_t i = 0; i < numberOfStreams; ++i)
+    {
+        auto stream = make_shared<StreamDescription>();
+        stream->m_id = i;
+        stream->m_name = msra::strfun::utf16(fgetstring(f));
+        uint32_t storageType, elementType, rank;
+        fget(f, storageType);
+        fget(f, elementType);
+        fget(f, rank);
+        SmallVector<size_t> dims(rank);
+        for (uint32_t k = 0; k < rank; ++k)
+        {
+            uint64_t dim;
+            fget(f, dim);
+            dims[k] = (size_t)dim;
+        }
+        stream->m_storageType = (StorageType)storageType;
+        stream->m_elementType = (ElementType)elementType;
+        stream->m_sampleLayout = make_shared<TensorShape>(dims);
+
+        // The data is used as it is stored, so it has to be of the precision of the reader.
+        if (stream->m_elementType != expectedType)
+            InvalidArgument("Stream '%ls' in binary corpus file %ls was not written with precision '%s'.",
+                stream->m_name.c_str(), m_path.c_str(), precision.c_str());
+        m_streams.push_back(stream);
+    }
+
+    uint64_t numberOfChunks, numberOfSequences, keysSize;
+    fget(f, numberOfChunks);
+    freadOrDie(m_chunks, (size_t)numberOfChunks, f);
+    fget(f, numberOfSequences);
+    freadOrDie(m_numberOfSamples, (size_t)numberOfSequences, f);
+    vector<char> keys;
+    fget(f, keysSize);
+    freadOrDie(keys, (size_t)keysSize, f);
+    fcheckTag(f, "EIDX");
+
+    if (m_chunks.size() > CHUNKID_MAX)
+        RuntimeError("Maximum number of chunks exceeded in binary corpus file %ls", m_path.c_str());
+
+    m_firstSequence.reserve(m_chunks.size() + 1);
+    m_firstSequence.push_back(0);
+    for (const auto& chunk : m_chunks)
+        m_firstSequence.push_back(m_firstSequence.back() + (size_t)chunk.m_numberOfSequences);
+    if (m_firstSequence.back() != m_numberOfSamples.size())
+        RuntimeError("Corrupt index in binary corpus file %ls", m_path.c_str());
+
+    // Registering the keys, the keys are stored in the order of the sequences, each terminated by '\0'.
+    auto& stringRegistry = corpus->GetStringRegistry();
+    m_keys.resize(m_numberOfSamples.size());
+    m_numberOfIncludedSequences.assign(m_chunks.size(), 0);
+    m_numberOfIncludedSamples.assign(m_chunks.size(), 0);
+    const char* key = keys.data();
+    const char* keysEnd = keys.data() + keys.size();
+    for (size_t c = 0; c < m_chunks.size(); ++c)
+    {
+        for (size_t s = m_firstSequence[c]; s < m_firstSequence[c + 1]; ++s)
+        {
+            const char* end = find(key, keysEnd, '\0');
+            if (end == keysEnd)
+                RuntimeError("Corrupt sequence keys in binary corpus file %ls", m_path.c_str());
+
+            string k(key, end);
+            key = end + 1;
+            if (!corpus->IsIncluded(k))
+            {
+                m_keys[s] = SIZE_MAX;
+                continue;
+            }
+
+            m_keys[s] = stringRegistry[k];
+            m_numberOfIncludedSequences[c]++;
+            m_numberOfIncludedSamples[c] += m_numberOfSamples[s];
+            if (!m_primary)
+                m_keyToSequence[m_keys[s]] = s;
+        }
+    }
+}
+
+ChunkDescriptions BinaryChunkDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    result.reserve(m_chunks.size());
+    for (size_t c = 0; c < m_chunks.size(); ++c)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = (ChunkIdType)c;
+        cd->m_numberOfSequences = m_numberOfIncludedSequences[c];
+        cd->m_numberOfSamples = m_numberOfIncludedSamples[c];
+        result.push_back(cd);
+    }
+    return result;
+}
+
+void BinaryChunkDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    size_t first = m_firstSequence[chunkId];
+    result.reserve(m_numberOfIncludedSequences[chunkId]);
+    for (size_t s = first; s < m_firstSequence[chunkId + 1]; ++s)
+    {
+        if (m_keys[s] == SIZE_MAX)
+            continue;
+
+        SequenceDescription description;
+        description.m_id = s - first;
+        description.m_numberOfSamples = m_numberOfSamples[s];
+        description.m_chunkId = chunkId;
+        description.m_key.m_sequence = m_keys[s];
+        description.m_key.m_sample = 0;
+        result.push_back(description);
+    }
+}
+
+bool BinaryChunkDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& description)
+{
+    if (m_primary)
+        LogicError("Data deserializer should not be primary.");
+
+    auto it = m_keyToSequence.find(key.m_sequence);
+    if (it == m_keyToSequence.end())
+        return false;
+
+    size_t s = it->second;
+    size_t chunkId = upper_bound(m_firstSequence.begin(), m_firstSequence.end(), s) - m_firstSequence.begin() - 1;
+    description.m_id = s - m_firstSequence[chunkId];
+    description.m_numberOfSamples = m_numberOfSamples[s];
+    description.m_chunkId = (ChunkIdType)chunkId;
+    description.m_key.m_sequence = key.m_sequence;
+    description.m_key.m_sample = 0;
+    return true;
+}
+
+ChunkPtr BinaryChunkDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    const BinaryChunkRecord& chunk = m_chunks[chunkId];
+    auto region = m_file->Map(chunk.m_fileOffset, (size_t)chunk.m_byteSize);
+    return make_shared<BinaryChunk>(this, region, (size_t)chunk.m_numberOfSequences);
+}
+
+}}}
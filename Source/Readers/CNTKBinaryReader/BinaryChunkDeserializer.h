@@ -0,0 +1,60 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <unordered_map>
+#include "DataDeserializerBase.h"
+#include "Config.h"
+#include "CorpusDescriptor.h"
+#include "BinaryFormat.h"
+#include "MappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer of the binary corpus format written by BinaryCorpusWriter (see BinaryFormat.h).
+// The data is stored already in the layout the packers expect, so chunks are simply memory mapped
+// and the sequence data returned by the chunks points directly into the mapping, without any parsing or copying.
+class BinaryChunkDeserializer : public DataDeserializerBase
+{
+public:
+    BinaryChunkDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    // Gets information about chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Gets information about a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+
+    // Maps a chunk into memory.
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    // Gets sequence description by its key.
+    virtual bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& description) override;
+
+private:
+    class BinaryChunk;
+
+    // Reads the stream descriptions, the chunk table and the sequence keys from the index at the end of the file.
+    void ReadIndex(CorpusDescriptorPtr corpus, const std::string& precision);
+
+    std::wstring m_path;
+    std::unique_ptr<MappedFile> m_file;
+
+    std::vector<BinaryChunkRecord> m_chunks;
+    std::vector<size_t> m_firstSequence;           // index of the first sequence of each chunk, and the total number of sequences at the end
+    std::vector<uint32_t> m_numberOfSamples;       // number of samples of each sequence
+    std::vector<size_t> m_keys;                    // key of each sequence, SIZE_MAX for sequences excluded by the corpus descriptor
+    std::vector<size_t> m_numberOfIncludedSequences; // number of included sequences of each chunk
+    std::vector<size_t> m_numberOfIncludedSamples;   // number of samples in the included sequences of each chunk
+
+    // Key -> sequence index, only used by a deserializer that is not primary.
+    std::unordered_map<size_t, size_t> m_keyToSequence;
+    bool m_primary;
+
+    DISABLE_COPY_AND_MOVE(BinaryChunkDeserializer);
+};
+
+}}}
@@ -0,0 +1,279 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+#include "BinaryCorpusWriter.h"
+#include "ElementTypeUtils.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Offset of the index offset in the file header (after the tag and the version).
+static const size_t INDEX_OFFSET_POSITION = 8;
+
+// Writes 'size' bytes followed by zero padding up to the next multiple of BINARY_ARRAY_ALIGNMENT.
+static void WriteAligned(FILE* f, const void* data, size_t size)
+{
+    static const char zeros[BINARY_ARRAY_ALIGNMENT] = {};
+    if (size > 0)
+        fwriteOrDie(data, 1, size, f);
+    size_t padding = AlignUp(size, BINARY_ARRAY_ALIGNMENT) - size;
+    if (padding > 0)
+        fwriteOrDie(zeros, 1, padding, f);
+}
+
+static void PadTo(FILE* f, uint64_t position)
+{
+    uint64_t current = fgetpos(f);
+    if (current < position)
+    {
+        vector<char> zeros((size_t)(position - current), 0);
+        fwriteOrDie(zeros, f);
+    }
+}
+
+BinaryCorpusWriter::BinaryCorpusWriter(const wstring& path, const vector<StreamDescriptionPtr>& streams, size_t chunkSizeInBytes) :
+    m_path(path),
+    m_file(nullptr),
+    m_chunkSizeInBytes(chunkSizeInBytes),
+    m_buffers(streams.size()),
+    m_firstBufferedSequence(0)
+{
+    if (streams.empty())
+        InvalidArgument("BinaryCorpusWriter: there are no streams to write.");
+
+    for (const auto& s : streams)
+    {
+        if (s->m_elementType != ElementType::tfloat && s->m_elementType != ElementType::tdouble)
+            InvalidArgument("BinaryCorpusWriter: stream '%ls' has an unsupported element type.", s->m_name.c_str());
+        if (s->m_contextWindow.first != 0 || s->m_contextWindow.second != 0)
+            InvalidArgument("BinaryCorpusWriter: stream '%ls' is spliced with its context on the device, which the binary format does not support.", s->m_name.c_str());
+
+        // The layout of dense streams is taken from the first sequence, the layout of the
+        // stream may be only a configured one (e.g. for images that are scaled by transforms later on).
+        m_streams.push_back(make_shared<StreamDescription>(*s));
+        m_sampleSizes.push_back(0);
+    }
+
+    for (auto& b : m_buffers)
+    {
+        b.m_sampleOffsets.push_back(0);
+        b.m_nnzOffsets.push_back(0);
+    }
+
+    m_file = fopenOrDie(path, L"wb");
+    fputTag(m_file, "BCRP");
+    fput(m_file, BINARY_FORMAT_VERSION);
+    fput(m_file, (uint64_t)0); // offset of the index, written by Close()
+    PadTo(m_file, BINARY_CHUNK_ALIGNMENT);
+}
+
+BinaryCorpusWriter::~BinaryCorpusWriter()
+{
+    if (m_file)
+        fclose(m_file);
+}
+
+void BinaryCorpusWriter::AddSequence(const string& key, const vector<SequenceDataPtr>& data)
+{
+    if (data.size() != m_streams.size())
+        LogicError("BinaryCorpusWriter: expected data of %d streams, got %d.", (int)m_streams.size(), (int)data.size());
+
+    uint32_t numberOfSamples = 0;
+    for (size_t i = 0; i < m_streams.size(); ++i)
+    {
+        const auto& stream = m_streams[i];
+        StreamBuffer& buffer = m_buffers[i];
+        const SequenceDataPtr& sequence = data[i];
+        size_t elementSize = GetSizeByType(stream->m_elementType);
+        numberOfSamples = max(numberOfSamples, sequence->m_numberOfSamples);
+
+        if (stream->m_storageType == StorageType::dense)
+        {
+            auto dense = static_pointer_cast<DenseSequenceData>(sequence);
+            TensorShapePtr layout = dense->m_sampleLayout ? dense->m_sampleLayout : stream->m_sampleLayout;
+            if (!layout)
+                RuntimeError("BinaryCorpusWriter: the sample layout of stream '%ls' is not known.", stream->m_name.c_str());
+            if (m_sampleSizes[i] == 0)
+            {
+                stream->m_sampleLayout = layout;
+                m_sampleSizes[i] = layout->GetNumElements() * elementSize;
+            }
+            if (layout->GetNumElements() * elementSize != m_sampleSizes[i])
+                RuntimeError("BinaryCorpusWriter: all samples of stream '%ls' must have the same size, sequence '%s' differs "
+                             "(for images, use a deserializer configuration that scales them to the same size).",
+                             stream->m_name.c_str(), key.c_str());
+
+            const char* values = static_cast<const char*>(sequence->m_data);
+            buffer.m_values.insert(buffer.m_values.end(), values, values + sequence->m_numberOfSamples * m_sampleSizes[i]);
+        }
+        else
+        {
+            auto sparse = static_pointer_cast<SparseSequenceData>(sequence);
+            if (sparse->m_nnzCounts.size() != sequence->m_numberOfSamples)
+                RuntimeError("BinaryCorpusWriter: sequence '%s' of stream '%ls' has an inconsistent number of samples.", key.c_str(), stream->m_name.c_str());
+
+            const char* values = static_cast<const char*>(sequence->m_data);
+            buffer.m_nnzCounts.insert(buffer.m_nnzCounts.end(), sparse->m_nnzCounts.begin(), sparse->m_nnzCounts.end());
+            buffer.m_indices.insert(buffer.m_indices.end(), sparse->m_indices, sparse->m_indices + sparse->m_totalNnzCount);
+            buffer.m_values.insert(buffer.m_values.end(), values, values + sparse->m_totalNnzCount * elementSize);
+            buffer.m_nnzOffsets.push_back(buffer.m_nnzOffsets.back() + sparse->m_totalNnzCount);
+        }
+
+        buffer.m_sampleOffsets.push_back(buffer.m_sampleOffsets.back() + sequence->m_numberOfSamples);
+    }
+
+    m_numberOfSamples.push_back(numberOfSamples);
+    m_keys.insert(m_keys.end(), key.begin(), key.end());
+    m_keys.push_back('\0');
+
+    if (BufferedBytes() >= m_chunkSizeInBytes)
+        FlushChunk();
+}
+
+size_t BinaryCorpusWriter::BufferedBytes() const
+{
+    size_t size = 0;
+    for (const auto& b : m_buffers)
+    {
+        size += (b.m_sampleOffsets.size() + b.m_nnzOffsets.size()) * sizeof(uint64_t) +
+                (b.m_nnzCounts.size() + b.m_indices.size()) * sizeof(IndexType) +
+                b.m_values.size();
+    }
+    return size;
+}
+
+void BinaryCorpusWriter::FlushChunk()
+{
+    size_t numberOfSequences = m_numberOfSamples.size() - m_firstBufferedSequence;
+    if (numberOfSequences == 0)
+        return;
+
+    // Stream blocks follow the table of their offsets.
+    vector<uint64_t> blockOffsets(m_streams.size());
+    size_t position = AlignUp(m_streams.size() * sizeof(uint64_t), BINARY_ARRAY_ALIGNMENT);
+    for (size_t i = 0; i < m_streams.size(); ++i)
+    {
+        const StreamBuffer& b = m_buffers[i];
+        blockOffsets[i] = position;
+        position += AlignUp(b.m_sampleOffsets.size() * sizeof(uint64_t), BINARY_ARRAY_ALIGNMENT);
+        if (m_streams[i]->m_storageType == StorageType::sparse_csc)
+        {
+            position += AlignUp(b.m_nnzOffsets.size() * sizeof(uint64_t), BINARY_ARRAY_ALIGNMENT);
+            position += AlignUp(b.m_nnzCounts.size() * sizeof(IndexType), BINARY_ARRAY_ALIGNMENT);
+            position += AlignUp(b.m_indices.size() * sizeof(IndexType), BINARY_ARRAY_ALIGNMENT);
+        }
+        position += AlignUp(b.m_values.size(), BINARY_ARRAY_ALIGNMENT);
+    }
+
+    BinaryChunkRecord chunk;
+    chunk.m_fileOffset = fgetpos(m_file);
+    chunk.m_byteSize = position;
+    chunk.m_numberOfSequences = numberOfSequences;
+    chunk.m_numberOfSamples = 0;
+    for (size_t s = m_firstBufferedSequence; s < m_numberOfSamples.size(); ++s)
+        chunk.m_numberOfSamples += m_numberOfSamples[s];
+
+    WriteAligned(m_file, blockOffsets.data(), blockOffsets.size() * sizeof(uint64_t));
+    for (size_t i = 0; i < m_streams.size(); ++i)
+    {
+        StreamBuffer& b = m_buffers[i];
+        WriteAligned(m_file, b.m_sampleOffsets.data(), b.m_sampleOffsets.size() * sizeof(uint64_t));
+        if (m_streams[i]->m_storageType == StorageType::sparse_csc)
+        {
+            WriteAligned(m_file, b.m_nnzOffsets.data(), b.m_nnzOffsets.size() * sizeof(uint64_t));
+            WriteAligned(m_file, b.m_nnzCounts.data(), b.m_nnzCounts.size() * sizeof(IndexType));
+            WriteAligned(m_file, b.m_indices.data(), b.m_indices.size() * sizeof(IndexType));
+        }
+        WriteAligned(m_file, b.m_values.data(), b.m_values.size());
+
+        b.m_sampleOffsets.assign(1, 0);
+        b.m_nnzOffsets.assign(1, 0);
+        b.m_nnzCounts.clear();
+        b.m_indices.clear();
+        b.m_values.clear();
+    }
+
+    assert(fgetpos(m_file) == chunk.m_fileOffset + chunk.m_byteSize);
+    PadTo(m_file, AlignUp((size_t)fgetpos(m_file), BINARY_CHUNK_ALIGNMENT));
+
+    if (m_chunks.size() == CHUNKID_MAX)
+        RuntimeError("BinaryCorpusWriter: maximum number of chunks exceeded, increase the chunk size.");
+    m_chunks.push_back(chunk);
+    m_firstBufferedSequence = m_numberOfSamples.size();
+}
+
+void BinaryCorpusWriter::Close()
+{
+    FlushChunk();
+
+    for (size_t i = 0; i < m_streams.size(); ++i)
+    {
+        if (!m_streams[i]->m_sampleLayout)
+            RuntimeError("BinaryCorpusWriter: the sample layout of stream '%ls' is not known.", m_streams[i]->m_name.c_str());
+    }
+
+    uint64_t indexOffset = fgetpos(m_file);
+    fputTag(m_file, "BIDX");
+    fput(m_file, (uint32_t)m_streams.size());
+    for (const auto& s : m_streams)
+    {
+        fputstring(m_file, msra::strfun::utf8(s->m_name));
+        fput(m_file, (uint32_t)s->m_storageType);
+        fput(m_file, (uint32_t)s->m_elementType);
+        fput(m_file, (uint32_t)s->m_sampleLayout->GetRank());
+        for (size_t k = 0; k < s->m_sampleLayout->GetRank(); ++k)
+            fput(m_file, (uint64_t)s->m_sampleLayout->GetDim(k));
+    }
+
+    fput(m_file, (uint64_t)m_chunks.size());
+    fwriteOrDie(m_chunks, m_file);
+    fput(m_file, (uint64_t)m_numberOfSamples.size());
+    fwriteOrDie(m_numberOfSamples, m_file);
+    fput(m_file, (uint64_t)m_keys.size());
+    fwriteOrDie(m_keys, m_file);
+    fputTag(m_file, "EIDX");
+
+    fsetpos(m_file, INDEX_OFFSET_POSITION);
+    fput(m_file, indexOffset);
+    fflushOrDie(m_file);
+    fclose(m_file);
+    m_file = nullptr;
+
+    fprintf(stderr, "BinaryCorpusWriter: wrote %" PRIu64 " sequences in %" PRIu64 " chunks to %ls\n",
+        (uint64_t)m_numberOfSamples.size(), (uint64_t)m_chunks.size(), m_path.c_str());
+}
+
+/*static*/ void BinaryCorpusWriter::Convert(IDataDeserializerPtr source, CorpusDescriptorPtr corpus, const wstring& path, size_t chunkSizeInBytes)
+{
+    BinaryCorpusWriter writer(path, source->GetStreamDescriptions(), chunkSizeInBytes);
+    const auto& stringRegistry = corpus->GetStringRegistry();
+
+    ChunkDescriptions chunks = source->GetChunkDescriptions();
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        vector<SequenceDescription> descriptions;
+        source->GetSequencesForChunk(chunks[c]->m_id, descriptions);
+        ChunkPtr chunk = source->GetChunk(chunks[c]->m_id);
+        for (const auto& d : descriptions)
+        {
+            vector<SequenceDataPtr> data;
+            chunk->GetSequence(d.m_id, data);
+            writer.AddSequence(stringRegistry[(size_t)d.m_key.m_sequence], data);
+        }
+
+        if ((c + 1) % 100 == 0 || c + 1 == chunks.size())
+            fprintf(stderr, "BinaryCorpusWriter: converted %d of %d chunks\n", (int)(c + 1), (int)chunks.size());
+    }
+
+    writer.Close();
+}
+
+}}}
@@ -0,0 +1,64 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include "DataDeserializer.h"
+#include "CorpusDescriptor.h"
+#include "BinaryFormat.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Writes sequences into a file in the binary corpus format (see BinaryFormat.h),
+// grouping them into chunks of about the given size.
+class BinaryCorpusWriter
+{
+public:
+    BinaryCorpusWriter(const std::wstring& path, const std::vector<StreamDescriptionPtr>& streams, size_t chunkSizeInBytes);
+    ~BinaryCorpusWriter();
+
+    // Appends a sequence, given the data of all streams.
+    void AddSequence(const std::string& key, const std::vector<SequenceDataPtr>& data);
+
+    // Writes the last chunk and the index, and closes the file.
+    void Close();
+
+    // Writes all sequences the deserializer provides, in the order of its chunks.
+    static void Convert(IDataDeserializerPtr source, CorpusDescriptorPtr corpus, const std::wstring& path, size_t chunkSizeInBytes);
+
+private:
+    // Data of a stream for the sequences of the current chunk.
+    struct StreamBuffer
+    {
+        std::vector<uint64_t> m_sampleOffsets;
+        std::vector<uint64_t> m_nnzOffsets;  // sparse only
+        std::vector<IndexType> m_nnzCounts;  // sparse only
+        std::vector<IndexType> m_indices;    // sparse only
+        std::vector<char> m_values;
+    };
+
+    // Writes the buffered sequences as a chunk.
+    void FlushChunk();
+
+    // Number of bytes the buffered sequences take in the file.
+    size_t BufferedBytes() const;
+
+    std::wstring m_path;
+    FILE* m_file;
+    std::vector<StreamDescriptionPtr> m_streams;
+    std::vector<size_t> m_sampleSizes; // sample sizes of dense streams in bytes
+    size_t m_chunkSizeInBytes;
+
+    std::vector<StreamBuffer> m_buffers;
+    std::vector<uint32_t> m_numberOfSamples; // of all sequences written so far
+    std::vector<char> m_keys;                // of all sequences written so far, each terminated by '\0'
+    std::vector<BinaryChunkRecord> m_chunks;
+    size_t m_firstBufferedSequence;          // index of the first sequence of the current chunk
+
+    DISABLE_COPY_AND_MOVE(BinaryCorpusWriter);
+};
+
+}}}
@@ -0,0 +1,48 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Layout of a binary corpus file (all values are little endian):
+//
+//   header   "BCRP" tag, format version (uint32), file offset of the index (uint64).
+//   chunks   Each chunk starts at a multiple of BINARY_CHUNK_ALIGNMENT. A chunk stores the data
+//            of all its sequences stream by stream: it starts with the offsets (uint64, relative to
+//            the chunk) of one block per stream, followed by the blocks.
+//   index    "BIDX" tag, the streams, the chunk table, the number of samples of each sequence
+//            and the keys of all sequences, "EIDX" tag.
+//
+// A stream block of a chunk with N sequences holds:
+//   dense    N + 1 sample offsets (uint64), then the samples of all sequences.
+//   sparse   N + 1 sample offsets (uint64), N + 1 offsets of the first non-zero value of each
+//            sequence (uint64), the nnz count of each sample (IndexType), the row indices of all
+//            non-zero values (IndexType), then the non-zero values.
+// Each array starts at a multiple of BINARY_ARRAY_ALIGNMENT, so that the data of a sequence
+// can be used directly from the memory mapped chunk.
+
+const uint32_t BINARY_FORMAT_VERSION = 1;
+
+const size_t BINARY_CHUNK_ALIGNMENT = 4096;
+const size_t BINARY_ARRAY_ALIGNMENT = 8;
+
+// An entry of the chunk table in the index.
+struct BinaryChunkRecord
+{
+    uint64_t m_fileOffset;        // offset of the chunk in the file
+    uint64_t m_byteSize;          // size of the chunk in bytes
+    uint64_t m_numberOfSequences; // number of sequences in the chunk
+    uint64_t m_numberOfSamples;   // number of samples in the chunk
+};
+
+inline size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}}}
@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Exports.cpp : Defines the exported functions for the DLL application.
+//
+
+#include "stdafx.h"
+#define DATAREADER_EXPORTS
+#include "DataReader.h"
+#include "Config.h"
+#include "Bundler.h"
+#include "StringUtil.h"
+#include "BinaryChunkDeserializer.h"
+#include "BinaryCorpusWriter.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// TODO: Not safe from the ABI perspective. Will be uglified to make the interface ABI.
+// A factory method for creating binary deserializers.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool primary)
+{
+    string precision = deserializerConfig.Find("precision", "float");
+    if (!AreEqualIgnoreCase(precision, "float") && !AreEqualIgnoreCase(precision, "double"))
+    {
+        InvalidArgument("Unsupported precision '%s'", precision.c_str());
+    }
+
+    if (type == L"CNTKBinaryFormatDeserializer")
+        *deserializer = new BinaryChunkDeserializer(corpus, deserializerConfig, primary);
+    else
+        InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
+
+    // Deserializer created.
+    return true;
+}
+
+// Converts the corpus described by the deserializers of the reader section into the binary format, i.e.
+//     outputFile = "train.bin"
+//     chunkSizeInBytes = 33554432
+//     reader = [
+//         deserializers = (
+//             [ type = "CNTKTextFormatDeserializer" module = "CNTKTextFormatReader" ...]
+//             ...
+//         )
+//     ]
+// The sequences are written in the order of the chunks of the first deserializer, with the precision of the command.
+extern "C" DATAREADER_API void ConvertCorpus(const ConfigParameters& config)
+{
+    typedef bool(*CreateDeserializerFactory) (IDataDeserializer** d, const std::wstring& type, const ConfigParameters& cfg, CorpusDescriptorPtr corpus, bool primary);
+
+    std::wstring outputFile = config(L"outputFile");
+    size_t chunkSizeInBytes = config(L"chunkSizeInBytes", (size_t)32 * 1024 * 1024);
+    string precision = config.Find("precision", "float");
+
+    ConfigParameters readerConfig = config(L"reader");
+    argvector<ConfigValue> deserializerConfigs =
+        readerConfig(L"deserializers", ConfigParameters::Array(argvector<ConfigValue>(vector<ConfigValue> {})));
+    if (deserializerConfigs.empty())
+        InvalidArgument("Could not find deserializers in the reader config.");
+
+    // Same as in the composite reader, the first deserializer is primary and drives chunking.
+    Plugin plugin;
+    auto corpus = std::make_shared<CorpusDescriptor>();
+    std::vector<IDataDeserializerPtr> deserializers;
+    for (size_t i = 0; i < deserializerConfigs.size(); ++i)
+    {
+        ConfigParameters p = deserializerConfigs[i];
+        p.Insert("frameMode", "false");
+        p.Insert("precision", precision);
+
+        std::string deserializerModule = p("module");
+        CreateDeserializerFactory f = (CreateDeserializerFactory)plugin.Load(deserializerModule, "CreateDeserializer");
+
+        std::wstring deserializerType = p("type");
+        IDataDeserializer* d;
+        if (!f(&d, deserializerType, p, corpus, i == 0))
+            RuntimeError("Cannot create deserializer. Please check module and type in the configuration.");
+        deserializers.push_back(IDataDeserializerPtr(d));
+    }
+
+    IDataDeserializerPtr source = deserializers.front();
+    if (deserializers.size() > 1)
+        source = std::make_shared<Bundler>(readerConfig, source, deserializers, (bool)readerConfig(L"checkData", true));
+
+    BinaryCorpusWriter::Convert(source, corpus, outputFile, chunkSizeInBytes);
+}
+
+}}}
@@ -0,0 +1,118 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include "MappedFile.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+MappedRegion::~MappedRegion()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(m_view);
+#else
+    munmap(m_view, m_viewSize);
+#endif
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::wstring& path) : m_path(path), m_mapping(NULL)
+{
+    m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        RuntimeError("Unable to open file %ls, error %x", path.c_str(), GetLastError());
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        CloseHandle(m_file);
+        RuntimeError("Unable to retrieve the size of file %ls, error %x", path.c_str(), GetLastError());
+    }
+    m_size = size.QuadPart;
+
+    m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mapping == NULL)
+    {
+        CloseHandle(m_file);
+        RuntimeError("Unable to memory map file %ls, error %x", path.c_str(), GetLastError());
+    }
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    m_granularity = info.dwAllocationGranularity;
+}
+
+MappedFile::~MappedFile()
+{
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+}
+
+MappedRegionPtr MappedFile::Map(uint64_t offset, size_t size) const
+{
+    if (offset + size > m_size)
+        RuntimeError("Region [%" PRIu64 ", %" PRIu64 ") is outside of file %ls", offset, offset + size, m_path.c_str());
+
+    uint64_t viewOffset = offset / m_granularity * m_granularity;
+    size_t viewSize = (size_t)(offset - viewOffset) + size;
+    void* view = MapViewOfFile(m_mapping, FILE_MAP_READ, (DWORD)(viewOffset >> 32), (DWORD)(viewOffset & 0xFFFFFFFF), viewSize);
+    if (view == NULL)
+        RuntimeError("Unable to map %" PRIu64 " bytes of file %ls, error %x", (uint64_t)viewSize, m_path.c_str(), GetLastError());
+
+    return MappedRegionPtr(new MappedRegion(view, viewSize, (const char*)view + (offset - viewOffset), size));
+}
+
+#else
+
+MappedFile::MappedFile(const std::wstring& path) : m_path(path)
+{
+    m_file = open(wtocharpath(path.c_str()).c_str(), O_RDONLY);
+    if (m_file == -1)
+        RuntimeError("Unable to open file %ls", path.c_str());
+
+    struct stat info;
+    if (fstat(m_file, &info) == -1)
+    {
+        close(m_file);
+        RuntimeError("Unable to retrieve the size of file %ls", path.c_str());
+    }
+    m_size = info.st_size;
+    m_granularity = (size_t)sysconf(_SC_PAGE_SIZE);
+}
+
+MappedFile::~MappedFile()
+{
+    close(m_file);
+}
+
+MappedRegionPtr MappedFile::Map(uint64_t offset, size_t size) const
+{
+    if (offset + size > m_size)
+        RuntimeError("Region [%" PRIu64 ", %" PRIu64 ") is outside of file %ls", offset, offset + size, m_path.c_str());
+
+    uint64_t viewOffset = offset / m_granularity * m_granularity;
+    size_t viewSize = (size_t)(offset - viewOffset) + size;
+    void* view = mmap(nullptr, viewSize, PROT_READ, MAP_SHARED, m_file, (off_t)viewOffset);
+    if (view == MAP_FAILED)
+        RuntimeError("Unable to map %" PRIu64 " bytes of file %ls", (uint64_t)viewSize, m_path.c_str());
+
+    // the whole region is going to be used, start reading it in now
+    madvise(view, viewSize, MADV_WILLNEED);
+
+    return MappedRegionPtr(new MappedRegion(view, viewSize, (const char*)view + (offset - viewOffset), size));
+}
+
+#endif
+
+}}}
@@ -0,0 +1,68 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A region of a file mapped read-only into memory.
+// The region is unmapped when the object is destroyed.
+class MappedRegion
+{
+public:
+    ~MappedRegion();
+
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    friend class MappedFile;
+    MappedRegion(void* view, size_t viewSize, const char* data, size_t size) :
+        m_view(view), m_viewSize(viewSize), m_data(data), m_size(size)
+    {}
+
+    void* m_view;      // start of the view (aligned down to the mapping granularity)
+    size_t m_viewSize; // size of the view
+    const char* m_data;
+    size_t m_size;
+
+    DISABLE_COPY_AND_MOVE(MappedRegion);
+};
+
+typedef std::shared_ptr<MappedRegion> MappedRegionPtr;
+
+// A file opened for read-only memory mapping of its regions.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::wstring& path);
+    ~MappedFile();
+
+    uint64_t Size() const { return m_size; }
+
+    // Maps [offset, offset + size) of the file into memory and asks the OS to start reading it in.
+    // Can be called concurrently.
+    MappedRegionPtr Map(uint64_t offset, size_t size) const;
+
+private:
+    std::wstring m_path;
+    uint64_t m_size;
+    size_t m_granularity; // offsets of the views must be multiples of this
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#else
+    int m_file;
+#endif
+
+    DISABLE_COPY_AND_MOVE(MappedFile);
+};
+
+}}}
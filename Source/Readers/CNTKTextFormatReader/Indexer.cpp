@@ -8,12 +8,16 @@
 #include <inttypes.h>
 #include "Indexer.h"
 #include "TextReaderConstants.h"
+#include "ExceptionCapture.h"
 
 using std::string;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-Indexer::Indexer(FILE* file, bool skipSequenceIds, size_t chunkSize) :
+// Number of bytes of input each thread scans at a time when indexing in parallel.
+const size_t PARALLEL_SCAN_BYTES_PER_THREAD = 4 * 1024 * 1024;
+
+Indexer::Indexer(FILE* file, bool skipSequenceIds, size_t chunkSize, size_t numThreads) :
     m_file(file),
     m_fileOffsetStart(0),
     m_fileOffsetEnd(0),
@@ -23,7 +27,9 @@ Indexer::Indexer(FILE* file, bool skipSequenceIds, size_t chunkSize) :
     m_pos(nullptr),
     m_done(false),
     m_hasSequenceIds(!skipSequenceIds),
-    m_index(chunkSize)
+    m_numThreads(max(numThreads, (size_t)1)),
+    m_index(chunkSize),
+    m_recordSequences(false)
 {
     if (m_file == nullptr)
     {
@@ -91,13 +97,76 @@ void Indexer::BuildFromLines(CorpusDescriptorPtr corpus)
     }
 }
 
-void Indexer::Build(CorpusDescriptorPtr corpus)
+void Indexer::Build(CorpusDescriptorPtr corpus, const IndexCache* cache)
 {
     if (!m_index.IsEmpty())
     {
         return;
     }
 
+    if (cache == nullptr)
+    {
+        BuildFromInput(corpus);
+        return;
+    }
+
+    if (TryLoadFromCache(corpus, *cache))
+    {
+        return;
+    }
+
+    m_recordSequences = true;
+    BuildFromInput(corpus);
+    SaveToCache(*cache);
+    m_recordSequences = false;
+    m_cachedSequences.clear();
+    m_cachedSequences.shrink_to_fit();
+}
+
+bool Indexer::TryLoadFromCache(CorpusDescriptorPtr corpus, const IndexCache& cache)
+{
+    bool hasSequenceIds = false;
+    vector<CachedSequence> sequences;
+    bool loaded = cache.TryLoad([&](FILE* f)
+    {
+        uint8_t flag;
+        uint64_t numberOfSequences;
+        fget(f, flag);
+        fget(f, numberOfSequences);
+        freadOrDie(sequences, (size_t)numberOfSequences, f);
+        hasSequenceIds = flag != 0;
+    });
+
+    if (!loaded)
+    {
+        return false;
+    }
+
+    m_hasSequenceIds = hasSequenceIds;
+    m_index.Reserve(filesize(m_file));
+    for (const auto& cached : sequences)
+    {
+        SequenceDescriptor sd = {};
+        sd.m_fileOffsetBytes = cached.m_fileOffsetBytes;
+        sd.m_byteSize = (size_t)cached.m_byteSize;
+        sd.m_numberOfSamples = (size_t)cached.m_numberOfSamples;
+        AddSequenceIfIncluded(corpus, (size_t)cached.m_key, sd);
+    }
+    return true;
+}
+
+void Indexer::SaveToCache(const IndexCache& cache)
+{
+    cache.Save([this](FILE* f)
+    {
+        fput(f, (uint8_t)(m_hasSequenceIds ? 1 : 0));
+        fput(f, (uint64_t)m_cachedSequences.size());
+        fwriteOrDie(m_cachedSequences, f);
+    });
+}
+
+void Indexer::BuildFromInput(CorpusDescriptorPtr corpus)
+{
     m_index.Reserve(filesize(m_file));
 
     RefillBuffer(); // read the first block of data
@@ -119,6 +188,17 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
     if (!m_hasSequenceIds || m_bufferStart[0] == NAME_PREFIX)
     {
         // skip sequence id parsing, treat lines as individual sequences
+        m_hasSequenceIds = false;
+    }
+
+    if (m_numThreads > 1)
+    {
+        BuildInParallel(corpus);
+        return;
+    }
+
+    if (!m_hasSequenceIds)
+    {
         BuildFromLines(corpus);
         return;
     }
@@ -158,8 +238,184 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
     AddSequenceIfIncluded(corpus, currentKey, sd);
 }
 
+void Indexer::BuildInParallel(CorpusDescriptorPtr corpus)
+{
+    // the block initially holds what has already been buffered
+    vector<char> block(m_pos, m_bufferEnd);
+    int64_t blockOffset = GetFileOffset();
+    size_t blockSize = m_numThreads * PARALLEL_SCAN_BYTES_PER_THREAD;
+
+    vector<vector<LineSpan>> spans(m_numThreads);
+    vector<size_t> rangeBegin(m_numThreads + 1);
+
+    // the sequence being stitched together from the spans
+    SequenceDescriptor sd = {};
+    size_t currentKey = 0;
+    bool hasSequence = false;
+    size_t lines = 0;
+
+    auto addSpan = [&](const LineSpan& span)
+    {
+        if (!m_hasSequenceIds)
+        {
+            SequenceDescriptor line = {};
+            line.m_numberOfSamples = 1;
+            line.m_fileOffsetBytes = span.m_fileOffsetBytes;
+            line.m_byteSize = span.m_byteSize;
+            AddSequenceIfIncluded(corpus, lines++, line);
+        }
+        else if (!hasSequence)
+        {
+            if (!span.m_hasKey)
+            {
+                RuntimeError("Expected a sequence id at the offset %" PRIi64 ", none was found.", span.m_fileOffsetBytes);
+            }
+            sd.m_fileOffsetBytes = span.m_fileOffsetBytes;
+            sd.m_byteSize = span.m_byteSize;
+            sd.m_numberOfSamples = span.m_numberOfLines;
+            currentKey = span.m_key;
+            hasSequence = true;
+        }
+        else if (!span.m_hasKey || span.m_key == currentKey)
+        {
+            sd.m_byteSize += span.m_byteSize;
+            sd.m_numberOfSamples += span.m_numberOfLines;
+        }
+        else
+        {
+            AddSequenceIfIncluded(corpus, currentKey, sd);
+            sd = {};
+            sd.m_fileOffsetBytes = span.m_fileOffsetBytes;
+            sd.m_byteSize = span.m_byteSize;
+            sd.m_numberOfSamples = span.m_numberOfLines;
+            currentKey = span.m_key;
+        }
+    };
+
+    while (!block.empty() || !m_done)
+    {
+        size_t size = block.size();
+        if (size < blockSize && !m_done)
+        {
+            block.resize(blockSize);
+            size_t bytesRead = fread(block.data() + size, 1, blockSize - size, m_file);
+            if (ferror(m_file))
+                RuntimeError("Could not read from the input file.");
+            if (bytesRead < blockSize - size)
+            {
+                m_done = true;
+            }
+            block.resize(size + bytesRead);
+        }
+
+        // only complete lines are scanned, except at the end of input
+        size_t scanSize = block.size();
+        if (!m_done)
+        {
+            while (scanSize > 0 && block[scanSize - 1] != ROW_DELIMITER)
+            {
+                --scanSize;
+            }
+
+            if (scanSize == 0)
+            {
+                // a line longer than the block, read more
+                blockSize *= 2;
+                continue;
+            }
+        }
+
+        // split the block at line boundaries into ranges of about the same size
+        const char* data = block.data();
+        rangeBegin[0] = 0;
+        for (size_t i = 1; i < m_numThreads; ++i)
+        {
+            size_t begin = max(rangeBegin[i - 1], scanSize * i / m_numThreads);
+            if (begin > 0 && begin < scanSize && data[begin - 1] != ROW_DELIMITER)
+            {
+                auto next = (const char*)memchr(data + begin, ROW_DELIMITER, scanSize - begin);
+                begin = next ? next - data + 1 : scanSize;
+            }
+            rangeBegin[i] = begin;
+        }
+        rangeBegin[m_numThreads] = scanSize;
+
+        ExceptionCapture capture;
+#pragma omp parallel for schedule(static) num_threads((int)m_numThreads)
+        for (int i = 0; i < (int)m_numThreads; ++i)
+        {
+            capture.SafeRun([&](int range)
+            {
+                spans[range].clear();
+                ScanLines(data + rangeBegin[range], data + rangeBegin[range + 1], blockOffset + rangeBegin[range], spans[range]);
+            }, i);
+        }
+        capture.RethrowIfHappened();
+
+        for (const auto& rangeSpans : spans)
+        {
+            for (const auto& span : rangeSpans)
+            {
+                addSpan(span);
+            }
+        }
+
+        // keep the incomplete last line for the next block
+        block.erase(block.begin(), block.begin() + scanSize);
+        blockOffset += scanSize;
+    }
+
+    if (hasSequence)
+    {
+        AddSequenceIfIncluded(corpus, currentKey, sd);
+    }
+}
+
+void Indexer::ScanLines(const char* begin, const char* end, int64_t fileOffset, vector<LineSpan>& spans) const
+{
+    for (const char* line = begin; line != end;)
+    {
+        auto next = (const char*)memchr(line, ROW_DELIMITER, end - line);
+        next = next ? next + 1 : end;
+
+        size_t key = 0;
+        bool hasKey = false, isLine = true;
+        if (m_hasSequenceIds)
+        {
+            const char* c = line;
+            for (; c != end && isdigit(*c); ++c)
+            {
+                key = key * 10 + (*c - '0');
+            }
+            // digits that run into the end of input are neither an id nor a line
+            // of the sequence (same as in Build, where TryGetSequenceId hits the end of input)
+            hasKey = c != line && c != end;
+            isLine = c != end;
+        }
+
+        if (!m_hasSequenceIds || spans.empty() || (hasKey && (!spans.back().m_hasKey || spans.back().m_key != key)))
+        {
+            LineSpan span = {};
+            span.m_fileOffsetBytes = fileOffset + (line - begin);
+            span.m_key = key;
+            span.m_hasKey = hasKey;
+            spans.push_back(span);
+        }
+
+        spans.back().m_byteSize += next - line;
+        spans.back().m_numberOfLines += isLine ? 1 : 0;
+        line = next;
+    }
+}
+
 void Indexer::AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceKey, SequenceDescriptor& sd)
 {
+    if (m_recordSequences)
+    {
+        CachedSequence cached = { sequenceKey, sd.m_fileOffsetBytes, sd.m_byteSize, sd.m_numberOfSamples };
+        m_cachedSequences.push_back(cached);
+    }
+
     auto& stringRegistry = corpus->GetStringRegistry();
     auto key = std::to_string(sequenceKey);
     if (corpus->IsIncluded(key))
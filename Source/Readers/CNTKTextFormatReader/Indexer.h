@@ -9,6 +9,7 @@
 #include <vector>
 #include "Descriptors.h"
 #include "CorpusDescriptor.h"
+#include "IndexCache.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -17,14 +18,18 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // others specify size and file offset of the respective structure).
 // As opposed to the data deserializer, indexer performs almost no parsing 
 // and therefore is several magnitudes faster.
+// With more than one thread, the input is read in large blocks, each block is split
+// at line boundaries and the parts are scanned concurrently, then the results are stitched
+// together in order.
 class Indexer 
 {
 public:
-    Indexer(FILE* file, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024);
+    Indexer(FILE* file, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024, size_t numThreads = 1);
 
     // Reads the input file, building and index of chunks and corresponding
-    // sequences.
-    void Build(CorpusDescriptorPtr corpus);
+    // sequences. If a cache is given, the index is loaded from the cache when
+    // it is up to date, otherwise the index is built and then saved to the cache.
+    void Build(CorpusDescriptorPtr corpus, const IndexCache* cache = nullptr);
 
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
@@ -50,9 +55,35 @@ private:
     bool m_hasSequenceIds; // true, when input contains one sequence per line 
                            // or when sequence id column was ignored during indexing.
 
+    size_t m_numThreads; // number of threads that scan the input
+
     // a collection of chunk descriptors and sequence keys.
     Index m_index;
 
+    // A sequence as found in the input (before it is filtered by the corpus descriptor),
+    // in the form it is stored in the index cache.
+    struct CachedSequence
+    {
+        uint64_t m_key;
+        int64_t m_fileOffsetBytes;
+        uint64_t m_byteSize;
+        uint64_t m_numberOfSamples;
+    };
+
+    // All sequences found in the input, only recorded when the index is going to be cached.
+    std::vector<CachedSequence> m_cachedSequences;
+    bool m_recordSequences;
+
+    // Builds the index from the input file.
+    void BuildFromInput(CorpusDescriptorPtr corpus);
+
+    // Loads the sequences from the cache and adds them to the index.
+    // Returns false (leaving the index empty) if the cache is missing or out of date.
+    bool TryLoadFromCache(CorpusDescriptorPtr corpus, const IndexCache& cache);
+
+    // Stores the sequences recorded while building the index in the cache.
+    void SaveToCache(const IndexCache& cache);
+
     // Same function as above but with check that the sequence is included in the corpus descriptor.
     void AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceKey, SequenceDescriptor& sd);
 
@@ -75,6 +106,25 @@ private:
     // the corresponding sequence id.
     void BuildFromLines(CorpusDescriptorPtr corpus);
 
+    // A run of consecutive lines found by one of the scanning threads.
+    // When the input has sequence ids, all lines of a span belong to the same sequence
+    // (a span without an id continues the sequence of the preceding span),
+    // otherwise each span is a single line.
+    struct LineSpan
+    {
+        int64_t m_fileOffsetBytes;
+        size_t m_byteSize;
+        size_t m_numberOfLines;
+        size_t m_key;
+        bool m_hasKey;
+    };
+
+    // Same as Build/BuildFromLines, but scans the input on m_numThreads threads.
+    void BuildInParallel(CorpusDescriptorPtr corpus);
+
+    // Splits the lines in [begin, end), which starts at the given file offset, into spans.
+    void ScanLines(const char* begin, const char* end, int64_t fileOffset, std::vector<LineSpan>& spans) const;
+
     // Returns current offset in the input file (in bytes). 
     int64_t GetFileOffset() const { return m_fileOffsetStart + (m_pos - m_bufferStart); }
 
@@ -149,6 +149,10 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
     m_chunkSizeBytes = config(L"chunkSizeInBytes", 32 * 1024 * 1024); // 32 MB by default
     m_keepDataInMemory = config(L"keepDataInMemory", false);
     m_frameMode = config(L"frameMode", false);
+    m_chunkPrefetchCount = config(L"chunkPrefetchCount", (size_t)0);
+    m_chunkPrefetchMaxSamples = config(L"chunkPrefetchMaxSamples", (size_t)SIZE_MAX);
+    m_numParserThreads = config(L"numParserThreads", (size_t)0);
+    m_cacheIndex = config(L"cacheIndex", false);
 }
 
 }}}
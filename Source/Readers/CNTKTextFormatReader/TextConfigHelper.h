@@ -39,6 +39,14 @@ public:
 
     bool IsInFrameMode() const { return m_frameMode; }
 
+    size_t GetChunkPrefetchCount() const { return m_chunkPrefetchCount; }
+
+    size_t GetChunkPrefetchMaxSamples() const { return m_chunkPrefetchMaxSamples; }
+
+    size_t GetNumParserThreads() const { return m_numParserThreads; }
+
+    bool ShouldCacheIndex() const { return m_cacheIndex; }
+
     ElementType GetElementType() const { return m_elementType; }
 
     DISABLE_COPY_AND_MOVE(TextConfigHelper);
@@ -54,6 +62,10 @@ private:
     size_t m_chunkSizeBytes; // chunks size in bytes
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
+    size_t m_chunkPrefetchCount; // number of chunks the randomizer loads ahead in the background (0 = none)
+    size_t m_chunkPrefetchMaxSamples; // limit on the samples in chunks loaded ahead
+    size_t m_numParserThreads; // number of threads that index the input and parse a chunk (0 = all cores)
+    bool m_cacheIndex; // if true, the index is saved next to the input file and reused by later runs
 };
 
 } } }
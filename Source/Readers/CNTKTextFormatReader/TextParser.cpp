@@ -7,6 +7,8 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <cfloat>
+#include <omp.h>
+#include "ExceptionCapture.h"
 #include "Indexer.h"
 #include "TextParser.h"
 #include "TextReaderConstants.h"
@@ -16,17 +18,8 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-enum State
-{
-    Init = 0,
-    Sign,
-    IntegralPart,
-    Period,
-    FractionalPart,
-    TheLetterE,
-    ExponentSign,
-    Exponent
-};
+// Minimum number of bytes of a chunk that are worth parsing on a separate thread.
+const size_t MIN_BYTES_PER_PARSER_THREAD = 64 * 1024;
 
 template <class ElemType>
 class TextParser<ElemType>::TextDataChunk : public Chunk, public std::enable_shared_from_this<Chunk>
@@ -67,6 +60,8 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams())
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
+    SetNumParserThreads(helper.GetNumParserThreads());
+    SetCacheIndex(helper.ShouldCacheIndex());
 
     Initialize();
 }
@@ -80,7 +75,6 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_indexer(nullptr),
     m_fileOffsetStart(0),
     m_fileOffsetEnd(0),
-    m_buffer(new char[BUFFER_SIZE + 1]),
     m_bufferStart(nullptr),
     m_bufferEnd(nullptr),
     m_pos(nullptr),
@@ -90,6 +84,9 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_numAllowedErrors(0),
     m_skipSequenceIds(false),
     m_numRetries(5),
+    m_numParserThreads(1),
+    m_cacheIndex(false),
+    m_owner(nullptr),
     m_corpus(corpus)
 {
     assert(streams.size() > 0);
@@ -118,6 +115,34 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_scratch = unique_ptr<char[]>(new char[m_maxAliasLength + 1]);
 }
 
+template <class ElemType>
+TextParser<ElemType>::TextParser(TextParser* owner) :
+    m_filename(owner->m_filename),
+    m_file(nullptr),
+    m_streamInfos(owner->m_streamInfos),
+    m_maxAliasLength(owner->m_maxAliasLength),
+    m_aliasToIdMap(owner->m_aliasToIdMap),
+    m_indexer(nullptr),
+    m_fileOffsetStart(0),
+    m_fileOffsetEnd(0),
+    m_bufferStart(nullptr),
+    m_bufferEnd(nullptr),
+    m_pos(nullptr),
+    m_scratch(new char[owner->m_maxAliasLength + 1]),
+    m_chunkSizeBytes(owner->m_chunkSizeBytes),
+    m_traceLevel(owner->m_traceLevel),
+    m_hadWarnings(false),
+    m_numAllowedErrors(0),
+    m_skipSequenceIds(owner->m_skipSequenceIds),
+    m_numRetries(0),
+    m_numParserThreads(1),
+    m_cacheIndex(false),
+    m_owner(owner),
+    m_corpus(owner->m_corpus)
+{
+    m_streams = owner->m_streams;
+}
+
 template <class ElemType>
 TextParser<ElemType>::~TextParser()
 {
@@ -166,21 +191,21 @@ void TextParser<ElemType>::Initialize()
                 "UTF-16 encoding is currently not supported.", m_filename.c_str());
         }
 
-        m_indexer = make_unique<Indexer>(m_file, m_skipSequenceIds, m_chunkSizeBytes);
+        m_indexer = make_unique<Indexer>(m_file, m_skipSequenceIds, m_chunkSizeBytes, m_numParserThreads);
 
-        m_indexer->Build(m_corpus);
+        if (m_cacheIndex)
+        {
+            // the format of the cached index depends on whether sequence ids are skipped
+            IndexCache cache(m_filename, m_skipSequenceIds ? "CNTKTextFormat/1 skipSequenceIds" : "CNTKTextFormat/1");
+            m_indexer->Build(m_corpus, &cache);
+        }
+        else
+        {
+            m_indexer->Build(m_corpus);
+        }
     });
 
     assert(m_indexer != nullptr);
-
-    int64_t position = _ftelli64(m_file);
-    if (position == -1L)
-    {
-        RuntimeError("Error retrieving current position in the input file (%ls).", m_filename.c_str());
-    }
-
-    m_fileOffsetStart = position;
-    m_fileOffsetEnd = position;
 }
 
 template <class ElemType>
@@ -292,54 +317,114 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
 template <class ElemType>
 void TextParser<ElemType>::LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor)
 {
-    for (const auto& sequenceDescriptor : descriptor.m_sequences)
+    const auto& sequences = descriptor.m_sequences;
+    if (sequences.empty())
+    {
+        return;
+    }
+
+    ReadChunk(descriptor);
+
+    // Sequences are parsed in ranges of about the same size in bytes, one range per thread,
+    // as long as each range is large enough to be worth a thread.
+    size_t numRanges = min(m_numParserThreads, sequences.size());
+    numRanges = min(numRanges, max((size_t)1, m_buffer.size() / MIN_BYTES_PER_PARSER_THREAD));
+
+    vector<SequenceBuffer> data(sequences.size());
+    if (numRanges == 1)
+    {
+        LoadSequences(descriptor, 0, sequences.size(), data);
+    }
+    else
+    {
+        // rangeBegin[i] is the first sequence of range i, a range can be empty
+        // if it is covered by a single large sequence.
+        vector<size_t> rangeBegin(numRanges + 1, sequences.size());
+        rangeBegin[0] = 0;
+        size_t bytesPerRange = m_buffer.size() / numRanges;
+        for (size_t i = 0, range = 1; i < sequences.size() && range < numRanges; ++i)
+        {
+            while (range < numRanges && (size_t)(sequences[i].m_fileOffsetBytes - m_fileOffsetStart) >= range * bytesPerRange)
+            {
+                rangeBegin[range++] = i;
+            }
+        }
+
+        while (m_chunkParsers.size() < numRanges)
+        {
+            m_chunkParsers.push_back(unique_ptr<TextParser>(new TextParser(this)));
+        }
+
+        auto loadRange = [this, &descriptor, &rangeBegin, &data](int range)
+        {
+            TextParser& parser = *m_chunkParsers[range];
+            parser.m_fileOffsetStart = m_fileOffsetStart;
+            parser.m_fileOffsetEnd = m_fileOffsetEnd;
+            parser.m_bufferStart = m_bufferStart;
+            parser.m_bufferEnd = m_bufferEnd;
+            parser.LoadSequences(descriptor, rangeBegin[range], rangeBegin[range + 1], data);
+        };
+
+        ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic) num_threads((int)numRanges)
+        for (int i = 0; i < (int)numRanges; ++i)
+            capture.SafeRun(loadRange, i);
+
+        for (auto& parser : m_chunkParsers)
+        {
+            m_hadWarnings |= parser->m_hadWarnings;
+            parser->m_hadWarnings = false;
+        }
+        capture.RethrowIfHappened();
+    }
+
+    // Sequence ids are positions in the chunk, so the map is filled in order.
+    for (size_t i = 0; i < sequences.size(); ++i)
     {
-        chunk->m_sequenceMap.insert(make_pair(
-            sequenceDescriptor.m_id,
-            LoadSequence(sequenceDescriptor)));
+        chunk->m_sequenceMap.emplace_hint(chunk->m_sequenceMap.end(), sequences[i].m_id, std::move(data[i]));
     }
 }
 
 template <class ElemType>
-void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
+void TextParser<ElemType>::LoadSequences(const ChunkDescriptor& descriptor, size_t begin, size_t end, vector<SequenceBuffer>& result)
 {
-    if (m_numAllowedErrors == 0)
+    for (size_t i = begin; i < end; ++i)
     {
-        PrintWarningNotification();
-        RuntimeError("Reached the maximum number of allowed errors"
-            " while reading the input file (%ls).",
-            m_filename.c_str());
+        result[i] = LoadSequence(descriptor.m_sequences[i]);
     }
-    --m_numAllowedErrors;
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryRefillBuffer()
+void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 {
-    size_t bytesRead = fread(m_buffer.get(), 1, BUFFER_SIZE, m_file);
-
-    if (bytesRead == (size_t)-1)
+    if (m_owner != nullptr)
     {
-        PrintWarningNotification();
-        RuntimeError("Could not read from the input file (%ls).", m_filename.c_str());
+        // helpers draw on the error budget of their owner.
+        std::lock_guard<std::mutex> lock(m_owner->m_errorsLock);
+        m_owner->m_hadWarnings |= m_hadWarnings;
+        m_owner->IncrementNumberOfErrorsOrDie();
+        return;
     }
 
-    if (!bytesRead)
+    if (m_numAllowedErrors == 0)
     {
-        return false;
+        PrintWarningNotification();
+        RuntimeError("Reached the maximum number of allowed errors"
+            " while reading the input file (%ls).",
+            m_filename.c_str());
     }
-
-    m_fileOffsetStart = m_fileOffsetEnd;
-    m_fileOffsetEnd += bytesRead;
-    m_bufferStart = m_buffer.get();
-    m_pos = m_bufferStart;
-    m_bufferEnd = m_bufferStart + bytesRead;
-    return true;
+    --m_numAllowedErrors;
 }
 
 template <class ElemType>
-void TextParser<ElemType>::SetFileOffset(int64_t offset)
+void TextParser<ElemType>::ReadChunk(const ChunkDescriptor& descriptor)
 {
+    assert(!descriptor.m_sequences.empty());
+    const auto& first = descriptor.m_sequences.front();
+    const auto& last = descriptor.m_sequences.back();
+    int64_t offset = first.m_fileOffsetBytes;
+    size_t size = (size_t)(last.m_fileOffsetBytes - offset) + last.m_byteSize;
+
     int rc = _fseeki64(m_file, offset, SEEK_SET);
     if (rc)
     {
@@ -348,10 +433,18 @@ void TextParser<ElemType>::SetFileOffset(int64_t offset)
             offset, m_filename.c_str());
     }
 
-    m_fileOffsetStart = offset;
-    m_fileOffsetEnd = offset;
+    m_buffer.resize(size);
+    if (fread(m_buffer.data(), 1, size, m_file) != size)
+    {
+        PrintWarningNotification();
+        RuntimeError("Could not read from the input file (%ls).", m_filename.c_str());
+    }
 
-    TryRefillBuffer();
+    m_fileOffsetStart = offset;
+    m_fileOffsetEnd = offset + size;
+    m_bufferStart = m_buffer.data();
+    m_bufferEnd = m_bufferStart + size;
+    m_pos = m_bufferStart;
 }
 
 template <class ElemType>
@@ -359,10 +452,8 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
 {
     auto fileOffset = sequenceDsc.m_fileOffsetBytes;
 
-    if (fileOffset < m_fileOffsetStart || fileOffset > m_fileOffsetEnd)
-    {
-        SetFileOffset(fileOffset);
-    }
+    // the whole sequence must have been read into the buffer by ReadChunk.
+    assert(fileOffset >= m_fileOffsetStart && fileOffset + (int64_t)sequenceDsc.m_byteSize <= m_fileOffsetEnd);
 
     size_t bufferOffset = fileOffset - m_fileOffsetStart;
     m_pos = m_bufferStart + bufferOffset;
@@ -955,7 +1046,25 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 
 
 
-// TODO: better precision (at the moment we're at parity with UCIFast)?
+// Powers of ten that are exactly representable as doubles.
+static const double s_powersOf10[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Number of significant decimal digits accumulated in the 64-bit mantissa,
+// the remaining ones only contribute to the exponent.
+const int MAX_MANTISSA_DIGITS = 19;
+
+// Exponent digits beyond this value cannot change the result.
+const int MAX_EXPONENT_VALUE = 100000;
+
+// Reads a number of the form [+-]digits[.[digits]][(e|E)[+-]digits].
+// Instead of a per-character state machine, each run of digits is consumed by
+// a tight loop that accumulates an integer mantissa and a decimal exponent,
+// and the value is scaled once at the end, which is exact for numbers with up to
+// 15 significant digits and a decimal exponent within +-22.
 // Assumes that bytesToRead is greater than the number of characters 
 // in the string representation of the floating point number
 // (i.e., the string is followed by one of the delimiters)
@@ -965,193 +1074,174 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 template <class ElemType>
 bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
 {
-    State state = State::Init;
-    double coefficient = .0, number = .0, divider = .0;
+    // The buffer holds the whole sequence, so the number lies within [m_pos, end).
+    const char* const end = m_pos + min(bytesToRead, (size_t)(m_bufferEnd - m_pos));
+    const char* p = m_pos;
+
+    auto moveTo = [this, &bytesToRead](const char* position)
+    {
+        bytesToRead -= position - m_pos;
+        m_pos = position;
+    };
+
+    auto exhausted = [this, &moveTo, end]()
+    {
+        moveTo(end);
+        if (ShouldWarn())
+        {
+            fprintf(stderr,
+                "WARNING: Exhausted all input expected for the current sequence"
+                " while reading a floating point value %ls.\n", GetFileInfo().c_str());
+        }
+        return false;
+    };
+
+    uint64_t mantissa = 0;
+    int numDigits = 0; // significant digits in the mantissa
+    int exponent = 0;  // value = mantissa * 10^exponent
+
+    // the number must either start with a number or a sign
     bool negative = false;
+    if (p != end && isSign(*p))
+    {
+        negative = (*p == '-');
+        ++p;
+    }
 
-    while (bytesToRead && CanRead())
+    if (p == end)
     {
-        char c = *m_pos;
+        return exhausted();
+    }
 
-        switch (state)
+    if (!isdigit(*p))
+    {
+        bool hasSign = (p != m_pos);
+        moveTo(p);
+        if (ShouldWarn())
         {
-        case State::Init:
-            // the number must either start with a number or a sign
-            if (isdigit(c))
+            if (hasSign)
             {
-                state = IntegralPart;
-                number = (c - '0');
-            }
-            else if (isSign(c))
-            {
-                state = Sign;
-                negative = (c == '-');
+                fprintf(stderr,
+                    "WARNING: A sign symbol is followed by an invalid character('%c')"
+                    " in a floating point value %ls.\n",
+                    *p, GetFileInfo().c_str());
             }
             else
             {
-                if (ShouldWarn())
-                {
-                    fprintf(stderr,
-                        "WARNING: Unexpected character ('%c')"
-                        " in a floating point value %ls.\n",
-                        c, GetFileInfo().c_str());
-                }
-                return false;
+                fprintf(stderr,
+                    "WARNING: Unexpected character ('%c')"
+                    " in a floating point value %ls.\n",
+                    *p, GetFileInfo().c_str());
             }
-            break;
-        case Sign:
-            // the sign must be followed by a number
-            if (isdigit(c))
+        }
+        return false;
+    }
+
+    // integral part
+    for (; p != end && isdigit(*p); ++p)
+    {
+        if (numDigits < MAX_MANTISSA_DIGITS)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            numDigits += (mantissa != 0);
+        }
+        else
+        {
+            ++exponent;
+        }
+    }
+
+    bool endsWithPeriod = false;
+    if (p != end && *p == '.')
+    {
+        ++p;
+        endsWithPeriod = (p != end && !isdigit(*p));
+
+        // fractional part
+        for (; p != end && isdigit(*p); ++p)
+        {
+            if (numDigits < MAX_MANTISSA_DIGITS)
             {
-                state = IntegralPart;
-                number = (c - '0');
+                mantissa = mantissa * 10 + (*p - '0');
+                numDigits += (mantissa != 0);
+                --exponent;
             }
-            else
+        }
+    }
+
+    // a period that is not followed by digits terminates the number
+    if (!endsWithPeriod && p != end && isE(*p))
+    {
+        // followed with optional minus or plus sign and nonempty sequence of decimal digits
+        ++p;
+        bool negativeExponent = false, hasExponentSign = false;
+        if (p != end && isSign(*p))
+        {
+            negativeExponent = (*p == '-');
+            hasExponentSign = true;
+            ++p;
+        }
+
+        if (p != end && !isdigit(*p))
+        {
+            moveTo(p);
+            if (ShouldWarn())
             {
-                if (ShouldWarn())
+                if (hasExponentSign)
                 {
                     fprintf(stderr,
-                        "WARNING: A sign symbol is followed by an invalid character('%c')"
-                        " in a floating point value %ls.\n",
-                        c, GetFileInfo().c_str());
-                }
-                return false;
-            }
-            break;
-        case IntegralPart:
-            if (isdigit(c))
-            {
-                number = number * 10 + (c - '0');
-            }
-            else if (c == '.')
-            {
-                state = Period;
-            }
-            else if (isE(c))
-            {
-                state = TheLetterE;
-                coefficient = (negative) ? -number : number;
-                number = 0;
-            }
-            else
-            {
-                value = static_cast<ElemType>((negative) ? -number : number);
-                return true;
-            }
-            break;
-        case Period:
-            if (isdigit(c))
-            {
-                state = FractionalPart;
-                coefficient = number;
-                number = (c - '0');
-                divider = 10;
-            }
-            else
-            {
-                value = static_cast<ElemType>((negative) ? -number : number);
-                return true;
-            }
-            break;
-        case FractionalPart:
-            if (isdigit(c))
-            {
-                // TODO: ignore if number of precision digits > FLT_[MANT_]DIG/DBL_[MANT_]DIG
-                // no state change
-                number = number * 10 + (c - '0');
-                divider *= 10;
-            }
-            else if (isE(c))
-            {
-                state = TheLetterE;
-                coefficient += (number / divider);
-                if (negative)
-                {
-                    coefficient = -coefficient;
+                        "WARNING: An exponent sign symbol followed by"
+                        " an unexpected character('%c')"
+                        " in a floating point value %ls.\n", *p, GetFileInfo().c_str());
                 }
-            }
-            else
-            {
-                coefficient += (number / divider);
-                value = static_cast<ElemType>((negative) ? -coefficient : coefficient);
-                return true;
-            }
-            break;
-        case TheLetterE:
-            // followed with optional minus or plus sign and nonempty sequence of decimal digits
-            if (isdigit(c))
-            {
-                state = Exponent;
-                negative = false;
-                number = (c - '0');
-            }
-            else if (isSign(c))
-            {
-                state = ExponentSign;
-                negative = (c == '-');
-            }
-            else
-            {
-                if (ShouldWarn())
+                else
                 {
                     fprintf(stderr,
                         "WARNING: An exponent symbol is followed by"
                         " an invalid character('%c')"
-                        " in a floating point value %ls.\n", c, GetFileInfo().c_str());
-                }
-                return false;
-            }
-            break;
-        case ExponentSign:
-            // exponent sign must be followed by a number
-            if (isdigit(c))
-            {
-                state = Exponent;
-                number = (c - '0');
-            }
-            else
-            {
-                if (ShouldWarn())
-                {
-                    fprintf(stderr,
-                        "WARNING: An exponent sign symbol followed by"
-                        " an unexpected character('%c')"
-                        " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                        " in a floating point value %ls.\n", *p, GetFileInfo().c_str());
                 }
-                return false;
-            }
-            break;
-        case Exponent:
-            if (isdigit(c))
-            {
-                // no state change
-                number = number * 10 + (c - '0');
             }
-            else
+            return false;
+        }
+
+        int exponentValue = 0;
+        for (; p != end && isdigit(*p); ++p)
+        {
+            if (exponentValue < MAX_EXPONENT_VALUE)
             {
-                // TODO: check the exponent value (see FLT_[MAX/MIN]_10_EXP).
-                double exponent = (negative) ? -number : number;
-                value = static_cast<ElemType>(coefficient * pow(10.0, exponent));
-                return true;
+                exponentValue = exponentValue * 10 + (*p - '0');
             }
-            break;
-        default:
-            LogicError("Reached an invalid state while reading a floating point value %ls.\n",
-                GetFileInfo().c_str());
         }
+        exponent += negativeExponent ? -exponentValue : exponentValue;
+    }
 
-        ++m_pos;
-        --bytesToRead;
+    if (p == end)
+    {
+        return exhausted();
     }
 
-    if (ShouldWarn())
+    moveTo(p);
+
+    double number = static_cast<double>(mantissa);
+    if (mantissa != 0 && exponent != 0)
     {
-        fprintf(stderr,
-            "WARNING: Exhausted all input expected for the current sequence"
-            " while reading a floating point value %ls.\n", GetFileInfo().c_str());
+        if (exponent < 0 && exponent >= -22)
+        {
+            number /= s_powersOf10[-exponent];
+        }
+        else if (exponent > 0 && exponent <= 22)
+        {
+            number *= s_powersOf10[exponent];
+        }
+        else
+        {
+            number *= pow(10.0, exponent);
+        }
     }
 
-    return false;
+    value = static_cast<ElemType>(negative ? -number : number);
+    return true;
 }
 
 template <class ElemType>
@@ -1184,6 +1274,18 @@ void TextParser<ElemType>::SetNumRetries(unsigned int numRetries)
     m_numRetries = numRetries;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::SetNumParserThreads(size_t numThreads)
+{
+    m_numParserThreads = numThreads ? numThreads : (size_t)omp_get_max_threads();
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetCacheIndex(bool cacheIndex)
+{
+    m_cacheIndex = cacheIndex;
+}
+
 template <class ElemType>
 std::wstring TextParser<ElemType>::GetFileInfo()
 {
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <mutex>
 #include "DataDeserializerBase.h"
 #include "Descriptors.h"
 #include "TextConfigHelper.h"
@@ -99,11 +100,12 @@ private:
 
     std::unique_ptr<Indexer> m_indexer;
 
+    // File offsets of the first and one past the last byte in the buffer.
     int64_t m_fileOffsetStart;
     int64_t m_fileOffsetEnd;
 
-    // TODO: not DRY (same in the Indexer), needs refactoring
-    unique_ptr<char[]> m_buffer;
+    // Contents of the chunk being loaded (all of its sequences are read with a single fread).
+    std::vector<char> m_buffer;
     const char* m_bufferStart;
     const char* m_bufferEnd;
     const char* m_pos; // buffer index
@@ -117,6 +119,14 @@ private:
     bool m_skipSequenceIds;
     unsigned int m_numRetries; // specifies the number of times an unsuccessful
     // file operation should be repeated (default value is 5).
+    size_t m_numParserThreads; // number of threads that index the input and parse a chunk.
+    bool m_cacheIndex; // if true, the index is saved to and loaded from a file next to the input.
+
+    // Helper parsers, one per thread, that parse ranges of sequences of a chunk concurrently.
+    // They share the buffer and the error budget of the parser that owns them.
+    std::vector<std::unique_ptr<TextParser>> m_chunkParsers;
+    TextParser* m_owner; // the parser this helper belongs to (nullptr if this is not a helper)
+    std::mutex m_errorsLock; // serializes error counting of the helpers
 
     // Corpus descriptor.
     CorpusDescriptorPtr m_corpus;
@@ -129,13 +139,12 @@ private:
     // have been swallowed.
     void PrintWarningNotification();
 
-    void SetFileOffset(int64_t position);
+    // Reads the byte range spanned by the sequences of the chunk into the buffer.
+    void ReadChunk(const ChunkDescriptor& descriptor);
 
     void SkipToNextValue(size_t& bytesToRead);
     void SkipToNextInput(size_t& bytesToRead);
 
-    bool TryRefillBuffer();
-
     int64_t GetFileOffset() const { return m_fileOffsetStart + (m_pos - m_bufferStart); }
 
     // Returns a string containing input file information (current offset, file name, etc.),
@@ -163,7 +172,7 @@ private:
     bool TryReadRow(SequenceBuffer& sequence, size_t& bytesToRead);
 
     // Returns true if there's still data available.
-    bool inline CanRead() { return m_pos != m_bufferEnd || TryRefillBuffer(); }
+    bool inline CanRead() { return m_pos != m_bufferEnd; }
 
     // Returns true if the trace level is greater or equal to 'Warning'
     bool inline ShouldWarn() { m_hadWarnings = true; return m_traceLevel >= Warning; }
@@ -171,11 +180,17 @@ private:
     // Given a descriptor, retrieves the data for the corresponding sequence from the file.
     SequenceBuffer LoadSequence(const SequenceDescriptor& descriptor);
 
+    // Parses the sequences [begin, end) of the chunk from the buffer.
+    void LoadSequences(const ChunkDescriptor& descriptor, size_t begin, size_t end, std::vector<SequenceBuffer>& result);
+
     // Given a descriptor, retrieves the data for the corresponding chunk from the file.
     void LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor);
 
     TextParser(CorpusDescriptorPtr corpus, const std::wstring& filename, const vector<StreamDescriptor>& streams);
 
+    // Creates a helper parser that parses the buffer of the owner.
+    explicit TextParser(TextParser* owner);
+
     void SetTraceLevel(unsigned int traceLevel);
 
     void SetMaxAllowedErrors(unsigned int maxErrors);
@@ -186,6 +201,10 @@ private:
 
     void SetNumRetries(unsigned int numRetries);
 
+    void SetNumParserThreads(size_t numThreads);
+
+    void SetCacheIndex(bool cacheIndex);
+
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
 
     const std::string& GetSequenceKey(const SequenceDescriptor& s) const;
@@ -65,6 +65,9 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryP
         m_packingMode = PackingMode::sequence;
     }
 
+    // Number of minibatches of sequences the sequence packer looks ahead to group sequences by length, 0 disables bucketing.
+    m_bucketingWindow = isActionWrite ? 0 : config(L"bucketingWindow", (size_t)0);
+
     m_precision = config("precision", "float");
 
     // Creating deserializers.
@@ -86,6 +89,7 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryP
     }
 
     int verbosity = config(L"verbosity", 0);
+    m_verbosity = verbosity;
 
     // Pick up the randomizer, always picking up no randomization for the write mode.
     bool randomize = isActionWrite ? false : config(L"randomize", false);
@@ -100,7 +104,11 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryP
         size_t randomizationWindow = config(L"randomizationWindow", requestDataSize);
         // By default using STL random number generator.
         bool useLegacyRandomization = config(L"useLegacyRandomization", false);
-        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, BlockRandomizer::DecimationMode::chunk, useLegacyRandomization, multiThreadedDeserialization);
+        // By default loading chunks only when the randomization window reaches them.
+        size_t chunkPrefetchCount = config(L"chunkPrefetchCount", (size_t)0);
+        size_t chunkPrefetchMaxSamples = config(L"chunkPrefetchMaxSamples", (size_t)SIZE_MAX);
+        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, BlockRandomizer::DecimationMode::chunk, useLegacyRandomization, multiThreadedDeserialization,
+            chunkPrefetchCount, chunkPrefetchMaxSamples);
     }
     else
     {
@@ -110,7 +118,7 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryP
     // In case when there are transforms, applying them to the data.
     m_sequenceEnumerator = m_transforms.empty()
         ? m_sequenceEnumerator 
-        : std::make_shared<TransformController>(m_transforms, m_sequenceEnumerator);
+        : std::make_shared<TransformController>(m_transforms, m_sequenceEnumerator, verbosity);
 
     // Create output stream descriptions - where to get those? from config? what if it is not the same as network expects?
     // TODO: Currently only dense output streams.
@@ -150,6 +158,7 @@ void CompositeDataReader::CreateDeserializers(const ConfigParameters& readerConf
         // TODO: Should go away in the future. Framing can be done on top of deserializers.
         ConfigParameters p = deserializerConfigs[i];
         p.Insert("frameMode", m_packingMode == PackingMode::sample ? "true" : "false");
+        p.Insert("truncated", m_packingMode == PackingMode::truncated ? "true" : "false");
         p.Insert("precision", m_precision);
 
         IDataDeserializerPtr d = CreateDeserializer(p, primary);
@@ -269,7 +278,9 @@ void CompositeDataReader::StartEpoch(const EpochConfiguration& cfg)
         m_packer = std::make_shared<SequencePacker>(
             m_provider,
             m_sequenceEnumerator,
-            m_streams);
+            m_streams,
+            m_bucketingWindow,
+            m_verbosity);
         break;
     case PackingMode::truncated:
     {
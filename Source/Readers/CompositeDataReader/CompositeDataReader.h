@@ -127,6 +127,11 @@ private:
 
     // Truncation length for BPTT mode.
     size_t m_truncationLength;
+
+    // Look-ahead window in minibatches for grouping sequences by length in the sequence mode.
+    size_t m_bucketingWindow;
+
+    int m_verbosity;
 };
 
 }}}
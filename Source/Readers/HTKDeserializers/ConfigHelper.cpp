@@ -217,10 +217,30 @@ wstring ConfigHelper::GetRandomizer()
     return randomizer;
 }
 
+wstring ConfigHelper::GetScpFilePath() const
+{
+    return m_config(L"scpFile");
+}
+
+wstring ConfigHelper::GetScpPathPrefix() const
+{
+    return m_config(L"prefixPathInSCP", L"");
+}
+
+bool ConfigHelper::ShouldCacheIndex() const
+{
+    return m_config(L"cacheIndex", false);
+}
+
+bool ConfigHelper::ShouldExpandContextOnDevice() const
+{
+    return m_config(L"expandContextOnDevice", false);
+}
+
 vector<wstring> ConfigHelper::GetSequencePaths()
 {
-    wstring scriptPath = m_config(L"scpFile");
-    wstring rootPath = m_config(L"prefixPathInSCP", L"");
+    wstring scriptPath = GetScpFilePath();
+    wstring rootPath = GetScpPathPrefix();
 
     vector<wstring> filelist;
     fprintf(stderr, "Reading script file %ls ...", scriptPath.c_str());
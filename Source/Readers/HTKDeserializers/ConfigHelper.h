@@ -52,6 +52,18 @@ public:
     // Gets utterance paths from the configuration.
     std::vector<std::wstring> GetSequencePaths();
 
+    // Gets the path of the script file that lists the utterances.
+    std::wstring GetScpFilePath() const;
+
+    // Gets the prefix that is prepended to the utterance paths of the script file.
+    std::wstring GetScpPathPrefix() const;
+
+    // Checks whether the parsed utterance paths should be cached next to the script file.
+    bool ShouldCacheIndex() const;
+
+    // Checks whether the context window should be added to the frames on the device instead of in the deserializer.
+    bool ShouldExpandContextOnDevice() const;
+
     // Gets randomization window.
     size_t GetRandomizationWindow();
 
@@ -8,6 +8,7 @@
 #include <inttypes.h>
 #include "HTKDataDeserializer.h"
 #include "ConfigHelper.h"
+#include "IndexCache.h"
 #include "Basics.h"
 #include <numeric>
 
@@ -59,6 +60,7 @@ HTKDataDeserializer::HTKDataDeserializer(
     InitializeStreams(inputName);
     InitializeFeatureInformation();
     InitializeAugmentationWindow(config);
+    InitializeContextExpansion(config, cfg(L"truncated", false));
 }
 
 HTKDataDeserializer::HTKDataDeserializer(
@@ -89,6 +91,7 @@ HTKDataDeserializer::HTKDataDeserializer(
     InitializeStreams(featureName);
     InitializeFeatureInformation();
     InitializeAugmentationWindow(config);
+    InitializeContextExpansion(config, feature(L"truncated", false));
 }
 
 void HTKDataDeserializer::InitializeAugmentationWindow(ConfigHelper& config)
@@ -103,19 +106,177 @@ void HTKDataDeserializer::InitializeAugmentationWindow(ConfigHelper& config)
     }
 }
 
+// Frames can be shipped without their context only if every sequence is a complete utterance in the minibatch:
+// the context of a frame is then available in its sequence, and the ReaderShim splices it on the device.
+// In frame mode and with truncated BPTT the frames are still augmented here.
+void HTKDataDeserializer::InitializeContextExpansion(ConfigHelper& config, bool truncated)
+{
+    m_expandContextOnDevice = false;
+    if (!config.ShouldExpandContextOnDevice() || (m_augmentationWindow.first == 0 && m_augmentationWindow.second == 0))
+    {
+        return;
+    }
+
+    if (m_frameMode || truncated)
+    {
+        fprintf(stderr, "HTKDataDeserializer: expandContextOnDevice is not supported in frame mode or with truncated BPTT, "
+            "the context window is added in the reader.\n");
+        return;
+    }
+
+    if (m_ioFeatureDimension * (1 + m_augmentationWindow.first + m_augmentationWindow.second) != m_dimension)
+    {
+        InvalidArgument("HTKDataDeserializer: the feature dimension %d does not match the context window of %d-dimensional frames.",
+            (int)m_dimension, (int)m_ioFeatureDimension);
+    }
+
+    m_expandContextOnDevice = true;
+    m_streams.front()->m_sampleLayout = make_shared<TensorShape>(m_ioFeatureDimension);
+    m_streams.front()->m_contextWindow = m_augmentationWindow;
+}
+
+// An utterance path as stored in the index cache.
+// The archive is an index into the table of archive paths stored along with the utterance paths.
+struct CachedUtterancePath
+{
+    uint32_t m_archive;
+    uint32_t m_flags;
+    uint64_t m_firstFrame;
+    uint64_t m_lastFrame;
+};
+
+static const uint32_t CachedPathIsArchive = 1;
+static const uint32_t CachedPathIsIdxFormat = 2;
+
+vector<msra::asr::htkfeatreader::parsedpath> HTKDataDeserializer::ReadUtterancePaths(ConfigHelper& config)
+{
+    typedef msra::asr::htkfeatreader::parsedpath parsedpath;
+
+    vector<parsedpath> result;
+    if (!config.ShouldCacheIndex())
+    {
+        vector<wstring> paths = config.GetSequencePaths();
+        result.reserve(paths.size());
+        for (const auto& u : paths)
+        {
+            result.push_back(parsedpath(u));
+        }
+        return result;
+    }
+
+    // The expansion of the paths depends on the prefix, so it is part of the signature.
+    IndexCache cache(config.GetScpFilePath(), "HTKDeserializer/1 " + msra::strfun::utf8(config.GetScpPathPrefix()));
+    bool loaded = cache.TryLoad([&result](FILE* f)
+    {
+        uint64_t numberOfArchives, numberOfPaths, logicalPathsSize;
+        vector<wstring> archives;
+        fget(f, numberOfArchives);
+        archives.reserve((size_t)numberOfArchives);
+        for (uint64_t i = 0; i < numberOfArchives; ++i)
+        {
+            archives.push_back(msra::strfun::utf16(fgetstring(f)));
+        }
+
+        vector<CachedUtterancePath> paths;
+        fget(f, numberOfPaths);
+        freadOrDie(paths, (size_t)numberOfPaths, f);
+
+        // logical paths, each terminated by '\0'
+        vector<char> logicalPaths;
+        fget(f, logicalPathsSize);
+        freadOrDie(logicalPaths, (size_t)logicalPathsSize, f);
+        if (!logicalPaths.empty() && logicalPaths.back() != '\0')
+        {
+            RuntimeError("malformed logical paths");
+        }
+
+        result.reserve(paths.size());
+        const char* logicalPath = logicalPaths.data();
+        const char* logicalPathsEnd = logicalPaths.data() + logicalPaths.size();
+        for (const auto& p : paths)
+        {
+            if (p.m_archive >= archives.size() || logicalPath == logicalPathsEnd)
+            {
+                RuntimeError("malformed utterance path");
+            }
+
+            string logical(logicalPath);
+            logicalPath += logical.size() + 1;
+            result.push_back(parsedpath(logical, archives[p.m_archive], (size_t)p.m_firstFrame, (size_t)p.m_lastFrame,
+                (p.m_flags & CachedPathIsArchive) != 0, (p.m_flags & CachedPathIsIdxFormat) != 0));
+        }
+    });
+
+    if (loaded)
+    {
+        fprintf(stderr, "Loaded %d utterance paths from %ls\n", (int)result.size(), cache.GetCachePath().c_str());
+        return result;
+    }
+
+    vector<wstring> paths = config.GetSequencePaths();
+    result.clear();
+    result.reserve(paths.size());
+    for (const auto& u : paths)
+    {
+        result.push_back(parsedpath(u));
+    }
+
+    cache.Save([&result](FILE* f)
+    {
+        // archive paths are stored in a table of their own, in the order of their first use
+        map<unsigned int, uint32_t> archiveToCached;
+        vector<unsigned int> archives;
+        vector<CachedUtterancePath> paths;
+        vector<char> logicalPaths;
+        paths.reserve(result.size());
+        for (const auto& u : result)
+        {
+            auto archive = archiveToCached.insert(make_pair(u.archivepathindex(), (uint32_t)archives.size()));
+            if (archive.second)
+            {
+                archives.push_back(u.archivepathindex());
+            }
+
+            CachedUtterancePath p;
+            p.m_archive = archive.first->second;
+            p.m_flags = (u.isarchivepath() ? CachedPathIsArchive : 0) | (u.isidxformatpath() ? CachedPathIsIdxFormat : 0);
+            p.m_firstFrame = u.firstframe();
+            p.m_lastFrame = u.lastframe();
+            paths.push_back(p);
+
+            const string& logical = u.logicalpathutf8();
+            logicalPaths.insert(logicalPaths.end(), logical.begin(), logical.end());
+            logicalPaths.push_back('\0');
+        }
+
+        fput(f, (uint64_t)archives.size());
+        for (auto a : archives)
+        {
+            fputstring(f, msra::strfun::utf8(parsedpath::archivePathStringVector[a]));
+        }
+
+        fput(f, (uint64_t)paths.size());
+        fwriteOrDie(paths, f);
+        fput(f, (uint64_t)logicalPaths.size());
+        fwriteOrDie(logicalPaths, f);
+    });
+
+    return result;
+}
+
 // Initializes chunks based on the configuration and utterance descriptions.
 void HTKDataDeserializer::InitializeChunkDescriptions(ConfigHelper& config)
 {
     // Read utterance descriptions.
-    vector<wstring> paths = config.GetSequencePaths();
+    auto paths = ReadUtterancePaths(config);
     vector<UtteranceDescription> utterances;
     utterances.reserve(paths.size());
     auto& stringRegistry = m_corpus->GetStringRegistry();
     size_t allUtterances = 0, allFrames = 0;
 
-    for (const auto& u : paths)
+    for (auto& u : paths)
     {
-        UtteranceDescription description(move(msra::asr::htkfeatreader::parsedpath(u)));
+        UtteranceDescription description(move(u));
         size_t numberOfFrames = description.GetNumberOfFrames();
 
         // For logging, also account for utterances and frames that we skip
@@ -470,9 +631,18 @@ void HTKDataDeserializer::GetSequenceById(ChunkIdType chunkId, size_t id, vector
 
     // wrapper that allows m[j].size() and m[j][i] as required by augmentneighbors()
     MatrixAsVectorOfVectors utteranceFramesWrapper(utteranceFrames);
-    FeatureMatrix features(m_dimension, m_frameMode ? 1 : utterance->GetNumberOfFrames());
+    FeatureMatrix features(m_expandContextOnDevice ? m_ioFeatureDimension : m_dimension, m_frameMode ? 1 : utterance->GetNumberOfFrames());
 
-    if (m_frameMode)
+    if (m_expandContextOnDevice)
+    {
+        // Only the frames of the utterance, the context is added on the device.
+        for (size_t frameIndex = 0; frameIndex < utterance->GetNumberOfFrames(); ++frameIndex)
+        {
+            auto fillIn = features.col(frameIndex);
+            CopyToOffset(utteranceFramesWrapper[frameIndex], fillIn, 0);
+        }
+    }
+    else if (m_frameMode)
     {
         // For frame mode augment a single frame.
         size_t frameIndex = id - chunkDescription.GetStartFrameIndexInsideChunk(utteranceIndex);
@@ -46,6 +46,11 @@ private:
     void InitializeStreams(const std::wstring& featureName);
     void InitializeFeatureInformation();
     void InitializeAugmentationWindow(ConfigHelper& config);
+    void InitializeContextExpansion(ConfigHelper& config, bool truncated);
+
+    // Reads the utterance paths listed in the script file, or restores them
+    // from the index cache next to the script file if it is enabled and up to date.
+    std::vector<msra::asr::htkfeatreader::parsedpath> ReadUtterancePaths(ConfigHelper& config);
 
     // Gets sequence by its chunk id and id inside the chunk.
     void GetSequenceById(ChunkIdType chunkId, size_t id, std::vector<SequenceDataPtr>&);
@@ -62,6 +67,9 @@ private:
     // Augmentation window.
     std::pair<size_t, size_t> m_augmentationWindow;
 
+    // Indicates whether the frames are shipped without their context, which is then added on the device.
+    bool m_expandContextOnDevice;
+
     CorpusDescriptorPtr m_corpus;
 
     // General configuration
@@ -113,7 +113,11 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
     // TODO: this should be bool. Change when config per deserializer is allowed.
     if (AreEqualIgnoreCase(readMethod, std::wstring(L"blockRandomize")))
     {
-        m_randomizer = std::make_shared<BlockRandomizer>(verbosity, window, bundler, BlockRandomizer::DecimationMode::chunk, true /* useLegacyRandomization */);
+        // Optionally loading chunks ahead of the randomization window in the background.
+        size_t chunkPrefetchCount = readerConfig(L"chunkPrefetchCount", (size_t)0);
+        size_t chunkPrefetchMaxSamples = readerConfig(L"chunkPrefetchMaxSamples", (size_t)SIZE_MAX);
+        m_randomizer = std::make_shared<BlockRandomizer>(verbosity, window, bundler, BlockRandomizer::DecimationMode::chunk, true /* useLegacyRandomization */,
+            false /* multithreadedGetNextSequences */, chunkPrefetchCount, chunkPrefetchMaxSamples);
     }
     else if (AreEqualIgnoreCase(readMethod, std::wstring(L"none")))
     {
@@ -197,6 +201,8 @@ void HTKMLFReader::StartEpoch(const EpochConfiguration& config)
         bpttConfig.m_epochIndex = config.m_epochIndex;
         bpttConfig.m_minibatchSizeInSamples = minibatchSize;
         bpttConfig.m_truncationSize = truncationLength;
+        bpttConfig.m_numberOfBuffers = config.m_numberOfBuffers;
+        bpttConfig.m_deviceId = config.m_deviceId;
 
         m_randomizer->StartEpoch(bpttConfig);
         m_packer->StartEpoch(bpttConfig);
@@ -422,21 +422,38 @@ public:
                 }
             }
 
+            archivePathIdx = archivepathindex(archivepath);
+            logicalpath = msra::strfun::utf8(localLogicalpath);
+        }
+
+        // constructor from the parts of an already parsed path (e.g. restored from an index cache)
+        parsedpath(const string& logicalpathutf8, const wstring& archivepath, size_t first, size_t last, bool archive, bool idxformat)
+            : logicalpath(logicalpathutf8), isarchive(archive), isidxformat(idxformat), s(first), e(last)
+        {
+            archivePathIdx = archivepathindex(archivepath);
+        }
+
+        // index of the archive path in archivePathStringVector; the path is added if not yet known
+        static unsigned int archivepathindex(const wstring& archivepath)
+        {
             auto iter = archivePathStringMap.find(archivepath);
             if (iter != archivePathStringMap.end())
-            {
-                archivePathIdx = iter->second;
-            }
-            else
-            {
-                archivePathIdx = (unsigned int)archivePathStringMap.size();
-                archivePathStringMap[archivepath] = archivePathIdx;
-                archivePathStringVector.push_back(archivepath);
-            }
+                return iter->second;
 
-            logicalpath = msra::strfun::utf8(localLogicalpath);
+            unsigned int idx = (unsigned int)archivePathStringMap.size();
+            archivePathStringMap[archivepath] = idx;
+            archivePathStringVector.push_back(archivepath);
+            return idx;
         }
 
+        // accessors for the parts of the path, see the constructor above
+        const string& logicalpathutf8() const { return logicalpath; }
+        unsigned int archivepathindex() const { return archivePathIdx; }
+        bool isarchivepath() const { return isarchive; }
+        bool isidxformatpath() const { return isidxformat; }
+        size_t firstframe() const { return s; }
+        size_t lastframe() const { return e; }
+
         // get the physical path for 'make' test
         wstring physicallocation() const
         {
@@ -10,6 +10,8 @@
 #include <zip.h>
 #include <unordered_map>
 #include <memory>
+#include <vector>
+#include <stdint.h>
 #include "ConcStack.h"
 #endif
 
@@ -22,7 +24,8 @@ public:
     virtual ~ByteReader() = default;
 
     virtual void Register(size_t seqId, const std::string& path) = 0;
-    virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) = 0;
+    // Reads and decodes the image, 'readFlags' are the flags of cv::imread, i.e. color and reduction.
+    virtual cv::Mat Read(size_t seqId, const std::string& path, int readFlags) = 0;
 
     DISABLE_COPY_AND_MOVE(ByteReader);
 };
@@ -31,25 +34,60 @@ class FileByteReader : public ByteReader
 {
 public:
     void Register(size_t, const std::string&) override {}
-    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
+    cv::Mat Read(size_t seqId, const std::string& path, int readFlags) override;
 };
 
 #ifdef USE_ZIP
+// Reads images from a .zip container.
+// The central directory of the archive is parsed once into a table of entries sorted by name, which is cached
+// next to the archive (see IndexCache). Stored (uncompressed) entries are read directly from the file with
+// positional reads, so any number of threads can read from the same archive without sharing state;
+// only compressed entries go through libzip.
 class ZipByteReader : public ByteReader
 {
 public:
     ZipByteReader(const std::string& zipPath);
+    ~ZipByteReader();
 
     void Register(size_t seqId, const std::string& path) override;
-    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
+    cv::Mat Read(size_t seqId, const std::string& path, int readFlags) override;
 
 private:
+    // An entry of the central directory.
+    struct ZipEntry
+    {
+        uint64_t m_localHeaderOffset;
+        uint64_t m_compressedSize;
+        uint64_t m_nameOffset;  // offset of the name in m_names
+        uint32_t m_index;       // index in the central directory, the same as used by libzip
+        uint32_t m_nameLength;
+        uint32_t m_stored;      // not compressed and not encrypted
+        uint32_t m_reserved;
+    };
+
+    void LoadIndex();
+    void ReadCentralDirectory();
+
+    // Reads 'size' bytes at 'offset' of the archive, can be called concurrently.
+    void ReadAt(uint64_t offset, void* buffer, size_t size) const;
+
     using ZipPtr = std::unique_ptr<zip_t, void(*)(zip_t*)>;
     ZipPtr OpenZip();
 
     std::string m_zipPath;
+#ifdef _WIN32
+    HANDLE m_file;
+#else
+    int m_file;
+#endif
+    uint64_t m_fileSize;
+
+    // Entries sorted by name, the names are stored one after another in m_names.
+    std::vector<ZipEntry> m_entries;
+    std::vector<char> m_names;
+
     conc_stack<ZipPtr> m_zips;
-    std::unordered_map<size_t, std::pair<zip_uint64_t, zip_uint64_t>> m_seqIdToIndex;
+    std::unordered_map<size_t, size_t> m_seqIdToEntry;
     conc_stack<std::vector<unsigned char>> m_workspace;
 };
 #endif
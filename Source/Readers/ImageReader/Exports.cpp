@@ -13,6 +13,7 @@
 #include "HeapMemoryProvider.h"
 #include "ImageDataDeserializer.h"
 #include "ImageTransformers.h"
+#include "ImageConfigHelper.h"
 #include "CorpusDescriptor.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -63,6 +64,11 @@ extern "C" DATAREADER_API bool CreateTransformer(Transformer** transformer, cons
         *transformer = new MeanTransformer(config);
     else if (type == L"Transpose")
         *transformer = new TransposeTransformer(config);
+    else if (type == L"Fused")
+    {
+        std::string mbFormat = config("mbFormat", "nchw");
+        *transformer = new FusedImageTransformer(config, ImageConfigHelper::ParseDataFormat(mbFormat));
+    }
     else
         // Unknown type.
         return false;
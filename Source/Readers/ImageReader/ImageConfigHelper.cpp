@@ -4,6 +4,8 @@
 //
 
 #include "stdafx.h"
+#include <algorithm>
+#include <cmath>
 #include "ImageConfigHelper.h"
 #include "StringUtil.h"
 #include "ConfigUtil.h"
@@ -30,15 +32,7 @@ ImageConfigHelper::ImageConfigHelper(const ConfigParameters& config)
     size_t h = featureSection("height");
     size_t c = featureSection("channels");
 
-    std::string mbFmt = featureSection("mbFormat", "nchw");
-    if (AreEqualIgnoreCase(mbFmt, "nhwc") || AreEqualIgnoreCase(mbFmt, "legacy"))
-    {
-        m_dataFormat = HWC;
-    }
-    else if (!AreEqualIgnoreCase(mbFmt, "nchw") || AreEqualIgnoreCase(mbFmt, "cudnn"))
-    {
-        RuntimeError("ImageReader does not support the sample format '%s', only 'nchw' and 'nhwc' are supported.", mbFmt.c_str());
-    }
+    m_dataFormat = ParseDataFormat(featureSection("mbFormat", "nchw"));
 
     auto features = std::make_shared<StreamDescription>();
     features->m_id = 0;
@@ -95,6 +89,10 @@ ImageConfigHelper::ImageConfigHelper(const ConfigParameters& config)
     m_cpuThreadCount = config(L"numCPUThreads", 0);
 
     m_cropType = ParseCropType(featureSection(L"cropType", ""));
+
+    m_decodeDownscale = featureSection(L"decodeDownscale", false);
+    m_minimumImageSide = GetMinimumImageSide(featureSection, featureSection);
+    m_fuseTransforms = featureSection(L"fuseTransforms", true);
 }
 
 std::vector<StreamDescriptionPtr> ImageConfigHelper::GetStreams() const
@@ -119,6 +117,50 @@ std::string ImageConfigHelper::GetMapPath() const
     return m_mapPath;
 }
 
+ImageLayoutKind ImageConfigHelper::ParseDataFormat(const std::string &src)
+{
+    if (AreEqualIgnoreCase(src, "nhwc") || AreEqualIgnoreCase(src, "legacy"))
+    {
+        return HWC;
+    }
+
+    if (!AreEqualIgnoreCase(src, "nchw") || AreEqualIgnoreCase(src, "cudnn"))
+    {
+        RuntimeError("ImageReader does not support the sample format '%s', only 'nchw' and 'nhwc' are supported.", src.c_str());
+    }
+
+    return CHW;
+}
+
+size_t ImageConfigHelper::GetMinimumImageSide(const ConfigParameters& cropConfig, const ConfigParameters& scaleConfig)
+{
+    if (!scaleConfig.ExistsCurrent(L"width") || !scaleConfig.ExistsCurrent(L"height"))
+    {
+        return 0;
+    }
+
+    size_t width = scaleConfig(L"width");
+    size_t height = scaleConfig(L"height");
+
+    // The crop is a fraction of the shorter side of the image, and the aspect ratio jitter
+    // can shrink one side of the crop by up to sqrt(1 - radius).
+    floatargvector cropRatio = cropConfig(L"cropRatio", "1.0");
+    doubleargvector aspectRatioRadius = cropConfig(L"aspectRatioRadius", ConfigParameters::Array(doubleargvector(vector<double>{0.0})));
+    double maxRadius = 0;
+    for (size_t i = 0; i < aspectRatioRadius.size(); ++i)
+    {
+        maxRadius = std::max(maxRadius, aspectRatioRadius[i]);
+    }
+
+    double ratio = std::min((double)cropRatio[0], (double)cropRatio[1]) * std::sqrt(std::max(0.0, 1 - maxRadius));
+    if (ratio <= 0)
+    {
+        return 0;
+    }
+
+    return (size_t)std::ceil(std::max(width, height) / ratio);
+}
+
 CropType ImageConfigHelper::ParseCropType(const std::string &src)
 {
     if (src.empty() || AreEqualIgnoreCase(src, "center"))
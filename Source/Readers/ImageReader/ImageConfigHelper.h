@@ -70,6 +70,28 @@ public:
 
     static CropType ParseCropType(const std::string &src);
 
+    static ImageLayoutKind ParseDataFormat(const std::string &src);
+
+    // Smallest side a decoded image can have so that cropping and scaling it with the given configuration
+    // does not upscale it; 0 if the configuration does not contain the target size.
+    static size_t GetMinimumImageSide(const ConfigParameters& cropConfig, const ConfigParameters& scaleConfig);
+
+    bool ShouldDownscaleOnDecode() const
+    {
+        return m_decodeDownscale;
+    }
+
+    size_t GetMinimumImageSide() const
+    {
+        return m_minimumImageSide;
+    }
+
+    // Whether the transformations are applied in a single pass (FusedImageTransformer) or as a chain of transformers.
+    bool ShouldFuseTransforms() const
+    {
+        return m_fuseTransforms;
+    }
+
 private:
     ImageConfigHelper(const ImageConfigHelper&) = delete;
     ImageConfigHelper& operator=(const ImageConfigHelper&) = delete;
@@ -81,6 +103,9 @@ private:
     bool m_randomize;
     bool m_grayscale;
     CropType m_cropType;
+    bool m_decodeDownscale;
+    size_t m_minimumImageSide;
+    bool m_fuseTransforms;
 };
 
 typedef std::shared_ptr<ImageConfigHelper> ImageConfigHelperPtr;
@@ -14,6 +14,11 @@
 #include "StringUtil.h"
 #include "ConfigUtil.h"
 
+// Decoding of reduced images (cv::IMREAD_REDUCED_*) is available starting with OpenCV 3.1.
+#if CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 1)
+#define HAS_REDUCED_DECODE
+#endif
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 class ImageDataDeserializer::LabelGenerator
@@ -166,6 +171,29 @@ ImageDataDeserializer::ImageDataDeserializer(CorpusDescriptorPtr corpus, const C
     // TODO: randomizer to collect how many copies each transform needs and request same sequence several times.
     bool multiViewCrop = config(L"multiViewCrop", false);
     CreateSequenceDescriptions(corpus, config(L"file"), labelDimension, multiViewCrop);
+
+    // The size the images can be reduced to on decoding is given by the crop and scale transforms of the feature stream.
+    bool decodeDownscale = featureSection(L"decodeDownscale", false);
+    size_t minimumImageSide = 0;
+    if (decodeDownscale)
+    {
+        argvector<ConfigParameters> transforms = featureSection("transforms");
+        int cropIndex = -1;
+        int scaleIndex = -1;
+        for (int i = 0; i < (int)transforms.size(); ++i)
+        {
+            std::wstring type = transforms[i](L"type", L"");
+            if (type == L"Crop" || type == L"Fused")
+                cropIndex = i;
+            if (type == L"Scale" || type == L"Fused")
+                scaleIndex = i;
+        }
+
+        if (scaleIndex >= 0)
+            minimumImageSide = ImageConfigHelper::GetMinimumImageSide(transforms[cropIndex >= 0 ? cropIndex : scaleIndex], transforms[scaleIndex]);
+    }
+
+    InitializeDecodeDownscale(decodeDownscale, minimumImageSide);
 }
 
 // TODO: Should be removed at some point.
@@ -203,6 +231,27 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     }
 
     CreateSequenceDescriptions(std::make_shared<CorpusDescriptor>(), configHelper.GetMapPath(), labelDimension, configHelper.IsMultiViewCrop());
+    InitializeDecodeDownscale(configHelper.ShouldDownscaleOnDecode(), configHelper.GetMinimumImageSide());
+}
+
+void ImageDataDeserializer::InitializeDecodeDownscale(bool enabled, size_t minimumImageSide)
+{
+    m_minimumImageSide = minimumImageSide;
+    if (!enabled)
+    {
+        return;
+    }
+
+    if (minimumImageSide == 0)
+    {
+        InvalidArgument("decodeDownscale requires the width and height of the scale transformation.");
+    }
+
+#ifdef HAS_REDUCED_DECODE
+    m_originalImageSides.assign(m_imageSequences.size(), 0);
+#else
+    fprintf(stderr, "WARNING: decodeDownscale requires OpenCV 3.1 or later, images are decoded in full size.\n");
+#endif
 }
 
 // Descriptions of chunks exposed by the image reader.
@@ -344,21 +393,51 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
 #endif
 }
 
+// Reads the image. With decode-time downscaling, the first read of an image decodes it in full size
+// and remembers its size, later reads decode it already reduced (for JPEG in the DCT domain, which is
+// several times faster than decoding the full image), as long as the crop and scale transformations
+// do not need to upscale the reduced image.
 cv::Mat ImageDataDeserializer::ReadImage(size_t seqId, const std::string& path, bool grayscale)
 {
     assert(!path.empty());
 
+    int readFlags = GetReadFlags(seqId, grayscale);
+    cv::Mat image;
     ImageDataDeserializer::SeqReaderMap::const_iterator r;
     if (m_readers.empty() || (r = m_readers.find(seqId)) == m_readers.end())
-        return m_defaultReader.Read(seqId, path, grayscale);
-    return (*r).second->Read(seqId, path, grayscale);
+        image = m_defaultReader.Read(seqId, path, readFlags);
+    else
+        image = (*r).second->Read(seqId, path, readFlags);
+
+    if (!m_originalImageSides.empty() && m_originalImageSides[seqId] == 0 && image.data)
+        m_originalImageSides[seqId] = std::min(image.rows, image.cols);
+    return image;
+}
+
+int ImageDataDeserializer::GetReadFlags(size_t seqId, bool grayscale) const
+{
+#ifdef HAS_REDUCED_DECODE
+    if (!m_originalImageSides.empty() && m_originalImageSides[seqId] != 0)
+    {
+        size_t side = m_originalImageSides[seqId];
+        if (side / 8 >= m_minimumImageSide)
+            return grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+        if (side / 4 >= m_minimumImageSide)
+            return grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+        if (side / 2 >= m_minimumImageSide)
+            return grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+    }
+#else
+    UNUSED(seqId);
+#endif
+    return grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
 }
 
-cv::Mat FileByteReader::Read(size_t, const std::string& path, bool grayscale)
+cv::Mat FileByteReader::Read(size_t, const std::string& path, int readFlags)
 {
     assert(!path.empty());
 
-    return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    return cv::imread(path, readFlags);
 }
 
 bool ImageDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
@@ -75,6 +75,17 @@ private:
     void RegisterByteReader(size_t seqId, const std::string& path, PathReaderMap& knownReaders);
     cv::Mat ReadImage(size_t seqId, const std::string& path, bool grayscale);
 
+    // Decode-time downscaling, see ReadImage.
+    void InitializeDecodeDownscale(bool enabled, size_t minimumImageSide);
+    int GetReadFlags(size_t seqId, bool grayscale) const;
+
+    // Smallest side a decoded image may have, given the crop and scale transformations.
+    size_t m_minimumImageSide;
+
+    // Shorter side of each image in full size, 0 if not yet known; only used with decode-time downscaling.
+    // Each element is only accessed by the thread that decodes the corresponding sequence.
+    std::vector<int> m_originalImageSides;
+
     // REVIEW alexeyk: can potentially use vector instead of map. Need to handle default reader and resizing though.
     using SeqReaderMap = std::unordered_map<size_t, std::shared_ptr<ByteReader>>;
     SeqReaderMap m_readers;
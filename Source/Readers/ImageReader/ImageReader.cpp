@@ -59,16 +59,25 @@ ImageReader::ImageReader(MemoryProviderPtr provider,
     std::wstring featureName = m_streams[configHelper.GetFeatureStreamId()]->m_name;
     ConfigParameters featureStream = config(featureName);
 
+    // Crop, scale, color, intensity, mean and transpose transformations are applied in a single pass per image,
+    // unless fuseTransforms=false asks for the chain of separate transformers.
     std::vector<Transformation> transformations;
-    transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
-
-    if (configHelper.GetDataFormat() == CHW)
+    if (configHelper.ShouldFuseTransforms())
+    {
+        transformations.push_back(Transformation{ std::make_shared<FusedImageTransformer>(featureStream, configHelper.GetDataFormat()), featureName });
+    }
+    else
     {
-        transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
+
+        if (configHelper.GetDataFormat() == CHW)
+        {
+            transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        }
     }
 
     m_sequenceEnumerator = std::make_shared<TransformController>(transformations, randomizer);
@@ -326,12 +326,17 @@ StreamDescription ScaleTransformer::Transform(const StreamDescription& inputStre
 void ScaleTransformer::Apply(size_t id, cv::Mat &mat)
 {
     UNUSED(id);
+    Scale(mat, mat);
+}
 
+void ScaleTransformer::Scale(const cv::Mat &from, cv::Mat &to)
+{
     // If matrix has not been converted to the right type, do it now as rescaling
     // requires floating point type.
-    if (mat.type() != CV_MAKETYPE(m_imageElementType, m_imgChannels))
+    cv::Mat converted = from;
+    if (from.type() != CV_MAKETYPE(m_imageElementType, m_imgChannels))
     {
-        mat.convertTo(mat, m_imageElementType);
+        from.convertTo(converted, m_imageElementType);
     }
 
     auto seed = GetSeed();
@@ -339,7 +344,7 @@ void ScaleTransformer::Apply(size_t id, cv::Mat &mat)
 
     auto index = UniIntT(0, static_cast<int>(m_interp.size()) - 1)(*rng);
     assert(m_interp.size() > 0);
-    cv::resize(mat, mat, cv::Size((int)m_imgWidth, (int)m_imgHeight), 0, 0, m_interp[index]);
+    cv::resize(converted, to, cv::Size((int)m_imgWidth, (int)m_imgHeight), 0, 0, m_interp[index]);
 
     m_rngs.push(std::move(rng));
 }
@@ -384,7 +389,7 @@ void MeanTransformer::Apply(size_t id, cv::Mat &mat)
     // REVIEW alexeyk: check type conversion (float/double).
     if (m_meanImg.size() == mat.size())
     {
-        mat = mat - m_meanImg;
+        cv::subtract(mat, m_meanImg, mat);
     }
 }
 
@@ -648,4 +653,115 @@ void ColorTransformer::Apply(cv::Mat &mat)
     m_rngs.push(std::move(rng));
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A sequence that returns its buffer to the pool of the fused transformer once the packer is done with it.
+struct PooledImageSequenceData : DenseSequenceData
+{
+    explicit PooledImageSequenceData(const std::shared_ptr<conc_stack<std::vector<char>>>& pool) : m_pool(pool)
+    {
+    }
+
+    ~PooledImageSequenceData()
+    {
+        m_pool->push(std::move(m_buffer));
+    }
+
+    std::vector<char> m_buffer;
+    std::shared_ptr<conc_stack<std::vector<char>>> m_pool;
+};
+
+FusedImageTransformer::FusedImageTransformer(const ConfigParameters& config, ImageLayoutKind outputFormat)
+    : m_crop(config), m_scale(config), m_color(config), m_intensity(config), m_mean(config),
+      m_outputFormat(outputFormat),
+      m_buffers(std::make_shared<conc_stack<std::vector<char>>>())
+{
+}
+
+void FusedImageTransformer::StartEpoch(const EpochConfiguration &config)
+{
+    // Some of the transformers override StartEpoch privately.
+    for (Transformer* t : std::initializer_list<Transformer*>{ &m_crop, &m_scale, &m_color, &m_intensity, &m_mean })
+    {
+        t->StartEpoch(config);
+    }
+}
+
+// The method describes how input stream is transformed to the output stream. Called once per applied stream.
+// The output stream has the dimensions of the scale transformation in the requested output format.
+StreamDescription FusedImageTransformer::Transform(const StreamDescription& inputStream)
+{
+    m_inputStream = inputStream;
+    StreamDescription stream = m_crop.Transform(inputStream);
+    stream = m_scale.Transform(stream);
+    stream = m_color.Transform(stream);
+    stream = m_intensity.Transform(stream);
+    stream = m_mean.Transform(stream);
+
+    ImageDimensions dimensions(*stream.m_sampleLayout, HWC);
+    m_outputStream = stream;
+    m_outputStream.m_sampleLayout = std::make_shared<TensorShape>(dimensions.AsTensorShape(m_outputFormat));
+    return m_outputStream;
+}
+
+SequenceDataPtr FusedImageTransformer::Transform(SequenceDataPtr sequence)
+{
+    const auto& inputSequence = static_cast<const DenseSequenceData&>(*sequence);
+    assert(inputSequence.m_numberOfSamples == 1);
+
+    ImageDimensions dimensions(*inputSequence.m_sampleLayout, HWC);
+    int type = CV_MAKETYPE(m_crop.m_imageElementType, static_cast<int>(dimensions.m_numChannels));
+    cv::Mat image(static_cast<int>(dimensions.m_height), static_cast<int>(dimensions.m_width), type, inputSequence.m_data);
+
+    // Cropping only changes the view of the decoded image, so the first copy is made by scaling.
+    static_cast<ImageTransformerBase&>(m_crop).Apply(sequence->m_id, image);
+    auto scaled = m_scaled.pop_or_create([]() { return std::make_unique<cv::Mat>(); });
+    m_scale.Scale(image, *scaled);
+    static_cast<ImageTransformerBase&>(m_color).Apply(sequence->m_id, *scaled);
+    static_cast<ImageTransformerBase&>(m_intensity).Apply(sequence->m_id, *scaled);
+    static_cast<ImageTransformerBase&>(m_mean).Apply(sequence->m_id, *scaled);
+    assert(scaled->isContinuous());
+
+    auto result = std::make_shared<PooledImageSequenceData>(m_buffers);
+    result->m_buffer = m_buffers->pop_or_create([]() { return std::vector<char>(); });
+    result->m_buffer.resize(m_outputStream.m_sampleLayout->GetNumElements() * GetSizeByType(m_outputStream.m_elementType));
+    if (m_outputStream.m_elementType == ElementType::tdouble)
+    {
+        CopyToOutput<double>(*scaled, result->m_buffer.data());
+    }
+    else
+    {
+        CopyToOutput<float>(*scaled, result->m_buffer.data());
+    }
+    m_scaled.push(std::move(scaled));
+
+    result->m_sampleLayout = m_outputStream.m_sampleLayout;
+    result->m_data = result->m_buffer.data();
+    result->m_numberOfSamples = inputSequence.m_numberOfSamples;
+    return result;
+}
+
+// Copies the image into the output buffer, transposing it from HWC to CHW if needed.
+template <class TElement>
+void FusedImageTransformer::CopyToOutput(const cv::Mat &image, char* output) const
+{
+    size_t rowCount = image.rows * image.cols;
+    size_t channelCount = image.channels();
+    auto src = reinterpret_cast<const TElement*>(image.ptr());
+    auto dst = reinterpret_cast<TElement*>(output);
+    if (m_outputFormat == HWC)
+    {
+        memcpy(dst, src, rowCount * channelCount * sizeof(TElement));
+        return;
+    }
+
+    for (size_t irow = 0; irow < rowCount; irow++)
+    {
+        for (size_t icol = 0; icol < channelCount; icol++)
+        {
+            dst[icol * rowCount + irow] = src[irow * channelCount + icol];
+        }
+    }
+}
+
 }}}
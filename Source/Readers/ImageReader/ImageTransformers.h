@@ -48,6 +48,9 @@ protected:
     virtual void Apply(size_t id, cv::Mat &from) = 0;
 
 protected:
+    // The fused transformer applies the image transformations directly on its own buffers.
+    friend class FusedImageTransformer;
+
     StreamDescription m_inputStream;
     StreamDescription m_outputStream;
     unsigned int m_seed;
@@ -99,8 +102,13 @@ public:
     StreamDescription Transform(const StreamDescription& inputStream) override;
 
 private:
+    friend class FusedImageTransformer;
+
     void Apply(size_t id, cv::Mat &mat) override;
 
+    // Scales 'from' into 'to', reusing the memory of 'to' if it is already of the target size.
+    void Scale(const cv::Mat &from, cv::Mat &to);
+
     using StrToIntMapT = std::unordered_map<std::string, int>;
     StrToIntMapT m_interpMap;
     std::vector<int> m_interp;
@@ -196,4 +204,40 @@ private:
     conc_stack<std::unique_ptr<cv::Mat>> m_hsvTemp;
 };
 
+// Applies crop, scale, color, intensity and mean transformations and the transposition to the output format
+// in a single pass per image, with the same parameters and results as the corresponding chain of transformers.
+// Intermediate images are kept in per-thread buffers and the output is written directly into a buffer
+// from a pool, which gets the buffer back when the sequence is released, so no memory is allocated per image
+// in the steady state.
+class FusedImageTransformer : public Transformer
+{
+public:
+    FusedImageTransformer(const ConfigParameters& config, ImageLayoutKind outputFormat);
+
+    void StartEpoch(const EpochConfiguration &config) override;
+
+    // Transformation of the stream.
+    StreamDescription Transform(const StreamDescription& inputStream) override;
+
+    // Transformation of the sequence.
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override;
+
+private:
+    template <class TElement>
+    void CopyToOutput(const cv::Mat &image, char* output) const;
+
+    CropTransformer m_crop;
+    ScaleTransformer m_scale;
+    ColorTransformer m_color;
+    IntensityTransformer m_intensity;
+    MeanTransformer m_mean;
+    ImageLayoutKind m_outputFormat;
+
+    StreamDescription m_inputStream;
+    StreamDescription m_outputStream;
+
+    conc_stack<std::unique_ptr<cv::Mat>> m_scaled;
+    std::shared_ptr<conc_stack<std::vector<char>>> m_buffers;
+};
+
 }}}
@@ -4,13 +4,47 @@
 //
 
 #include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 #include "ByteReader.h"
 
 #ifdef USE_ZIP
 
+#include "IndexCache.h"
+#include "fileutil.h"
+#include "StringUtil.h"
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Signatures and sizes of the .zip records, see the .ZIP File Format Specification (APPNOTE.TXT).
+static const uint32_t ZipLocalHeaderSignature = 0x04034b50;
+static const uint32_t ZipCentralHeaderSignature = 0x02014b50;
+static const uint32_t ZipEndOfCentralDirectorySignature = 0x06054b50;
+static const uint32_t Zip64EndOfCentralDirectorySignature = 0x06064b50;
+static const uint32_t Zip64EndOfCentralDirectoryLocatorSignature = 0x07064b50;
+static const size_t ZipLocalHeaderSize = 30;
+static const size_t ZipCentralHeaderSize = 46;
+static const size_t ZipEndOfCentralDirectorySize = 22;
+static const size_t Zip64EndOfCentralDirectorySize = 56;
+static const size_t Zip64EndOfCentralDirectoryLocatorSize = 20;
+static const size_t ZipMaxCommentSize = 0xFFFF;
+
+// The records are little endian.
+template <class T>
+static T GetField(const char* record, size_t offset)
+{
+    T value;
+    memcpy(&value, record + offset, sizeof(T));
+    return value;
+}
+
 std::string GetZipError(int err)
 {
     zip_error_t error;
@@ -24,6 +58,247 @@ ZipByteReader::ZipByteReader(const std::string& zipPath)
     : m_zipPath(zipPath)
 {
     assert(!m_zipPath.empty());
+
+#ifdef _WIN32
+    m_file = CreateFileW(msra::strfun::utf16(m_zipPath).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        RuntimeError("Failed to open %s, error %x", m_zipPath.c_str(), GetLastError());
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        CloseHandle(m_file);
+        RuntimeError("Failed to get the size of %s, error %x", m_zipPath.c_str(), GetLastError());
+    }
+    m_fileSize = size.QuadPart;
+#else
+    m_file = open(m_zipPath.c_str(), O_RDONLY);
+    if (m_file == -1)
+        RuntimeError("Failed to open %s", m_zipPath.c_str());
+
+    struct stat info;
+    if (fstat(m_file, &info) == -1)
+    {
+        close(m_file);
+        RuntimeError("Failed to get the size of %s", m_zipPath.c_str());
+    }
+    m_fileSize = info.st_size;
+#endif
+
+    try
+    {
+        LoadIndex();
+    }
+    catch (...)
+    {
+#ifdef _WIN32
+        CloseHandle(m_file);
+#else
+        close(m_file);
+#endif
+        throw;
+    }
+}
+
+ZipByteReader::~ZipByteReader()
+{
+#ifdef _WIN32
+    CloseHandle(m_file);
+#else
+    close(m_file);
+#endif
+}
+
+void ZipByteReader::ReadAt(uint64_t offset, void* buffer, size_t size) const
+{
+    if (offset + size > m_fileSize)
+        RuntimeError("Invalid zip file %s: record at %" PRIu64 " is outside of the file", m_zipPath.c_str(), offset);
+
+    char* p = static_cast<char*>(buffer);
+    while (size > 0)
+    {
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD bytesRead = 0;
+        DWORD toRead = (DWORD)std::min(size, (size_t)0x40000000);
+        if (!ReadFile(m_file, p, toRead, &bytesRead, &overlapped) || bytesRead == 0)
+            RuntimeError("Failed to read %" PRIu64 " bytes at %" PRIu64 " from %s, error %x", (uint64_t)size, offset, m_zipPath.c_str(), GetLastError());
+#else
+        ssize_t bytesRead = pread(m_file, p, size, (off_t)offset);
+        if (bytesRead <= 0)
+        {
+            if (bytesRead == -1 && errno == EINTR)
+                continue;
+            RuntimeError("Failed to read %" PRIu64 " bytes at %" PRIu64 " from %s", (uint64_t)size, offset, m_zipPath.c_str());
+        }
+#endif
+        p += bytesRead;
+        offset += bytesRead;
+        size -= bytesRead;
+    }
+}
+
+// Loads the entry table from the cache, or reads the central directory and caches the table.
+void ZipByteReader::LoadIndex()
+{
+    IndexCache cache(msra::strfun::utf16(m_zipPath), "ZipByteReader/1");
+    bool loaded = cache.TryLoad([this](FILE* f)
+    {
+        uint64_t numberOfEntries, namesSize;
+        fget(f, numberOfEntries);
+        freadOrDie(m_entries, (size_t)numberOfEntries, f);
+        fget(f, namesSize);
+        freadOrDie(m_names, (size_t)namesSize, f);
+        for (const auto& e : m_entries)
+        {
+            if (e.m_nameOffset + e.m_nameLength > m_names.size())
+                RuntimeError("malformed zip entry");
+        }
+    });
+
+    if (loaded)
+    {
+        fprintf(stderr, "ZipByteReader: loaded %" PRIu64 " entries of %s from %ls\n", (uint64_t)m_entries.size(), m_zipPath.c_str(), cache.GetCachePath().c_str());
+        return;
+    }
+
+    m_entries.clear();
+    m_names.clear();
+    ReadCentralDirectory();
+
+    cache.Save([this](FILE* f)
+    {
+        fput(f, (uint64_t)m_entries.size());
+        fwriteOrDie(m_entries, f);
+        fput(f, (uint64_t)m_names.size());
+        fwriteOrDie(m_names, f);
+    });
+}
+
+void ZipByteReader::ReadCentralDirectory()
+{
+    // The end of central directory record is at the end of the file, followed only by the archive comment.
+    size_t tailSize = (size_t)std::min<uint64_t>(m_fileSize, ZipEndOfCentralDirectorySize + ZipMaxCommentSize);
+    if (tailSize < ZipEndOfCentralDirectorySize)
+        RuntimeError("Invalid zip file %s: the file is too small", m_zipPath.c_str());
+
+    std::vector<char> tail(tailSize);
+    uint64_t tailOffset = m_fileSize - tailSize;
+    ReadAt(tailOffset, tail.data(), tailSize);
+
+    const char* end = nullptr;
+    for (size_t i = tailSize - ZipEndOfCentralDirectorySize + 1; i-- > 0;)
+    {
+        if (GetField<uint32_t>(tail.data(), i) == ZipEndOfCentralDirectorySignature)
+        {
+            end = tail.data() + i;
+            break;
+        }
+    }
+
+    if (end == nullptr)
+        RuntimeError("Invalid zip file %s: end of central directory not found", m_zipPath.c_str());
+
+    uint64_t numberOfEntries = GetField<uint16_t>(end, 10);
+    uint64_t directorySize = GetField<uint32_t>(end, 12);
+    uint64_t directoryOffset = GetField<uint32_t>(end, 16);
+
+    // Archives with more than 65535 entries or larger than 4GB keep the values in the zip64 record instead.
+    if (numberOfEntries == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF)
+    {
+        uint64_t endOffset = tailOffset + (end - tail.data());
+        if (endOffset < Zip64EndOfCentralDirectoryLocatorSize)
+            RuntimeError("Invalid zip file %s: zip64 end of central directory locator not found", m_zipPath.c_str());
+
+        char locator[Zip64EndOfCentralDirectoryLocatorSize];
+        ReadAt(endOffset - Zip64EndOfCentralDirectoryLocatorSize, locator, sizeof(locator));
+        if (GetField<uint32_t>(locator, 0) != Zip64EndOfCentralDirectoryLocatorSignature)
+            RuntimeError("Invalid zip file %s: zip64 end of central directory locator not found", m_zipPath.c_str());
+
+        char end64[Zip64EndOfCentralDirectorySize];
+        ReadAt(GetField<uint64_t>(locator, 8), end64, sizeof(end64));
+        if (GetField<uint32_t>(end64, 0) != Zip64EndOfCentralDirectorySignature)
+            RuntimeError("Invalid zip file %s: zip64 end of central directory not found", m_zipPath.c_str());
+
+        numberOfEntries = GetField<uint64_t>(end64, 32);
+        directorySize = GetField<uint64_t>(end64, 40);
+        directoryOffset = GetField<uint64_t>(end64, 48);
+    }
+
+    std::vector<char> directory((size_t)directorySize);
+    ReadAt(directoryOffset, directory.data(), directory.size());
+
+    std::vector<ZipEntry> entries;
+    entries.reserve((size_t)numberOfEntries);
+    size_t position = 0;
+    for (uint64_t index = 0; index < numberOfEntries; ++index)
+    {
+        const char* header = directory.data() + position;
+        if (position + ZipCentralHeaderSize > directory.size() || GetField<uint32_t>(header, 0) != ZipCentralHeaderSignature)
+            RuntimeError("Invalid zip file %s: corrupt central directory entry %" PRIu64, m_zipPath.c_str(), index);
+
+        uint16_t flags = GetField<uint16_t>(header, 8);
+        uint16_t method = GetField<uint16_t>(header, 10);
+        uint64_t compressedSize = GetField<uint32_t>(header, 20);
+        uint64_t uncompressedSize = GetField<uint32_t>(header, 24);
+        uint16_t nameLength = GetField<uint16_t>(header, 28);
+        uint16_t extraLength = GetField<uint16_t>(header, 30);
+        uint16_t commentLength = GetField<uint16_t>(header, 32);
+        uint64_t localHeaderOffset = GetField<uint32_t>(header, 42);
+        if (position + ZipCentralHeaderSize + nameLength + extraLength + commentLength > directory.size())
+            RuntimeError("Invalid zip file %s: corrupt central directory entry %" PRIu64, m_zipPath.c_str(), index);
+
+        // The zip64 extra field has the 64 bit values of exactly those fields that are set to 0xFFFFFFFF.
+        const char* extra = header + ZipCentralHeaderSize + nameLength;
+        for (size_t e = 0; e + 4 <= extraLength;)
+        {
+            uint16_t id = GetField<uint16_t>(extra, e);
+            uint16_t size = GetField<uint16_t>(extra, e + 2);
+            if (id == 0x0001)
+            {
+                size_t f = e + 4;
+                if (uncompressedSize == 0xFFFFFFFF && f + 8 <= e + 4 + size)
+                {
+                    uncompressedSize = GetField<uint64_t>(extra, f);
+                    f += 8;
+                }
+                if (compressedSize == 0xFFFFFFFF && f + 8 <= e + 4 + size)
+                {
+                    compressedSize = GetField<uint64_t>(extra, f);
+                    f += 8;
+                }
+                if (localHeaderOffset == 0xFFFFFFFF && f + 8 <= e + 4 + size)
+                {
+                    localHeaderOffset = GetField<uint64_t>(extra, f);
+                }
+                break;
+            }
+            e += 4 + size;
+        }
+
+        ZipEntry entry = {};
+        entry.m_localHeaderOffset = localHeaderOffset;
+        entry.m_compressedSize = compressedSize;
+        entry.m_nameOffset = m_names.size();
+        entry.m_nameLength = nameLength;
+        entry.m_index = (uint32_t)index;
+        entry.m_stored = method == 0 && (flags & 1) == 0 && compressedSize == uncompressedSize;
+        entries.push_back(entry);
+        m_names.insert(m_names.end(), header + ZipCentralHeaderSize, header + ZipCentralHeaderSize + nameLength);
+
+        position += ZipCentralHeaderSize + nameLength + extraLength + commentLength;
+    }
+
+    // Sorting by name for the lookup in Register, the stable sort keeps the first of duplicate names first, as libzip does.
+    const char* names = m_names.data();
+    std::stable_sort(entries.begin(), entries.end(), [names](const ZipEntry& a, const ZipEntry& b)
+    {
+        return std::lexicographical_compare(names + a.m_nameOffset, names + a.m_nameOffset + a.m_nameLength,
+                                            names + b.m_nameOffset, names + b.m_nameOffset + b.m_nameLength);
+    });
+    m_entries.swap(entries);
 }
 
 ZipByteReader::ZipPtr ZipByteReader::OpenZip()
@@ -46,33 +321,61 @@ ZipByteReader::ZipPtr ZipByteReader::OpenZip()
 
 void ZipByteReader::Register(size_t seqId, const std::string& path)
 {
-    auto zipFile = m_zips.pop_or_create([this]() { return OpenZip(); });
-    zip_stat_t stat;
-    zip_stat_init(&stat);
-    int err = zip_stat(zipFile.get(), path.c_str(), 0, &stat);
-    if (ZIP_ER_OK != err)
-        RuntimeError("Failed to get file info of %s, zip library error: %s", path.c_str(), GetZipError(err).c_str());
-    m_seqIdToIndex[seqId] = std::make_pair(stat.index, stat.size);
-    m_zips.push(std::move(zipFile));
+    const char* names = m_names.data();
+    auto entry = std::lower_bound(m_entries.begin(), m_entries.end(), path, [names](const ZipEntry& e, const std::string& p)
+    {
+        return std::lexicographical_compare(names + e.m_nameOffset, names + e.m_nameOffset + e.m_nameLength, p.begin(), p.end());
+    });
+
+    if (entry == m_entries.end() || path.compare(0, std::string::npos, names + entry->m_nameOffset, entry->m_nameLength) != 0)
+        RuntimeError("Failed to find %s in the zip file %s", path.c_str(), m_zipPath.c_str());
+
+    m_seqIdToEntry[seqId] = entry - m_entries.begin();
 }
 
-cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscale)
+cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, int readFlags)
 {
     // Find index of the file in .zip file.
-    auto r = m_seqIdToIndex.find(seqId);
-    if (r == m_seqIdToIndex.end())
+    auto r = m_seqIdToEntry.find(seqId);
+    if (r == m_seqIdToEntry.end())
         RuntimeError("Could not find file %s in the zip file, sequence id = %lu", path.c_str(), (long)seqId);
 
-    zip_uint64_t index = std::get<0>((*r).second);
-    zip_uint64_t size = std::get<1>((*r).second);
+    const ZipEntry& entry = m_entries[r->second];
+    size_t size = (size_t)entry.m_compressedSize;
 
     auto contents = m_workspace.pop_or_create([size]() { return vector<unsigned char>(size); });
     if (contents.size() < size)
         contents.resize(size);
-    auto zipFile = m_zips.pop_or_create([this]() { return OpenZip(); });
+
+    if (entry.m_stored)
     {
+        // The data follows the local header, whose name and extra field may differ in length from the central directory.
+        char header[ZipLocalHeaderSize];
+        ReadAt(entry.m_localHeaderOffset, header, sizeof(header));
+        if (GetField<uint32_t>(header, 0) != ZipLocalHeaderSignature)
+            RuntimeError("Invalid local header of file %s in the zip file %s", path.c_str(), m_zipPath.c_str());
+
+        uint64_t dataOffset = entry.m_localHeaderOffset + ZipLocalHeaderSize + GetField<uint16_t>(header, 26) + GetField<uint16_t>(header, 28);
+        ReadAt(dataOffset, contents.data(), size);
+    }
+    else
+    {
+        // Compressed entries are read through libzip, which needs the uncompressed size.
+        auto zipFile = m_zips.pop_or_create([this]() { return OpenZip(); });
+        zip_stat_t stat;
+        zip_stat_init(&stat);
+        if (zip_stat_index(zipFile.get(), entry.m_index, 0, &stat) != 0)
+        {
+            RuntimeError("Failed to get file info of %s, zip library error: %s",
+                         path.c_str(), GetZipError(zip_error_code_zip(zip_get_error(zipFile.get()))).c_str());
+        }
+
+        size = (size_t)stat.size;
+        if (contents.size() < size)
+            contents.resize(size);
+
         std::unique_ptr<zip_file_t, void(*)(zip_file_t*)> file(
-            zip_fopen_index(zipFile.get(), index, 0),
+            zip_fopen_index(zipFile.get(), entry.m_index, 0),
             [](zip_file_t* f)
             {
                 assert(f != nullptr);
@@ -82,7 +385,6 @@ cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscal
                 UNUSED(err);
 #endif
             });
-        assert(nullptr != file);
         if (nullptr == file)
         {
             RuntimeError("Could not open file %s in the zip file, sequence id = %lu, zip library error: %s",
@@ -96,11 +398,12 @@ cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscal
             RuntimeError("Bytes read %lu != expected %lu while reading file %s",
                          (long)bytesRead, (long)size, path.c_str());
         }
+        file.reset();
+        m_zips.push(std::move(zipFile));
     }
-    m_zips.push(std::move(zipFile));
 
-    cv::Mat img; 
-    img = cv::imdecode(cv::Mat(1, (int)size, CV_8UC1, contents.data()), grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    cv::Mat img;
+    img = cv::imdecode(cv::Mat(1, (int)size, CV_8UC1, contents.data()), readFlags);
     assert(nullptr != img.data);
     m_workspace.push(std::move(contents));
     return img;
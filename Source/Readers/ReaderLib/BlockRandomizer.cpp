@@ -23,7 +23,9 @@ BlockRandomizer::BlockRandomizer(
     IDataDeserializerPtr deserializer,
     DecimationMode decimationMode,
     bool useLegacyRandomization,
-    bool multithreadedGetNextSequence)
+    bool multithreadedGetNextSequence,
+    size_t chunkPrefetchCount,
+    size_t chunkPrefetchMaxSamples)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_decimationMode(decimationMode),
@@ -34,10 +36,18 @@ BlockRandomizer::BlockRandomizer(
       m_sweepTotalNumberOfSamples(0),
       m_lastSeenChunkId(CHUNKID_MAX),
       m_chunkRandomizer(std::make_shared<ChunkRandomizer>(deserializer, randomizationRangeInSamples, useLegacyRandomization)),
-      m_multithreadedGetNextSequences(multithreadedGetNextSequence)
+      m_multithreadedGetNextSequences(multithreadedGetNextSequence),
+      m_chunkPrefetchCount(chunkPrefetchCount),
+      m_chunkPrefetchMaxSamples(chunkPrefetchMaxSamples),
+      m_prefetchedSamples(0),
+      m_prefetchGeneration(0)
 {
     assert(deserializer != nullptr);
 
+    // A single thread is enough, GetChunk() calls are serialized anyway.
+    if (m_chunkPrefetchCount > 0)
+        m_prefetchThreads.reset(new WorkStealingThreadPool(1));
+
     m_streams = m_deserializer->GetStreamDescriptions();
     m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer);
 
@@ -49,11 +59,25 @@ BlockRandomizer::BlockRandomizer(
     }
 }
 
+BlockRandomizer::~BlockRandomizer()
+{
+    // Skip the pending loads, and wait for the one in progress.
+    ClearPrefetchedChunks();
+    m_prefetchThreads.reset();
+}
+
 // Start a new epoch.
 void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
 {
     m_lastSeenChunkId = CHUNKID_MAX;
 
+    // Prefetched chunks were picked based on the decimation of the previous epoch.
+    if (!m_prefetchedChunks.empty() && m_decimationMode == DecimationMode::chunk &&
+        (config.m_numberOfWorkers != m_config.m_numberOfWorkers || config.m_workerRank != m_config.m_workerRank))
+    {
+        ClearPrefetchedChunks();
+    }
+
     m_config = config;
     if (config.m_totalEpochSizeInSamples == requestDataSize)
     {
@@ -105,6 +129,7 @@ void BlockRandomizer::PrepareNewSweepIfNeeded(size_t samplePosition)
 
         // Unloading all chunk data from memory.
         m_chunks.clear();
+        ClearPrefetchedChunks();
         m_lastSeenChunkId = CHUNKID_MAX;
     }
 }
@@ -268,16 +293,28 @@ void BlockRandomizer::RetrieveDataChunks()
         }
         else
         {
-            chunks[chunk.m_chunkId] = m_deserializer->GetChunk(chunk.m_original->m_id);
+            bool prefetched = m_prefetchedChunks.find(chunk.m_chunkId) != m_prefetchedChunks.end();
+            chunks[chunk.m_chunkId] = GetChunk(chunk);
 
             if (m_verbosity >= Information)
-                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
+                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u%s), now %" PRIu64 " chunks in memory\n",
                         chunk.m_chunkId,
                         chunk.m_original->m_id,
+                        prefetched ? ", prefetched" : "",
                         ++numLoadedChunks);
         }
     }
 
+    // Prefetched chunks that the window has passed without using them (e.g. after a seek) are not needed anymore.
+    const auto& randomizedChunks = m_chunkRandomizer->GetRandomizedChunks();
+    for (auto it = m_prefetchedChunks.begin(); it != m_prefetchedChunks.end() && it->first <= m_lastSeenChunkId;)
+    {
+        m_prefetchedSamples -= randomizedChunks[it->first].m_original->m_numberOfSamples;
+        it = m_prefetchedChunks.erase(it);
+    }
+
+    PrefetchChunksAfter(m_lastSeenChunkId);
+
     // Swapping current chunks in the m_chunks, by that removing all stale and remembering newly loaded.
     // TODO diagnostics for paged out chunks?
     m_chunks.swap(chunks);
@@ -289,4 +326,89 @@ void BlockRandomizer::RetrieveDataChunks()
                 window.back().m_chunkId);
 }
 
+// Gets a chunk from the deserializer, or from the prefetched chunks if it has been requested already.
+ChunkPtr BlockRandomizer::GetChunk(const RandomizedChunk& chunk)
+{
+    auto it = m_prefetchedChunks.find(chunk.m_chunkId);
+    if (it != m_prefetchedChunks.end())
+    {
+        std::shared_future<ChunkPtr> loading = it->second;
+        m_prefetchedChunks.erase(it);
+        m_prefetchedSamples -= chunk.m_original->m_numberOfSamples;
+        return loading.get(); // waits if the chunk is still being loaded, rethrows a load error
+    }
+
+    std::lock_guard<std::mutex> lock(m_getChunkMutex);
+    return m_deserializer->GetChunk(chunk.m_original->m_id);
+}
+
+// Schedules background loading of the next m_chunkPrefetchCount chunks of this worker after the given randomized chunk,
+// as far as they fit into m_chunkPrefetchMaxSamples.
+void BlockRandomizer::PrefetchChunksAfter(ChunkIdType chunkId)
+{
+    if (m_chunkPrefetchCount == 0)
+    {
+        return;
+    }
+
+    const auto& randomizedChunks = m_chunkRandomizer->GetRandomizedChunks();
+    size_t generation = m_prefetchGeneration;
+    size_t numChunks = 0;
+    for (size_t i = (size_t)chunkId + 1; i < randomizedChunks.size() && numChunks < m_chunkPrefetchCount; ++i)
+    {
+        const auto& chunk = randomizedChunks[i];
+        if (m_decimationMode == DecimationMode::chunk && chunk.m_chunkId % m_config.m_numberOfWorkers != m_config.m_workerRank)
+        {
+            continue;
+        }
+
+        numChunks++;
+        if (m_prefetchedChunks.find(chunk.m_chunkId) != m_prefetchedChunks.end())
+        {
+            continue;
+        }
+
+        if (m_prefetchedSamples + chunk.m_original->m_numberOfSamples > m_chunkPrefetchMaxSamples)
+        {
+            break;
+        }
+
+        auto promise = std::make_shared<std::promise<ChunkPtr>>();
+        m_prefetchedChunks[chunk.m_chunkId] = promise->get_future().share();
+        m_prefetchedSamples += chunk.m_original->m_numberOfSamples;
+
+        if (m_verbosity >= Debug)
+            fprintf(stderr, "BlockRandomizer::PrefetchChunksAfter: prefetching randomized chunk %u (original chunk: %u)\n",
+                    chunk.m_chunkId,
+                    chunk.m_original->m_id);
+
+        ChunkIdType originalChunkId = chunk.m_original->m_id;
+        m_prefetchThreads->Submit([this, promise, originalChunkId, generation](size_t)
+        {
+            try
+            {
+                ChunkPtr data;
+                {
+                    std::lock_guard<std::mutex> lock(m_getChunkMutex);
+                    if (m_prefetchGeneration == generation) // otherwise nobody is waiting for the chunk anymore
+                        data = m_deserializer->GetChunk(originalChunkId);
+                }
+                promise->set_value(data);
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        });
+    }
+}
+
+// Drops all prefetched chunks; pending loads are abandoned.
+void BlockRandomizer::ClearPrefetchedChunks()
+{
+    m_prefetchGeneration++;
+    m_prefetchedChunks.clear();
+    m_prefetchedSamples = 0;
+}
+
 }}}
@@ -6,11 +6,17 @@
 #pragma once
 
 #include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <atomic>
 
 #include "SequenceEnumerator.h"
 #include "DataDeserializer.h"
 #include "ChunkRandomizer.h"
 #include "SequenceRandomizer.h"
+#include "WorkStealingThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -30,6 +36,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //
 // This class is responsible for decimation and loading the data chunks in to memory.
 // Actual randomization happens in ChunkRandomizer and SequenceRandomizer.
+// Because the randomized chunk order of a sweep is known upfront, chunks that follow the current window can be
+// loaded in the background before the window reaches them (chunkPrefetchCount > 0). Prefetched chunks that have
+// not been used yet are limited to chunkPrefetchMaxSamples samples, and are dropped once they fall behind the window.
 // TODO: The behavior can be simplified by only randomizing sequences forward.
 class BlockRandomizer : public SequenceEnumerator
 {
@@ -47,7 +56,11 @@ public:
         IDataDeserializerPtr deserializer,
         DecimationMode decimationMode = DecimationMode::chunk,
         bool useLegacyRandomization = false,
-        bool multithreadedGetNextSequences = false);
+        bool multithreadedGetNextSequences = false,
+        size_t chunkPrefetchCount = 0,
+        size_t chunkPrefetchMaxSamples = SIZE_MAX);
+
+    ~BlockRandomizer();
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -75,6 +88,15 @@ private:
     // Prepares a new sweep if needed.
     void PrepareNewSweepIfNeeded(size_t samplePosition);
 
+    // Gets a chunk from the deserializer, or from the prefetched chunks if it has been requested already.
+    ChunkPtr GetChunk(const RandomizedChunk& chunk);
+
+    // Schedules background loading of the chunks that follow the given randomized chunk.
+    void PrefetchChunksAfter(ChunkIdType chunkId);
+
+    // Drops all prefetched chunks; pending loads are abandoned.
+    void ClearPrefetchedChunks();
+
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
 
@@ -120,6 +142,25 @@ private:
     // TODO temporary; should go away when transformers are moved closer to the deserializer
     bool m_multithreadedGetNextSequences;
 
+    // Number of chunks ahead of the window to load in the background, 0 if chunks are only loaded on demand.
+    size_t m_chunkPrefetchCount;
+
+    // Maximum total number of samples in chunks that are prefetched but not used yet.
+    size_t m_chunkPrefetchMaxSamples;
+
+    // Chunks that are being loaded or have been loaded ahead of the window, by randomized chunk id.
+    std::map<ChunkIdType, std::shared_future<ChunkPtr>> m_prefetchedChunks;
+    size_t m_prefetchedSamples;
+
+    // Incremented whenever the prefetched chunks are dropped, so that pending loads can be skipped.
+    std::atomic<size_t> m_prefetchGeneration;
+
+    // Deserializers are not required to be reentrant, so all GetChunk() calls are serialized.
+    std::mutex m_getChunkMutex;
+
+    // Loads chunks in the background; created only if prefetching is enabled.
+    std::unique_ptr<WorkStealingThreadPool> m_prefetchThreads;
+
     // General configuration
     // TODO generalize those for ReaderLib / Reader / CNTK
     enum VerbosityLevel
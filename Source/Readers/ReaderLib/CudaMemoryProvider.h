@@ -21,7 +21,7 @@ class CudaMemoryProvider : public MemoryProvider
 public:
     CudaMemoryProvider(int deviceId)
     {
-        m_allocator = std::make_unique<CUDAPageLockedMemAllocator>(deviceId);
+        m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
     }
 
     virtual void* Alloc(size_t elementSize, size_t numberOfElements) override
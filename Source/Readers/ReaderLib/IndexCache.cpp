@@ -0,0 +1,122 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "IndexCache.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "Basics.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Version of the cache header; increment when the layout of the header changes.
+// The layout of the cached index itself is versioned by the signature.
+static const uint32_t INDEX_CACHE_VERSION = 1;
+
+IndexCache::IndexCache(const std::wstring& inputPath, const std::string& signature, const std::wstring& cachePath) :
+    m_inputPath(inputPath),
+    m_cachePath(cachePath.empty() ? inputPath + L".index" : cachePath),
+    m_signature(signature)
+{
+}
+
+bool IndexCache::TryGetInputStamp(uint64_t& size, int64_t& modificationTime) const
+{
+#ifdef _WIN32
+    struct _stat64 fileInfo;
+    if (_wstat64(m_inputPath.c_str(), &fileInfo) != 0)
+        return false;
+#else
+    struct stat fileInfo;
+    if (stat(wtocharpath(m_inputPath.c_str()).c_str(), &fileInfo) != 0)
+        return false;
+#endif
+    size = (uint64_t)fileInfo.st_size;
+    modificationTime = (int64_t)fileInfo.st_mtime;
+    return true;
+}
+
+bool IndexCache::TryLoad(const std::function<void(FILE*)>& read) const
+{
+    uint64_t inputSize;
+    int64_t inputModificationTime;
+    if (!fexists(m_cachePath) || !TryGetInputStamp(inputSize, inputModificationTime))
+        return false;
+
+    FILE* f = nullptr;
+    try
+    {
+        f = fopenOrDie(m_cachePath, L"rbS");
+
+        fcheckTag(f, "BIDX");
+        uint32_t version;
+        fget(f, version);
+        std::string signature = fgetstring(f);
+        uint64_t size;
+        int64_t modificationTime;
+        fget(f, size);
+        fget(f, modificationTime);
+        if (version != INDEX_CACHE_VERSION || signature != m_signature ||
+            size != inputSize || modificationTime != inputModificationTime)
+        {
+            fclose(f);
+            fprintf(stderr, "IndexCache: index cache '%ls' is out of date, rebuilding the index.\n", m_cachePath.c_str());
+            return false;
+        }
+
+        read(f);
+        fcheckTag(f, "EIDX");
+        fclose(f);
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        if (f)
+            fclose(f);
+        fprintf(stderr, "WARNING: could not load index cache '%ls' (%s), rebuilding the index.\n", m_cachePath.c_str(), e.what());
+        return false;
+    }
+}
+
+void IndexCache::Save(const std::function<void(FILE*)>& write) const
+{
+    uint64_t inputSize;
+    int64_t inputModificationTime;
+    if (!TryGetInputStamp(inputSize, inputModificationTime))
+        return;
+
+    std::wstring tempPath = m_cachePath + L".tmp" + std::to_wstring(GetCurrentProcessId());
+    FILE* f = nullptr;
+    try
+    {
+        f = fopenOrDie(tempPath, L"wbS");
+
+        fputTag(f, "BIDX");
+        fput(f, INDEX_CACHE_VERSION);
+        fputstring(f, m_signature);
+        fput(f, inputSize);
+        fput(f, inputModificationTime);
+
+        write(f);
+        fputTag(f, "EIDX");
+        fflushOrDie(f);
+        fclose(f);
+        f = nullptr;
+
+        renameOrDie(tempPath, m_cachePath);
+    }
+    catch (const std::exception& e)
+    {
+        if (f)
+            fclose(f);
+        if (fexists(tempPath))
+            _wunlink(tempPath.c_str());
+        fprintf(stderr, "WARNING: could not save index cache '%ls' (%s).\n", m_cachePath.c_str(), e.what());
+    }
+}
+
+}}}
@@ -0,0 +1,48 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <functional>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A sidecar file that persists the index a deserializer builds over its input
+// (sequence offsets of a text file, utterances listed in an SCP file, ...), so that
+// later runs can load it instead of scanning the whole input again.
+// The cache is only used if it was written for an input file of the same size and
+// modification time, and with the same signature, which should capture the format
+// of the cached data and all options that affect the index. Otherwise, or if the cache
+// cannot be read or written, the index is simply built from the input as usual.
+class IndexCache
+{
+public:
+    // The cache of 'inputPath' is stored in 'cachePath' (by default, next to the input with an ".index" suffix).
+    IndexCache(const std::wstring& inputPath, const std::string& signature, const std::wstring& cachePath = L"");
+
+    // Opens the cache, validates its header and calls 'read' to load the index.
+    // Returns false if there is no valid cache, or if 'read' throws.
+    bool TryLoad(const std::function<void(FILE*)>& read) const;
+
+    // Calls 'write' to store the index. The cache is written to a temporary file first
+    // and renamed when complete, so concurrent readers (e.g. other MPI workers) never
+    // see a partial cache.
+    void Save(const std::function<void(FILE*)>& write) const;
+
+    const std::wstring& GetCachePath() const { return m_cachePath; }
+
+private:
+    // Gets the size and the modification time of the input file.
+    bool TryGetInputStamp(uint64_t& size, int64_t& modificationTime) const;
+
+    std::wstring m_inputPath;
+    std::wstring m_cachePath;
+    std::string m_signature;
+};
+
+}}}
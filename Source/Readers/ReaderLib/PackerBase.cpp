@@ -8,6 +8,7 @@
 
 #include "PackerBase.h"
 #include "ElementTypeUtils.h"
+#include "CudaMemoryProvider.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -17,10 +18,12 @@ using namespace std;
 void PackerBase::StreamBuffer::Resize(size_t newSize)
 {
     m_size = newSize;
+    // The buffers are swapped around, so the deleter must not refer to this object.
+    MemoryProviderPtr memoryProvider = m_memoryProvider;
     m_data.reset(reinterpret_cast<char*>(m_memoryProvider->Alloc(1, newSize)),
-        [this](char* p)
+        [memoryProvider](char* p)
     {
-        m_memoryProvider->Free(p);
+        memoryProvider->Free(p);
     });
 }
 
@@ -31,6 +34,56 @@ void PackerBase::StartEpoch(const EpochConfiguration& config)
     {
         LogicError("Minibatch size cannot be zero.");
     }
+
+    PrepareStreamBuffers(config);
+}
+
+void PackerBase::PrepareStreamBuffers(const EpochConfiguration& config)
+{
+    size_t numberOfBuffers = max(config.m_numberOfBuffers, (size_t)1);
+    DEVICEID_TYPE deviceId = config.m_deviceId >= 0 ? config.m_deviceId : CPUDEVICE;
+    if (numberOfBuffers == m_previousStreamBuffers.size() + 1 && deviceId == m_deviceId)
+    {
+        return;
+    }
+
+    if (deviceId != m_deviceId)
+    {
+        // Copies from page-locked memory to the GPU are faster, and do not need another copy in the driver.
+        m_memoryProvider = deviceId >= 0 ? std::make_shared<CudaMemoryProvider>(deviceId) : m_defaultMemoryProvider;
+        m_deviceId = deviceId;
+    }
+
+    m_streamBuffers.assign(m_outputStreamDescriptions.size(), StreamBuffer(m_memoryProvider));
+    m_previousStreamBuffers.assign(numberOfBuffers - 1, m_streamBuffers);
+    m_nextStreamBuffers = 0;
+}
+
+void PackerBase::SwitchStreamBuffers()
+{
+    if (m_previousStreamBuffers.empty())
+    {
+        return;
+    }
+
+    m_streamBuffers.swap(m_previousStreamBuffers[m_nextStreamBuffers]);
+    m_nextStreamBuffers = (m_nextStreamBuffers + 1) % m_previousStreamBuffers.size();
+}
+
+void PackerBase::ResizeStreamBuffers(size_t streamIndex, size_t newSize)
+{
+    if (m_streamBuffers[streamIndex].m_size != newSize)
+    {
+        m_streamBuffers[streamIndex].Resize(newSize);
+    }
+
+    for (auto& buffers : m_previousStreamBuffers)
+    {
+        if (buffers[streamIndex].m_size != newSize)
+        {
+            buffers[streamIndex].Resize(newSize);
+        }
+    }
 }
 
 PackerBase::PackerBase(MemoryProviderPtr memoryProvider,
@@ -38,7 +91,11 @@ PackerBase::PackerBase(MemoryProviderPtr memoryProvider,
     const std::vector<StreamDescriptionPtr>& streams) :
     m_sequenceEnumerator(sequenceEnumerator),
     m_minibatchSize(0),
-    m_outputStreamDescriptions(streams)
+    m_outputStreamDescriptions(streams),
+    m_nextStreamBuffers(0),
+    m_defaultMemoryProvider(memoryProvider),
+    m_memoryProvider(memoryProvider),
+    m_deviceId(CPUDEVICE)
 {
     m_inputStreamDescriptions = sequenceEnumerator->GetStreamDescriptions();
     assert(m_inputStreamDescriptions.size() != 0);
@@ -67,6 +67,25 @@ protected:
     // Buffers for allocated data.
     std::vector<StreamBuffer> m_streamBuffers;
 
+    // Buffers of the previous minibatches that the caller may still be using (EpochConfiguration::m_numberOfBuffers - 1 sets).
+    // SwitchStreamBuffers() swaps them with m_streamBuffers in turn.
+    std::vector<std::vector<StreamBuffer>> m_previousStreamBuffers;
+    size_t m_nextStreamBuffers;
+
+    // Memory provider given by the reader, and the one used for the buffers (page-locked memory if the target is a GPU).
+    MemoryProviderPtr m_defaultMemoryProvider;
+    MemoryProviderPtr m_memoryProvider;
+    DEVICEID_TYPE m_deviceId;
+
+    // Recreates the (empty) stream buffers if the number of buffers or the target device has changed.
+    void PrepareStreamBuffers(const EpochConfiguration& config);
+
+    // Makes the next set of buffers current. Packers call this before packing a minibatch.
+    void SwitchStreamBuffers();
+
+    // Resizes the buffers of a stream in all sets, so that fixed-size packers can allocate them upfront.
+    void ResizeStreamBuffers(size_t streamIndex, size_t newSize);
+
     // Minibatch size in samples.
     size_t m_minibatchSize;
 
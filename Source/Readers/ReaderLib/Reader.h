@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <memory>
+#include <utility>
 #include "Sequences.h"
 #include "TensorShape.h"
 
@@ -30,6 +31,8 @@ struct EpochConfiguration
     size_t m_totalEpochSizeInSamples;       // Total size of the epoch in samples
     size_t m_epochIndex;                    // Current epoch index [0 .. max number of epochs)
     size_t m_truncationSize;                // Truncation size in samples for truncated BPTT mode.
+    size_t m_numberOfBuffers = 1;           // Number of minibatches returned by ReadMinibatch whose data the caller uses at the same time
+    DEVICEID_TYPE m_deviceId = CPUDEVICE;   // Device the minibatch data is copied to, CPUDEVICE if unknown; GPUs get page-locked buffers
 };
 
 // Supported primitive element types, will be extended in the future.
@@ -58,12 +61,16 @@ struct StreamDescription
     ElementType m_elementType;     // Element type of the stream
     TensorShapePtr m_sampleLayout; // Layout of the sample for the stream
                                    // If not specified - can be specified per sequence
+    std::pair<size_t, size_t> m_contextWindow = { 0, 0 }; // Number of samples to the left and right each sample is spliced with (dense only)
+                                                          // The data contains the samples without their context, the ReaderShim splices them
+                                                          // on the device, so the input has (1 + left + right) times the sample size.
 };
 typedef std::shared_ptr<StreamDescription> StreamDescriptionPtr;
 
 // Represent a minibatch date for a single stream formatted in according to the minibatch layout.
 // This data is returned per stream as a part of Minibatch from the ReadMinibatch function.
-// All raw non owned pointers are valid till the next call to the ReadMinibatch function.
+// All raw non owned pointers are valid till the next call to the ReadMinibatch function,
+// or, if the epoch was started with m_numberOfBuffers = N, till the N-th next call.
 struct StreamMinibatch
 {
     void* m_data;         // Contiguous array of data. Can be encoded in dense or sparse formats depending on the stream description.
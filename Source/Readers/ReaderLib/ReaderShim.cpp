@@ -12,6 +12,7 @@
 #endif
 
 #include <sstream>
+#include <algorithm>
 #include "Basics.h"
 
 #define DATAREADER_EXPORTS // creating the exports here
@@ -22,7 +23,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 template <class ElemType>
 ReaderShim<ElemType>::ReaderShim(ReaderFactory factory)
-    : m_factory(factory)
+    : m_factory(factory), m_prefetchDepth(1), m_deviceId(CPUDEVICE)
 {
 }
 
@@ -37,6 +38,14 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
     // otherwise deferring - synchronous execution during .get() call
     m_launchType = prefetch ? launch::async : launch::deferred;
 
+    // Number of minibatches read ahead while the network processes the current one.
+    // The packers keep one more set of buffers than that, so that the next read can overlap with copying the current minibatch.
+    m_prefetchDepth = prefetch ? (size_t)config(L"prefetchDepth", (size_t)1) : 1;
+    if (m_prefetchDepth == 0)
+    {
+        InvalidArgument("ReaderShim: prefetchDepth must be at least 1.");
+    }
+
     m_numParallelSequences = numberOfuttsPerMinibatchForAllEpochs[0];
 
     m_reader = m_factory(config);
@@ -62,10 +71,11 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
     size_t requestedEpochSamples /*= requestDataSize*/)
 {
     // For adaptive minibatch, make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
+    for (const auto& read : m_prefetchQueue)
     {
-        m_prefetchTask.wait();
+        read.wait();
     }
+    m_prefetchQueue.clear();
 
     EpochConfiguration config;
     config.m_workerRank = subsetNum;
@@ -73,17 +83,41 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
     config.m_minibatchSizeInSamples = requestedMBSize;
     config.m_totalEpochSizeInSamples = requestedEpochSamples;
     config.m_epochIndex = epoch;
+    config.m_truncationSize = 0; // set by the readers that use it
+    config.m_numberOfBuffers = m_launchType == launch::async ? m_prefetchDepth + 1 : 1;
+    config.m_deviceId = m_deviceId;
 
     m_reader->StartEpoch(config);
     m_endOfEpoch = false;
 
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish,
-    // return the result and kick off a new one.
-    m_prefetchTask = std::async(m_launchType, [this]()
+    // Starting the prefetch tasks. There are always m_prefetchDepth reads queued.
+    // When the network requests a new minibatch, we wait for the oldest one to finish,
+    // queue a new one and return the result.
+    while (m_prefetchQueue.size() < m_prefetchDepth)
+    {
+        EnqueueRead();
+    }
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::EnqueueRead()
+{
+    std::shared_future<Minibatch> previous;
+    if (!m_prefetchQueue.empty())
+    {
+        previous = m_prefetchQueue.back();
+    }
+
+    m_prefetchQueue.push_back(std::async(m_launchType, [this, previous]() -> Minibatch
     {
+        // Nothing is read past the end of the epoch.
+        if (previous.valid() && previous.get().m_endOfEpoch)
+        {
+            return Minibatch(true);
+        }
+
         return m_reader->ReadMinibatch();
-    });
+    }).share());
 }
 
 string EnumerateInputs(const map<wstring, size_t> &nameToStreamId)
@@ -120,18 +154,29 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     int deviceId = matrices.begin()->second.matrix->GetDeviceId();
     for (auto mx : matrices)
         assert(mx.second.matrix->GetDeviceId() == deviceId), UNUSED(deviceId);
+    m_deviceId = deviceId;
 
-    assert(m_prefetchTask.valid());
+    assert(!m_prefetchQueue.empty());
 
-    Minibatch minibatch = m_prefetchTask.get();
+    Minibatch minibatch = m_prefetchQueue.front().get();
+    m_prefetchQueue.pop_front();
     if (minibatch.m_endOfEpoch)
     {
         m_endOfEpoch = true;
+
+        // The reads queued after this one return nothing.
+        m_prefetchQueue.clear();
         if (minibatch.m_data.empty())
         {
             return false;
         }
     }
+    else
+    {
+        // Topping up the queue before copying, so that the next read overlaps with the copy;
+        // the packers write it into a different buffer.
+        EnqueueRead();
+    }
 
     // Reset stale mb layouts.
     // BUGBUG: This seems incorrect. (1) layouts should all be updated below, and (2) some of these layouts are the same, we are resetting them twice.
@@ -144,8 +189,8 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     map<wstring, wstring> layoutToInputMap;
     if (!minibatch.m_data.empty())
     {
-        // TODO: Use alternating pinned buffer in the packer, do not copy anything, but pack into the pinned memory.
         // Copy returned minibatch to the matrices.
+        // The packers write into page-locked memory if the matrices were on a GPU in the previous epoch, see m_deviceId.
         for (const auto& mx : matrices)
         {
             if (m_nameToStreamId.find(mx.first) == m_nameToStreamId.end())
@@ -183,21 +228,26 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
 
             size_t sampleSize = m_streams[streamId]->m_sampleLayout->GetNumElements();
             auto& matrix = matrices.GetInputMatrix<ElemType>(mx.first);
-            FillMatrixFromStream(m_streams[streamId]->m_storageType, &matrix, sampleSize, stream);
+            const auto& contextWindow = m_streams[streamId]->m_contextWindow;
+            if (contextWindow.first == 0 && contextWindow.second == 0)
+            {
+                FillMatrixFromStream(m_streams[streamId]->m_storageType, &matrix, sampleSize, stream);
+            }
+            else
+            {
+                // The samples come without their context, it is added on the device, so that the copy is (1 + left + right) times smaller.
+                if (!m_spliceInput || m_spliceInput->GetDeviceId() != matrix.GetDeviceId())
+                {
+                    m_spliceInput.reset(new Matrix<ElemType>(matrix.GetDeviceId()));
+                    m_spliceIndices.reset(new Matrix<ElemType>(matrix.GetDeviceId()));
+                }
+
+                FillMatrixFromStream(m_streams[streamId]->m_storageType, m_spliceInput.get(), sampleSize, stream);
+                SpliceContext(matrix, *m_spliceInput, stream->m_layout, contextWindow);
+            }
         }
     }
 
-    if (!m_endOfEpoch)
-    {
-        // Starting the prefetch task. There is always a single async read in flight.
-        // When the network requests a new minibatch, we wait for the current async to finish,
-        // return the result and kick off a new one.
-        m_prefetchTask = std::async(m_launchType, [this]()
-        {
-            return m_reader->ReadMinibatch();
-        });
-    }
-
     return !minibatch.m_data.empty();
 }
 
@@ -228,6 +278,51 @@ void ReaderShim<ElemType>::FillMatrixFromStream(StorageType type, Matrix<ElemTyp
     }
 }
 
+// The window of the sample in column j is gathered into columns [j * window, (j + 1) * window), left context first,
+// so that reshaping the result to (1 + left + right) times the rows gives the spliced samples in the original columns.
+// As when the deserializer augments the frames, the context does not extend beyond the sequence: the first and the last
+// sample are repeated instead. Gaps take their own (empty) column for the whole window.
+template <class ElemType>
+void ReaderShim<ElemType>::SpliceContext(Matrix<ElemType>& matrix, const Matrix<ElemType>& samples, const MBLayoutPtr& layout, const std::pair<size_t, size_t>& contextWindow)
+{
+    const size_t left = contextWindow.first;
+    const size_t window = contextWindow.first + 1 + contextWindow.second;
+    const size_t numCols = layout->GetNumCols();
+    const size_t numParallelSequences = layout->GetNumParallelSequences();
+    const ptrdiff_t numTimeSteps = (ptrdiff_t)layout->GetNumTimeSteps();
+
+    m_spliceIndicesBuffer.resize(numCols * window);
+    for (size_t j = 0; j < numCols; ++j)
+    {
+        std::fill(m_spliceIndicesBuffer.begin() + j * window, m_spliceIndicesBuffer.begin() + (j + 1) * window, (ElemType)j);
+    }
+
+    for (const auto& sequence : layout->GetAllSequences())
+    {
+        if (sequence.seqId == GAP_SEQUENCE_ID)
+        {
+            continue;
+        }
+
+        // Only the part of the sequence inside the minibatch is available.
+        ptrdiff_t begin = std::max<ptrdiff_t>(sequence.tBegin, 0);
+        ptrdiff_t end = std::min<ptrdiff_t>((ptrdiff_t)sequence.tEnd, numTimeSteps);
+        for (ptrdiff_t t = begin; t < end; ++t)
+        {
+            ElemType* windowIndices = &m_spliceIndicesBuffer[(t * numParallelSequences + sequence.s) * window];
+            for (size_t k = 0; k < window; ++k)
+            {
+                ptrdiff_t source = std::min(std::max(t + (ptrdiff_t)k - (ptrdiff_t)left, begin), end - 1);
+                windowIndices[k] = (ElemType)(source * numParallelSequences + sequence.s);
+            }
+        }
+    }
+
+    m_spliceIndices->SetValue(1, numCols * window, matrix.GetDeviceId(), m_spliceIndicesBuffer.data(), matrixFlagNormal);
+    matrix.DoGatherColumnsOf(0, *m_spliceIndices, samples, 1);
+    matrix.Reshape(samples.GetNumRows() * window, numCols);
+}
+
 template <class ElemType>
 bool ReaderShim<ElemType>::DataEnd() { return false; } // Note: Return value never used.
 
@@ -10,6 +10,7 @@
 
 #include <map>
 #include <string>
+#include <deque>
 #include "DataReader.h"
 #include <future>
 #include "Reader.h"
@@ -34,10 +35,10 @@ public:
     virtual void Destroy() override
     {
         // Make sure there are no outstanding reads.
-        if (m_prefetchTask.valid())
+        if (!m_prefetchQueue.empty())
         {
-            // If there are some, give them time to finish.
-            m_prefetchTask.wait_for(std::chrono::seconds(5));
+            // If there are some, give them time to finish (the reads are chained, so waiting for the last one is enough).
+            m_prefetchQueue.back().wait_for(std::chrono::seconds(5));
         }
 
         delete this;
@@ -60,7 +61,15 @@ public:
     virtual size_t GetNumParallelSequencesForFixingBPTTMode() override;
 
 private:
-    std::future<Minibatch> m_prefetchTask;
+    // Minibatches being read ahead, oldest first.
+    // Each read waits for the previous one, so there is never more than one call into the reader at a time.
+    std::deque<std::shared_future<Minibatch>> m_prefetchQueue;
+
+    // Number of minibatches to read ahead.
+    size_t m_prefetchDepth;
+
+    // Device of the input matrices as of the last GetMinibatch(), so that the packer can allocate page-locked buffers for it.
+    DEVICEID_TYPE m_deviceId;
     ReaderPtr m_reader;
     ReaderFactory m_factory;
     bool m_endOfEpoch;
@@ -71,7 +80,18 @@ private:
     std::vector<StreamDescriptionPtr> m_streams;
     launch m_launchType;
 
+    // Starts reading the minibatch after the ones already in the queue.
+    void EnqueueRead();
+
     void FillMatrixFromStream(StorageType type, Matrix<ElemType>* matrix, size_t numRows, const StreamMinibatchPtr& stream);
+
+    // Splices each sample with the samples of its context window within the same sequence, see StreamDescription::m_contextWindow.
+    void SpliceContext(Matrix<ElemType>& matrix, const Matrix<ElemType>& samples, const MBLayoutPtr& layout, const std::pair<size_t, size_t>& contextWindow);
+
+    // Samples without their context, and the columns that make up the context windows, on the device of the input matrices.
+    std::unique_ptr<Matrix<ElemType>> m_spliceInput;
+    std::unique_ptr<Matrix<ElemType>> m_spliceIndices;
+    std::vector<ElemType> m_spliceIndicesBuffer;
 };
 
 }}}
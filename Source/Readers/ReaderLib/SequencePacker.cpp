@@ -7,6 +7,7 @@
 #define _SCL_SECURE_NO_WARNINGS
 
 #include <numeric>
+#include <algorithm>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include "SequencePacker.h"
@@ -36,19 +37,153 @@ MBLayoutPtr SequencePacker::CreateMBLayout(const StreamBatch& batch)
     return pMBLayout;
 }
 
+void SequencePacker::StartEpoch(const EpochConfiguration& config)
+{
+    PackerBase::StartEpoch(config);
+
+    size_t numberOfWorkers = max(config.m_numberOfWorkers, (size_t)1);
+    m_workerMinibatchSize = (m_minibatchSize + numberOfWorkers - 1) / numberOfWorkers;
+
+    m_window.clear();
+    m_windowSamples = 0;
+    m_endOfEnumeration = false;
+    m_packedSamples = 0;
+    m_packedColumns = 0;
+}
+
+Sequences SequencePacker::GetNextBucket()
+{
+    // Filling the window up to the requested number of minibatches of this worker.
+    // The enumerator is still asked for the global minibatch size, of which it returns this worker's share.
+    while (!m_endOfEnumeration && m_windowSamples < m_bucketingWindow * m_workerMinibatchSize)
+    {
+        auto sequences = m_sequenceEnumerator->GetNextSequences(m_minibatchSize);
+        m_endOfEnumeration = sequences.m_endOfEpoch;
+        if (sequences.m_data.empty() || sequences.m_data.front().empty())
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < sequences.m_data.front().size(); ++i)
+        {
+            BufferedSequence sequence;
+            sequence.m_numberOfSamples = 0;
+            for (const auto& streamBatch : sequences.m_data)
+            {
+                sequence.m_data.push_back(streamBatch[i]);
+                sequence.m_numberOfSamples = max(sequence.m_numberOfSamples, (size_t)streamBatch[i]->m_numberOfSamples);
+            }
+
+            m_windowSamples += sequence.m_numberOfSamples;
+            m_window.push_back(move(sequence));
+        }
+    }
+
+    Sequences result;
+    result.m_endOfEpoch = m_endOfEnumeration && m_window.empty();
+    if (m_window.empty())
+    {
+        return result;
+    }
+
+    vector<size_t> order(m_window.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(),
+        [this](size_t a, size_t b) { return m_window[a].m_numberOfSamples < m_window[b].m_numberOfSamples; });
+
+    // Starting with the oldest sequence and growing the bucket in the order of lengths in both directions,
+    // always taking the closest length, while the sequences fit into the minibatch.
+    size_t first = find(order.begin(), order.end(), (size_t)0) - order.begin();
+    size_t last = first + 1;
+    size_t length = m_window[0].m_numberOfSamples;
+    size_t samples = length;
+    for (;;)
+    {
+        bool shorterFits = first > 0 && samples + m_window[order[first - 1]].m_numberOfSamples <= m_workerMinibatchSize;
+        bool longerFits = last < order.size() && samples + m_window[order[last]].m_numberOfSamples <= m_workerMinibatchSize;
+        if (shorterFits && longerFits)
+        {
+            // Both fit, taking the closer one.
+            shorterFits = length - m_window[order[first - 1]].m_numberOfSamples <= m_window[order[last]].m_numberOfSamples - length;
+            longerFits = !shorterFits;
+        }
+
+        if (shorterFits)
+        {
+            samples += m_window[order[--first]].m_numberOfSamples;
+        }
+        else if (longerFits)
+        {
+            samples += m_window[order[last++]].m_numberOfSamples;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    // Longest sequences first, so that the shorter ones fill the remaining space of the rows.
+    vector<bool> selected(m_window.size(), false);
+    result.m_data.resize(m_window[0].m_data.size());
+    for (size_t i = last; i-- > first;)
+    {
+        const auto& sequence = m_window[order[i]];
+        for (size_t streamIndex = 0; streamIndex < sequence.m_data.size(); ++streamIndex)
+        {
+            result.m_data[streamIndex].push_back(sequence.m_data[streamIndex]);
+        }
+
+        selected[order[i]] = true;
+    }
+
+    // Removing the taken sequences, keeping the order of the remaining ones.
+    size_t remaining = 0;
+    for (size_t i = 0; i < m_window.size(); ++i)
+    {
+        if (!selected[i])
+        {
+            m_window[remaining++] = move(m_window[i]);
+        }
+    }
+
+    m_window.resize(remaining);
+    m_windowSamples -= samples;
+    result.m_endOfEpoch = m_endOfEnumeration && m_window.empty();
+    return result;
+}
+
+void SequencePacker::UpdatePaddingStatistics(const Minibatch& minibatch)
+{
+    for (const auto& stream : minibatch.m_data)
+    {
+        m_packedSamples += stream->m_layout->GetActualNumSamples();
+        m_packedColumns += stream->m_layout->GetNumCols();
+    }
+
+    if (minibatch.m_endOfEpoch && m_packedColumns > 0 && (m_bucketingWindow > 0 || m_verbosity > 0))
+    {
+        fprintf(stderr, "SequencePacker: padding efficiency %.2f%% (%" PRIu64 " samples in %" PRIu64 " columns)%s.\n",
+            100.0 * m_packedSamples / m_packedColumns, (uint64_t)m_packedSamples, (uint64_t)m_packedColumns,
+            m_bucketingWindow > 0 ? " with bucketing" : "");
+    }
+}
+
 Minibatch SequencePacker::ReadMinibatch()
 {
-    auto sequences = m_sequenceEnumerator->GetNextSequences(m_minibatchSize);
+    auto sequences = m_bucketingWindow > 0 ? GetNextBucket() : m_sequenceEnumerator->GetNextSequences(m_minibatchSize);
     const auto& batch = sequences.m_data;
 
     Minibatch minibatch(sequences.m_endOfEpoch);
     if (batch.empty())
     {
+        UpdatePaddingStatistics(minibatch);
         return minibatch;
     }
 
     assert(m_outputStreamDescriptions.size() == batch.size());
 
+    SwitchStreamBuffers();
+
     for (int streamIndex = 0; streamIndex < batch.size(); ++streamIndex)
     {
         const auto& streamBatch = batch[streamIndex];
@@ -64,6 +199,7 @@ Minibatch SequencePacker::ReadMinibatch()
         minibatch.m_data.push_back(streamMinibatch);
     }
 
+    UpdatePaddingStatistics(minibatch);
     return minibatch;
 }
 
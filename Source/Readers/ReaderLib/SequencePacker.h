@@ -11,20 +11,36 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 // This packer generates minibatches containing full sequences packed for 
 // efficient (concurrent) consumption on a GPU.
+//
+// With bucketing enabled (bucketingWindow > 0) the packer looks ahead the given number of minibatches
+// of randomized sequences and builds each minibatch from sequences of similar length, so that the layout
+// has fewer gaps. The oldest sequence of the window always goes into the next minibatch, so a sequence is
+// never delayed by more than the window and the randomization only changes locally.
 class SequencePacker : public PackerBase
 {
 public:
     SequencePacker(
         MemoryProviderPtr memoryProvider,
         SequenceEnumeratorPtr sequenceEnumerator,
-        const std::vector<StreamDescriptionPtr>& streams) :
-        PackerBase(memoryProvider, sequenceEnumerator, streams)
+        const std::vector<StreamDescriptionPtr>& streams,
+        size_t bucketingWindow = 0,
+        int verbosity = 0) :
+        PackerBase(memoryProvider, sequenceEnumerator, streams),
+        m_bucketingWindow(bucketingWindow),
+        m_verbosity(verbosity),
+        m_workerMinibatchSize(0),
+        m_windowSamples(0),
+        m_endOfEnumeration(false),
+        m_packedSamples(0),
+        m_packedColumns(0)
     {
 
     }
 
     virtual Minibatch ReadMinibatch() override;
 
+    virtual void StartEpoch(const EpochConfiguration& config) override;
+
 protected:
     virtual MBLayoutPtr PackDenseStream(const StreamBatch& batch, size_t streamIndex);
 
@@ -33,6 +49,36 @@ protected:
     // Given a number of sequences, creates an MB layout that is used to guide
     // the actual packing.
     virtual MBLayoutPtr CreateMBLayout(const StreamBatch& batch);
+
+private:
+    // A sequence of the look-ahead window, with its data in all streams.
+    struct BufferedSequence
+    {
+        std::vector<SequenceDataPtr> m_data;
+        size_t m_numberOfSamples; // Maximum number of samples across streams
+    };
+
+    // Fills the look-ahead window and takes the sequences of the next minibatch out of it.
+    Sequences GetNextBucket();
+
+    // Accounts the samples and columns of the packed minibatch, reports the padding efficiency at the end of the epoch.
+    void UpdatePaddingStatistics(const Minibatch& minibatch);
+
+    // Size of the look-ahead window in minibatches, 0 disables bucketing.
+    size_t m_bucketingWindow;
+    int m_verbosity;
+
+    // This worker's share of the minibatch, the enumerator only returns the sequences of this worker.
+    size_t m_workerMinibatchSize;
+
+    // Sequences of the look-ahead window in the order they came from the enumerator.
+    std::vector<BufferedSequence> m_window;
+    size_t m_windowSamples;
+    bool m_endOfEnumeration;
+
+    // Number of samples and of layout columns (samples and gaps) packed in the epoch, across streams.
+    size_t m_packedSamples;
+    size_t m_packedColumns;
 };
 
 typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
@@ -0,0 +1,181 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "TransformController.h"
+#include <algorithm>
+#include <condition_variable>
+#include <omp.h>
+#include "ExceptionCapture.h"
+#include "TimerUtility.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+TransformController::TransformController(const std::vector<Transformation>& transformations, SequenceEnumeratorPtr sequenceProvider, int verbosity)
+    : m_sequenceProvider(sequenceProvider), m_verbosity(verbosity)
+{
+    // Applying transformations to stream descriptions,
+    // i.e. a transformation can change a stream from dense to sparse.
+    std::vector<StreamDescriptionPtr> transformedStreams = m_sequenceProvider->GetStreamDescriptions();
+    for (auto& t : transformations)
+    {
+        size_t streamId = GetStreamId(t.m_streamName, transformedStreams);
+        auto stream = std::find_if(m_streamTransformations.begin(), m_streamTransformations.end(),
+                                   [streamId](const StreamTransformations& s) { return s.m_streamId == streamId; });
+        if (stream == m_streamTransformations.end())
+        {
+            m_streamTransformations.push_back(StreamTransformations{ streamId, std::vector<size_t>() });
+            stream = m_streamTransformations.end() - 1;
+        }
+
+        stream->m_transformations.push_back(m_transformations.size());
+        m_transformations.push_back(std::make_pair(t, streamId));
+        transformedStreams[streamId] = std::make_shared<StreamDescription>(t.m_transformer->Transform(*transformedStreams[streamId]));
+    }
+    m_outputStreams = transformedStreams;
+
+    m_statistics.reset(new TransformStatistics[m_transformations.size()]);
+    for (size_t i = 0; i < m_transformations.size(); ++i)
+    {
+        m_statistics[i].m_microseconds = 0;
+        m_statistics[i].m_sequences = 0;
+    }
+
+    // The readers control the number of CPU threads through OpenMP (e.g. numCPUThreads of the image reader).
+    m_threadPool.reset(new WorkStealingThreadPool(omp_get_max_threads()));
+}
+
+// Sets configuration for the current epoch.
+// Some transformers can change their config based on the epoch.
+void TransformController::StartEpoch(const EpochConfiguration &config)
+{
+    assert(m_sequenceProvider != nullptr);
+    ReportStatistics();
+    for (auto& t : m_transformations)
+    {
+        t.first.m_transformer->StartEpoch(config);
+    }
+
+    m_sequenceProvider->StartEpoch(config);
+}
+
+// Gets next sequences up to a maximum count of samples,
+// applying transformers to particular streams.
+Sequences TransformController::GetNextSequences(size_t sampleCount)
+{
+    assert(m_sequenceProvider != nullptr);
+    Sequences sequences = m_sequenceProvider->GetNextSequences(sampleCount);
+    if (sequences.m_data.empty() || sequences.m_data.front().empty())
+    {
+        return sequences;
+    }
+
+    // One task per sequence and transformed stream, with the size of the input as the estimate of the cost.
+    struct Task
+    {
+        size_t m_cost;
+        size_t m_sequence;
+        size_t m_stream; // index into m_streamTransformations
+    };
+
+    auto inputStreams = m_sequenceProvider->GetStreamDescriptions();
+    size_t numberOfSequences = sequences.m_data.front().size();
+    std::vector<Task> tasks;
+    tasks.reserve(numberOfSequences * m_streamTransformations.size());
+    for (size_t s = 0; s < m_streamTransformations.size(); ++s)
+    {
+        const auto& stream = *inputStreams[m_streamTransformations[s].m_streamId];
+        for (size_t j = 0; j < numberOfSequences; ++j)
+        {
+            const auto& sequence = sequences.m_data[m_streamTransformations[s].m_streamId][j];
+            size_t cost = sequence->m_numberOfSamples;
+            if (stream.m_storageType == StorageType::dense)
+            {
+                const auto& layout = static_cast<const DenseSequenceData&>(*sequence).m_sampleLayout;
+                cost *= layout ? layout->GetNumElements() : stream.m_sampleLayout ? stream.m_sampleLayout->GetNumElements() : 1;
+            }
+            tasks.push_back(Task{ cost, j, s });
+        }
+    }
+
+    // Workers take the newest task of their own queue first and steal the oldest ones,
+    // so queueing the cheapest tasks first makes each worker start with its most expensive ones.
+    std::stable_sort(tasks.begin(), tasks.end(), [](const Task& a, const Task& b) { return a.m_cost < b.m_cost; });
+
+    ExceptionCapture capture;
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t remaining = tasks.size();
+    for (const auto& task : tasks)
+    {
+        m_threadPool->Submit([this, task, &sequences, &capture, &mutex, &done, &remaining](size_t)
+        {
+            const auto& stream = m_streamTransformations[task.m_stream];
+            capture.SafeRun([this, &stream, &sequences](size_t sequenceId)
+            {
+                Apply(stream.m_transformations, sequences.m_data[stream.m_streamId][sequenceId]);
+            }, task.m_sequence);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--remaining == 0)
+            {
+                done.notify_one();
+            }
+        });
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&remaining] { return remaining == 0; });
+    }
+
+    capture.RethrowIfHappened();
+    return sequences;
+}
+
+void TransformController::Apply(const std::vector<size_t>& transformations, SequenceDataPtr& sequence)
+{
+    Timer timer;
+    for (size_t i : transformations)
+    {
+        timer.Restart();
+        sequence = m_transformations[i].first.m_transformer->Transform(sequence);
+        timer.Stop();
+
+        m_statistics[i].m_microseconds += (long long)(timer.ElapsedSeconds() * MICRO_PER_SEC);
+        m_statistics[i].m_sequences++;
+    }
+}
+
+void TransformController::ReportStatistics()
+{
+    for (size_t i = 0; i < m_transformations.size(); ++i)
+    {
+        long long microseconds = m_statistics[i].m_microseconds.exchange(0);
+        size_t count = m_statistics[i].m_sequences.exchange(0);
+        if (m_verbosity >= 1 && count > 0)
+        {
+            fprintf(stderr, "TransformController: transformation %d of stream '%ls': %d sequences, %.3f seconds, %.1f microseconds per sequence\n",
+                    (int)i, m_transformations[i].first.m_streamName.c_str(), (int)count, microseconds / (double)MICRO_PER_SEC, microseconds / (double)count);
+        }
+    }
+}
+
+size_t TransformController::GetStreamId(const std::wstring streamName, const std::vector<StreamDescriptionPtr>& streams) const
+{
+    for (const auto& s : streams)
+    {
+        if (s->m_name == streamName)
+        {
+            return s->m_id;
+        }
+    }
+
+    assert(false);
+    LogicError("Unexpected stream specified for transformation.");
+}
+
+}}}
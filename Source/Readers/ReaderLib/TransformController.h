@@ -6,10 +6,11 @@
 #pragma once
 
 #include <set>
+#include <atomic>
 
 #include "Transformer.h"
 #include "SequenceEnumerator.h"
-#include "ExceptionCapture.h"
+#include "WorkStealingThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -23,36 +24,20 @@ struct Transformation
 // A class responsible for applying a list of transformers to sequences and stream descriptions.
 // Delegates retrieving of sequences to another sequence provider(such as randomizer) and applies transformations after retrieving.
 // Usually used by the packer to get next set of sequences.
+//
+// The transformations of a stream are applied in order, but the transformations of different streams are independent,
+// so each (sequence, stream) pair is a separate task on a work-stealing thread pool. Tasks are queued so that
+// each worker starts with the largest inputs and the small ones are left for stealing at the end,
+// which keeps a few large images from delaying the whole minibatch.
+// The time spent in each transformation is accumulated and reported at the start of each epoch with verbosity >= 1.
 class TransformController : public SequenceEnumerator
 {
 public:
-    TransformController(const std::vector<Transformation>& transformations, SequenceEnumeratorPtr sequenceProvider)
-        : m_sequenceProvider(sequenceProvider)
-    {
-        // Applying transformations to stream descriptions,
-        // i.e. a transformation can change a stream from dense to sparse.
-        std::vector<StreamDescriptionPtr> transformedStreams = m_sequenceProvider->GetStreamDescriptions();
-        for (auto& t : transformations)
-        {
-            size_t streamId = GetStreamId(t.m_streamName, transformedStreams);
-            m_transformations.push_back(std::make_pair(t, streamId));
-            transformedStreams[streamId] = std::make_shared<StreamDescription>(t.m_transformer->Transform(*transformedStreams[streamId]));
-        }
-        m_outputStreams = transformedStreams;
-    }
+    TransformController(const std::vector<Transformation>& transformations, SequenceEnumeratorPtr sequenceProvider, int verbosity = 0);
 
     // Sets configuration for the current epoch.
     // Some transformers can change their config based on the epoch.
-    virtual void StartEpoch(const EpochConfiguration &config) override
-    {
-        assert(m_sequenceProvider != nullptr);
-        for (auto& t : m_transformations)
-        {
-            t.first.m_transformer->StartEpoch(config);
-        }
-
-        m_sequenceProvider->StartEpoch(config);
-    }
+    virtual void StartEpoch(const EpochConfiguration &config) override;
 
     // Description of streams that the transformer provides.
     virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
@@ -62,50 +47,38 @@ public:
 
     // Gets next sequences up to a maximum count of samples,
     // applying transformers to particular streams.
-    virtual Sequences GetNextSequences(size_t sampleCount) override
-    {
-        assert(m_sequenceProvider != nullptr);
-        Sequences sequences = m_sequenceProvider->GetNextSequences(sampleCount);
-        if (sequences.m_data.empty())
-        {
-            return sequences;
-        }
-
-        ExceptionCapture capture;
-#pragma omp parallel for schedule(dynamic)
-        for (int j = 0; j < sequences.m_data.front().size(); ++j)
-        {
-            capture.SafeRun([this, &sequences](int sequenceId)
-            {
-                for (auto& t : m_transformations)
-                {
-                    sequences.m_data[t.second][sequenceId] = t.first.m_transformer->Transform(sequences.m_data[t.second][sequenceId]);
-                }
-            }, j);
-        }
-
-        capture.RethrowIfHappened();
-        return sequences;
-    }
+    virtual Sequences GetNextSequences(size_t sampleCount) override;
 
 private:
-    size_t GetStreamId(const std::wstring streamName, const std::vector<StreamDescriptionPtr>& streams) const
+    size_t GetStreamId(const std::wstring streamName, const std::vector<StreamDescriptionPtr>& streams) const;
+
+    // Applies the transformations of a stream to a sequence.
+    void Apply(const std::vector<size_t>& transformations, SequenceDataPtr& sequence);
+
+    // Prints and resets the time spent in the transformations.
+    void ReportStatistics();
+
+    // Transformations applied to a single stream, as indices into m_transformations.
+    struct StreamTransformations
     {
-        for (const auto& s : streams)
-        {
-            if (s->m_name == streamName)
-            {
-                return s->m_id;
-            }
-        }
-
-        assert(false);
-        LogicError("Unexpected stream specified for transformation.");
-    }
+        size_t m_streamId;
+        std::vector<size_t> m_transformations;
+    };
+
+    // Time spent in a transformation since the last report.
+    struct TransformStatistics
+    {
+        std::atomic<long long> m_microseconds;
+        std::atomic<size_t> m_sequences;
+    };
 
     SequenceEnumeratorPtr m_sequenceProvider;
     std::vector<StreamDescriptionPtr> m_outputStreams;
     std::vector<std::pair<Transformation, size_t>> m_transformations;
+    std::vector<StreamTransformations> m_streamTransformations;
+    std::unique_ptr<TransformStatistics[]> m_statistics;
+    std::unique_ptr<WorkStealingThreadPool> m_threadPool;
+    int m_verbosity;
 };
 
 }}}
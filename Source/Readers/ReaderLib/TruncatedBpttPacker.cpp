@@ -130,6 +130,8 @@ TruncatedBPTTPacker::TruncatedBPTTPacker(
 
 void TruncatedBPTTPacker::StartEpoch(const EpochConfiguration& config)
 {
+    PrepareStreamBuffers(config);
+
     if (m_minibatchSize != config.m_minibatchSizeInSamples ||
         m_truncationSize != config.m_truncationSize)
     {
@@ -159,16 +161,19 @@ void TruncatedBPTTPacker::StartEpoch(const EpochConfiguration& config)
 
         m_sequenceBufferPerStream.clear();
 
-        // Preparing the buffers.
         for (int i = 0; i < m_outputStreamDescriptions.size(); ++i)
         {
-            const auto& stream = m_outputStreamDescriptions[i];
-            auto& buffer = m_streamBuffers[i];
-            buffer.Resize(m_numParallelSequences * m_truncationSize * GetSampleSize(stream));
             m_sequenceBufferPerStream.push_back(make_shared<SequenceBuffer>(m_numParallelSequences));
         }
     }
 
+    // Preparing the buffers (no-op if they have the right size already).
+    for (int i = 0; i < m_outputStreamDescriptions.size(); ++i)
+    {
+        const auto& stream = m_outputStreamDescriptions[i];
+        ResizeStreamBuffers(i, m_numParallelSequences * m_truncationSize * GetSampleSize(stream));
+    }
+
     // Filling in the initial set of sequences
     for (size_t slotIndex = 0; slotIndex < m_numParallelSequences; ++slotIndex)
     {
@@ -188,9 +193,19 @@ Minibatch TruncatedBPTTPacker::ReadMinibatch()
         return result;
     }
 
+    SwitchStreamBuffers();
+
     // Iterating over the streams/slots and packing them into the minibatch.
     for (size_t streamIndex = 0; streamIndex < m_outputStreamDescriptions.size(); ++streamIndex)
     {
+        // The layouts of previous minibatches may still be in use, see EpochConfiguration::m_numberOfBuffers.
+        if (!m_previousStreamBuffers.empty())
+        {
+            auto pMBLayout = make_shared<MBLayout>();
+            pMBLayout->SetUniqueAxisName(L"TruncatedBPTTPacker");
+            m_currentLayouts[streamIndex] = pMBLayout;
+        }
+
         m_currentLayouts[streamIndex]->Init(m_numParallelSequences, m_truncationSize);
         size_t sequenceId = 0;
         for (size_t slotIndex = 0; slotIndex < m_numParallelSequences; ++slotIndex)
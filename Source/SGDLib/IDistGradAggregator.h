@@ -21,6 +21,18 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) = 0;
 
+    // Tells that one of the gradients of the next AggregateGradients() call is final, so that an aggregator which overlaps
+    // communication with backprop can start on it. Aggregators that do not overlap ignore this.
+    virtual void GradientReady(const Matrix<ElemType>* /*gradient*/)
+    {
+    }
+
+    // whether GradientReady() is acted upon; the caller should then pass the gradients in the order in which backprop completes them
+    virtual bool IsOverlappingBackprop() const
+    {
+        return false;
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
@@ -17,6 +17,7 @@
 #include <stdexcept>
 #include <chrono> 
 #include <random>
+#include <functional>
 
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -39,12 +40,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         size_t m_localSamplesProcessedSinceLastReport; 
         double m_accumulatedSecondsOnSyncPointInOneEpoch;
         size_t m_syncPointHitCounterInOneEpoch;
+        double m_accumulatedSecondsOnCommunicationInOneEpoch;
         Timer  m_Timer; 
 
     public:
         MASGDPerfStats(size_t myRank, size_t numWorkers):
             m_numWorkers(numWorkers), m_myRank(myRank), m_numSyncPerformedInCurrentEpoch(0), m_reportFrequency(1), 
-            m_totalSamplesProcessedSinceLastReport(0), m_localSamplesProcessedSinceLastReport(0)
+            m_totalSamplesProcessedSinceLastReport(0), m_localSamplesProcessedSinceLastReport(0),
+            m_accumulatedSecondsOnSyncPointInOneEpoch(0), m_syncPointHitCounterInOneEpoch(0), m_accumulatedSecondsOnCommunicationInOneEpoch(0)
         {
             m_Timer.Start();
         }
@@ -60,14 +63,23 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             m_numSyncPerformedInCurrentEpoch = 0; 
             m_accumulatedSecondsOnSyncPointInOneEpoch = 0;
             m_syncPointHitCounterInOneEpoch = 0;
+            m_accumulatedSecondsOnCommunicationInOneEpoch = 0;
         }
         void OnEpochEnd()
         {
             m_Timer.Stop();
+            if (m_reportFrequency > 0 && m_numSyncPerformedInCurrentEpoch > 0)
+            {
+                fprintf(stderr, "\t\t(model aggregation stats) %d syncs in this epoch, %.2f seconds on comm., average = %.2f ms per sync\n",
+                        (int)m_numSyncPerformedInCurrentEpoch,
+                        m_accumulatedSecondsOnCommunicationInOneEpoch,
+                        m_accumulatedSecondsOnCommunicationInOneEpoch * 1000 / m_numSyncPerformedInCurrentEpoch);
+            }
         }
         void OnMAPerformed(size_t localSamplesProcessedSinceLastSync, size_t totalSamplesProcessedSinceLastSync, float secondsOnCommunication)
         {
             m_numSyncPerformedInCurrentEpoch++;
+            m_accumulatedSecondsOnCommunicationInOneEpoch += secondsOnCommunication;
             m_totalSamplesProcessedSinceLastReport += totalSamplesProcessedSinceLastSync; 
             m_localSamplesProcessedSinceLastReport += localSamplesProcessedSinceLastSync; 
             if ( m_reportFrequency > 0 && 
@@ -123,13 +135,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     {
         typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
      public:
-         IMASGD(const MPIWrapperPtr& pMPI, size_t perfReportFreq, DEVICEID_TYPE devId)
+         IMASGD(const MPIWrapperPtr& pMPI, size_t perfReportFreq, DEVICEID_TYPE devId, MPIAllReduceAlgorithm allReduceAlgorithm = MPIAllReduceAlgorithm::Default)
              : m_MAworkerStatus(pMPI->NumNodesInUse(), MAWorkerStatus::NOTSTARTED), 
              m_numSyncPerformed(0), 
              m_numWorkers(pMPI->NumNodesInUse()), 
              m_myRank(pMPI->CurrentNodeRank()),
              m_pMPI(pMPI), 
              m_deviceId(devId),
+             m_allReduceAlgorithm(allReduceAlgorithm),
              m_perfReporter(pMPI->CurrentNodeRank(), pMPI->NumNodesInUse())
          {
              m_perfReporter.SetReportFrequency(perfReportFreq);
@@ -304,6 +317,115 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
             return retval;
         }
+        // Sets each parameter to the sum over all workers of 'factor' times its value, for use by ModelAggregationProcessing().
+        // The parameters are staged in a flat buffer that is kept across syncs, and the buffer is all-reduced in chunks:
+        // while a chunk is being reduced by a non-blocking all-reduce, the next one is staged, and reduced chunks are written
+        // back as soon as they are done. Small parameters share a chunk, large ones span several.
+        // The built-in all-reduce algorithms of MPIWrapper are blocking, so with them the whole buffer is reduced at once.
+        void AggregateModel(const std::list<ComputationNodeBasePtr>& learnableNodes, ElemType factor, float& secondsOnCommunication)
+        {
+            Timer commTimer;
+            commTimer.Start();
+
+            // lay out the parameters in the buffer; it is only reallocated if their total size changes
+            m_modelSegments.clear();
+            size_t numElements = 0;
+            for (auto& pBaseNode : learnableNodes)
+            {
+                if (!pBaseNode->IsParameterUpdateRequired())
+                    continue;
+                auto pNode = DownCast(pBaseNode);
+                m_modelSegments.push_back(ModelSegment{ pNode, numElements, pNode->Value().GetNumElements() });
+                numElements += pNode->Value().GetNumElements();
+            }
+            if (m_modelBuffer.size() != numElements)
+                m_modelBuffer.resize(numElements);
+
+            // the slice [begin, end) of the buffer, and of the parameters it stands for
+            auto forEachSlice = [this](size_t begin, size_t end, const std::function<void(Matrix<ElemType>&, ElemType*)>& fn)
+            {
+                for (const auto& segment : m_modelSegments)
+                {
+                    size_t sliceBegin = max(begin, segment.m_offset);
+                    size_t sliceEnd = min(end, segment.m_offset + segment.m_numElements);
+                    if (sliceBegin >= sliceEnd)
+                        continue;
+                    Matrix<ElemType> slice = segment.m_node->Value().Reshaped(1, segment.m_numElements).ColumnSlice(sliceBegin - segment.m_offset, sliceEnd - sliceBegin);
+                    fn(slice, m_modelBuffer.data() + sliceBegin);
+                }
+            };
+            auto stage = [&](size_t begin, size_t end)
+            {
+                forEachSlice(begin, end, [](Matrix<ElemType>& slice, ElemType* buffer)
+                {
+                    size_t bufferSize = slice.GetNumElements();
+                    slice.CopyToArray(buffer, bufferSize); // no allocation, the buffer is large enough
+                });
+                for (size_t i = begin; i < end; i++)
+                    m_modelBuffer[i] *= factor;
+            };
+            auto writeBack = [&](size_t begin, size_t end)
+            {
+                forEachSlice(begin, end, [](Matrix<ElemType>& slice, ElemType* buffer)
+                {
+                    slice.SetValue(1, slice.GetNumElements(), slice.GetDeviceId(), buffer);
+                });
+            };
+
+            bool isParallel = (m_pMPI->NumNodesInUse() > 1) && (m_pMPI->Communicator() != MPI_COMM_NULL);
+            if (isParallel && m_allReduceAlgorithm != MPIAllReduceAlgorithm::Default)
+            {
+                stage(0, numElements);
+                m_pMPI->AllReduce(m_modelBuffer.data(), numElements, m_allReduceAlgorithm);
+                writeBack(0, numElements);
+            }
+            else
+            {
+                size_t chunkSize = ModelAggregationChunkSize;
+                size_t numChunks = (numElements + chunkSize - 1) / chunkSize;
+                std::vector<MPI_Request> requests(numChunks, MPI_REQUEST_NULL);
+                size_t numWrittenBack = 0;
+                for (size_t chunk = 0; chunk < numChunks; chunk++)
+                {
+                    size_t begin = chunk * chunkSize;
+                    size_t end = min(numElements, begin + chunkSize);
+                    stage(begin, end);
+                    if (isParallel)
+                    {
+                        ElemType* buffer = m_modelBuffer.data() + begin;
+                        MPI_Iallreduce(MPI_IN_PLACE, buffer, (int)(end - begin), MPIWrapper::GetDataType(buffer), MPI_SUM, m_pMPI->Communicator(), &requests[chunk]) || MpiFail("MPI_Iallreduce");
+                    }
+
+                    // write back the chunks that are done, in order, and bound the number of chunks in flight
+                    while (numWrittenBack <= chunk)
+                    {
+                        int done = 0;
+                        if (chunk + 1 - numWrittenBack > MaxModelAggregationChunksInFlight)
+                        {
+                            MPI_Wait(&requests[numWrittenBack], MPI_STATUS_IGNORE) || MpiFail("MPI_Wait");
+                            done = 1;
+                        }
+                        else
+                        {
+                            MPI_Test(&requests[numWrittenBack], &done, MPI_STATUS_IGNORE) || MpiFail("MPI_Test");
+                        }
+                        if (!done)
+                            break;
+                        writeBack(numWrittenBack * chunkSize, min(numElements, (numWrittenBack + 1) * chunkSize));
+                        numWrittenBack++;
+                    }
+                }
+                for (; numWrittenBack < numChunks; numWrittenBack++)
+                {
+                    MPI_Wait(&requests[numWrittenBack], MPI_STATUS_IGNORE) || MpiFail("MPI_Wait");
+                    writeBack(numWrittenBack * chunkSize, min(numElements, (numWrittenBack + 1) * chunkSize));
+                }
+            }
+
+            commTimer.Stop();
+            secondsOnCommunication += (float)commTimer.ElapsedSeconds();
+        }
+
         // borrow DownCast function from ComputationNetwork
         ComputationNodePtr DownCast(ComputationNodeBasePtr inode)
         {
@@ -320,6 +442,20 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         MASGDPerfStats              m_perfReporter;
         MPIWrapperPtr m_pMPI;
         DEVICEID_TYPE               m_deviceId;
+        MPIAllReduceAlgorithm       m_allReduceAlgorithm;
+
+    private:
+        static const size_t ModelAggregationChunkSize = 1 << 18;   // elements per all-reduce
+        static const size_t MaxModelAggregationChunksInFlight = 4;
+
+        struct ModelSegment
+        {
+            ComputationNodePtr m_node;
+            size_t m_offset;       // in m_modelBuffer
+            size_t m_numElements;
+        };
+        std::vector<ModelSegment>   m_modelSegments;
+        std::vector<ElemType>       m_modelBuffer;
  };
 
 
@@ -329,11 +465,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     {
         typedef IMASGD<ElemType> Base; 
         using Base::m_pMPI;
-        using Base::DownCast;
+        using Base::AggregateModel;
 
     public:
-        BasicModelAveragingSGD(const MPIWrapperPtr& pMPI, size_t reportFreq, DEVICEID_TYPE devID)
-            : Base(pMPI, reportFreq, devID)
+        BasicModelAveragingSGD(const MPIWrapperPtr& pMPI, size_t reportFreq, DEVICEID_TYPE devID, MPIAllReduceAlgorithm allReduceAlgorithm = MPIAllReduceAlgorithm::Default)
+            : Base(pMPI, reportFreq, devID, allReduceAlgorithm)
         {
             fprintf(stderr, "Parallel training (%d workers) using ModelAveraging\n",(int)m_pMPI->NumNodesInUse());
         }
@@ -373,34 +509,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             }
 
             //----------------------------------------
-            // 2. process for each individual node
+            // 2. average the models, weighted by the contributions
             //----------------------------------------
-            for (auto& pBaseNode : learnableNodes)
-            {
-                if (!pBaseNode->IsParameterUpdateRequired())
-                {
-                    continue;
-                }
-                // 2.1 model averaging
-                auto pNode = DownCast(pBaseNode);
-                // 2.1.1. average model from individual models 
-                Matrix<ElemType> mat(pNode->Value().DeepClone()); // pNode->Value returns lvalue, so a deep copy is invoked here
-                // 2.1.2. normalize the weight matrix 
-                Matrix<ElemType>::Scale(factor, mat);
-                // 2.1.3. send weight matrix over MPI nodes; 
-                unique_ptr<ElemType[]> px(mat.CopyToArray());
-                //ElemType* px = mat.CopyToArray();
-                size_t    nx = mat.GetNumElements();
-                // 2.1.4. inplace sum 
-                commTimer.Restart();
-                m_pMPI->AllReduce(px.get(), nx);
-                commTimer.Stop();
-                secondsOnCommunication += (float)commTimer.ElapsedSeconds();
-                // 2.1.5. set value 
-                pNode->Value().SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), px.get());
-                // 2.1.6. clean up 
-                //delete[]px;
-            }
+            AggregateModel(learnableNodes, (ElemType)factor, secondsOnCommunication);
         }
     };
 
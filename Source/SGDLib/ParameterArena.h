@@ -0,0 +1,254 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ParameterArena.h -- contiguous storage for the learnable parameters, their gradients and smoothed gradients
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "ComputationNode.h"
+#include <list>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// ParameterArena -- keeps the values, gradients and (optionally) smoothed gradients of the dense learnable parameters
+// in three contiguous 1 x N matrices, and turns the matrices of the nodes into views into them.
+// An elementwise optimizer step then takes one set of matrix operations for all parameters instead of one per parameter,
+// and the gradients can be aggregated as a single buffer.
+// The parameters are ordered by their learning rate multiplier; each run of equal multipliers forms a group with its own step.
+//
+// Other code may replace the storage behind a node matrix, e.g. when a model is reread from disk, or when a gradient
+// becomes sparse because the parameter is applied to sparse input. Bind() therefore checks all views before they are used:
+// dense matrices that were replaced are copied back into the arena and rebound, while a parameter whose gradient became
+// sparse leaves the arena for good, taking its value and smoothed gradient with it.
+template <class ElemType>
+class ParameterArena
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    struct Group
+    {
+        double m_learningRateMultiplier;
+        size_t m_begin; // first column in the arena
+        size_t m_end;
+    };
+
+    ParameterArena(const std::list<ComputationNodeBasePtr>& learnableNodes, bool withSmoothedGradients, DEVICEID_TYPE deviceId)
+        : m_values(deviceId), m_gradients(deviceId), m_smoothedGradients(deviceId), m_withSmoothedGradients(withSmoothedGradients)
+    {
+        size_t index = 0;
+        for (const auto& learnableNode : learnableNodes)
+        {
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(learnableNode);
+            if (node && node->IsParameterUpdateRequired() && node->Value().GetMatrixType() == MatrixType::DENSE && node->Value().GetNumElements() > 0)
+                m_entries.push_back(Entry{ node, index, 0, node->Value().GetNumElements(), false });
+            index++;
+        }
+
+        std::stable_sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b)
+        {
+            return a.m_node->GetLearningRateMultiplier() < b.m_node->GetLearningRateMultiplier();
+        });
+
+        size_t offset = 0;
+        for (auto& entry : m_entries)
+        {
+            double multiplier = entry.m_node->GetLearningRateMultiplier();
+            if (m_groups.empty() || m_groups.back().m_learningRateMultiplier != multiplier)
+                m_groups.push_back(Group{ multiplier, offset, offset });
+
+            entry.m_offset = offset;
+            offset += entry.m_numElements;
+            m_groups.back().m_end = offset;
+        }
+
+        if (offset == 0)
+            return;
+
+        m_values.Resize(1, offset);
+        m_values.SetValue(0);
+        m_gradients.Resize(1, offset);
+        m_gradients.SetValue(0);
+        if (m_withSmoothedGradients)
+        {
+            m_smoothedGradients.Resize(1, offset);
+            m_smoothedGradients.SetValue(0);
+        }
+    }
+
+    bool IsEmpty() const { return m_entries.empty(); }
+    size_t GetNumElements() const { return m_values.GetNumCols(); }
+    size_t GetNumParameters() const { return m_entries.size(); }
+    const std::vector<Group>& GetGroups() const { return m_groups; }
+
+    // the nodes whose matrices are currently views into the arena
+    bool Contains(const ComputationNodeBasePtr& node) const { return m_boundNodes.find(node.get()) != m_boundNodes.end(); }
+    const std::vector<ComputationNodePtr>& GetBoundNodes() const { return m_boundNodeList; }
+
+    Matrix<ElemType>& Values()            { return m_values; }
+    Matrix<ElemType>& Gradients()         { return m_gradients; }
+    Matrix<ElemType>& SmoothedGradients() { return m_smoothedGradients; }
+
+    // a group's range of one of the arena matrices
+    static Matrix<ElemType> GroupSlice(const Matrix<ElemType>& arena, const Group& group)
+    {
+        return arena.ColumnSlice(group.m_begin, group.m_end - group.m_begin);
+    }
+
+    // Makes sure the node matrices are views into the arena; 'learnableNodes' and 'smoothedGradients' are the lists the arena was created for.
+    // Returns the number of parameters whose gradient matrix changed in this call, by being rebound or by leaving the arena.
+    size_t Bind(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients)
+    {
+        std::vector<Matrix<ElemType>*> smoothedGradientByIndex;
+        for (auto& smoothedGradient : smoothedGradients)
+            smoothedGradientByIndex.push_back(&smoothedGradient);
+        if (smoothedGradientByIndex.size() != learnableNodes.size())
+            LogicError("ParameterArena: The smoothed gradients do not match the learnable parameters.");
+
+        size_t numDetached = 0;
+        size_t numChanged = 0;
+        for (auto& entry : m_entries)
+        {
+            if (entry.m_detached)
+                continue;
+
+            Matrix<ElemType>& value = entry.m_node->Value();
+            Matrix<ElemType>& smoothedGradient = *smoothedGradientByIndex[entry.m_index];
+            auto& gradient = entry.m_node->GradientPtrRef();
+            if (value.GetMatrixType() != MatrixType::DENSE || value.GetNumElements() != entry.m_numElements ||
+                (gradient && gradient->GetMatrixType() != MatrixType::DENSE))
+            {
+                Detach(entry, smoothedGradient);
+                numDetached++;
+                numChanged++;
+                continue;
+            }
+
+            size_t numRows = value.GetNumRows();
+            size_t numCols = value.GetNumCols();
+
+            Matrix<ElemType> valueView = View(m_values, entry, numRows, numCols);
+            if (!IsViewOf(value, valueView))
+            {
+                valueView.AssignValuesOf(value);
+                value = std::move(valueView);
+            }
+
+            // The gradient matrix object may be shared with other nodes through the MatrixPool, so the node gets a new one.
+            Matrix<ElemType> gradientView = View(m_gradients, entry, numRows, numCols);
+            if (!gradient || !IsViewOf(*gradient, gradientView))
+            {
+                if (gradient && gradient->GetNumElements() == entry.m_numElements)
+                    gradientView.AssignValuesOf(gradient->Reshaped(numRows, numCols));
+                else
+                    gradientView.SetValue(0);
+                gradient = make_shared<Matrix<ElemType>>(std::move(gradientView));
+                numChanged++;
+            }
+
+            if (m_withSmoothedGradients)
+            {
+                Matrix<ElemType> smoothedGradientView = View(m_smoothedGradients, entry, numRows, numCols);
+                if (!IsViewOf(smoothedGradient, smoothedGradientView))
+                {
+                    if (smoothedGradient.GetMatrixType() == MatrixType::DENSE && smoothedGradient.GetNumElements() == entry.m_numElements)
+                        smoothedGradientView.AssignValuesOf(smoothedGradient.Reshaped(numRows, numCols));
+                    else
+                        smoothedGradientView.SetValue(0);
+                    smoothedGradient = std::move(smoothedGradientView);
+                }
+            }
+        }
+
+        if (numDetached > 0 || m_boundNodeList.empty())
+        {
+            m_boundNodes.clear();
+            m_boundNodeList.clear();
+            for (const auto& entry : m_entries)
+            {
+                if (!entry.m_detached)
+                {
+                    m_boundNodes.insert(entry.m_node.get());
+                    m_boundNodeList.push_back(entry.m_node);
+                }
+            }
+        }
+
+        return numChanged;
+    }
+
+private:
+    struct Entry
+    {
+        ComputationNodePtr m_node;
+        size_t m_index;       // position in the list of learnable nodes
+        size_t m_offset;      // first column in the arena
+        size_t m_numElements;
+        bool m_detached;
+    };
+
+    static Matrix<ElemType> View(const Matrix<ElemType>& arena, const Entry& entry, size_t numRows, size_t numCols)
+    {
+        return arena.ColumnSlice(entry.m_offset, entry.m_numElements).Reshaped(numRows, numCols);
+    }
+
+    static bool IsViewOf(const Matrix<ElemType>& matrix, const Matrix<ElemType>& view)
+    {
+        return matrix.GetMatrixType() == MatrixType::DENSE &&
+               matrix.GetDeviceId() == view.GetDeviceId() &&
+               matrix.GetNumRows() == view.GetNumRows() &&
+               matrix.GetNumCols() == view.GetNumCols() &&
+               matrix.Data() == view.Data();
+    }
+
+    // Gives the value and smoothed gradient their own storage again. Their slots are cleared, so that the group steps,
+    // which still run over them, leave them at zero (up to injected noise, which is never read).
+    void Detach(Entry& entry, Matrix<ElemType>& smoothedGradient)
+    {
+        Matrix<ElemType>& value = entry.m_node->Value();
+        Matrix<ElemType> valueView = m_values.ColumnSlice(entry.m_offset, entry.m_numElements);
+        if (value.GetMatrixType() == MatrixType::DENSE && value.GetNumElements() > 0 && value.Data() == valueView.Data())
+        {
+            Matrix<ElemType> ownValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId());
+            ownValue.AssignValuesOf(value);
+            value = std::move(ownValue);
+        }
+        valueView.SetValue(0);
+
+        if (m_withSmoothedGradients)
+        {
+            Matrix<ElemType> smoothedGradientView = m_smoothedGradients.ColumnSlice(entry.m_offset, entry.m_numElements);
+            if (smoothedGradient.GetMatrixType() == MatrixType::DENSE && smoothedGradient.GetNumElements() > 0 && smoothedGradient.Data() == smoothedGradientView.Data())
+            {
+                Matrix<ElemType> ownSmoothedGradient(smoothedGradient.GetNumRows(), smoothedGradient.GetNumCols(), smoothedGradient.GetDeviceId());
+                ownSmoothedGradient.AssignValuesOf(smoothedGradient);
+                smoothedGradient = std::move(ownSmoothedGradient);
+            }
+            smoothedGradientView.SetValue(0);
+        }
+
+        m_gradients.ColumnSlice(entry.m_offset, entry.m_numElements).SetValue(0);
+
+        entry.m_detached = true;
+        fprintf(stderr, "ParameterArena: %ls %ls operation left the arena (sparse gradient or changed size), it is updated on its own.\n",
+                entry.m_node->NodeName().c_str(), entry.m_node->OperationName().c_str());
+    }
+
+    std::vector<Entry> m_entries;
+    std::vector<Group> m_groups;
+    std::set<const ComputationNodeBase*> m_boundNodes;
+    std::vector<ComputationNodePtr> m_boundNodeList;
+
+    Matrix<ElemType> m_values;
+    Matrix<ElemType> m_gradients;
+    Matrix<ElemType> m_smoothedGradients;
+    bool m_withSmoothedGradients;
+};
+
+}}}
@@ -17,6 +17,8 @@
 #endif
 
 #include "SimpleDistGradAggregator.h"
+#include "SharedMemoryDistGradAggregator.h"
+#include "ParameterArena.h"
 #include "ProgressTracing.h"
 
 #include <map>
@@ -151,6 +153,18 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                       IDataReader* trainSetDataReader,
                                       IDataReader* validationSetDataReader)
 {
+    // these edit the network, so they must happen before we hold on to any of its nodes
+    if (m_fuseLSTMCells || m_fuseBiasActivations)
+    {
+        auto nodesToKeep = GetTrainCriterionNodes(net);
+        let& evalNodes = GetEvalCriterionNodes(net);
+        nodesToKeep.insert(nodesToKeep.end(), evalNodes.begin(), evalNodes.end());
+        if (m_fuseLSTMCells) // first, since bias-activation fusion would take apart the cells' gates
+            net->FuseLSTMCells(nodesToKeep);
+        if (m_fuseBiasActivations)
+            net->FuseBiasActivations(nodesToKeep);
+    }
+
     let& criterionNodes = GetTrainCriterionNodes(net);
 
     fprintf(stderr, "\n");
@@ -197,6 +211,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), preComputeNodesList.cbegin(), preComputeNodesList.cend());
 
     // allocate memory for forward and backward computation
+    net->SetParallelTraversalThreads(m_parallelTraversalThreads);
     net->AllocateAllMatrices(evaluationNodes, additionalNodesToEvaluate, criterionNodes[0]);
 
     // get feature and label nodes into an array of matrices that will be passed to GetMinibatch()
@@ -288,7 +303,36 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     {
         InitModelAggregationHandler(m_syncStatsTrace, net->GetDeviceId());
     }
-    
+
+    // move the parameters into contiguous storage, so that the optimizer and the gradient aggregation can treat them as one
+    m_parameterArena = nullptr;
+    if (m_useParameterArena)
+    {
+        if (GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD && m_bufferedAsyncGradientAggregation)
+        {
+            fprintf(stderr, "WARNING: useParameterArena is ignored with bufferedAsyncGradientAggregation, which swaps the gradient matrices of the parameters.\n");
+        }
+        else
+        {
+            m_parameterArena = make_shared<ParameterArena<ElemType>>(learnableNodes, CanUpdateParameterArena(), net->GetDeviceId());
+            m_parameterArena->Bind(learnableNodes, smoothedGradients);
+            LOGPRINTF(stderr, "Parameter arena: %d parameters with %d elements in %d learning rate groups%s.\n",
+                      (int) m_parameterArena->GetNumParameters(), (int) m_parameterArena->GetNumElements(), (int) m_parameterArena->GetGroups().size(),
+                      CanUpdateParameterArena() ? ", updated together" : "");
+        }
+    }
+
+    if (m_benchmarkAllReduce && m_mpi != nullptr)
+    {
+        size_t numParameterElements = 0;
+        for (auto& node : learnableNodes)
+        {
+            if (node->IsParameterUpdateRequired())
+                numParameterElements += node->GetSampleLayout().GetNumElements();
+        }
+        m_mpi->BenchmarkAllReduce<ElemType>(numParameterElements);
+    }
+
     // precompute mean and invStdDev nodes and save initial model
     // When no precompute, only save if we did not load the model from a 
     // checkpoint but instead built it from a network description
@@ -839,6 +883,20 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         {
             fprintf(stderr, ", BufferedAsyncGradientAggregation is ENABLED");
         }
+
+        if (m_distGradAgg->IsOverlappingBackprop())
+        {
+            fprintf(stderr, ", OverlapGradientAggregation is ENABLED");
+        }
+
+        if (dynamic_pointer_cast<SharedMemoryDistGradAggregator<ElemType>>(m_distGradAgg))
+        {
+            fprintf(stderr, ", SharedMemoryGradientAggregation is ENABLED");
+        }
+        else if (m_gradientAllReduceAlgorithm != MPIAllReduceAlgorithm::Default)
+        {
+            fprintf(stderr, ", AllReduceAlgorithm = %s", AllReduceAlgorithmName(m_gradientAllReduceAlgorithm));
+        }
     }
 
     if (useDistributedMBReading)
@@ -958,7 +1016,23 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // ===========================================================
 
                 if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                {
+                    // let the aggregator start on each gradient as soon as it is final
+                    // With sub-minibatches, the gradients are only final after DoneWithCurrentMinibatch() has accumulated them,
+                    // so then AggregateGradients() reports them all after the loop instead.
+                    ComputationNetwork::BackpropCallback gradientReady;
+                    if (useGradientAggregation && m_distGradAgg->IsOverlappingBackprop() && actualNumSubminibatches == 1)
+                    {
+                        gradientReady = [this](const ComputationNodeBasePtr& node)
+                        {
+                            auto learnableNode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+                            if (learnableNode && learnableNode->IsParameterUpdateRequired())
+                                m_distGradAgg->GradientReady(&learnableNode->Gradient());
+                        };
+                    }
+
+                    net->Backprop(criterionNodes[0], gradientReady);
+                }
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -968,6 +1042,10 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 smbDispatcher.DoneWithCurrentMinibatch();
         } // if (actualMBSize > 0)
 
+        // gradients may have become sparse, or matrices been replaced since the last minibatch
+        if (m_parameterArena && m_parameterArena->Bind(learnableNodes, smoothedGradients) > 0)
+            learnParamsGradients.clear();
+
         // for momentum/clipping/regularization/etc., as well as for progress and statistics, we should only count frames that are not gaps
         // #samples according to the default dynamic axis, for use with criterion nodes that do not have an MBLayout
         size_t numSamplesWithLabelOfNetwork = wasDataRead ? net->GetNumSamplesWithLabelOfNetwork(actualMBSize) : 0;
@@ -995,10 +1073,32 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             if (learnParamsGradients.size() == 0)
             {
                 learnParamsGradients.reserve(learnableNodes.size());
-                for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+
+                // Without quantization, the gradients in the arena are aggregated as one buffer.
+                // Quantization works column by column and needs the shapes of the individual gradients.
+                // An aggregator overlapping with backprop needs the individual gradients as well, in the order in which backprop completes them.
+                bool overlapping = m_distGradAgg->IsOverlappingBackprop();
+                bool aggregateArena = m_parameterArena && !m_parameterArena->IsEmpty() && m_numGradientBits == (8 * sizeof(ElemType)) && !overlapping;
+                if (aggregateArena)
+                    learnParamsGradients.push_back(&m_parameterArena->Gradients());
+
+                std::list<ComputationNodeBasePtr> orderedLearnableNodes = learnableNodes;
+                if (overlapping)
+                {
+                    std::map<ComputationNodeBasePtr, size_t> evalPosition;
+                    size_t position = 0;
+                    for (const auto& node : net->GetEvalOrder(criterionNodes[0]))
+                        evalPosition[node] = position++;
+                    orderedLearnableNodes.sort([&evalPosition](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b)
+                    {
+                        return evalPosition[a] > evalPosition[b];
+                    });
+                }
+
+                for (auto nodeIter = orderedLearnableNodes.begin(); nodeIter != orderedLearnableNodes.end(); nodeIter++)
                 {
                     ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
-                    if (node->IsParameterUpdateRequired())
+                    if (node->IsParameterUpdateRequired() && !(aggregateArena && m_parameterArena->Contains(node)))
                     {
                         Matrix<ElemType>* currParamsGradient = &(node->Gradient()); // TODO: we can use shared_ptrs now
 
@@ -1050,11 +1150,21 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             if (numSamplesInMinibatch != aggregateNumSamples)
                 fprintf(stderr, "SGD: using true #samples %d instead of MB size %d\n", (int)numSamplesInMinibatch, (int)aggregateNumSamples);
 #endif
+            bool updateArena = m_parameterArena && !m_parameterArena->IsEmpty() && CanUpdateParameterArena();
+            if (updateArena)
+            {
+                // BUGBUG (Issue #95): Access to net MBLayout can no longer be done if we have multiple input layouts
+                UpdateParameterArena(learnRatePerSample,
+                                     GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences()), numSamplesInMinibatch,
+                                     m_L2RegWeight, m_L1RegWeight,
+                                     m_useNesterovMomentum);
+            }
+
             auto smoothedGradientIter = smoothedGradients.begin();
             for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
             {
                 ComputationNodeBasePtr node = *nodeIter;
-                if (node->IsParameterUpdateRequired())
+                if (node->IsParameterUpdateRequired() && !(updateArena && m_parameterArena->Contains(node)))
                 {
                     Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
 #ifdef _DEBUG
@@ -1799,6 +1909,12 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
         if (m_distGradAgg == nullptr)
         {
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
+            if (m_gradientAllReduceAlgorithm != MPIAllReduceAlgorithm::Default)
+                fprintf(stderr, "WARNING: allReduceAlgorithm is ignored by the quantized gradient aggregator.\n");
+            if (m_overlapGradientAggregation)
+                fprintf(stderr, "WARNING: overlapGradientAggregation is ignored by the quantized gradient aggregator.\n");
+            if (m_sharedMemoryGradientAggregation)
+                fprintf(stderr, "WARNING: useSharedMemoryGradientAggregation is ignored by the quantized gradient aggregator.\n");
             m_distGradAgg = std::make_shared<AllReduceDistGradAggregator<ElemType>>(m_mpi, m_numGradientBits, m_zeroThresholdFor1Bit, true /*useQuantizationForSelfStripe*/, m_bufferedAsyncGradientAggregation, traceLevel, m_syncStatsTrace);
 #else
             if (m_numGradientBits != (8 * sizeof(ElemType)))
@@ -1806,7 +1922,25 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
                 RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
             }
 
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace);
+            if (m_sharedMemoryGradientAggregation && (m_bufferedAsyncGradientAggregation || m_overlapGradientAggregation))
+            {
+                fprintf(stderr, "WARNING: useSharedMemoryGradientAggregation is ignored with useBufferedAsyncGradientAggregation or overlapGradientAggregation.\n");
+            }
+            else if (m_sharedMemoryGradientAggregation)
+            {
+                m_distGradAgg = std::make_shared<SharedMemoryDistGradAggregator<ElemType>>(m_mpi, m_syncStatsTrace);
+            }
+
+            if (m_distGradAgg == nullptr)
+            {
+                size_t bucketSize = 0;
+                if (m_overlapGradientAggregation && m_bufferedAsyncGradientAggregation)
+                    fprintf(stderr, "WARNING: overlapGradientAggregation is ignored with useBufferedAsyncGradientAggregation, which already overlaps the aggregation with the next minibatch.\n");
+                else if (m_overlapGradientAggregation)
+                    bucketSize = m_gradientBucketSizeInKB * 1024 / sizeof(ElemType);
+
+                m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, bucketSize, m_gradientAllReduceAlgorithm);
+            }
 #endif // !CNTK_PARALLEL_TRAINING_SUPPORT
         }
 
@@ -1828,7 +1962,7 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
     }
     if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD)
     {
-        m_pMASGDHelper = make_shared<BasicModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID);
+        m_pMASGDHelper = make_shared<BasicModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID, m_modelAggregationAllReduceAlgorithm);
     }
     else if (GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD)
     {
@@ -1963,6 +2097,76 @@ void SGD<ElemType>::UpdateWeights(const ComputationNodeBasePtr& node,
     node->BumpEvalTimeStamp();
 }
 
+// UpdateParameterArena - update all parameters in the arena
+// This does the same as UpdateWeightsS() for the dense case, but each step is one operation over a whole learning rate group.
+// Gradient clipping by norm remains per parameter, as the norm is that of the individual gradient.
+template <class ElemType>
+void SGD<ElemType>::UpdateParameterArena(const double learnRatePerSample,
+                                         const double momentumPerSample,
+                                         const size_t actualMBSize,
+                                         const double L2RegWeight, const double L1RegWeight,
+                                         const bool useNesterovMomentum) const
+{
+    assert(actualMBSize > 0);
+    assert(CanUpdateParameterArena());
+
+    const double momentum = MomentumPerMB(momentumPerSample, actualMBSize);
+    auto& arena = *m_parameterArena;
+
+    if (!m_gradientClippingWithTruncation && m_clippingThresholdPerSample != std::numeric_limits<double>::infinity())
+    {
+        for (const auto& node : arena.GetBoundNodes())
+            ClipGradient(node->Gradient(), actualMBSize);
+    }
+
+    for (const auto& group : arena.GetGroups())
+    {
+        Matrix<ElemType> functionValues   = ParameterArena<ElemType>::GroupSlice(arena.Values(), group);
+        Matrix<ElemType> gradientValues   = ParameterArena<ElemType>::GroupSlice(arena.Gradients(), group);
+        Matrix<ElemType> smoothedGradient = ParameterArena<ElemType>::GroupSlice(arena.SmoothedGradients(), group);
+        double groupLearnRatePerSample = learnRatePerSample * group.m_learningRateMultiplier;
+
+        if (m_gradientClippingWithTruncation)
+            ClipGradient(gradientValues, actualMBSize);
+
+        double noiseStd = GradientUpdateNoiseStd();
+        Matrix<ElemType> sgdUpdateNoise((DEVICEID_TYPE) functionValues.GetDeviceId());
+        if (noiseStd > 0)
+        {
+            sgdUpdateNoise.SetValue(gradientValues);
+            sgdUpdateNoise.SetGaussianRandomValue(0, (ElemType) noiseStd);
+        }
+
+        if (L2RegWeight > 0)
+            Matrix<ElemType>::ScaleAndAdd((ElemType)(L2RegWeight * actualMBSize), functionValues, gradientValues);
+
+        if (GradUpdateType() == GradientsUpdateType::None)
+        {
+            smoothedGradient.NormalGrad(gradientValues, functionValues,
+                                        (ElemType) groupLearnRatePerSample, (ElemType) momentum, useNesterovMomentum);
+        }
+        else // AdaGrad without average multiplier
+        {
+            smoothedGradient.Adagrad(gradientValues, false);
+            Matrix<ElemType>::ScaleAndAdd((ElemType)(-groupLearnRatePerSample), gradientValues, functionValues);
+        }
+
+        if (noiseStd > 0)
+            Matrix<ElemType>::ScaleAndAdd(1.0, sgdUpdateNoise, functionValues);
+
+        if (L1RegWeight > 0)
+            functionValues.InplaceSoftThreshold((ElemType)(groupLearnRatePerSample * L1RegWeight * actualMBSize));
+
+#ifdef _DEBUG
+        if (functionValues.HasNan("UpdateParameterArena(): "))
+            LogicError("The parameter arena has NaNs in functionValues after parameter update.");
+#endif
+    }
+
+    for (const auto& node : arena.GetBoundNodes())
+        node->BumpEvalTimeStamp();
+}
+
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
 {
@@ -2318,6 +2522,14 @@ static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
     else InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | DataParallelSGD | ModelAveragingSGD | BlockMomentumSGD)");
 }
 
+static MPIAllReduceAlgorithm ParseAllReduceAlgorithm(const wstring& s)
+{
+    if      (EqualCI(s, L"") || EqualCI(s, L"mpi")) return MPIAllReduceAlgorithm::Default;
+    else if (EqualCI(s, L"ring"))                   return MPIAllReduceAlgorithm::Ring;
+    else if (EqualCI(s, L"hierarchical"))           return MPIAllReduceAlgorithm::Hierarchical;
+    else InvalidArgument("ParseAllReduceAlgorithm: Invalid all-reduce algorithm. Valid values are (mpi | ring | hierarchical)");
+}
+
 static LearningRateSearchAlgorithm ParseLearningRateSearchType(const wstring& s)
 {
     if      (EqualCI(s, L"false") || EqualCI(s, L"none")) return LearningRateSearchAlgorithm::None;
@@ -2395,6 +2607,10 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     bool useNesterovMomentum = configSGD(L"useNAG", false);
 
     m_maxTempMemSizeInSamplesForCNN = configSGD(L"maxTempMemSizeInSamplesForCNN", (size_t) 0);
+    m_parallelTraversalThreads = configSGD(L"parallelTraversalThreads", (size_t) 0);
+    m_fuseBiasActivations = configSGD(L"fuseBiasActivations", false);
+    m_fuseLSTMCells = configSGD(L"fuseLSTMCells", false);
+    m_useParameterArena = configSGD(L"useParameterArena", false);
 
     m_traceLevel = configSGD(L"traceLevel", (int) 0);
     m_numMBsToShowResult = configSGD(L"numMBsToShowResult", (size_t)10);
@@ -2558,6 +2774,12 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = 32;
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_overlapGradientAggregation = false;
+    m_gradientBucketSizeInKB = 0;
+    m_gradientAllReduceAlgorithm = MPIAllReduceAlgorithm::Default;
+    m_sharedMemoryGradientAggregation = false;
+    m_modelAggregationAllReduceAlgorithm = MPIAllReduceAlgorithm::Default;
+    m_benchmarkAllReduce = false;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
@@ -2579,6 +2801,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_parallelizationStartEpochNum = configParallelTrain(L"parallelizationStartEpoch", (int)1) - 1; // Epoch numbers internally are 0 based
             m_enableDistributedMBReading = configParallelTrain(L"distributedMBReading", false);
             m_syncStatsTrace = configParallelTrain(L"syncPerfStats", (int)0);
+            m_benchmarkAllReduce = configParallelTrain(L"benchmarkAllReduce", false);
 
             if (configParallelTrain.Exists(L"DataParallelSGD"))
             {
@@ -2587,6 +2810,14 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 m_numGradientBits = configDataParallelSGD(L"gradientBits", defaultGradientBits);
                 m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
                 m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+                m_overlapGradientAggregation = configDataParallelSGD(L"overlapGradientAggregation", false);
+                m_gradientBucketSizeInKB = configDataParallelSGD(L"gradientBucketSizeInKB", (size_t) 4096);
+                m_gradientAllReduceAlgorithm = ParseAllReduceAlgorithm(configDataParallelSGD(L"allReduceAlgorithm", L"mpi"));
+                m_sharedMemoryGradientAggregation = configDataParallelSGD(L"useSharedMemoryGradientAggregation", false);
+                if (m_overlapGradientAggregation && m_gradientBucketSizeInKB == 0)
+                {
+                    InvalidArgument("gradientBucketSizeInKB must be greater than 0 when using overlapGradientAggregation!");
+                }
                 if ( m_numGradientBits < 1 || m_numGradientBits > (8 * sizeofElemType) )
                 {
                     InvalidArgument("gradientBits must be in the range [1, 32] when using precision=float and in range [1, 64] when using precision=double!");
@@ -2595,6 +2826,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             if (configParallelTrain.Exists(L"ModelAveragingSGD"))
             {
                 const ConfigRecordType& configMASGD(configParallelTrain(L"ModelAveragingSGD", ConfigRecordType::Record()));
+                m_modelAggregationAllReduceAlgorithm = ParseAllReduceAlgorithm(configMASGD(L"allReduceAlgorithm", L"mpi"));
                 if (configMASGD.Exists(L"blockSizePerWorker") && configMASGD.Exists(L"blockSize"))
                 {
                     InvalidArgument("It is only allowed to set blockSizePerWorker or blockSize, not both of them");
@@ -227,6 +227,10 @@ protected:
     doubleargvector m_batchNormalizationTimeConstant;
     doubleargvector m_batchNormalizationBlendTimeConstant;
     size_t m_maxTempMemSizeInSamplesForCNN;
+    size_t m_parallelTraversalThreads; // > 0 to run independent nodes concurrently on this many CPU threads
+    bool m_fuseBiasActivations;        // replace activations of a sum like Sigmoid(Plus(z, b)) by single fused nodes before training
+    bool m_fuseLSTMCells;              // replace LSTM cells unrolled through PastValue/FutureValue by FusedLSTM nodes before training
+    bool m_useParameterArena;          // keep the dense parameters, gradients and smoothed gradients in contiguous storage, see ParameterArena
 
     int m_traceLevel;
 
@@ -261,13 +265,21 @@ protected:
     // n > 1: Show stats after every n sync
     int m_syncStatsTrace;
 
+    // time each all-reduce algorithm on a buffer of the model's size before training
+    bool m_benchmarkAllReduce;
+
     // Data parallel SGD training parameters
     int m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
     bool m_zeroThresholdFor1Bit;
+    bool m_overlapGradientAggregation;  // all-reduce gradients in buckets while backprop is still running
+    size_t m_gradientBucketSizeInKB;
+    MPIAllReduceAlgorithm m_gradientAllReduceAlgorithm;
+    bool m_sharedMemoryGradientAggregation; // all workers on one host reduce through shared memory instead of MPI
 
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
+    MPIAllReduceAlgorithm m_modelAggregationAllReduceAlgorithm;
     bool   m_resetSGDMomentum; 
     bool   m_useNesterovBlockMomentum;
     double m_blockLearningRate; 
@@ -291,6 +303,9 @@ protected:
 template <class ElemType>
 class IDistGradAggregator;
 
+template <class ElemType>
+class ParameterArena;
+
 // -----------------------------------------------------------------------
 // class SGD
 // -----------------------------------------------------------------------
@@ -495,6 +510,19 @@ protected:
 
     void ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const;
 
+    // whether the update of the parameters is elementwise with a smoothed gradient of the parameter's size, so it can run over the whole arena
+    bool CanUpdateParameterArena() const
+    {
+        return GradUpdateType() == GradientsUpdateType::None || (GradUpdateType() == GradientsUpdateType::AdaGrad && !m_needAveMultiplier);
+    }
+
+    // UpdateParameterArena - same as UpdateWeights() for all parameters in the arena, with one set of operations per learning rate group
+    void UpdateParameterArena(const double learnRatePerSample,
+                              const double momentumPerSample,
+                              const size_t actualMBSize,
+                              const double L2RegWeight, const double L1RegWeight,
+                              const bool useNesterovMomentum) const;
+
     void SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen, // TODO: combine totalSamplesSeen and prevCriterion into a EpochCriterion type
                             const double learnRatePerSample,
                             const std::list<Matrix<ElemType>>& smoothedGradients,
@@ -555,6 +583,8 @@ protected:
     std::shared_ptr<IDistGradAggregator<ElemType>> m_distGradAgg;
     std::shared_ptr<struct DistGradHeader> m_gradHeader;
 
+    std::shared_ptr<ParameterArena<ElemType>> m_parameterArena;
+
     shared_ptr<IMASGD<ElemType>> m_pMASGDHelper;
 
 private:
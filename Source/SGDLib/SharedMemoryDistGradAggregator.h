@@ -0,0 +1,314 @@
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "TimerUtility.h"
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <cstring>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A named shared-memory segment that the processes on one host map into their address space.
+class SharedMemorySegment
+{
+public:
+    SharedMemorySegment(const std::string& name, size_t size, bool create)
+        : m_data(nullptr), m_size(size)
+    {
+#ifdef _WIN32
+        std::string mappingName = "Local\\" + name;
+        if (create)
+            m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((unsigned long long) size >> 32), (DWORD) size, mappingName.c_str());
+        else
+            m_mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mappingName.c_str());
+        if (m_mapping == NULL)
+            RuntimeError("SharedMemorySegment: Failed to %s the shared memory segment '%s' (error %d).", create ? "create" : "open", name.c_str(), (int) GetLastError());
+        m_data = (char*) MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (m_data == nullptr)
+        {
+            CloseHandle(m_mapping);
+            RuntimeError("SharedMemorySegment: Failed to map the shared memory segment '%s' (error %d).", name.c_str(), (int) GetLastError());
+        }
+#else
+        std::string shmName = "/" + name;
+        int fd = shm_open(shmName.c_str(), create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, S_IRUSR | S_IWUSR);
+        if (fd < 0)
+            RuntimeError("SharedMemorySegment: Failed to %s the shared memory segment '%s' (errno %d).", create ? "create" : "open", name.c_str(), errno);
+        if (create && ftruncate(fd, (off_t) size) != 0)
+        {
+            close(fd);
+            shm_unlink(shmName.c_str());
+            RuntimeError("SharedMemorySegment: Failed to allocate %d bytes for the shared memory segment '%s' (errno %d).", (int) size, name.c_str(), errno);
+        }
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            RuntimeError("SharedMemorySegment: Failed to map the shared memory segment '%s' (errno %d).", name.c_str(), errno);
+        m_data = (char*) data;
+#endif
+    }
+
+    ~SharedMemorySegment()
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+#else
+        munmap(m_data, m_size);
+#endif
+    }
+
+    // Removes the name once all processes have mapped the segment; the memory lives on until the last one unmaps it.
+    // This way nothing is left behind if a process crashes. (Windows does this by itself when the last handle is closed.)
+    static void RemoveName(const std::string& name)
+    {
+#ifndef _WIN32
+        shm_unlink(("/" + name).c_str());
+#else
+        UNUSED(name);
+#endif
+    }
+
+    char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    HANDLE m_mapping;
+#endif
+
+    DISABLE_COPY_AND_MOVE(SharedMemorySegment);
+};
+
+// Aggregates the gradients of processes that all run on the same host through shared memory instead of MPI.
+// Every process copies its gradients and header into its own slot of a shared segment. After a barrier, each process sums up
+// its 1/N slice of the gradients over all slots (with OpenMP threads), and the headers in rank order, so that all processes get
+// bit-identical results. After a second barrier, each process gathers the reduced slices into its gradients. The slots are
+// double-buffered, so that the next minibatch's staging cannot overwrite a slot that is still being gathered from.
+// The barriers are spinning counters in the shared segment; MPI is only used to set up the segment.
+template <class ElemType>
+class SharedMemoryDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    SharedMemoryDistGradAggregator(const MPIWrapperPtr& mpi, int syncStatsTrace)
+        : IDistGradAggregator<ElemType>(mpi), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_numSegmentsCreated(0),
+          m_numElements(0), m_numEvalNode(-1), m_headerSlotSize(0), m_gradientSlotSize(0)
+    {
+        if (m_mpi->NumNodesOnThisHost() != NumProc())
+            InvalidArgument("SharedMemoryDistGradAggregator: All %d workers must run on the same host.", (int) NumProc());
+    }
+
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int /*epochNumber*/) override
+    {
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        size_t slotSet = m_iterationCount % 2;
+        m_iterationCount++;
+
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        size_t numElements = 0;
+        for (auto gradient : gradients)
+        {
+            if (gradient->GetMatrixType() != DENSE)
+                RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+            numElements += gradient->GetNumElements();
+        }
+        if (!m_segment || numElements != m_numElements || headerCPU->numEvalNode != m_numEvalNode)
+            CreateSegment(numElements, headerCPU->numEvalNode);
+
+        // stage our gradients and header
+        size_t myRank = MyRank();
+        ElemType* mySlot = GradientSlot(slotSet, myRank);
+        if (headerCPU->numSamples == 0)
+        {
+            headerCPU->criterion = 0.0;
+            for (int i = 0; i < headerCPU->numEvalNode; ++i)
+                headerCPU->evalErrors[i] = { 0.0, 0 };
+
+            // If the current node did not process any samples, the gradients should be zero'd
+            memset(mySlot, 0, sizeof(ElemType) * numElements);
+        }
+        else
+        {
+            size_t offset = 0;
+            for (auto gradient : gradients)
+            {
+                ElemType* slotPart = mySlot + offset;
+                size_t size = gradient->GetNumElements();
+                gradient->CopyToArray(slotPart, size); // no allocation, the slot is large enough
+                offset += gradient->GetNumElements();
+            }
+        }
+        memcpy((void*) HeaderSlot(slotSet, myRank), (void*) headerCPU, headerCPU->Size());
+        Barrier();
+
+        // sum up our slice over all slots, and all headers
+        ElemType* slice = mySlot + SliceBegin(myRank);
+        long sliceSize = (long) (SliceBegin(myRank + 1) - SliceBegin(myRank));
+        for (size_t rank = 0; rank < NumProc(); rank++)
+        {
+            if (rank == myRank)
+                continue;
+            const ElemType* other = GradientSlot(slotSet, rank) + SliceBegin(myRank);
+#pragma omp parallel for
+            for (long i = 0; i < sliceSize; i++)
+                slice[i] += other[i];
+        }
+        headerCPU->Aggregate(HeaderSlot(slotSet, 0));
+        for (size_t rank = 1; rank < NumProc(); rank++)
+            headerCPU->Aggregate(HeaderSlot(slotSet, rank), true);
+        Barrier();
+
+        // gather the reduced slices
+        int deviceId = gradients[0]->GetDeviceId();
+        if (deviceId != CPUDEVICE)
+            m_gatherBuffer.resize(numElements);
+        size_t offset = 0;
+        for (auto gradient : gradients)
+        {
+            size_t size = gradient->GetNumElements();
+            ElemType* target = (deviceId == CPUDEVICE) ? gradient->Data() : m_gatherBuffer.data() + offset;
+            for (size_t rank = 0; rank < NumProc(); rank++)
+            {
+                size_t begin = max(offset, SliceBegin(rank));
+                size_t end = min(offset + size, SliceBegin(rank + 1));
+                if (begin < end)
+                    memcpy(target + (begin - offset), GradientSlot(slotSet, rank) + begin, sizeof(ElemType) * (end - begin));
+            }
+            if (deviceId != CPUDEVICE)
+                gradient->SetValue(gradient->GetNumRows(), gradient->GetNumCols(), deviceId, target);
+            offset += size;
+        }
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Actual gradient aggregation time: %.6g\n", aggregationTimer.ElapsedSeconds());
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+private:
+    struct BarrierState
+    {
+        std::atomic<size_t> m_numArrived;
+        std::atomic<size_t> m_generation;
+    };
+
+    static const size_t SlotAlignment = 64; // keep the slots on separate cache lines
+
+    static size_t AlignUp(size_t size)
+    {
+        return (size + SlotAlignment - 1) / SlotAlignment * SlotAlignment;
+    }
+
+    // Creates the segment on rank 0 and maps it on all others. Collective; all workers have the same gradients, so they all
+    // come here in the same call.
+    void CreateSegment(size_t numElements, int numEvalNode)
+    {
+        m_segment.reset();
+        m_numElements = numElements;
+        m_numEvalNode = numEvalNode;
+        DistGradHeader* header = DistGradHeader::Create(numEvalNode);
+        m_headerSlotSize = AlignUp(header->Size());
+        DistGradHeader::Destroy(header);
+        m_gradientSlotSize = AlignUp(sizeof(ElemType) * numElements);
+        size_t size = AlignUp(sizeof(BarrierState)) + 2 * NumProc() * (m_headerSlotSize + m_gradientSlotSize);
+
+        // the name is unique per job and aggregator instance
+        size_t nameParts[2] = { (size_t) GetCurrentProcessId(), m_numSegmentsCreated++ };
+        m_mpi->Bcast(nameParts, 2, m_mpi->MainNodeRank());
+        std::string name = "cntk_gradagg_" + std::to_string(nameParts[0]) + "_" + std::to_string(nameParts[1]) + "_" + std::to_string(sizeof(ElemType));
+
+        if (m_mpi->IsMainNode())
+        {
+            m_segment.reset(new SharedMemorySegment(name, size, /*create=*/true));
+            BarrierState* barrier = new (m_segment->Data()) BarrierState;
+            if (!barrier->m_numArrived.is_lock_free())
+                RuntimeError("SharedMemoryDistGradAggregator: Atomic counters are not lock-free on this platform.");
+            barrier->m_numArrived = 0;
+            barrier->m_generation = 0;
+        }
+        m_mpi->WaitAll();
+        if (!m_mpi->IsMainNode())
+            m_segment.reset(new SharedMemorySegment(name, size, /*create=*/false));
+        m_mpi->WaitAll();
+        if (m_mpi->IsMainNode())
+            SharedMemorySegment::RemoveName(name);
+
+        if (m_mpi->IsMainNode())
+            fprintf(stderr, "SharedMemoryDistGradAggregator: %d workers share a segment of %.1f MB.\n", (int) NumProc(), size / 1048576.0);
+    }
+
+    BarrierState* GetBarrierState()
+    {
+        return reinterpret_cast<BarrierState*>(m_segment->Data());
+    }
+
+    char* Slots()
+    {
+        return m_segment->Data() + AlignUp(sizeof(BarrierState));
+    }
+
+    DistGradHeader* HeaderSlot(size_t slotSet, size_t rank)
+    {
+        return reinterpret_cast<DistGradHeader*>(Slots() + (slotSet * NumProc() + rank) * m_headerSlotSize);
+    }
+
+    ElemType* GradientSlot(size_t slotSet, size_t rank)
+    {
+        return reinterpret_cast<ElemType*>(Slots() + 2 * NumProc() * m_headerSlotSize + (slotSet * NumProc() + rank) * m_gradientSlotSize);
+    }
+
+    // the elements that 'rank' reduces are [SliceBegin(rank), SliceBegin(rank + 1))
+    size_t SliceBegin(size_t rank)
+    {
+        return m_numElements * rank / NumProc();
+    }
+
+    // central sense-reversing barrier: the last one to arrive opens the next generation
+    void Barrier()
+    {
+        BarrierState* state = GetBarrierState();
+        size_t generation = state->m_generation.load();
+        if (state->m_numArrived.fetch_add(1) + 1 == NumProc())
+        {
+            state->m_numArrived = 0;
+            state->m_generation.fetch_add(1);
+        }
+        else
+        {
+            while (state->m_generation.load() == generation)
+                std::this_thread::yield();
+        }
+    }
+
+    int m_syncStatsTrace;
+    size_t m_iterationCount;
+    size_t m_numSegmentsCreated;
+
+    std::unique_ptr<SharedMemorySegment> m_segment;
+    size_t m_numElements;
+    int m_numEvalNode;
+    size_t m_headerSlotSize;
+    size_t m_gradientSlotSize;
+    std::vector<ElemType> m_gatherBuffer; // gradients on the GPU are gathered here first
+};
+} } }
@@ -3,6 +3,9 @@
 #include "IDistGradAggregator.h"
 #include "CUDAPageLockedMemAllocator.h"
 #include <future>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
 #include "MatrixQuantizerImpl.h"
@@ -15,13 +18,39 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int syncStatsTrace)
-        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0)
+    // A 'bucketSize' > 0 enables overlapping the aggregation with backprop: consecutive gradients are grouped into buckets of
+    // about this many elements, and each bucket is all-reduced on a separate thread as soon as GradientReady() was called for
+    // all of its gradients. This cannot be combined with async aggregation, which overlaps with the next minibatch instead.
+    // 'allReduceAlgorithm' selects how the gradients are summed up; the built-in algorithms of MPIWrapper are blocking, so with them
+    // the header exchange no longer overlaps with the gradient all-reduce.
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int syncStatsTrace, size_t bucketSize = 0,
+                             MPIAllReduceAlgorithm allReduceAlgorithm = MPIAllReduceAlgorithm::Default)
+        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0),
+          m_bucketSize(bucketSize), m_abortBucketAggregation(false), m_allReduceAlgorithm(allReduceAlgorithm)
     {
+        if (m_useAsyncAggregation && m_bucketSize > 0)
+            InvalidArgument("SimpleDistGradAggregator: Async aggregation cannot be combined with overlapping the aggregation with backprop.");
     }
 
     ~SimpleDistGradAggregator()
     {
+        // do not leave the bucket thread waiting for gradients that will not come (we get here on errors only)
+        if (m_pendingBucketAggregation.valid())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_bucketMutex);
+                m_abortBucketAggregation = true;
+            }
+            m_bucketCompleted.notify_all();
+            try
+            {
+                m_pendingBucketAggregation.get();
+            }
+            catch (...)
+            {
+            }
+        }
+
         for (size_t i = 0; i < m_recvHeaders.size(); ++i)
         {
             DistGradHeader::Destroy(m_recvHeaders[i]);
@@ -40,7 +69,11 @@ public:
         bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
         m_iterationCount++;
 
-        if (m_useAsyncAggregation)
+        if (IsOverlappingBackprop())
+        {
+            return AggregateGradientsInBuckets(gradients, headerCPU, showSyncPerfStats);
+        }
+        else if (m_useAsyncAggregation)
         {
             // If we are performing async gradient aggregation, let's wait for the pending gradient aggregation to finish
             // then swap the contents of the buffered gradients and the new gradient matrices and fire an async aggreagation
@@ -122,7 +155,55 @@ public:
         }
     }
 
+    void GradientReady(const Matrix<ElemType>* gradient) override
+    {
+        if (!IsOverlappingBackprop())
+            return;
+
+        std::lock_guard<std::mutex> lock(m_bucketMutex);
+
+        // gradients are unknown until the buckets are formed in the first AggregateGradients() call
+        auto iter = m_gradientIndices.find(gradient);
+        if (iter == m_gradientIndices.end() || m_isGradientReady[iter->second])
+            return;
+
+        size_t index = iter->second;
+        m_isGradientReady[index] = true;
+        GradientBucket& bucket = m_buckets[m_bucketOfGradient[index]];
+        if (--bucket.m_numPendingGradients == 0)
+        {
+            int deviceId = gradient->GetDeviceId();
+            if (deviceId != CPUDEVICE)
+                FetchBucket(bucket, deviceId);
+            m_bucketCompleted.notify_all();
+        }
+
+        // the first gradient of a minibatch starts the thread that reduces the buckets in order
+        if (!m_pendingBucketAggregation.valid())
+        {
+            int deviceId = gradient->GetDeviceId();
+            m_pendingBucketAggregation = std::async(std::launch::async, [this, deviceId]
+                                                    {
+                                                        ReduceBuckets(deviceId);
+                                                    });
+        }
+    }
+
+    bool IsOverlappingBackprop() const override
+    {
+        return m_bucketSize > 0;
+    }
+
 private:
+    struct GradientBucket
+    {
+        size_t m_begin; // range of gradients in m_bucketedGradients
+        size_t m_end;
+        size_t m_numElements;
+        std::shared_ptr<ElemType> m_buffer; // the packed gradients; none if the single gradient is reduced in place
+        size_t m_numPendingGradients;       // gradients not yet reported in the current minibatch
+    };
+
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
         assert(deviceID >= 0);
@@ -156,8 +237,10 @@ private:
 
                 if (deviceId != CPUDEVICE)
                 {
-                    m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, m_useAsyncAggregation)));
-                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
+                    // with buckets, the copies run concurrently with backprop, and the intermediate buffers are per bucket
+                    m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, m_useAsyncAggregation || IsOverlappingBackprop())));
+                    if (!IsOverlappingBackprop())
+                        m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
                 }
 
                 if (m_useAsyncAggregation)
@@ -172,6 +255,9 @@ private:
                 m_bufferedGradHeader->Clear();
             }
 
+            if (IsOverlappingBackprop())
+                CreateBuckets(gradients);
+
             if (m_mpi->IsMainNode())
             {
                 for (size_t i = 0; i < NumProc() - 1; ++i)
@@ -277,6 +363,13 @@ private:
                 reductionBuffer = m_intermediateCPUBuffers[i].get();
             }
 
+            if (m_allReduceAlgorithm != MPIAllReduceAlgorithm::Default)
+            {
+                allReduceRequests[i] = MPI_REQUEST_NULL;
+                m_mpi->AllReduce(reductionBuffer, gradients[i]->GetNumElements(), m_allReduceAlgorithm);
+                continue;
+            }
+
             // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
             MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, gradients[i]->GetNumElements(), MPIWrapper::GetDataType(reductionBuffer), MPI_SUM, m_mpi->Communicator(), &allReduceRequests[i]) || MpiFail("MPI_Iallreduce");
         }
@@ -364,6 +457,193 @@ private:
         }
     }
 
+    // Groups consecutive gradients into buckets of about m_bucketSize elements; a larger gradient forms a bucket of its own.
+    // The caller passes the gradients in the order in which backprop completes them, so the buckets become ready in turn.
+    void CreateBuckets(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        m_buckets.clear();
+        m_gradientIndices.clear();
+        m_bucketOfGradient.clear();
+
+        int deviceId = gradients[0]->GetDeviceId();
+        while (deviceId != CPUDEVICE && m_gpuDataTransferers.size() < gradients.size())
+            m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, true)));
+
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            size_t numElements = gradients[i]->GetNumElements();
+            if (m_buckets.empty() || (m_buckets.back().m_numElements > 0 && m_buckets.back().m_numElements + numElements > m_bucketSize))
+                m_buckets.push_back(GradientBucket{ i, i, 0, nullptr, 0 });
+
+            GradientBucket& bucket = m_buckets.back();
+            bucket.m_end = i + 1;
+            bucket.m_numElements += numElements;
+            bucket.m_numPendingGradients++;
+            m_gradientIndices[gradients[i]] = i;
+            m_bucketOfGradient.push_back(m_buckets.size() - 1);
+        }
+
+        // gradients on the GPU go through a (pinned) CPU buffer; on the CPU, a bucket with a single gradient is reduced in place
+        for (auto& bucket : m_buckets)
+        {
+            if (deviceId != CPUDEVICE)
+                bucket.m_buffer = AllocateIntermediateBuffer(deviceId, bucket.m_numElements);
+            else if (bucket.m_end - bucket.m_begin > 1)
+                bucket.m_buffer.reset(new ElemType[bucket.m_numElements], [](ElemType* p) { delete[] p; });
+        }
+
+        m_bucketedGradients = gradients;
+        m_isGradientReady.assign(gradients.size(), false);
+
+        fprintf(stderr, "SimpleDistGradAggregator: %d gradients in %d buckets for overlapping aggregation with backprop.\n", (int) gradients.size(), (int) m_buckets.size());
+    }
+
+    // queue the copies of a bucket's gradients to the CPU, behind their computation on the main stream
+    void FetchBucket(const GradientBucket& bucket, int deviceId)
+    {
+        std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+        mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+
+        ElemType* buffer = bucket.m_buffer.get();
+        for (size_t i = bucket.m_begin; i < bucket.m_end; i++)
+        {
+            m_gpuDataTransferers[i]->CopyGPUToCPUAsync(m_bucketedGradients[i]->Data(), m_bucketedGradients[i]->GetNumElements(), buffer);
+            buffer += m_bucketedGradients[i]->GetNumElements();
+        }
+    }
+
+    // runs on its own thread: all-reduces the buckets in order, each once all of its gradients are ready
+    // This is the only thread making MPI calls until AggregateGradients() has waited for it.
+    void ReduceBuckets(int deviceId)
+    {
+        if (deviceId != CPUDEVICE)
+            Matrix<ElemType>::SetDevice(deviceId);
+
+        for (auto& bucket : m_buckets)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_bucketMutex);
+                m_bucketCompleted.wait(lock, [this, &bucket] { return bucket.m_numPendingGradients == 0 || m_abortBucketAggregation; });
+                if (m_abortBucketAggregation)
+                    return;
+            }
+
+            ElemType* buffer = bucket.m_buffer ? bucket.m_buffer.get() : m_bucketedGradients[bucket.m_begin]->Data();
+            if (deviceId != CPUDEVICE)
+            {
+                for (size_t i = bucket.m_begin; i < bucket.m_end; i++)
+                    m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
+            }
+            else if (bucket.m_buffer)
+            {
+                ElemType* packed = buffer;
+                for (size_t i = bucket.m_begin; i < bucket.m_end; i++)
+                {
+                    memcpy(packed, m_bucketedGradients[i]->Data(), sizeof(ElemType) * m_bucketedGradients[i]->GetNumElements());
+                    packed += m_bucketedGradients[i]->GetNumElements();
+                }
+            }
+
+            m_mpi->AllReduce(buffer, bucket.m_numElements, m_allReduceAlgorithm);
+
+            if (deviceId != CPUDEVICE || bucket.m_buffer)
+            {
+                const ElemType* packed = buffer;
+                for (size_t i = bucket.m_begin; i < bucket.m_end; i++)
+                {
+                    if (deviceId != CPUDEVICE)
+                        m_gpuDataTransferers[i]->CopyCPUToGPUAsync(const_cast<ElemType*>(packed), m_bucketedGradients[i]->GetNumElements(), m_bucketedGradients[i]->Data());
+                    else
+                        memcpy(m_bucketedGradients[i]->Data(), packed, sizeof(ElemType) * m_bucketedGradients[i]->GetNumElements());
+                    packed += m_bucketedGradients[i]->GetNumElements();
+                }
+            }
+        }
+    }
+
+    // completes the aggregation of a minibatch whose gradients were reported through GradientReady()
+    bool AggregateGradientsInBuckets(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
+    {
+        // the gradient matrices may have been replaced, e.g. when parameters were rebound; none of the new ones can have been reported yet
+        if (gradients != m_bucketedGradients)
+        {
+            if (m_pendingBucketAggregation.valid())
+                LogicError("SimpleDistGradAggregator: The gradients to aggregate are not the ones whose aggregation was started.");
+            CreateBuckets(gradients);
+        }
+
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        if (headerCPU->numSamples == 0)
+        {
+            headerCPU->criterion = 0.0;
+            for (int i = 0; i < headerCPU->numEvalNode; ++i)
+                headerCPU->evalErrors[i] = { 0.0, 0 };
+
+            // If the current node did not process any samples, the gradients should be zero'd
+            // (none of them have been reported, since there was no backprop)
+            for (size_t i = 0; i < gradients.size(); ++i)
+            {
+                if (!m_isGradientReady[i])
+                    gradients[i]->SetValue(0);
+            }
+        }
+
+        // report what backprop did not, e.g. since there was no backprop in this minibatch, then wait for the buckets
+        for (size_t i = 0; i < gradients.size(); ++i)
+            GradientReady(gradients[i]);
+        m_pendingBucketAggregation.get();
+
+        AggregateHeader(headerCPU, (int) gradients.size());
+
+        int deviceId = gradients[0]->GetDeviceId();
+        if (deviceId != CPUDEVICE)
+        {
+            for (size_t i = 0; i < gradients.size(); ++i)
+                m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
+        }
+
+        // prepare for the next minibatch
+        for (auto& bucket : m_buckets)
+            bucket.m_numPendingGradients = bucket.m_end - bucket.m_begin;
+        m_isGradientReady.assign(gradients.size(), false);
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            double waitTime = aggregationTimer.ElapsedSeconds();
+            fprintf(stderr, "Gradient aggregation time after backprop: %.6g\n", waitTime);
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+    // sums the headers of all nodes on the main node, which then broadcasts the result
+    void AggregateHeader(DistGradHeader* headerCPU, int tag)
+    {
+        if (m_mpi->IsMainNode())
+        {
+            std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int source = (j >= MyRank()) ? (j + 1) : j;
+                MPI_Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, tag, m_mpi->Communicator(), &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
+            }
+
+            MPI_Waitall(recvHeaderRequests.size(), recvHeaderRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+                headerCPU->Aggregate(m_recvHeaders[j], true);
+        }
+        else
+        {
+            MPI_Send(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), tag, m_mpi->Communicator()) || MpiFail("MPI_Send");
+        }
+
+        MPI_Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), m_mpi->Communicator()) || MpiFail("MPI_Bcast");
+    }
+
 private:
     std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
     std::vector<std::shared_ptr<ElemType>> m_intermediateCPUBuffers;
@@ -388,5 +668,21 @@ private:
     size_t m_iterationCount;
 
     int m_currentEpochNumber;
+
+    // Overlapping the aggregation with backprop
+    size_t m_bucketSize; // in elements; 0 if not overlapping
+    std::vector<GradientBucket> m_buckets;
+    std::vector<Matrix<ElemType>*> m_bucketedGradients;
+    std::unordered_map<const Matrix<ElemType>*, size_t> m_gradientIndices; // [gradient] -> index into m_bucketedGradients
+    std::vector<size_t> m_bucketOfGradient;
+    std::vector<bool> m_isGradientReady;
+
+    // the thread reducing the buckets of the current minibatch, and what it waits for
+    std::future<void> m_pendingBucketAggregation;
+    std::mutex m_bucketMutex;
+    std::condition_variable m_bucketCompleted;
+    bool m_abortBucketAggregation;
+
+    MPIAllReduceAlgorithm m_allReduceAlgorithm;
 };
 } } }
@@ -4,6 +4,8 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/BlockMultiplier.h"
+#include "../../../Source/Math/QuantizedMultiplier.h"
+#include <thread>
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace TEST {
 
@@ -154,5 +156,96 @@ BOOST_AUTO_TEST_CASE(BlockMultiplyTest)
     TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerSSE>>(m, k, n);
 }
 
+BOOST_AUTO_TEST_CASE(BlockMultiplyTilesTest)
+{
+    // uneven sizes exercise the single-row kernels, all block sizes, and a partial panel of B
+    TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerSSE>>(6, 203, 300, 4);
+    TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerSSE>>(12, 300, 260, 3);
+}
+
+BOOST_AUTO_TEST_CASE(BlockMultiplyLargeTest)
+{
+    // a product with more than 32768 outputs, split into many tiles over several threads
+    TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerSSE>>(64, 256, 600, 4);
+    TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerSSE>>(130, 200, 300, 4);
+}
+
+BOOST_AUTO_TEST_CASE(BlockMultiplyConcurrentTest)
+{
+    // several threads multiply different inputs by the same prepared B on a shared multiplier
+    typedef BlockMultiplier<BlockHandlerSSE> MultiplierT;
+    const int m = 4;
+    const int k = 256;
+    const int n = 200;
+    const int numCallers = 4;
+    MultiplierT testMult(2);
+    ReferenceMultiplier<int16_t, int16_t, int32_t> refMult;
+
+    int16_t* B = testMult.CreateMatrixB(k, n);
+    RandInitIntMatrix<int16_t>(B, k, n, 63);
+    int16_t* preparedB = testMult.PrepareB(B, k, n);
+
+    std::vector<int16_t*> As(numCallers);
+    std::vector<int32_t*> refCs(numCallers);
+    std::vector<int32_t*> testCs(numCallers);
+    for (int i = 0; i < numCallers; ++i)
+    {
+        As[i] = testMult.CreateMatrixA(m, k);
+        RandInitIntMatrix<int16_t>(As[i], m, k, 63);
+        refCs[i] = refMult.CreateMatrixC(m, n);
+        refMult.MultiplyMatrices(As[i], m, k, B, n, refCs[i]);
+        testCs[i] = testMult.CreateMatrixC(m, n);
+    }
+
+    std::vector<std::thread> callers;
+    for (int i = 0; i < numCallers; ++i)
+    {
+        callers.push_back(std::thread([&, i]()
+        {
+            for (int rep = 0; rep < 10; ++rep)
+                testMult.MultiplyMatrices(As[i], m, k, preparedB, n, testCs[i]);
+        }));
+    }
+    for (auto& caller : callers)
+        caller.join();
+
+    for (int i = 0; i < numCallers; ++i)
+    {
+        CompareMatricesAndDump(refCs[i], testCs[i], m, k, n);
+        testMult.FreeMatrix(As[i]);
+        refMult.FreeMatrix(refCs[i]);
+        testMult.FreeMatrix(testCs[i]);
+    }
+    testMult.FreeMatrix(B);
+    testMult.FreeMatrix(preparedB);
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedMultiplyTest)
+{
+    // odd sizes exercise the partial blocks and the padding of the data columns
+    const size_t m = 37;
+    const size_t k = 203;
+    const size_t n = 7;
+    Matrix<float> weights = Matrix<float>::RandomUniform(m, k, CPUDEVICE, -1.0f, 1.0f, 1);
+    Matrix<float> data = Matrix<float>::RandomUniform(k, n, CPUDEVICE, -3.0f, 3.0f, 2);
+    Matrix<float> reference(m, n, CPUDEVICE);
+    Matrix<float>::Multiply(weights, false, data, false, reference);
+
+    QuantizedMultiplier<float> multiplier8(weights, 8);
+    Matrix<float> result(m, n, CPUDEVICE);
+    multiplier8.Multiply(data, result);
+    BOOST_CHECK_LT(QuantizedMultiplier<float>::RelativeError(result, reference), 0.02);
+
+    QuantizedMultiplier<float> multiplier16(weights, 16);
+    multiplier16.Multiply(data, result);
+    BOOST_CHECK_LT(QuantizedMultiplier<float>::RelativeError(result, reference), 0.001);
+
+    // a column slice of a larger matrix can receive the result
+    Matrix<float> wide(m, 2 * n, CPUDEVICE);
+    Matrix<float> rightHalf = wide.ColumnSlice(n, n);
+    multiplier16.Multiply(data, rightHalf);
+    BOOST_CHECK_LT(QuantizedMultiplier<float>::RelativeError(wide.ColumnSlice(n, n), reference), 0.001);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}} //end namespaces
@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/CPUPackedMatrix.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -220,6 +221,30 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiplyAndDiv, RandomSeedFixture)
     BOOST_CHECK(m3.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiplyPacked, RandomSeedFixture)
+{
+    // 37 rows leave a partial panel; 1..9 columns cover partial and full column groups
+    SMatrix a(37, 53);
+    a.SetUniformRandomValue(-1, 1, IncrementCounter());
+    CPUPackedMatrix<float> packed(a.Data(), a.GetNumRows(), a.GetNumCols());
+    for (size_t n = 1; n <= 9; n++)
+    {
+        SMatrix b(53, n);
+        b.SetUniformRandomValue(-1, 1, IncrementCounter());
+        SMatrix expected(37, n);
+        expected.SetUniformRandomValue(-1, 1, IncrementCounter());
+        SMatrix actual(expected);
+
+        SMatrix::MultiplyAndWeightedAdd(0.5f, a, false, b, false, 2.0f, expected);
+        SMatrix::MultiplyAndWeightedAdd(0.5f, packed, b, 2.0f, actual);
+        BOOST_CHECK(actual.IsEqualTo(expected, c_epsilonFloatE4));
+
+        SMatrix::MultiplyAndWeightedAdd(1, a, false, b, false, 0, expected);
+        SMatrix::MultiplyAndWeightedAdd(1, packed, b, 0, actual);
+        BOOST_CHECK(actual.IsEqualTo(expected, c_epsilonFloatE4));
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixElementOperations, RandomSeedFixture)
 {
     // TODO: consider splitting this large test
@@ -898,6 +923,113 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpReductions, RandomSeedFixture)
+{
+    // reduce each column of a 37 x 5 matrix to a single value
+    const size_t rows = 37, cols = 5;
+    SMatrix a = SMatrix::RandomUniform(rows, cols, -2, 2, IncrementCounter());
+
+    SmallVector<size_t> regularOpDims{cols}, reducingOpDims{rows};
+    std::array<SmallVector<ptrdiff_t>, 2> regularStrides{SmallVector<ptrdiff_t>{(ptrdiff_t) rows}, SmallVector<ptrdiff_t>{1}};
+    std::array<SmallVector<ptrdiff_t>, 2> reducingStrides{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}};
+    std::array<size_t, 2> offsets{0, 0};
+
+    SMatrix maxs(1, cols), mins(1, cols), logSums(1, cols);
+    maxs.TensorOp(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opMax, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    mins.TensorOp(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opMin, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    logSums.TensorOp(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opLogSum, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    for (size_t j = 0; j < cols; j++)
+    {
+        float expectedMax = a(0, j), expectedMin = a(0, j);
+        double sumExp = 0;
+        for (size_t i = 0; i < rows; i++)
+        {
+            expectedMax = std::max(expectedMax, a(i, j));
+            expectedMin = std::min(expectedMin, a(i, j));
+            sumExp += exp((double) a(i, j));
+        }
+        BOOST_CHECK_EQUAL(maxs(0, j), expectedMax);
+        BOOST_CHECK_EQUAL(mins(0, j), expectedMin);
+        BOOST_CHECK_CLOSE(logSums(0, j), (float) log(sumExp), 1e-3);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpBroadcastingSum, RandomSeedFixture)
+{
+    // c = a + b with a column vector b broadcast over the columns (bias add); 'rows' is not a multiple of any vector width
+    const size_t rows = 131, cols = 7;
+    SMatrix a = SMatrix::RandomUniform(rows, cols, -1, 1, IncrementCounter());
+    SMatrix b = SMatrix::RandomUniform(rows, 1, -1, 1, IncrementCounter());
+    SMatrix c(rows, cols);
+
+    SmallVector<size_t> regularOpDims{rows, cols};
+    std::array<SmallVector<ptrdiff_t>, 3> regularStrides{SmallVector<ptrdiff_t>{1, (ptrdiff_t) rows}, SmallVector<ptrdiff_t>{1, 0}, SmallVector<ptrdiff_t>{1, (ptrdiff_t) rows}};
+    std::array<SmallVector<ptrdiff_t>, 3> reducingStrides;
+    c.TensorOp(0, a, b, 1, ElementWiseOperator::opSum, ElementWiseOperator::opSum, std::array<size_t, 3>{0, 0, 0}, regularOpDims, regularStrides, SmallVector<size_t>(), reducingStrides);
+
+    for (size_t j = 0; j < cols; j++)
+        for (size_t i = 0; i < rows; i++)
+            BOOST_CHECK_EQUAL(c(i, j), a(i, j) + b(i, 0));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpThreadedElementwise, RandomSeedFixture)
+{
+    // large enough to be split across OMP threads (more than TensorOpMinElementsForThreading elements)
+    const size_t rows = 259, cols = 300;
+    SMatrix a = SMatrix::RandomUniform(rows, cols, -1, 1, IncrementCounter());
+    SMatrix b = SMatrix::RandomUniform(rows, 1, -1, 1, IncrementCounter());
+    SMatrix c(rows, cols), d(rows, cols);
+
+    SmallVector<size_t> regularOpDims{rows, cols};
+    std::array<SmallVector<ptrdiff_t>, 3> binaryStrides{SmallVector<ptrdiff_t>{1, (ptrdiff_t) rows}, SmallVector<ptrdiff_t>{1, 0}, SmallVector<ptrdiff_t>{1, (ptrdiff_t) rows}};
+    std::array<SmallVector<ptrdiff_t>, 3> binaryReducingStrides;
+    c.TensorOp(0, a, b, 1, ElementWiseOperator::opSum, ElementWiseOperator::opSum, std::array<size_t, 3>{0, 0, 0}, regularOpDims, binaryStrides, SmallVector<size_t>(), binaryReducingStrides);
+
+    std::array<SmallVector<ptrdiff_t>, 2> unaryStrides{SmallVector<ptrdiff_t>{1, (ptrdiff_t) rows}, SmallVector<ptrdiff_t>{1, (ptrdiff_t) rows}};
+    std::array<SmallVector<ptrdiff_t>, 2> unaryReducingStrides;
+    d.TensorOp(0, c, 1, ElementWiseOperator::opLinearRectifier, ElementWiseOperator::opSum, std::array<size_t, 2>{0, 0}, regularOpDims, unaryStrides, SmallVector<size_t>(), unaryReducingStrides);
+
+    for (size_t j = 0; j < cols; j++)
+    {
+        for (size_t i = 0; i < rows; i++)
+        {
+            float sum = a(i, j) + b(i, 0);
+            BOOST_CHECK_EQUAL(c(i, j), sum);
+            BOOST_CHECK_EQUAL(d(i, j), sum > 0 ? sum : 0);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpThreadedReductions, RandomSeedFixture)
+{
+    // reduce each row of a 200 x 300 matrix, so that the split across OMP threads runs along the regular (row) dimension
+    const size_t rows = 200, cols = 300;
+    SMatrix a = SMatrix::RandomUniform(rows, cols, -2, 2, IncrementCounter());
+
+    SmallVector<size_t> regularOpDims{rows}, reducingOpDims{cols};
+    std::array<SmallVector<ptrdiff_t>, 2> regularStrides{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}};
+    std::array<SmallVector<ptrdiff_t>, 2> reducingStrides{SmallVector<ptrdiff_t>{(ptrdiff_t) rows}, SmallVector<ptrdiff_t>{0}};
+    std::array<size_t, 2> offsets{0, 0};
+
+    SMatrix sums(rows, 1), maxs(rows, 1);
+    sums.TensorOp(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opSum, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    maxs.TensorOp(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opMax, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    for (size_t i = 0; i < rows; i++)
+    {
+        double expectedSum = 0;
+        float expectedMax = a(i, 0);
+        for (size_t j = 0; j < cols; j++)
+        {
+            expectedSum += a(i, j);
+            expectedMax = std::max(expectedMax, a(i, j));
+        }
+        BOOST_CHECK_SMALL(sums(i, 0) - (float) expectedSum, 1e-3f);
+        BOOST_CHECK_EQUAL(maxs(i, 0), expectedMax);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
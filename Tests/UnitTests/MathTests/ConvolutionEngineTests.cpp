@@ -7,6 +7,8 @@
 #include <array>
 #include <random>
 #include <numeric>
+#include <fstream>
+#include <cstdio>
 #include "../../../Source/Math/Matrix.h"
 #include "../../../Source/Math/CPUMatrix.h"
 #include "../../../Source/Math/GPUMatrix.h"
@@ -59,6 +61,11 @@ std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE, size_t>> GetTestEng
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 0));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 1));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 3));
+
+    // Direct engine. Implemented only for CPU. Geometries that it does not support go to the Gemm engine.
+    auto directOrGemm = (ConvolutionEngineKind)((int)ConvolutionEngineKind::Direct | (int)ConvolutionEngineKind::Gemm);
+    res.push_back(std::make_tuple(directOrGemm, -1, 0));
+    res.push_back(std::make_tuple(directOrGemm, -1, 3));
     return res;
 }
 
@@ -230,6 +237,191 @@ BOOST_AUTO_TEST_CASE(ConvolutionForward)
     }
 }
 
+// The generic configs above have too few channels for the direct engine to use Winograd's algorithm,
+// so test it separately, against the reference engine on the CPU.
+BOOST_AUTO_TEST_CASE(ConvolutionForwardWinograd)
+{
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<> batchSizeG(1, 8);
+    std::normal_distribution<float> nd;
+
+    std::vector<ConvolveGeometryPtr> geometries;
+    for (size_t inW : {4, 5, 8, 13})
+    {
+        for (bool autoPad : {false, true})
+        {
+            // Outputs of at least 8x8 use F(4x4, 3x3), smaller ones F(2x2, 3x3).
+            geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(inW, inW + 3, 4),
+                TensorShape(3, 3, 4), TensorShape(6), TensorShape(1, 1, 4),
+                ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+                TensorShape(0), TensorShape(0)));
+        }
+    }
+
+    int deviceId = -1;
+    for (size_t maxTempMem : {0, 3})
+    {
+        for (const auto& g : geometries)
+        {
+            auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+            auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, maxTempMem, PoolKind::None, ConvolutionEngineKind::Direct);
+
+            size_t n = batchSizeG(rng);
+            vec buf;
+            buf.resize(g->InputShape().GetNumElements() * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+            size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+            buf.resize(g->KernelShape().GetNumElements() * mapCount);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+            size_t crowOut = g->OutputShape().GetNumElements();
+            SingleMatrix out(crowOut, n, deviceId);
+            SingleMatrix outB(crowOut, n, deviceId);
+
+            SingleMatrix workspace(deviceId);
+            SingleMatrix workspaceB(deviceId);
+
+            testEng->Forward(in, kernel, out, workspace);
+            baseEng->Forward(in, kernel, outB, workspaceB);
+
+            std::stringstream tmsg;
+            tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n << ", MaxTempMem: " << maxTempMem;
+            std::string msg = " are not equal, " + tmsg.str();
+
+            // The transforms lose a few bits, so outputs close to 0 need a larger absolute error.
+            float relErr = Err<float>::Rel;
+            float absErr = Err<float>::Abs;
+            std::string emsg;
+
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, relErr * 4, absErr * 512), "out" << msg << ". " << emsg);
+        }
+    }
+}
+
+// Turns autotuning off again when a test ends, even if it fails, so that it does not leak into later tests.
+struct ConvolutionAutotuningGuard
+{
+    ~ConvolutionAutotuningGuard()
+    {
+        ConvolutionEngineAutotuning::Enable(false);
+    }
+};
+
+// Runs the forward pass of a new autotuned engine and checks it against the reference engine.
+static void CheckAutotunedForward(const ConvolveGeometryPtr& g, size_t n, std::mt19937& rng)
+{
+    std::normal_distribution<float> nd;
+    int deviceId = -1;
+    auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+    auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::All);
+
+    vec buf;
+    buf.resize(g->InputShape().GetNumElements() * n);
+    std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+    SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+    size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+    buf.resize(g->KernelShape().GetNumElements() * mapCount);
+    std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+    SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+    size_t crowOut = g->OutputShape().GetNumElements();
+    SingleMatrix out(crowOut, n, deviceId);
+    SingleMatrix outB(crowOut, n, deviceId);
+    SingleMatrix workspace(deviceId);
+
+    testEng->Forward(in, kernel, out, workspace);
+    baseEng->Forward(in, kernel, outB, workspace);
+
+    std::stringstream tmsg;
+    tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n;
+    std::string msg = " are not equal, " + tmsg.str();
+
+    float relErr = Err<float>::Rel;
+    float absErr = Err<float>::Abs;
+    std::string emsg;
+
+    BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, relErr * 4, absErr * 9), "out" << msg << ". " << emsg);
+}
+
+static std::vector<std::string> ReadLines(const std::string& path)
+{
+    std::vector<std::string> lines;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+        lines.push_back(line);
+    return lines;
+}
+
+static void WriteLines(const std::string& path, const std::vector<std::string>& lines)
+{
+    std::ofstream file(path, std::ios::trunc);
+    for (const auto& line : lines)
+        file << line << "\n";
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionAutotuned)
+{
+    std::mt19937 rng(0);
+    ConvolutionAutotuningGuard guard;
+    ConvolutionEngineAutotuning::Enable(true);
+    for (const auto& g : GenerateConvTestConfigs())
+    {
+        // Run twice with different minibatch sizes, so that the second run does not reuse the first choice.
+        for (size_t n : {4, 3})
+            CheckAutotunedForward(g, n, rng);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionAutotunedCache)
+{
+    const std::string cachePath = "ConvolutionAutotunedCache.txt";
+    const std::wstring cachePathW(cachePath.begin(), cachePath.end());
+    std::remove(cachePath.c_str());
+    std::mt19937 rng(0);
+    ConvolutionAutotuningGuard guard;
+    auto geometries = GenerateConvTestConfigs();
+    auto runAll = [&]
+    {
+        // as a new process would: the choices are only known from the cache file
+        ConvolutionEngineAutotuning::Enable(true, cachePathW);
+        for (const auto& g : geometries)
+            CheckAutotunedForward(g, 4, rng);
+    };
+
+    // The first run times the engines and writes one line per geometry that has several engines to choose from.
+    runAll();
+    auto timed = ReadLines(cachePath);
+    BOOST_REQUIRE(!timed.empty());
+
+    // A later run takes the choices from the cache and adds nothing, since it does not time again.
+    runAll();
+    BOOST_CHECK_EQUAL(ReadLines(cachePath).size(), timed.size());
+
+    // Choices that do not parse, of unknown engines, or outside the workspace limit are ignored: the engines
+    // are timed again, which appends a valid line for each. So are lines without a choice or for other machines.
+    for (const std::string& badChoice : { "garbage", "99 4", "1 0", "1" })
+    {
+        std::vector<std::string> corrupt = { "not a cache line", "other CPU x 1|float|forward|4|0|geometry\t1 1" };
+        for (const auto& line : timed)
+            corrupt.push_back(line.substr(0, line.rfind('\t')) + "\t" + badChoice);
+        WriteLines(cachePath, corrupt);
+        runAll();
+        BOOST_CHECK_EQUAL(ReadLines(cachePath).size(), corrupt.size() + timed.size());
+    }
+
+    // A file that cannot be read as lines at all is ignored as a whole.
+    WriteLines(cachePath, { std::string(2000000, 'x') });
+    runAll();
+    BOOST_CHECK_EQUAL(ReadLines(cachePath).size(), 1 + timed.size());
+
+    std::remove(cachePath.c_str());
+}
+
 BOOST_AUTO_TEST_CASE(ConvolutionBackwardData)
 {
     std::mt19937 rng(0);
@@ -0,0 +1,64 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Helpers for tests that build a ComputationNetwork in code and compare the results of two ways of running it.
+//
+#pragma once
+
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include <boost/test/unit_test.hpp>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+template <class ElemType>
+inline std::vector<ElemType> ToVector(const Matrix<ElemType>& matrix)
+{
+    ElemType* data = matrix.CopyToArray();
+    std::vector<ElemType> result(data, data + matrix.GetNumElements());
+    delete[] data;
+    return result;
+}
+
+// Allocate the matrices of a compiled network, then run 'numPasses' forward and backward passes through 'criterion'
+// on the current values of the input nodes. Returns, for each pass, the criterion value, the values of 'outputs',
+// and the gradients of 'parameters'.
+template <class ElemType>
+inline std::vector<std::vector<ElemType>> ForwardAndBackprop(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterion,
+                                                             const std::vector<ComputationNodeBasePtr>& inputs, const std::vector<ComputationNodeBasePtr>& parameters,
+                                                             size_t numPasses = 1, const std::vector<ComputationNodeBasePtr>& outputs = std::vector<ComputationNodeBasePtr>())
+{
+    net->AllocateAllMatrices({ criterion }, outputs, criterion);
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->StartEvaluateMinibatchLoop(criterion);
+    std::vector<std::vector<ElemType>> results;
+    for (size_t pass = 0; pass < numPasses; pass++)
+    {
+        ComputationNetwork::BumpEvalTimeStamp(inputs);
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+
+        results.push_back(ToVector(dynamic_pointer_cast<ComputationNode<ElemType>>(criterion)->Value()));
+        for (const auto& output : outputs)
+            results.push_back(ToVector(dynamic_pointer_cast<ComputationNode<ElemType>>(output)->Value()));
+        for (const auto& parameter : parameters)
+            results.push_back(ToVector(dynamic_pointer_cast<ComputationNode<ElemType>>(parameter)->Gradient()));
+    }
+    return results;
+}
+
+template <class ElemType>
+inline void CheckResultsClose(const std::vector<std::vector<ElemType>>& results, const std::vector<std::vector<ElemType>>& expected, ElemType tolerance)
+{
+    BOOST_REQUIRE_EQUAL(results.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        BOOST_REQUIRE_EQUAL(results[i].size(), expected[i].size());
+        for (size_t j = 0; j < expected[i].size(); j++)
+            BOOST_CHECK_SMALL(results[i][j] - expected[i][j], tolerance);
+    }
+}
+
+}}}}
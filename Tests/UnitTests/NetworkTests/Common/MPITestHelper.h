@@ -0,0 +1,20 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Helpers for tests of the distributed training code. The tests run on a single process as well as under mpiexec with several.
+//
+#pragma once
+
+#include "MPIWrapper.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// MPI is initialized once per process, by the first test that needs it.
+inline MPIWrapperPtr GetTestMPI()
+{
+    static MPIWrapperPtr mpi = MPIWrapper::GetInstance(true);
+    return mpi;
+}
+
+}}}}
@@ -0,0 +1,128 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Common/ComputationNetworkTestHelper.h"
+#include "Common/MPITestHelper.h"
+#include "SimpleDistGradAggregator.h"
+#include "SharedMemoryDistGradAggregator.h"
+#include <thread>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Aggregates the gradients of a few minibatches and returns the aggregated gradients and headers.
+// The gradient values are small integers that depend on the rank, so their sums are exact in any order.
+// With 'bucketSize' > 0 the aggregator overlaps with backprop: the gradients are reported from another thread
+// in reverse order as backprop would, except for some that are left for AggregateGradients() to report.
+// On one of the workers, a minibatch has no samples and reports no gradients at all.
+// With 'sharedMemory' the gradients are aggregated through shared memory instead of MPI.
+template <class ElemType>
+static std::vector<std::vector<ElemType>> AggregateMinibatches(size_t bucketSize, bool sharedMemory = false)
+{
+    auto mpi = GetTestMPI();
+    const size_t rank = mpi->CurrentNodeRank();
+    const size_t numMinibatches = 4;
+    const size_t emptyMinibatch = 2, emptyRank = mpi->NumNodesInUse() - 1;
+    const size_t sizes[][2] = { { 3, 1 }, { 5, 7 }, { 40, 30 }, { 1, 1 }, { 2, 300 }, { 64, 1 }, { 9, 9 } };
+
+    std::vector<std::unique_ptr<Matrix<ElemType>>> matrices;
+    std::vector<Matrix<ElemType>*> gradients;
+    for (const auto& size : sizes)
+    {
+        matrices.emplace_back(new Matrix<ElemType>(size[0], size[1], CPUDEVICE));
+        gradients.push_back(matrices.back().get());
+    }
+
+    std::unique_ptr<IDistGradAggregator<ElemType>> aggregator;
+    if (sharedMemory)
+        aggregator.reset(new SharedMemoryDistGradAggregator<ElemType>(mpi, 0));
+    else
+        aggregator.reset(new SimpleDistGradAggregator<ElemType>(mpi, false, 0, bucketSize));
+    std::shared_ptr<DistGradHeader> header(DistGradHeader::Create(1), [](DistGradHeader* p) { DistGradHeader::Destroy(p); });
+
+    std::vector<std::vector<ElemType>> results;
+    for (size_t minibatch = 0; minibatch < numMinibatches; minibatch++)
+    {
+        bool empty = minibatch == emptyMinibatch && rank == emptyRank;
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            std::vector<ElemType> values(gradients[i]->GetNumElements());
+            for (size_t j = 0; j < values.size(); j++)
+                values[j] = empty ? 0 : (ElemType) ((rank + 1) * (i + 1) + (j % 5) + minibatch);
+            gradients[i]->SetValue(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), CPUDEVICE, values.data());
+        }
+
+        header->numEvalNode = 1;
+        header->numSamples = empty ? 0 : 10 + rank;
+        header->numSamplesWithLabel = header->numSamples;
+        header->criterion = empty ? 0 : (double) rank + minibatch;
+        header->evalErrors[0] = std::make_pair(empty ? 0.0 : 1.0, header->numSamples);
+
+        if (bucketSize > 0 && !empty)
+        {
+            std::thread backprop([&]()
+            {
+                for (size_t i = gradients.size(); i-- > 0;)
+                {
+                    if (i % 3 != 1)
+                        aggregator->GradientReady(gradients[i]);
+                }
+            });
+            backprop.join();
+        }
+
+        aggregator->AggregateGradients(gradients, header.get(), 0);
+
+        for (const auto& gradient : gradients)
+            results.push_back(ToVector(*gradient));
+        results.push_back({ (ElemType) header->numSamples, (ElemType) header->numSamplesWithLabel, (ElemType) header->criterion,
+                            (ElemType) header->evalErrors[0].first, (ElemType) header->evalErrors[0].second });
+    }
+
+    return results;
+}
+
+template <class ElemType>
+static void CheckOverlappedAggregation()
+{
+    auto expected = AggregateMinibatches<ElemType>(0);
+    // one bucket per gradient, buckets that pack several gradients, and a single bucket for all
+    for (size_t bucketSize : { 1, 256, 1 << 20 })
+    {
+        auto actual = AggregateMinibatches<ElemType>(bucketSize);
+        BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); i++)
+            BOOST_CHECK_EQUAL_COLLECTIONS(actual[i].begin(), actual[i].end(), expected[i].begin(), expected[i].end());
+    }
+}
+
+template <class ElemType>
+static void CheckSharedMemoryAggregation()
+{
+    auto expected = AggregateMinibatches<ElemType>(0);
+    auto actual = AggregateMinibatches<ElemType>(0, true);
+    BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++)
+        BOOST_CHECK_EQUAL_COLLECTIONS(actual[i].begin(), actual[i].end(), expected[i].begin(), expected[i].end());
+}
+
+BOOST_AUTO_TEST_SUITE(DistGradAggregatorSuite)
+
+BOOST_AUTO_TEST_CASE(OverlappedAggregationMatchesAggregationAfterBackprop)
+{
+    CheckOverlappedAggregation<float>();
+    CheckOverlappedAggregation<double>();
+}
+
+BOOST_AUTO_TEST_CASE(SharedMemoryAggregationMatchesMPIAggregation)
+{
+    CheckSharedMemoryAggregation<float>();
+    CheckSharedMemoryAggregation<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,80 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Common/ComputationNetworkTestHelper.h"
+#include "NonlinearityNodes.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// A network with one affine layer per supported fusion (Sigmoid, Tanh, RectifiedLinear of a bias Plus), run with and
+// without FuseBiasActivations(). Returns the criterion value and all parameter gradients.
+template <class ElemType>
+static std::vector<std::vector<ElemType>> RunAffineLayers(bool fuse)
+{
+    const size_t inputDim = 6, hiddenDim = 10, outputDim = 3, numSamples = 7;
+
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", inputDim);
+    auto labels   = builder.CreateInputNode(L"labels", outputDim);
+    std::vector<ComputationNodeBasePtr> parameters;
+    auto parameter = [&](const std::wstring& name, size_t rows, size_t cols)
+    {
+        auto p = builder.CreateLearnableParameter(name, rows, cols);
+        p->Value().SetUniformRandomValue(-1, 1, (unsigned long) parameters.size() + 1);
+        parameters.push_back(p);
+        return p;
+    };
+
+    shared_ptr<ComputationNode<ElemType>> h = features;
+    size_t dim = inputDim;
+    for (size_t layer = 0; layer < 3; layer++)
+    {
+        auto suffix = std::to_wstring(layer);
+        auto W = parameter(L"W" + suffix, hiddenDim, dim);
+        auto b = parameter(L"b" + suffix, hiddenDim, 1); // broadcast over the samples
+        auto z = builder.Plus(builder.Times(W, h, 1, L"Wh" + suffix), b, L"z" + suffix);
+        h = layer == 0 ? builder.Sigmoid(z, L"h" + suffix) : layer == 1 ? builder.Tanh(z, L"h" + suffix) : builder.RectifiedLinear(z, L"h" + suffix);
+        dim = hiddenDim;
+    }
+    auto Wo = parameter(L"Wo", outputDim, hiddenDim);
+    auto criterion = builder.SquareError(labels, builder.Times(Wo, h, 1, L"out"), L"ce");
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+
+    if (fuse)
+    {
+        BOOST_CHECK_EQUAL(net->FuseBiasActivations({ criterion }), 3);
+        BOOST_CHECK(!net->NodeNameExists(L"z0") && !net->NodeNameExists(L"z1") && !net->NodeNameExists(L"z2"));
+        BOOST_CHECK(dynamic_pointer_cast<FusedBiasActivationNode<ElemType>>(net->GetNodeFromName(L"h1")) != nullptr);
+    }
+
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    features->Value().Resize(inputDim, numSamples);
+    features->Value().SetUniformRandomValue(-1, 1, 100);
+    labels->Value().Resize(outputDim, numSamples);
+    labels->Value().SetUniformRandomValue(-1, 1, 101);
+
+    return ForwardAndBackprop<ElemType>(net, criterion, { features, labels }, parameters);
+}
+
+BOOST_AUTO_TEST_SUITE(FusedBiasActivationSuite)
+
+BOOST_AUTO_TEST_CASE(FusedBiasActivationMatchesUnfusedFloat)
+{
+    CheckResultsClose<float>(RunAffineLayers<float>(true), RunAffineLayers<float>(false), 1e-5f);
+}
+
+BOOST_AUTO_TEST_CASE(FusedBiasActivationMatchesUnfusedDouble)
+{
+    CheckResultsClose<double>(RunAffineLayers<double>(true), RunAffineLayers<double>(false), 1e-12);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
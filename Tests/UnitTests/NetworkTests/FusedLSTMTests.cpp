@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Common/ComputationNetworkTestHelper.h"
+#include "RecurrentNodes.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// An LSTM cell with peepholes, unrolled through PastValue like BS.RNNs.LSTMP, followed by a linear output layer.
+// With 'fuse', FuseLSTMCells() replaces the cell by a FusedLSTMNode. Two sequences of different lengths are
+// packed with a gap, so that sequence starts and gaps are exercised. Returns the criterion, the network output, and
+// the gradients of all parameters.
+template <class ElemType>
+static std::vector<std::vector<ElemType>> RunLSTM(bool fuse)
+{
+    const size_t inputDim = 3, cellDim = 4, outputDim = 2, numSequences = 2, numTimeSteps = 5;
+    const float initialState = 0.1f;
+
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+
+    auto x      = builder.CreateInputNode(L"features", inputDim);
+    auto labels = builder.CreateInputNode(L"labels", outputDim);
+    std::vector<ComputationNodeBasePtr> parameters;
+    auto parameter = [&](const std::wstring& name, size_t rows, size_t cols)
+    {
+        auto p = builder.CreateLearnableParameter(name, rows, cols);
+        p->Value().SetUniformRandomValue(-0.5, 0.5, (unsigned long) parameters.size() + 1);
+        parameters.push_back(p);
+        return p;
+    };
+
+    auto dh = builder.PastValue(nullptr, initialState, cellDim, 1, L"dh");
+    auto dc = builder.PastValue(nullptr, initialState, cellDim, 1, L"dc");
+    // B + W * x + H * h(t-1)
+    auto gateInput = [&](const std::wstring& gate)
+    {
+        auto projection = builder.Plus(parameter(L"B" + gate, cellDim, 1), builder.Times(parameter(L"W" + gate, cellDim, inputDim), x, 1, L"Wx" + gate), L"Wxb" + gate);
+        return builder.Plus(projection, builder.Times(parameter(L"H" + gate, cellDim, cellDim), dh, 1, L"Hh" + gate), L"z" + gate);
+    };
+    // Sigmoid (B + W * x + H * h(t-1) + C .* c)
+    auto gate = [&](const std::wstring& gate, const shared_ptr<ComputationNode<ElemType>>& c)
+    {
+        auto z = gateInput(gate);
+        auto peephole = builder.ElementTimes(parameter(L"C" + gate, cellDim, 1), c, L"Cc" + gate);
+        return builder.Sigmoid(builder.Plus(z, peephole, L"zc" + gate), gate);
+    };
+
+    auto it = gate(L"i", dc);
+    auto ft = gate(L"f", dc);
+    auto bit = builder.ElementTimes(it, builder.Tanh(gateInput(L"c"), L"tanhz"), L"bit");
+    auto ct = builder.Plus(builder.ElementTimes(ft, dc, L"bft"), bit, L"c");
+    auto ot = gate(L"o", ct);
+    auto ht = builder.ElementTimes(ot, builder.Tanh(ct, L"tanhc"), L"h");
+    dh->AttachInputs({ ht });
+    dc->AttachInputs({ ct });
+
+    auto Wout = parameter(L"Wout", outputDim, cellDim);
+    auto out = builder.Times(Wout, ht, 1, L"out");
+    auto criterion = builder.SquareError(labels, out, L"ce");
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->AddToNodeGroup(L"output", out);
+    net->CompileNetwork();
+
+    if (fuse)
+    {
+        BOOST_CHECK_EQUAL(net->FuseLSTMCells({ criterion }), 1);
+        BOOST_CHECK(dynamic_pointer_cast<FusedLSTMNode<ElemType>>(net->GetNodeFromName(L"h")) != nullptr);
+        // the parameters keep their names, so that models stay compatible
+        for (const auto& p : parameters)
+            BOOST_CHECK(net->NodeNameExists(p->NodeName()) && net->GetNodeFromName(p->NodeName()) == p);
+    }
+
+    // sequence 0 spans all steps; sequence 1 is shorter and followed by a gap
+    auto pMBLayout = net->GetMBLayoutPtrOfNetwork();
+    pMBLayout->Init(numSequences, numTimeSteps);
+    pMBLayout->AddSequence(0, 0, 0, numTimeSteps);
+    pMBLayout->AddSequence(1, 1, 0, 3);
+    pMBLayout->AddSequence(GAP_SEQUENCE_ID, 1, 3, numTimeSteps);
+    x->Value().Resize(inputDim, numSequences * numTimeSteps);
+    x->Value().SetUniformRandomValue(-1, 1, 100);
+    labels->Value().Resize(outputDim, numSequences * numTimeSteps);
+    labels->Value().SetUniformRandomValue(-1, 1, 101);
+
+    auto results = ForwardAndBackprop<ElemType>(net, criterion, { x, labels }, parameters, 1, { out });
+    // the output is undefined in the gap
+    for (size_t t = 3; t < numTimeSteps; t++)
+        for (size_t i = 0; i < outputDim; i++)
+            results[1][(t * numSequences + 1) * outputDim + i] = 0;
+    return results;
+}
+
+BOOST_AUTO_TEST_SUITE(FusedLSTMSuite)
+
+BOOST_AUTO_TEST_CASE(FusedLSTMMatchesUnrolledLSTMFloat)
+{
+    CheckResultsClose<float>(RunLSTM<float>(true), RunLSTM<float>(false), 1e-5f);
+}
+
+BOOST_AUTO_TEST_CASE(FusedLSTMMatchesUnrolledLSTMDouble)
+{
+    CheckResultsClose<double>(RunLSTM<double>(true), RunLSTM<double>(false), 1e-12);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
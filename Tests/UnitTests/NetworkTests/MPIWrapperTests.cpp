@@ -0,0 +1,58 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Common/MPITestHelper.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// All-reduces buffers of several sizes with the given algorithm. The values are small integers that depend on the rank,
+// so their sums are exact in any order. The sizes include empty and single-element buffers and sizes that do not divide
+// by the number of nodes, and they grow and shrink so that the scratch buffers and the shared memory are reused.
+template <class ElemType>
+static std::vector<std::vector<ElemType>> AllReduceBuffers(MPIAllReduceAlgorithm algorithm)
+{
+    auto mpi = GetTestMPI();
+    const size_t rank = mpi->CurrentNodeRank();
+    const size_t sizes[] = { 0, 1, 2, 7, 1000, 100003, 5, 4096 };
+
+    std::vector<std::vector<ElemType>> results;
+    for (size_t size : sizes)
+    {
+        std::vector<ElemType> values(size);
+        for (size_t j = 0; j < size; j++)
+            values[j] = (ElemType) ((rank + 1) * (j % 11) + rank);
+        mpi->AllReduce(values.data(), values.size(), algorithm);
+        results.push_back(values);
+    }
+    return results;
+}
+
+template <class ElemType>
+static void CheckAllReduceAlgorithms()
+{
+    auto expected = AllReduceBuffers<ElemType>(MPIAllReduceAlgorithm::Default);
+    for (auto algorithm : { MPIAllReduceAlgorithm::Ring, MPIAllReduceAlgorithm::Hierarchical })
+    {
+        auto actual = AllReduceBuffers<ElemType>(algorithm);
+        BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); i++)
+            BOOST_CHECK_EQUAL_COLLECTIONS(actual[i].begin(), actual[i].end(), expected[i].begin(), expected[i].end());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(MPIWrapperSuite)
+
+BOOST_AUTO_TEST_CASE(AllReduceAlgorithmsMatchMPIAllreduce)
+{
+    CheckAllReduceAlgorithms<float>();
+    CheckAllReduceAlgorithms<double>();
+    CheckAllReduceAlgorithms<int>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
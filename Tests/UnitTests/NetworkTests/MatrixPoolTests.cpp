@@ -0,0 +1,134 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNode.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+typedef shared_ptr<Matrix<float>> MatrixPtr;
+
+static const ComputationNodeBase* FakeOwner(size_t i)
+{
+    // the pool only uses the owner as a key
+    return reinterpret_cast<const ComputationNodeBase*>(i + 1);
+}
+
+BOOST_AUTO_TEST_SUITE(MatrixPoolSuite)
+
+BOOST_AUTO_TEST_CASE(MatrixPoolPlanIsSmallerThanLifoReuse)
+{
+    MatrixPool pool;
+    MatrixPtr a, b, c, d;
+
+    // a and b are alive at the same time, then c and d; the old LIFO reuse would hand the small b to the large c
+    pool.BeginPlanning();
+    pool.Request(CPUDEVICE, FakeOwner(0), &a, 100, false);
+    pool.Request(CPUDEVICE, FakeOwner(1), &b, 10, false);
+    pool.Release(&a);
+    pool.Release(&b);
+    pool.Request(CPUDEVICE, FakeOwner(2), &c, 100, false);
+    pool.Request(CPUDEVICE, FakeOwner(3), &d, 10, false);
+    pool.OptimizedMemoryAllocation();
+
+    BOOST_CHECK(a != b);
+    BOOST_CHECK(c != d);
+    BOOST_CHECK(a == c);
+    BOOST_CHECK(b == d);
+
+    const MatrixPool::PlanStatistics& stats = pool.GetPlanStatistics<float>();
+    BOOST_CHECK_EQUAL(stats.numRequests, 4);
+    BOOST_CHECK_EQUAL(stats.numPlannedMatrices, 2);
+    BOOST_CHECK_EQUAL(stats.plannedFixedBytes, 110 * sizeof(float));
+    BOOST_CHECK_EQUAL(stats.naiveFixedBytes, 200 * sizeof(float));
+    BOOST_CHECK_EQUAL(stats.lowerBoundFixedBytes, 110 * sizeof(float));
+    BOOST_CHECK_LT(stats.plannedFixedBytes, stats.naiveFixedBytes);
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolOverlappingLifetimesNeverShare)
+{
+    const size_t numRequests = 200;
+    std::mt19937 rng(1);
+    std::vector<MatrixPtr> matrices(numRequests);
+    std::vector<std::pair<size_t, size_t>> lifetimes(numRequests, std::make_pair(SIZE_MAX, SIZE_MAX));
+    std::vector<size_t> alive;
+
+    // random interleaving of requests and releases, of mixed sizes and both kinds
+    MatrixPool pool;
+    pool.BeginPlanning();
+    size_t step = 0, next = 0;
+    while (next < numRequests || !alive.empty())
+    {
+        if (next < numRequests && (alive.empty() || rng() % 2 == 0))
+        {
+            pool.Request(CPUDEVICE, FakeOwner(next), &matrices[next], 1 + rng() % 1000, next % 3 == 0);
+            lifetimes[next].first = step++;
+            alive.push_back(next++);
+        }
+        else
+        {
+            size_t k = rng() % alive.size();
+            size_t i = alive[k];
+            alive.erase(alive.begin() + k);
+            pool.Release(&matrices[i]);
+            lifetimes[i].second = step++;
+        }
+    }
+    pool.OptimizedMemoryAllocation();
+
+    const MatrixPool::PlanStatistics& stats = pool.GetPlanStatistics<float>();
+    BOOST_CHECK_LT(stats.numPlannedMatrices, numRequests);
+    BOOST_CHECK_LE(stats.plannedFixedBytes, stats.naiveFixedBytes);
+    BOOST_CHECK_LE(stats.plannedBytesPerColumn, stats.naiveBytesPerColumn);
+
+    for (size_t i = 0; i < numRequests; i++)
+    {
+        BOOST_REQUIRE(matrices[i] != nullptr);
+        for (size_t j = i + 1; j < numRequests; j++)
+        {
+            bool overlap = lifetimes[i].first < lifetimes[j].second && lifetimes[j].first < lifetimes[i].second;
+            if (overlap)
+                BOOST_CHECK(matrices[i] != matrices[j]);
+            if (matrices[i] == matrices[j])
+                BOOST_CHECK_EQUAL(i % 3 == 0, j % 3 == 0); // minibatch-scaled and fixed requests are never mixed
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolLateRequestGetsPrivateMatrix)
+{
+    MatrixPool pool;
+    MatrixPtr a, b, late;
+
+    pool.BeginPlanning();
+    pool.Request(CPUDEVICE, FakeOwner(0), &a, 100, false);
+    pool.Release(&a);
+    pool.Request(CPUDEVICE, FakeOwner(1), &b, 100, false);
+    pool.Release(&b);
+    pool.OptimizedMemoryAllocation();
+    BOOST_CHECK(a == b);
+
+    // a request after planning must not end up in a placeholder or in a matrix shared with anybody
+    pool.Request(CPUDEVICE, FakeOwner(2), &late, 100, false);
+    BOOST_REQUIRE(late != nullptr);
+    BOOST_CHECK(late != a);
+    BOOST_CHECK(pool.GetPlannedMatrices(FakeOwner(2)).empty());
+    pool.Release(&late); // no-op
+
+    // a new plan forgets the previous one
+    BOOST_CHECK_EQUAL(pool.GetPlannedMatrices(FakeOwner(0)).size(), 1);
+    pool.BeginPlanning();
+    BOOST_CHECK(pool.GetPlannedMatrices(FakeOwner(0)).empty());
+    pool.Request(CPUDEVICE, FakeOwner(0), &a, 100, false);
+    pool.OptimizedMemoryAllocation();
+    BOOST_CHECK_EQUAL(pool.GetPlannedMatrices(FakeOwner(0)).size(), 1);
+    BOOST_CHECK_EQUAL(pool.GetPlanStatistics<float>().numRequests, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,96 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Common/ComputationNetworkTestHelper.h"
+#include "Common/MPITestHelper.h"
+#include "InputAndParamNodes.h"
+#include "SGD.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Value of element j of parameter i on worker 'rank' before the sync 'sync'.
+static double ModelValue(size_t rank, size_t i, size_t j, size_t sync)
+{
+    return (double) ((rank + 1) * (i + 1) + (j % 7) + sync);
+}
+
+// Averages a model over all workers a few times, weighted by the number of samples of each worker, and checks the result.
+// The model has small parameters that share an all-reduce chunk and a large one that spans several chunks.
+// A parameter that is not updated must not be touched.
+template <class ElemType>
+static void CheckModelAveraging()
+{
+    auto mpi = GetTestMPI();
+    const size_t rank = mpi->CurrentNodeRank(), numWorkers = mpi->NumNodesInUse();
+    const size_t dims[][2] = { { 3, 5 }, { 700, 900 }, { 1, 1 }, { 512, 300 }, { 40, 7 } };
+    const size_t fixedParameter = 2;
+
+    std::list<ComputationNodeBasePtr> learnableNodes;
+    std::vector<shared_ptr<ComputationNode<ElemType>>> parameters;
+    for (size_t i = 0; i < 5; i++)
+    {
+        shared_ptr<ComputationNode<ElemType>> p = make_shared<LearnableParameter<ElemType>>(CPUDEVICE, L"W" + std::to_wstring(i), TensorShape(dims[i][0], dims[i][1]));
+        p->SetLearningRateMultiplier(i == fixedParameter ? 0.0f : 1.0f);
+        learnableNodes.push_back(p);
+        parameters.push_back(p);
+    }
+
+    BasicModelAveragingSGD<ElemType> modelAveraging(mpi, 1, CPUDEVICE);
+    std::list<Matrix<ElemType>> smoothedGradients;
+    size_t allSamples = 0;
+    for (size_t r = 0; r < numWorkers; r++)
+        allSamples += 100 * (r + 1);
+
+    // the staging buffer is kept across syncs
+    for (size_t sync = 0; sync < 3; sync++)
+    {
+        for (size_t i = 0; i < parameters.size(); i++)
+        {
+            std::vector<ElemType> values(parameters[i]->Value().GetNumElements());
+            for (size_t j = 0; j < values.size(); j++)
+                values[j] = (ElemType) ModelValue(rank, i, j, sync);
+            parameters[i]->Value().SetValue(dims[i][0], dims[i][1], CPUDEVICE, values.data());
+        }
+
+        size_t totalSamples = 0;
+        float secondsOnCommunication = 0;
+        modelAveraging.ModelAggregationProcessing(100 * (rank + 1), learnableNodes, smoothedGradients, totalSamples, secondsOnCommunication);
+        BOOST_CHECK_EQUAL(totalSamples, allSamples);
+
+        for (size_t i = 0; i < parameters.size(); i++)
+        {
+            auto values = ToVector(parameters[i]->Value());
+            size_t numMismatches = 0;
+            for (size_t j = 0; j < values.size(); j++)
+            {
+                double expected = ModelValue(rank, i, j, sync);
+                if (i != fixedParameter)
+                {
+                    expected = 0;
+                    for (size_t r = 0; r < numWorkers; r++)
+                        expected += 100.0 * (r + 1) / allSamples * ModelValue(r, i, j, sync);
+                }
+
+                if (fabs(values[j] - expected) > 1e-5 * fabs(expected))
+                    numMismatches++;
+            }
+            BOOST_CHECK_EQUAL(numMismatches, 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(ModelAveragingSuite)
+
+BOOST_AUTO_TEST_CASE(ModelAveragingInChunks)
+{
+    CheckModelAveraging<float>();
+    CheckModelAveraging<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
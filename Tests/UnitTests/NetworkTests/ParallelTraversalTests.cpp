@@ -0,0 +1,133 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Common/ComputationNetworkTestHelper.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Criterion value and all parameter gradients of two forward/backward passes through a network with several
+// independent branches (which parallel traversal runs concurrently) and with pooled matrices shared between them.
+template <class ElemType>
+static std::vector<std::vector<ElemType>> RunBranchyNetwork(size_t parallelTraversalThreads)
+{
+    const size_t inputDim = 8, hiddenDim = 16, outputDim = 4, numSamples = 5, numBranches = 4;
+
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", inputDim);
+    auto labels   = builder.CreateInputNode(L"labels", outputDim);
+    std::vector<ComputationNodeBasePtr> parameters;
+    auto parameter = [&](const std::wstring& name, size_t rows, size_t cols)
+    {
+        auto p = builder.CreateLearnableParameter(name, rows, cols);
+        p->Value().SetUniformRandomValue(-0.5, 0.5, (unsigned long) parameters.size() + 1);
+        parameters.push_back(p);
+        return p;
+    };
+
+    auto W0 = parameter(L"W0", hiddenDim, inputDim);
+    auto b0 = parameter(L"b0", hiddenDim, 1);
+    auto h = builder.Sigmoid(builder.Plus(builder.Times(W0, features), b0, L"z0"), L"h0");
+    shared_ptr<ComputationNode<ElemType>> sum;
+    for (size_t i = 0; i < numBranches; i++)
+    {
+        auto W = parameter(L"W" + std::to_wstring(i + 1), hiddenDim, hiddenDim);
+        auto z = builder.Times(W, h, 1, L"z" + std::to_wstring(i + 1));
+        auto a = (i % 2 == 0) ? builder.Tanh(z, L"a" + std::to_wstring(i + 1)) : builder.RectifiedLinear(z, L"a" + std::to_wstring(i + 1));
+        sum = sum ? builder.Plus(sum, a, L"s" + std::to_wstring(i + 1)) : a;
+    }
+    auto Wo = parameter(L"Wo", outputDim, hiddenDim);
+    auto criterion = builder.SquareError(labels, builder.Times(Wo, sum, 1, L"out"), L"ce");
+    net->AddToNodeGroup(L"criterion", criterion);
+
+    net->SetParallelTraversalThreads(parallelTraversalThreads);
+    net->CompileNetwork();
+
+    // fixed input data
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    features->Value().Resize(inputDim, numSamples);
+    features->Value().SetUniformRandomValue(-1, 1, 100);
+    labels->Value().Resize(outputDim, numSamples);
+    labels->Value().SetUniformRandomValue(-1, 1, 101);
+
+    // twice, so that the second pass reuses the shared matrices
+    return ForwardAndBackprop<ElemType>(net, criterion, { features, labels }, parameters, 2);
+}
+
+// Criterion value and all parameter gradients of two passes through a network whose independent branches all
+// multiply with the same weight matrix. With packed weights, the branches share the packed copy of that matrix.
+template <class ElemType>
+static std::vector<std::vector<ElemType>> RunSharedWeightNetwork(size_t parallelTraversalThreads, bool usePackedWeights)
+{
+    const size_t inputDim = 8, hiddenDim = 16, numSamples = 5, numBranches = 4;
+
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", inputDim);
+    auto labels   = builder.CreateInputNode(L"labels", hiddenDim);
+    std::vector<ComputationNodeBasePtr> parameters;
+    auto parameter = [&](const std::wstring& name, size_t rows, size_t cols)
+    {
+        auto p = builder.CreateLearnableParameter(name, rows, cols);
+        p->Value().SetUniformRandomValue(-0.5, 0.5, (unsigned long) parameters.size() + 1);
+        parameters.push_back(p);
+        return p;
+    };
+
+    auto W = parameter(L"W", hiddenDim, hiddenDim);
+    shared_ptr<ComputationNode<ElemType>> sum;
+    for (size_t i = 0; i < numBranches; i++)
+    {
+        auto V = parameter(L"V" + std::to_wstring(i), hiddenDim, inputDim);
+        auto h = builder.Tanh(builder.Times(V, features, 1, L"h" + std::to_wstring(i)), L"a" + std::to_wstring(i));
+        auto z = builder.Times(W, h, 1, L"z" + std::to_wstring(i));
+        sum = sum ? builder.Plus(sum, z, L"s" + std::to_wstring(i)) : z;
+    }
+    auto criterion = builder.SquareError(labels, sum, L"ce");
+    net->AddToNodeGroup(L"criterion", criterion);
+
+    net->SetParallelTraversalThreads(parallelTraversalThreads);
+    net->CompileNetwork();
+    if (usePackedWeights)
+        BOOST_REQUIRE_EQUAL(net->EnablePackedWeights(), 2 * numBranches);
+
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    features->Value().Resize(inputDim, numSamples);
+    features->Value().SetUniformRandomValue(-1, 1, 100);
+    labels->Value().Resize(hiddenDim, numSamples);
+    labels->Value().SetUniformRandomValue(-1, 1, 101);
+
+    return ForwardAndBackprop<ElemType>(net, criterion, { features, labels }, parameters, 2);
+}
+
+BOOST_AUTO_TEST_SUITE(ParallelTraversalSuite)
+
+BOOST_AUTO_TEST_CASE(ParallelTraversalMatchesSequential)
+{
+    auto sequential = RunBranchyNetwork<float>(0);
+    for (size_t threads : { 1, 2, 4 })
+    {
+        auto parallel = RunBranchyNetwork<float>(threads);
+        BOOST_REQUIRE_EQUAL(parallel.size(), sequential.size());
+        // conflicting accesses keep their sequential order, so the results must be bit-identical
+        for (size_t i = 0; i < sequential.size(); i++)
+            BOOST_CHECK_EQUAL_COLLECTIONS(parallel[i].begin(), parallel[i].end(), sequential[i].begin(), sequential[i].end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ParallelTraversalWithSharedPackedWeights)
+{
+    auto expected = RunSharedWeightNetwork<float>(0, false);
+    for (size_t threads : { 0, 4 })
+        CheckResultsClose(RunSharedWeightNetwork<float>(threads, true), expected, 1e-5f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,109 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Common/ComputationNetworkTestHelper.h"
+#include "SGD.h"
+#include "ParameterArena.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Gives the tests access to the per-parameter update of SGD and to the update of the parameter arena.
+template <class ElemType>
+class ParameterArenaSGD : public SGD<ElemType>
+{
+    typedef SGD<ElemType> Base;
+
+public:
+    ParameterArenaSGD(const ConfigParameters& config)
+        : Base(config)
+    {
+    }
+
+    void UpdatePerParameter(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients,
+                            double learnRatePerSample, double momentumPerSample, size_t actualMBSize, double L2RegWeight)
+    {
+        auto smoothedGradient = smoothedGradients.begin();
+        for (const auto& node : learnableNodes)
+            this->UpdateWeights(node, *smoothedGradient++, learnRatePerSample, momentumPerSample, actualMBSize, L2RegWeight, 0, false, false);
+    }
+
+    void UpdateArena(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients,
+                     double learnRatePerSample, double momentumPerSample, size_t actualMBSize, double L2RegWeight)
+    {
+        if (!this->m_parameterArena)
+            this->m_parameterArena = make_shared<ParameterArena<ElemType>>(learnableNodes, this->CanUpdateParameterArena(), CPUDEVICE);
+        this->m_parameterArena->Bind(learnableNodes, smoothedGradients);
+        this->UpdateParameterArena(learnRatePerSample, momentumPerSample, actualMBSize, L2RegWeight, 0, false);
+    }
+};
+
+// Values of the parameters after a few updates with fixed gradients, either one parameter at a time or through the arena.
+// The parameters have different shapes and two different learning rate multipliers, so the arena has two groups.
+template <class ElemType>
+static std::vector<std::vector<ElemType>> RunUpdates(bool useArena, double momentumPerSample)
+{
+    const size_t actualMBSize = 4, numUpdates = 3;
+    const double learnRatePerSample = 0.05, L2RegWeight = 0.001;
+
+    ConfigParameters config;
+    config.Parse("modelPath=ParameterArenaTests.dnn;maxEpochs=1;learningRatesPerSample=0.05");
+    ParameterArenaSGD<ElemType> sgd(config);
+
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    std::list<ComputationNodeBasePtr> learnableNodes;
+    std::list<Matrix<ElemType>> smoothedGradients;
+    const size_t shapes[][2] = { { 3, 4 }, { 5, 1 }, { 2, 7 }, { 1, 1 } };
+    const double multipliers[] = { 1, 0.5, 1, 0.5 };
+    for (size_t i = 0; i < 4; i++)
+    {
+        auto p = builder.CreateLearnableParameter(L"W" + std::to_wstring(i), shapes[i][0], shapes[i][1]);
+        p->Value().SetUniformRandomValue(-1, 1, (unsigned long) i + 1);
+        p->SetLearningRateMultiplier(multipliers[i]);
+        p->CreateGradientMatrixIfNull();
+        p->Gradient().Resize(shapes[i][0], shapes[i][1]);
+        learnableNodes.push_back(p);
+        smoothedGradients.push_back(Matrix<ElemType>(shapes[i][0], shapes[i][1], CPUDEVICE));
+        smoothedGradients.back().SetValue(0);
+    }
+
+    for (size_t update = 0; update < numUpdates; update++)
+    {
+        // the arena is bound on the first update, which must keep the gradients set before
+        size_t seed = 100 * (update + 1);
+        for (const auto& node : learnableNodes)
+            dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient().SetUniformRandomValue(-1, 1, (unsigned long) seed++);
+
+        if (useArena)
+            sgd.UpdateArena(learnableNodes, smoothedGradients, learnRatePerSample, momentumPerSample, actualMBSize, L2RegWeight);
+        else
+            sgd.UpdatePerParameter(learnableNodes, smoothedGradients, learnRatePerSample, momentumPerSample, actualMBSize, L2RegWeight);
+    }
+
+    std::vector<std::vector<ElemType>> values;
+    for (const auto& node : learnableNodes)
+        values.push_back(ToVector(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value()));
+    return values;
+}
+
+BOOST_AUTO_TEST_SUITE(ParameterArenaSuite)
+
+BOOST_AUTO_TEST_CASE(ParameterArenaPlainSGD)
+{
+    CheckResultsClose(RunUpdates<float>(true, 0), RunUpdates<float>(false, 0), 1e-6f);
+    CheckResultsClose(RunUpdates<double>(true, 0), RunUpdates<double>(false, 0), 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(ParameterArenaMomentumSGD)
+{
+    CheckResultsClose(RunUpdates<float>(true, 0.9), RunUpdates<float>(false, 0.9), 1e-6f);
+    CheckResultsClose(RunUpdates<double>(true, 0.9), RunUpdates<double>(false, 0.9), 1e-12);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -24,20 +24,40 @@ public:
     ChunkPtr m_chunk;
 
     CNTKTextFormatReaderTestRunner(const string& filename,
-        const vector<StreamDescriptor>& streams, unsigned int maxErrors) :
+        const vector<StreamDescriptor>& streams, unsigned int maxErrors, size_t numParserThreads = 1, bool cacheIndex = false) :
         m_parser(std::make_shared<CorpusDescriptor>(), wstring(filename.begin(), filename.end()), streams)
     {
         m_parser.SetMaxAllowedErrors(maxErrors);
         m_parser.SetTraceLevel(TextParser<ElemType>::TraceLevel::Info);
         m_parser.SetChunkSize(SIZE_MAX);
         m_parser.SetNumRetries(0);
+        m_parser.SetNumParserThreads(numParserThreads);
+        m_parser.SetCacheIndex(cacheIndex);
         m_parser.Initialize();
     }
+
+    const Index& GetIndex() const
+    {
+        return m_parser.m_indexer->GetIndex();
+    }
+
     // Retrieves a chunk of data.
     void LoadChunk()
     {
         m_chunk = m_parser.GetChunk(0);
     }
+
+    // Retrieves the data of all sequences in the loaded chunk.
+    void GetSequences(vector<vector<SequenceDataPtr>>& result)
+    {
+        vector<SequenceDescription> descriptions;
+        m_parser.GetSequencesForChunk(0, descriptions);
+        for (const auto& description : descriptions)
+        {
+            result.push_back(vector<SequenceDataPtr>());
+            m_chunk->GetSequence(description.m_id, result.back());
+        }
+    }
 };
 
 namespace Test {
@@ -75,6 +95,24 @@ struct CNTKTextFormatReaderFixture : ReaderFixture
     }
 };
 
+// Converts the corpus described by a section of the config file into the binary format of the CNTKBinaryReader.
+void ConvertCorpus(const string& configFileName, const string& sectionName)
+{
+    typedef void (*ConvertCorpusProc)(const ConfigParameters& config);
+
+    std::wstring configFN(configFileName.begin(), configFileName.end());
+    std::wstring configFileCommand(L"configFile=" + configFN);
+
+    wchar_t* arg[2]{L"CNTK", &configFileCommand[0]};
+    ConfigParameters config;
+    const std::string rawConfigString = ConfigParameters::ParseCommandLine(2, arg, config);
+    config.ResolveVariables(rawConfigString);
+
+    Plugin plugin;
+    ConvertCorpusProc convertCorpus = (ConvertCorpusProc)plugin.Load(std::string("CNTKBinaryReader"), "ConvertCorpus");
+    convertCorpus(config(sectionName));
+}
+
 BOOST_FIXTURE_TEST_SUITE(ReaderTestSuite, CNTKTextFormatReaderFixture)
 
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_Simple_dense)
@@ -662,6 +700,107 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_invalid_input)
     CheckFilesEquivalent(control, output);
 };
 
+// the same input indexed and parsed on one and on several threads
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_parallel_parsing)
+{
+    vector<StreamDescriptor> streams(1);
+    streams[0].m_alias = "F0";
+    streams[0].m_name = L"F0";
+    streams[0].m_storageType = StorageType::sparse_csc;
+    streams[0].m_sampleDimension = 20;
+
+    CNTKTextFormatReaderTestRunner<double> sequential("100x100_jagged_sparse.txt", streams, 0, 1);
+    CNTKTextFormatReaderTestRunner<double> parallel("100x100_jagged_sparse.txt", streams, 0, 4);
+    sequential.LoadChunk();
+    parallel.LoadChunk();
+
+    vector<vector<SequenceDataPtr>> expected, actual;
+    sequential.GetSequences(expected);
+    parallel.GetSequences(actual);
+
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        auto e = static_pointer_cast<SparseSequenceData>(expected[i][0]);
+        auto a = static_pointer_cast<SparseSequenceData>(actual[i][0]);
+        BOOST_REQUIRE_EQUAL(e->m_numberOfSamples, a->m_numberOfSamples);
+        BOOST_REQUIRE_EQUAL(e->m_totalNnzCount, a->m_totalNnzCount);
+        BOOST_CHECK_EQUAL_COLLECTIONS(e->m_nnzCounts.begin(), e->m_nnzCounts.end(), a->m_nnzCounts.begin(), a->m_nnzCounts.end());
+
+        const double* expectedValues = static_cast<const double*>(e->m_data);
+        const double* actualValues = static_cast<const double*>(a->m_data);
+        BOOST_CHECK_EQUAL_COLLECTIONS(e->m_indices, e->m_indices + e->m_totalNnzCount, a->m_indices, a->m_indices + a->m_totalNnzCount);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expectedValues, expectedValues + e->m_totalNnzCount, actualValues, actualValues + a->m_totalNnzCount);
+    }
+};
+
+void CheckIndicesAreEqual(const Index& expected, const Index& actual)
+{
+    BOOST_REQUIRE_EQUAL(expected.m_chunks.size(), actual.m_chunks.size());
+    for (size_t i = 0; i < expected.m_chunks.size(); ++i)
+    {
+        const auto& e = expected.m_chunks[i];
+        const auto& a = actual.m_chunks[i];
+        BOOST_REQUIRE_EQUAL(e.m_sequences.size(), a.m_sequences.size());
+        BOOST_REQUIRE_EQUAL(e.m_byteSize, a.m_byteSize);
+        BOOST_REQUIRE_EQUAL(e.m_numberOfSamples, a.m_numberOfSamples);
+        for (size_t j = 0; j < e.m_sequences.size(); ++j)
+        {
+            BOOST_REQUIRE_EQUAL(e.m_sequences[j].m_fileOffsetBytes, a.m_sequences[j].m_fileOffsetBytes);
+            BOOST_REQUIRE_EQUAL(e.m_sequences[j].m_byteSize, a.m_sequences[j].m_byteSize);
+            BOOST_REQUIRE_EQUAL(e.m_sequences[j].m_numberOfSamples, a.m_sequences[j].m_numberOfSamples);
+            BOOST_REQUIRE_EQUAL(e.m_sequences[j].m_key.m_sequence, a.m_sequences[j].m_key.m_sequence);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_index_cache)
+{
+    vector<StreamDescriptor> streams(1);
+    streams[0].m_alias = "F0";
+    streams[0].m_name = L"F0";
+    streams[0].m_storageType = StorageType::sparse_csc;
+    streams[0].m_sampleDimension = 20;
+
+    const string input = "100x100_jagged_sparse.txt";
+    const string cache = input + ".index";
+    remove(cache.c_str());
+    BOOST_SCOPE_EXIT(&cache)
+    {
+        remove(cache.c_str());
+    } BOOST_SCOPE_EXIT_END
+
+    CNTKTextFormatReaderTestRunner<double> uncached(input, streams, 0);
+
+    // the first run builds the index and saves it, the second one loads it
+    CNTKTextFormatReaderTestRunner<double> building(input, streams, 0, 1, true);
+    BOOST_REQUIRE(fexists(cache));
+    CNTKTextFormatReaderTestRunner<double> loading(input, streams, 0, 1, true);
+    CheckIndicesAreEqual(uncached.GetIndex(), building.GetIndex());
+    CheckIndicesAreEqual(uncached.GetIndex(), loading.GetIndex());
+
+    // a corrupt cache is ignored (and replaced)
+    FILE* f = fopenOrDie(cache, "wb");
+    fputs("not an index", f);
+    fclose(f);
+    CNTKTextFormatReaderTestRunner<double> rebuilding(input, streams, 0, 1, true);
+    CheckIndicesAreEqual(uncached.GetIndex(), rebuilding.GetIndex());
+
+    loading.LoadChunk();
+    uncached.LoadChunk();
+    vector<vector<SequenceDataPtr>> expected, actual;
+    uncached.GetSequences(expected);
+    loading.GetSequences(actual);
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        auto e = static_pointer_cast<SparseSequenceData>(expected[i][0]);
+        auto a = static_pointer_cast<SparseSequenceData>(actual[i][0]);
+        BOOST_REQUIRE_EQUAL(e->m_numberOfSamples, a->m_numberOfSamples);
+        BOOST_REQUIRE_EQUAL(e->m_totalNnzCount, a->m_totalNnzCount);
+    }
+};
+
 // 100 sequences with N samples for each of 3 inputs, where N is chosen at random
 // from [1, 100] for each sequence
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_100x100x3)
@@ -800,6 +939,66 @@ BOOST_AUTO_TEST_CASE(CompositeCNTKTextFormatReader_5x5_and_5x10_jagged_minibatch
         false);
 };
 
+// Reading a binary corpus converted from the text format produces the same minibatches as reading the text.
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_5x5_and_5x10_jagged)
+{
+    HelperRunReaderTest<double>(
+        testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_Output.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_Output.txt",
+        "5x10_and_5x5_jagged",
+        "reader",
+        40,     // epoch size
+        10,     // mb size
+        3,      // num epochs
+        2,
+        0,
+        0,
+        1,
+        false,
+        false,
+        false);
+
+    ConvertCorpus(testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk", "5x10_and_5x5_jagged_convert");
+
+    HelperRunReaderTest<double>(
+        testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_Output.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_binary_Output.txt",
+        "5x10_and_5x5_jagged_binary",
+        "reader",
+        40,     // epoch size
+        10,     // mb size
+        3,      // num epochs
+        2,
+        0,
+        0,
+        1,
+        false,
+        false,
+        false);
+};
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse)
+{
+    ConvertCorpus(testDataPath() + "/Config/CNTKTextFormatReader/sparse.cntk", "50x20_jagged_sequences_convert");
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKTextFormatReader/sparse.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_sparse.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_sparse_binary_Output.txt",
+        "50x20_jagged_sequences_binary",
+        "reader",
+        564,  // epoch size
+        564,  // mb size
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        true);
+};
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
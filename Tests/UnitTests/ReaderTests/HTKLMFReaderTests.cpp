@@ -619,6 +619,56 @@ BOOST_AUTO_TEST_CASE(HTKDeserializersSimpleDataLoop12)
         1);
 };
 
+BOOST_AUTO_TEST_SUITE_END()
+
+// Fixture for the small HTK corpus in the repository: three utterances of 4, 6, and 5 two-dimensional frames
+// whose values are 10 * utterance + frame and its negation, so that the expected context windows can be read off the control file.
+struct HTKContextReaderFixture : ReaderFixture
+{
+    HTKContextReaderFixture()
+        : ReaderFixture("/Data/HTKDeserializers")
+    {
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(HTKContextReaderTestSuite, HTKContextReaderFixture)
+
+// 2 frames of left and 1 frame of right context, added by the deserializer
+BOOST_AUTO_TEST_CASE(HTKDeserializersContextWindow)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/HTKDeserializersContextWindow_Config.cntk",
+        testDataPath() + "/Control/HTKDeserializersContextWindow_Control.txt",
+        testDataPath() + "/Control/HTKDeserializersContextWindow_Output.txt",
+        "Simple_Test",
+        "reader",
+        15,
+        10,
+        1,
+        1,
+        1,
+        0,
+        1);
+};
+
+// the same context window, spliced by the ReaderShim instead (expandContextOnDevice)
+BOOST_AUTO_TEST_CASE(HTKDeserializersExpandContextOnDevice)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/HTKDeserializersExpandContextOnDevice_Config.cntk",
+        testDataPath() + "/Control/HTKDeserializersContextWindow_Control.txt",
+        testDataPath() + "/Control/HTKDeserializersExpandContextOnDevice_Output.txt",
+        "Simple_Test",
+        "reader",
+        15,
+        10,
+        1,
+        1,
+        1,
+        0,
+        1);
+};
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 
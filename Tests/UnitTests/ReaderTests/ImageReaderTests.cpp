@@ -36,6 +36,24 @@ BOOST_AUTO_TEST_CASE(ImageReaderSimple)
         1);
 }
 
+// The chain of separate transformers gives the same result as the fused transformer used by default.
+BOOST_AUTO_TEST_CASE(ImageReaderChainedTransforms)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageReaderChainedTransforms_Config.cntk",
+        testDataPath() + "/Control/ImageReaderSimple_Control.txt",
+        testDataPath() + "/Control/ImageReaderChainedTransforms_Output.txt",
+        "Simple_Test",
+        "reader",
+        4,
+        4,
+        1,
+        1,
+        0,
+        0,
+        1);
+}
+
 BOOST_AUTO_TEST_CASE(ImageAndTextReaderSimple)
 {
     HelperRunReaderTest<float>(
@@ -54,6 +72,24 @@ BOOST_AUTO_TEST_CASE(ImageAndTextReaderSimple)
 }
 
 
+// The "Fused" transform gives the same result as the chain of Crop, Scale, Mean and Transpose.
+BOOST_AUTO_TEST_CASE(ImageAndTextReaderFused)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageAndTextReaderFused_Config.cntk",
+        testDataPath() + "/Control/ImageAndTextReaderSimple_Control.txt",
+        testDataPath() + "/Control/ImageAndTextReaderFused_Output.txt",
+        "Simple_Test",
+        "reader",
+        4,
+        4,
+        1,
+        1,
+        0,
+        0,
+        1);
+}
+
 BOOST_AUTO_TEST_CASE(ImageReaderBadMap)
 {
     BOOST_REQUIRE_EXCEPTION(
@@ -131,6 +167,52 @@ BOOST_AUTO_TEST_CASE(ImageReaderZip)
         1);
 }
 
+// Compressed entries are read through the zip library, and give the same images as the stored entries of simple.zip.
+BOOST_AUTO_TEST_CASE(ImageReaderZipDeflated)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageReaderZipDeflated_Config.cntk",
+        testDataPath() + "/Control/ImageReaderZip_Control.txt",
+        testDataPath() + "/Control/ImageReaderZipDeflated_Output.txt",
+        "ZipDeflated_Test",
+        "reader",
+        4,
+        4,
+        1,
+        1,
+        0,
+        0,
+        1);
+}
+
+// The first run reads the central directory and caches the entry table next to the archive,
+// the second run loads the table from the cache.
+BOOST_AUTO_TEST_CASE(ImageReaderZipCachedIndex)
+{
+    const auto indexPath = testDataPath() + "/Data/images/simple.zip.index";
+    boost::filesystem::remove(indexPath);
+
+    for (size_t run = 0; run < 2; run++)
+    {
+        HelperRunReaderTest<float>(
+            testDataPath() + "/Config/ImageReaderZip_Config.cntk",
+            testDataPath() + "/Control/ImageReaderZip_Control.txt",
+            testDataPath() + "/Control/ImageReaderZip_Output.txt",
+            "Zip_Test",
+            "reader",
+            4,
+            4,
+            1,
+            1,
+            0,
+            0,
+            1);
+        BOOST_CHECK(boost::filesystem::exists(indexPath));
+    }
+
+    boost::filesystem::remove(indexPath);
+}
+
 BOOST_AUTO_TEST_CASE(ImageReaderZipMissingFile)
 {
     BOOST_REQUIRE_EXCEPTION(
@@ -148,7 +230,7 @@ BOOST_AUTO_TEST_CASE(ImageReaderZipMissingFile)
             0,
             1),
             std::runtime_error,
-            [](std::runtime_error const& ex) { return string("Failed to get file info of missing.jpg, zip library error: Unknown error -1") == ex.what(); });
+            [](std::runtime_error const& ex) { return string(ex.what()).find("Failed to find missing.jpg in the zip file") == 0; });
 }
 
 BOOST_AUTO_TEST_CASE(ImageReaderMultiView)
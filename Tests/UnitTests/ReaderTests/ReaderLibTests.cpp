@@ -9,9 +9,13 @@
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
 #include "CorpusDescriptor.h"
+#include "SequencePacker.h"
+#include "TransformController.h"
+#include "HeapMemoryProvider.h"
 
 #include <numeric>
 #include <random>
+#include <limits>
 
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
@@ -104,13 +108,13 @@ public:
             }));
         }
 
-        m_streams.push_back(make_shared<StreamDescription>(StreamDescription{
-            L"input",
-            0,
-            StorageType::dense,
-            ElementType::tfloat,
-            m_sampleLayout
-        }));
+        auto stream = make_shared<StreamDescription>();
+        stream->m_name = L"input";
+        stream->m_id = 0;
+        stream->m_storageType = StorageType::dense;
+        stream->m_elementType = ElementType::tfloat;
+        stream->m_sampleLayout = m_sampleLayout;
+        m_streams.push_back(stream);
 
 
     };
@@ -327,6 +331,71 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerChaosMonkey)
     }
 }
 
+BOOST_AUTO_TEST_CASE(BlockRandomizerChunkPrefetch)
+{
+    const int seed = 42;
+    const int numChunks = 50;
+    const int numSequencesPerChunk = 4;
+    const int windowSize = 12;
+    vector<float> data(numChunks * numSequencesPerChunk);
+    iota(data.begin(), data.end(), 0.0f);
+    mt19937 rng(seed);
+    uniform_int_distribution<int> distr(1, 4);
+
+    auto mockDeserializer = make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data);
+
+    vector<EpochConfiguration> epochs;
+    for (int t = 0; t < 10; t++)
+    {
+        EpochConfiguration epochConfiguration;
+        epochConfiguration.m_numberOfWorkers = distr(rng);
+        epochConfiguration.m_workerRank = distr(rng) % epochConfiguration.m_numberOfWorkers;
+        epochConfiguration.m_minibatchSizeInSamples = 0; // don't care
+        epochConfiguration.m_totalEpochSizeInSamples = data.size() / distr(rng);
+        epochConfiguration.m_epochIndex = t;
+        epochs.push_back(epochConfiguration);
+    }
+
+    vector<size_t> samplesToGet(1000);
+    for (auto& s : samplesToGet)
+        s = distr(rng);
+
+    // Returns the values of all sequences, with a negative marker after each minibatch and at the end of each epoch.
+    // The randomizers are run one after another, because sequence randomization uses the global rand().
+    auto readAll = [&](shared_ptr<BlockRandomizer> randomizer)
+    {
+        vector<float> result;
+        size_t request = 0;
+        for (const auto& epochConfiguration : epochs)
+        {
+            randomizer->StartEpoch(epochConfiguration);
+            for (;;)
+            {
+                Sequences sequences = randomizer->GetNextSequences(samplesToGet[request++ % samplesToGet.size()]);
+                for (const auto& sequence : sequences.m_data.empty() ? vector<SequenceDataPtr>() : sequences.m_data.front())
+                {
+                    result.push_back(*((float*)reinterpret_cast<DenseSequenceData&>(*sequence).m_data));
+                }
+                result.push_back(-1);
+                if (sequences.m_endOfEpoch)
+                {
+                    result.push_back(-2);
+                    break;
+                }
+            }
+        }
+        return result;
+    };
+
+    // Loading chunks ahead must not change what is returned, also when the prefetch budget does not allow the full look-ahead.
+    vector<float> expected = readAll(make_shared<BlockRandomizer>(0, windowSize, mockDeserializer, BlockRandomizer::DecimationMode::chunk, false));
+    vector<float> prefetched = readAll(make_shared<BlockRandomizer>(0, windowSize, mockDeserializer, BlockRandomizer::DecimationMode::chunk, false, false, 3));
+    vector<float> limited = readAll(make_shared<BlockRandomizer>(0, windowSize, mockDeserializer, BlockRandomizer::DecimationMode::chunk, false, false, 8, 2 * numSequencesPerChunk));
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), prefetched.begin(), prefetched.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), limited.begin(), limited.end());
+}
+
 BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochLegacyRandomization)
 {
     vector<float> data(10);
@@ -404,6 +473,333 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+BOOST_AUTO_TEST_CASE(SequencePackerMultipleBuffers)
+{
+    vector<float> data(20);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 4, data);
+
+    auto randomizer = make_shared<NoRandomizer>(mockDeserializer);
+    auto packer = make_shared<SequencePacker>(make_shared<HeapMemoryProvider>(), randomizer, mockDeserializer->GetStreamDescriptions());
+
+    const size_t numberOfBuffers = 3;
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 2;
+    epochConfiguration.m_totalEpochSizeInSamples = data.size();
+    epochConfiguration.m_epochIndex = 0;
+    epochConfiguration.m_truncationSize = 0;
+    epochConfiguration.m_numberOfBuffers = numberOfBuffers;
+    epochConfiguration.m_deviceId = CPUDEVICE;
+    randomizer->StartEpoch(epochConfiguration);
+    packer->StartEpoch(epochConfiguration);
+
+    // The data of the last numberOfBuffers minibatches must stay intact.
+    vector<Minibatch> minibatches;
+    for (size_t i = 0; i < data.size() / 2; i++)
+    {
+        minibatches.push_back(packer->ReadMinibatch());
+        BOOST_REQUIRE_EQUAL(minibatches.back().m_data.size(), 1);
+        for (size_t j = minibatches.size() - min(minibatches.size(), numberOfBuffers); j < minibatches.size(); j++)
+        {
+            const float* values = reinterpret_cast<const float*>(minibatches[j].m_data.front()->m_data);
+            BOOST_CHECK_EQUAL(values[0], 2 * j);
+            BOOST_CHECK_EQUAL(values[1], 2 * j + 1);
+        }
+    }
+}
+
+// Enumerates sequences of the given lengths, all samples of a sequence hold the index of the sequence.
+// Streams other than the first one are named "input1", "input2", ... and hold the same data.
+class MockSequenceEnumerator : public SequenceEnumerator
+{
+    vector<vector<float>> m_sequenceData;
+    vector<StreamDescriptionPtr> m_streams;
+    size_t m_next;
+
+public:
+    MockSequenceEnumerator(const vector<uint32_t>& lengths, size_t numberOfStreams = 1) : m_next(0)
+    {
+        for (size_t i = 0; i < lengths.size(); i++)
+        {
+            m_sequenceData.push_back(vector<float>(lengths[i], (float)i));
+        }
+
+        for (size_t i = 0; i < numberOfStreams; i++)
+        {
+            auto stream = make_shared<StreamDescription>();
+            stream->m_name = i == 0 ? L"input" : L"input" + to_wstring(i);
+            stream->m_id = i;
+            stream->m_storageType = StorageType::dense;
+            stream->m_elementType = ElementType::tfloat;
+            stream->m_sampleLayout = make_shared<TensorShape>(1);
+            m_streams.push_back(stream);
+        }
+    }
+
+    vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    void StartEpoch(const EpochConfiguration&) override
+    {
+        m_next = 0;
+    }
+
+    Sequences GetNextSequences(size_t sampleCount) override
+    {
+        Sequences result;
+        result.m_data.resize(m_streams.size());
+        size_t samples = 0;
+        while (m_next < m_sequenceData.size() &&
+               (result.m_data[0].empty() || samples + m_sequenceData[m_next].size() <= sampleCount))
+        {
+            for (const auto& stream : m_streams)
+            {
+                auto data = make_shared<DenseSequenceData>();
+                data->m_data = &m_sequenceData[m_next][0];
+                data->m_numberOfSamples = (uint32_t)m_sequenceData[m_next].size();
+                data->m_sampleLayout = stream->m_sampleLayout;
+                result.m_data[stream->m_id].push_back(data);
+            }
+            samples += m_sequenceData[m_next++].size();
+        }
+
+        result.m_endOfEpoch = m_next == m_sequenceData.size();
+        return result;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(SequencePackerBucketing)
+{
+    vector<uint32_t> lengths;
+    for (size_t i = 0; i < 16; i++)
+    {
+        lengths.push_back(i % 2 ? 4 : 1);
+    }
+
+    auto enumerator = make_shared<MockSequenceEnumerator>(lengths);
+    auto packer = make_shared<SequencePacker>(make_shared<HeapMemoryProvider>(), enumerator, enumerator->GetStreamDescriptions(), 4);
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 8;
+    epochConfiguration.m_totalEpochSizeInSamples = 40;
+    epochConfiguration.m_epochIndex = 0;
+    epochConfiguration.m_truncationSize = 0;
+    epochConfiguration.m_numberOfBuffers = 1;
+    epochConfiguration.m_deviceId = CPUDEVICE;
+    enumerator->StartEpoch(epochConfiguration);
+    packer->StartEpoch(epochConfiguration);
+
+    // Sequences of equal length are packed together, so the minibatches have no gaps,
+    // and every sequence is returned exactly once.
+    vector<size_t> counts(lengths.size(), 0);
+    for (;;)
+    {
+        auto minibatch = packer->ReadMinibatch();
+        if (!minibatch.m_data.empty())
+        {
+            const auto& layout = minibatch.m_data.front()->m_layout;
+            const float* values = reinterpret_cast<const float*>(minibatch.m_data.front()->m_data);
+            BOOST_CHECK_EQUAL(layout->GetActualNumSamples(), layout->GetNumCols());
+            for (const auto& sequence : layout->GetAllSequences())
+            {
+                size_t id = (size_t)values[layout->GetColumnIndex(sequence, 0)];
+                BOOST_REQUIRE_LT(id, lengths.size());
+                BOOST_CHECK_EQUAL(sequence.GetNumTimeSteps(), lengths[id]);
+                counts[id]++;
+            }
+        }
+
+        if (minibatch.m_endOfEpoch)
+        {
+            break;
+        }
+    }
+
+    BOOST_CHECK(all_of(counts.begin(), counts.end(), [](size_t c) { return c == 1; }));
+}
+
+// With several workers, the buckets are filled up to this worker's share of the minibatch,
+// and the workers together read every sequence once.
+BOOST_AUTO_TEST_CASE(SequencePackerBucketingMultipleWorkers)
+{
+    vector<float> data(24);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(4, 6, data, 2);
+
+    const size_t numberOfWorkers = 2;
+    const size_t minibatchSize = 8;
+    vector<size_t> counts(data.size(), 0);
+    for (size_t rank = 0; rank < numberOfWorkers; rank++)
+    {
+        auto randomizer = make_shared<NoRandomizer>(mockDeserializer);
+        auto packer = make_shared<SequencePacker>(make_shared<HeapMemoryProvider>(), randomizer, mockDeserializer->GetStreamDescriptions(), 4);
+
+        EpochConfiguration epochConfiguration;
+        epochConfiguration.m_numberOfWorkers = numberOfWorkers;
+        epochConfiguration.m_workerRank = rank;
+        epochConfiguration.m_minibatchSizeInSamples = minibatchSize;
+        epochConfiguration.m_totalEpochSizeInSamples = data.size() * 2;
+        epochConfiguration.m_epochIndex = 0;
+        epochConfiguration.m_truncationSize = 0;
+        randomizer->StartEpoch(epochConfiguration);
+        packer->StartEpoch(epochConfiguration);
+
+        size_t workerSamples = 0;
+        for (;;)
+        {
+            auto minibatch = packer->ReadMinibatch();
+            if (!minibatch.m_data.empty())
+            {
+                const auto& layout = minibatch.m_data.front()->m_layout;
+                const float* values = reinterpret_cast<const float*>(minibatch.m_data.front()->m_data);
+                BOOST_CHECK_LE(layout->GetActualNumSamples(), minibatchSize / numberOfWorkers);
+                workerSamples += layout->GetActualNumSamples();
+                for (const auto& sequence : layout->GetAllSequences())
+                {
+                    size_t id = (size_t)values[layout->GetColumnIndex(sequence, 0)];
+                    BOOST_REQUIRE_LT(id, data.size());
+                    counts[id]++;
+                }
+            }
+
+            if (minibatch.m_endOfEpoch)
+            {
+                break;
+            }
+        }
+
+        BOOST_CHECK_EQUAL(workerSamples, data.size() * 2 / numberOfWorkers);
+    }
+
+    BOOST_CHECK(all_of(counts.begin(), counts.end(), [](size_t c) { return c == 1; }));
+}
+
+// Maps each value x of a dense sequence to x * m_scale + m_shift, and throws for the sequence starting with m_failingValue.
+class MockTransformer : public Transformer
+{
+    // Owns the transformed values.
+    struct TransformedSequenceData : DenseSequenceData
+    {
+        vector<float> m_values;
+    };
+
+    float m_scale;
+    float m_shift;
+    float m_failingValue;
+
+public:
+    MockTransformer(float scale, float shift, float failingValue = numeric_limits<float>::quiet_NaN())
+        : m_scale(scale), m_shift(shift), m_failingValue(failingValue)
+    {
+    }
+
+    void StartEpoch(const EpochConfiguration&) override
+    {
+    }
+
+    StreamDescription Transform(const StreamDescription& inputStream) override
+    {
+        return inputStream;
+    }
+
+    SequenceDataPtr Transform(SequenceDataPtr inputSequence) override
+    {
+        const auto& input = static_cast<const DenseSequenceData&>(*inputSequence);
+        const float* values = reinterpret_cast<const float*>(input.m_data);
+        if (values[0] == m_failingValue)
+        {
+            RuntimeError("Transformation failed");
+        }
+
+        auto result = make_shared<TransformedSequenceData>();
+        result->m_values.resize(input.m_numberOfSamples);
+        for (size_t i = 0; i < result->m_values.size(); i++)
+        {
+            result->m_values[i] = values[i] * m_scale + m_shift;
+        }
+
+        result->m_data = result->m_values.data();
+        result->m_numberOfSamples = input.m_numberOfSamples;
+        result->m_sampleLayout = input.m_sampleLayout;
+        return result;
+    }
+};
+
+// The transformations of a stream are applied in order, each stream only gets its own transformations,
+// and the sequences keep their order although the tasks run largest first on several threads.
+BOOST_AUTO_TEST_CASE(TransformControllerAppliesTransformationsInOrder)
+{
+    vector<uint32_t> lengths;
+    for (size_t i = 0; i < 64; i++)
+    {
+        lengths.push_back((uint32_t)(1 + (i * 7) % 13));
+    }
+
+    auto enumerator = make_shared<MockSequenceEnumerator>(lengths, 3);
+    vector<Transformation> transformations
+    {
+        Transformation{ make_shared<MockTransformer>(2.0f, 1.0f), L"input" },
+        Transformation{ make_shared<MockTransformer>(1.0f, -3.0f), L"input2" },
+        Transformation{ make_shared<MockTransformer>(3.0f, 0.0f), L"input" },
+        Transformation{ make_shared<MockTransformer>(-1.0f, 5.0f), L"input2" },
+    };
+    auto controller = make_shared<TransformController>(transformations, enumerator);
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_totalEpochSizeInSamples = 1000;
+    epochConfiguration.m_epochIndex = 0;
+    controller->StartEpoch(epochConfiguration);
+
+    auto sequences = controller->GetNextSequences(SIZE_MAX);
+    BOOST_REQUIRE_EQUAL(sequences.m_data.size(), 3);
+    for (size_t j = 0; j < lengths.size(); j++)
+    {
+        const float x = (float)j;
+        const float expected[] = { (x * 2 + 1) * 3, x, -(x - 3) + 5 };
+        for (size_t stream = 0; stream < 3; stream++)
+        {
+            BOOST_REQUIRE_EQUAL(sequences.m_data[stream].size(), lengths.size());
+            const auto& sequence = *sequences.m_data[stream][j];
+            BOOST_REQUIRE_EQUAL(sequence.m_numberOfSamples, lengths[j]);
+            const float* values = reinterpret_cast<const float*>(sequence.m_data);
+            for (size_t i = 0; i < lengths[j]; i++)
+            {
+                BOOST_CHECK_EQUAL(values[i], expected[stream]);
+            }
+        }
+    }
+
+    BOOST_CHECK(sequences.m_endOfEpoch);
+}
+
+BOOST_AUTO_TEST_CASE(TransformControllerRethrowsTransformationErrors)
+{
+    vector<uint32_t> lengths(32, 2);
+    auto enumerator = make_shared<MockSequenceEnumerator>(lengths, 2);
+    vector<Transformation> transformations
+    {
+        Transformation{ make_shared<MockTransformer>(1.0f, 0.0f), L"input" },
+        Transformation{ make_shared<MockTransformer>(1.0f, 0.0f, 17.0f), L"input1" },
+    };
+    auto controller = make_shared<TransformController>(transformations, enumerator);
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_totalEpochSizeInSamples = 1000;
+    epochConfiguration.m_epochIndex = 0;
+    controller->StartEpoch(epochConfiguration);
+
+    BOOST_REQUIRE_EXCEPTION(
+        controller->GetNextSequences(SIZE_MAX),
+        std::runtime_error,
+        [](std::runtime_error const& ex) { return string("Transformation failed") == ex.what(); });
+}
+
 BOOST_AUTO_TEST_CASE(DefaultCorpusDescriptor)
 {
     const int seed = 13;